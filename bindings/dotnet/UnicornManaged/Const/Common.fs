@@ -107,6 +107,22 @@ module Common =
     let UC_QUERY_PAGE_SIZE = 2
     let UC_QUERY_ARCH = 3
     let UC_QUERY_TIMEOUT = 4
+    let UC_QUERY_TB_TRANSLATED = 5
+    let UC_QUERY_TB_REUSED = 6
+    let UC_QUERY_TB_FLUSHES = 7
+    let UC_QUERY_TB_EVICTED = 8
+    let UC_QUERY_CODE_BUFFER_SIZE = 9
+    let UC_QUERY_CODE_BUFFER_USED = 10
+    let UC_QUERY_TLB_SIZE = 11
+    let UC_QUERY_TLB_HITS = 12
+    let UC_QUERY_TLB_MISSES = 13
+    let UC_QUERY_TLB_FLUSHES = 14
+    let UC_OPT_HOOK_DIRECT = 1
+    let UC_OPT_FASTMEM = 2
+    let UC_OPT_CODE_BUFFER_SIZE = 3
+    let UC_OPT_TLB_SIZE = 4
+    let UC_OPT_TLB_COUNT_HITS = 5
+    let UC_OPT_PROFILE = 6
 
     let UC_PROT_NONE = 0
     let UC_PROT_READ = 1
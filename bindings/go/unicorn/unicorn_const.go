@@ -102,6 +102,22 @@ const (
 	QUERY_PAGE_SIZE = 2
 	QUERY_ARCH = 3
 	QUERY_TIMEOUT = 4
+	QUERY_TB_TRANSLATED = 5
+	QUERY_TB_REUSED = 6
+	QUERY_TB_FLUSHES = 7
+	QUERY_TB_EVICTED = 8
+	QUERY_CODE_BUFFER_SIZE = 9
+	QUERY_CODE_BUFFER_USED = 10
+	QUERY_TLB_SIZE = 11
+	QUERY_TLB_HITS = 12
+	QUERY_TLB_MISSES = 13
+	QUERY_TLB_FLUSHES = 14
+	OPT_HOOK_DIRECT = 1
+	OPT_FASTMEM = 2
+	OPT_CODE_BUFFER_SIZE = 3
+	OPT_TLB_SIZE = 4
+	OPT_TLB_COUNT_HITS = 5
+	OPT_PROFILE = 6
 
 	PROT_NONE = 0
 	PROT_READ = 1
@@ -104,6 +104,22 @@ public interface UnicornConst {
    public static final int UC_QUERY_PAGE_SIZE = 2;
    public static final int UC_QUERY_ARCH = 3;
    public static final int UC_QUERY_TIMEOUT = 4;
+   public static final int UC_QUERY_TB_TRANSLATED = 5;
+   public static final int UC_QUERY_TB_REUSED = 6;
+   public static final int UC_QUERY_TB_FLUSHES = 7;
+   public static final int UC_QUERY_TB_EVICTED = 8;
+   public static final int UC_QUERY_CODE_BUFFER_SIZE = 9;
+   public static final int UC_QUERY_CODE_BUFFER_USED = 10;
+   public static final int UC_QUERY_TLB_SIZE = 11;
+   public static final int UC_QUERY_TLB_HITS = 12;
+   public static final int UC_QUERY_TLB_MISSES = 13;
+   public static final int UC_QUERY_TLB_FLUSHES = 14;
+   public static final int UC_OPT_HOOK_DIRECT = 1;
+   public static final int UC_OPT_FASTMEM = 2;
+   public static final int UC_OPT_CODE_BUFFER_SIZE = 3;
+   public static final int UC_OPT_TLB_SIZE = 4;
+   public static final int UC_OPT_TLB_COUNT_HITS = 5;
+   public static final int UC_OPT_PROFILE = 6;
 
    public static final int UC_PROT_NONE = 0;
    public static final int UC_PROT_READ = 1;
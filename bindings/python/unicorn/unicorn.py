@@ -106,6 +106,7 @@ def _setup_prototype(lib, fname, restype, *argtypes):
 ucerr = ctypes.c_int
 uc_engine = ctypes.c_void_p
 uc_context = ctypes.c_void_p
+uc_snapshot = ctypes.c_void_p
 uc_hook_h = ctypes.c_size_t
 
 class _uc_mem_region(ctypes.Structure):
@@ -115,11 +116,48 @@ class _uc_mem_region(ctypes.Structure):
         ("perms", ctypes.c_uint32),
     ]
 
+class _uc_mem_dirty(ctypes.Structure):
+    _fields_ = [
+        ("begin", ctypes.c_uint64),
+        ("end",   ctypes.c_uint64),
+        ("pages", ctypes.POINTER(ctypes.c_uint64)),
+    ]
+
+class uc_stats(ctypes.Structure):
+    _fields_ = [
+        ("tb_translated",   ctypes.c_uint64),
+        ("tb_guest_bytes",  ctypes.c_uint64),
+        ("tb_host_bytes",   ctypes.c_uint64),
+        ("tb_fast_hits",    ctypes.c_uint64),
+        ("tb_slow_lookups", ctypes.c_uint64),
+        ("tb_flushes",      ctypes.c_uint64),
+        ("tb_evicted",      ctypes.c_uint64),
+        ("tb_invalidated",  ctypes.c_uint64),
+        ("tlb_fills",       ctypes.c_uint64),
+        ("tlb_misses",      ctypes.c_uint64),
+        ("tlb_flushes",     ctypes.c_uint64),
+        ("hook_calls",      ctypes.c_uint64 * 32),
+        ("translate_ns",    ctypes.c_uint64),
+        ("execute_ns",      ctypes.c_uint64),
+    ]
+
+class uc_tb_profile(ctypes.Structure):
+    _fields_ = [
+        ("address",   ctypes.c_uint64),
+        ("size",      ctypes.c_uint32),
+        ("host_size", ctypes.c_uint32),
+        ("count",     ctypes.c_uint64),
+    ]
+
 
 _setup_prototype(_uc, "uc_version", ctypes.c_uint, ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_int))
 _setup_prototype(_uc, "uc_arch_supported", ctypes.c_bool, ctypes.c_int)
 _setup_prototype(_uc, "uc_open", ucerr, ctypes.c_uint, ctypes.c_uint, ctypes.POINTER(uc_engine))
 _setup_prototype(_uc, "uc_close", ucerr, uc_engine)
+_setup_prototype(_uc, "uc_fork", ucerr, uc_engine, ctypes.POINTER(uc_engine))
+_setup_prototype(_uc, "uc_snapshot_take", ucerr, uc_engine, ctypes.POINTER(uc_snapshot))
+_setup_prototype(_uc, "uc_snapshot_restore", ucerr, uc_engine, uc_snapshot)
+_setup_prototype(_uc, "uc_snapshot_free", ucerr, uc_snapshot)
 _setup_prototype(_uc, "uc_strerror", ctypes.c_char_p, ucerr)
 _setup_prototype(_uc, "uc_errno", ucerr, uc_engine)
 _setup_prototype(_uc, "uc_reg_read", ucerr, uc_engine, ctypes.c_int, ctypes.c_void_p)
@@ -131,15 +169,26 @@ _setup_prototype(_uc, "uc_emu_stop", ucerr, uc_engine)
 _setup_prototype(_uc, "uc_hook_del", ucerr, uc_engine, uc_hook_h)
 _setup_prototype(_uc, "uc_mem_map", ucerr, uc_engine, ctypes.c_uint64, ctypes.c_size_t, ctypes.c_uint32)
 _setup_prototype(_uc, "uc_mem_map_ptr", ucerr, uc_engine, ctypes.c_uint64, ctypes.c_size_t, ctypes.c_uint32, ctypes.c_void_p)
+_setup_prototype(_uc, "uc_mem_map_batch", ucerr, uc_engine, ctypes.POINTER(_uc_mem_region), ctypes.c_uint32)
+_setup_prototype(_uc, "uc_mem_get_ptr", ucerr, uc_engine, ctypes.c_uint64, ctypes.POINTER(ctypes.c_void_p), ctypes.POINTER(ctypes.c_size_t))
+_setup_prototype(_uc, "uc_mem_code_written", ucerr, uc_engine, ctypes.c_uint64, ctypes.c_size_t)
 _setup_prototype(_uc, "uc_mem_unmap", ucerr, uc_engine, ctypes.c_uint64, ctypes.c_size_t)
 _setup_prototype(_uc, "uc_mem_protect", ucerr, uc_engine, ctypes.c_uint64, ctypes.c_size_t, ctypes.c_uint32)
 _setup_prototype(_uc, "uc_query", ucerr, uc_engine, ctypes.c_uint32, ctypes.POINTER(ctypes.c_size_t))
+_setup_prototype(_uc, "uc_option", ucerr, uc_engine, ctypes.c_uint32, ctypes.c_size_t)
+_setup_prototype(_uc, "uc_stats_get", ucerr, uc_engine, ctypes.POINTER(uc_stats))
+_setup_prototype(_uc, "uc_profile_get", ucerr, uc_engine, ctypes.POINTER(uc_tb_profile), ctypes.c_size_t, ctypes.POINTER(ctypes.c_size_t))
+_setup_prototype(_uc, "uc_profile_reset", ucerr, uc_engine)
 _setup_prototype(_uc, "uc_context_alloc", ucerr, uc_engine, ctypes.POINTER(uc_context))
+_setup_prototype(_uc, "uc_context_alloc_user", ucerr, uc_engine, ctypes.POINTER(uc_context))
 _setup_prototype(_uc, "uc_free", ucerr, ctypes.c_void_p)
 _setup_prototype(_uc, "uc_context_save", ucerr, uc_engine, uc_context)
 _setup_prototype(_uc, "uc_context_restore", ucerr, uc_engine, uc_context)
 _setup_prototype(_uc, "uc_context_size", ctypes.c_size_t, uc_engine)
 _setup_prototype(_uc, "uc_mem_regions", ucerr, uc_engine, ctypes.POINTER(ctypes.POINTER(_uc_mem_region)), ctypes.POINTER(ctypes.c_uint32))
+_setup_prototype(_uc, "uc_mem_dirty_start", ucerr, uc_engine)
+_setup_prototype(_uc, "uc_mem_dirty_get", ucerr, uc_engine, ctypes.POINTER(ctypes.POINTER(_uc_mem_dirty)), ctypes.POINTER(ctypes.c_uint32))
+_setup_prototype(_uc, "uc_mem_dirty_reset", ucerr, uc_engine)
 
 # uc_hook_add is special due to variable number of arguments
 _uc.uc_hook_add = _uc.uc_hook_add
@@ -279,6 +328,9 @@ class UcCleanupManager(object):
 
 class Uc(object):
     _cleanup = UcCleanupManager()
+    # the engines by handle: hooks inherited by uc_fork() call back the
+    # methods of the engine forked from, with the handle of the new one
+    _engines = weakref.WeakValueDictionary()
 
     def __init__(self, arch, mode):
         # verify version compatibility with the core before doing anything
@@ -299,6 +351,7 @@ class Uc(object):
         self._ctype_cbs = {}
         self._callback_count = 0
         self._cleanup.register(self)
+        self._engines[self._uch.value] = self
 
     @staticmethod
     def release_handle(uch):
@@ -310,6 +363,27 @@ class Uc(object):
             except:  # _uc might be pulled from under our feet
                 pass
 
+    # a new engine in the same state, see uc_fork()
+    def fork(self):
+        child = self.__class__.__new__(self.__class__)
+        child._arch, child._mode = self._arch, self._mode
+        child._uch = ctypes.c_void_p()
+        status = _uc.uc_fork(self._uch, ctypes.byref(child._uch))
+        if status != uc.UC_ERR_OK:
+            child._uch = None
+            raise UcError(status)
+        # the inherited hooks keep their callbacks alive
+        child._callbacks = dict(self._callbacks)
+        child._ctype_cbs = dict(self._ctype_cbs)
+        child._callback_count = self._callback_count
+        child._cleanup.register(child)
+        self._engines[child._uch.value] = child
+        return child
+
+    # the engine of @handle, to pass to the callbacks of hooks
+    def _engine(self, handle):
+        return self._engines.get(handle, self)
+
     # emulate from @begin, and stop when reaching address @until
     def emu_start(self, begin, until, timeout=0, count=0):
         status = _uc.uc_emu_start(self._uch, begin, until, timeout, count)
@@ -435,6 +509,15 @@ class Uc(object):
             raise UcError(status)
         return bytearray(data)
 
+    # host address of memory, and how many bytes are contiguous there
+    def mem_get_ptr(self, address):
+        ptr = ctypes.c_void_p()
+        size = ctypes.c_size_t()
+        status = _uc.uc_mem_get_ptr(self._uch, address, ctypes.byref(ptr), ctypes.byref(size))
+        if status != uc.UC_ERR_OK:
+            raise UcError(status)
+        return (ptr.value, size.value)
+
     # write to memory
     def mem_write(self, address, data):
         status = _uc.uc_mem_write(self._uch, address, data, len(data))
@@ -453,6 +536,15 @@ class Uc(object):
         if status != uc.UC_ERR_OK:
             raise UcError(status)
 
+    # map many ranges of memory at once, given as (begin, end, perms) with
+    # @end inclusive, as returned by mem_regions()
+    def mem_map_batch(self, regions):
+        regions = list(regions)
+        array = (_uc_mem_region * len(regions))(*regions)
+        status = _uc.uc_mem_map_batch(self._uch, array, len(regions))
+        if status != uc.UC_ERR_OK:
+            raise UcError(status)
+
     # unmap a range of memory
     def mem_unmap(self, address, size):
         status = _uc.uc_mem_unmap(self._uch, address, size)
@@ -465,6 +557,12 @@ class Uc(object):
         if status != uc.UC_ERR_OK:
             raise UcError(status)
 
+    # drop the code translated from memory modified by the host
+    def mem_code_written(self, address, size):
+        status = _uc.uc_mem_code_written(self._uch, address, size)
+        if status != uc.UC_ERR_OK:
+            raise UcError(status)
+
     # return CPU mode at runtime
     def query(self, query_mode):
         result = ctypes.c_size_t(0)
@@ -473,45 +571,74 @@ class Uc(object):
             raise UcError(status)
         return result.value
 
+    # set option of the engine at runtime
+    def option(self, opt_type, value):
+        status = _uc.uc_option(self._uch, opt_type, value)
+        if status != uc.UC_ERR_OK:
+            raise UcError(status)
+
+    # statistics of the engine since it was opened
+    def stats(self):
+        result = uc_stats()
+        status = _uc.uc_stats_get(self._uch, ctypes.byref(result))
+        if status != uc.UC_ERR_OK:
+            raise UcError(status)
+        return result
+
+    # the @count blocks run most with UC_OPT_PROFILE, hottest first
+    def profile(self, count):
+        blocks = (uc_tb_profile * count)()
+        found = ctypes.c_size_t()
+        status = _uc.uc_profile_get(self._uch, blocks, count, ctypes.byref(found))
+        if status != uc.UC_ERR_OK:
+            raise UcError(status)
+        return blocks[:found.value]
+
+    # forget the runs counted so far
+    def profile_reset(self):
+        status = _uc.uc_profile_reset(self._uch)
+        if status != uc.UC_ERR_OK:
+            raise UcError(status)
+
     def _hookcode_cb(self, handle, address, size, user_data):
-        # call user's callback with self object
+        # call user's callback with the engine object
         (cb, data) = self._callbacks[user_data]
-        cb(self, address, size, data)
+        cb(self._engine(handle), address, size, data)
 
     def _hook_mem_invalid_cb(self, handle, access, address, size, value, user_data):
-        # call user's callback with self object
+        # call user's callback with the engine object
         (cb, data) = self._callbacks[user_data]
-        return cb(self, access, address, size, value, data)
+        return cb(self._engine(handle), access, address, size, value, data)
 
     def _hook_mem_access_cb(self, handle, access, address, size, value, user_data):
-        # call user's callback with self object
+        # call user's callback with the engine object
         (cb, data) = self._callbacks[user_data]
-        cb(self, access, address, size, value, data)
+        cb(self._engine(handle), access, address, size, value, data)
 
     def _hook_intr_cb(self, handle, intno, user_data):
-        # call user's callback with self object
+        # call user's callback with the engine object
         (cb, data) = self._callbacks[user_data]
-        cb(self, intno, data)
+        cb(self._engine(handle), intno, data)
 
     def _hook_insn_invalid_cb(self, handle, user_data):
-        # call user's callback with self object
+        # call user's callback with the engine object
         (cb, data) = self._callbacks[user_data]
-        return cb(self, data)
+        return cb(self._engine(handle), data)
 
     def _hook_insn_in_cb(self, handle, port, size, user_data):
-        # call user's callback with self object
+        # call user's callback with the engine object
         (cb, data) = self._callbacks[user_data]
-        return cb(self, port, size, data)
+        return cb(self._engine(handle), port, size, data)
 
     def _hook_insn_out_cb(self, handle, port, size, value, user_data):
-        # call user's callback with self object
+        # call user's callback with the engine object
         (cb, data) = self._callbacks[user_data]
-        cb(self, port, size, value, data)
+        cb(self._engine(handle), port, size, value, data)
 
     def _hook_insn_syscall_cb(self, handle, user_data):
-        # call user's callback with self object
+        # call user's callback with the engine object
         (cb, data) = self._callbacks[user_data]
-        cb(self, data)
+        cb(self._engine(handle), data)
 
     # add a hook
     def hook_add(self, htype, callback, user_data=None, begin=1, end=0, arg1=0):
@@ -595,8 +722,9 @@ class Uc(object):
             raise UcError(status)
         h = 0
 
-    def context_save(self):
-        context = UcContext(self._uch)
+    # user=True saves only the user-visible registers, see uc_context_alloc_user()
+    def context_save(self, user=False):
+        context = UcContext(self._uch, user)
         status = _uc.uc_context_save(self._uch, context.context)
         if status != uc.UC_ERR_OK:
             raise UcError(status)
@@ -627,12 +755,56 @@ class Uc(object):
         finally:
             _uc.uc_free(regions)
 
+    # track the pages of memory written to, see uc_mem_dirty_start()
+    def mem_dirty_start(self):
+        status = _uc.uc_mem_dirty_start(self._uch)
+        if status != uc.UC_ERR_OK:
+            raise UcError(status)
+
+    # this returns a generator of regions in the form (begin, end, pages),
+    # @pages listing the addresses of the pages written to
+    def mem_dirty(self):
+        page_size = self.query(uc.UC_QUERY_PAGE_SIZE)
+        regions = ctypes.POINTER(_uc_mem_dirty)()
+        count = ctypes.c_uint32()
+        status = _uc.uc_mem_dirty_get(self._uch, ctypes.byref(regions), ctypes.byref(count))
+        if status != uc.UC_ERR_OK:
+            raise UcError(status)
+
+        try:
+            for i in range(count.value):
+                r = regions[i]
+                pages = [r.begin + n * page_size
+                         for n in range((r.end - r.begin + 1) // page_size)
+                         if r.pages[n // 64] >> (n % 64) & 1]
+                yield (r.begin, r.end, pages)
+        finally:
+            _uc.uc_free(regions)
+
+    # mark all pages clean
+    def mem_dirty_reset(self):
+        status = _uc.uc_mem_dirty_reset(self._uch)
+        if status != uc.UC_ERR_OK:
+            raise UcError(status)
+
+    # save the memory & registers, see uc_snapshot_take()
+    def snapshot_take(self):
+        return UcSnapshot(self._uch)
+
+    def snapshot_restore(self, snapshot):
+        status = _uc.uc_snapshot_restore(self._uch, snapshot.snapshot)
+        if status != uc.UC_ERR_OK:
+            raise UcError(status)
+
 
 class UcContext(ctypes.Structure):
-    def __init__(self, h):
+    def __init__(self, h, user=False):
         self.context = uc_context()
 
-        status = _uc.uc_context_alloc(h, ctypes.byref(self.context))
+        if user:
+            status = _uc.uc_context_alloc_user(h, ctypes.byref(self.context))
+        else:
+            status = _uc.uc_context_alloc(h, ctypes.byref(self.context))
         if status != uc.UC_ERR_OK:
             raise UcError(status)
 
@@ -640,6 +812,18 @@ class UcContext(ctypes.Structure):
         _uc.uc_free(self.context)
 
 
+# can be freed before or after the engine it was taken of
+class UcSnapshot(object):
+    def __init__(self, h):
+        self.snapshot = uc_snapshot()
+        status = _uc.uc_snapshot_take(h, ctypes.byref(self.snapshot))
+        if status != uc.UC_ERR_OK:
+            raise UcError(status)
+
+    def __del__(self):
+        _uc.uc_snapshot_free(self.snapshot)
+
+
 # print out debugging info
 def debug():
     archs = {
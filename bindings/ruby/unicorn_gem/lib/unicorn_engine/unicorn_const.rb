@@ -102,6 +102,22 @@ module UnicornEngine
 	UC_QUERY_PAGE_SIZE = 2
 	UC_QUERY_ARCH = 3
 	UC_QUERY_TIMEOUT = 4
+	UC_QUERY_TB_TRANSLATED = 5
+	UC_QUERY_TB_REUSED = 6
+	UC_QUERY_TB_FLUSHES = 7
+	UC_QUERY_TB_EVICTED = 8
+	UC_QUERY_CODE_BUFFER_SIZE = 9
+	UC_QUERY_CODE_BUFFER_USED = 10
+	UC_QUERY_TLB_SIZE = 11
+	UC_QUERY_TLB_HITS = 12
+	UC_QUERY_TLB_MISSES = 13
+	UC_QUERY_TLB_FLUSHES = 14
+	UC_OPT_HOOK_DIRECT = 1
+	UC_OPT_FASTMEM = 2
+	UC_OPT_CODE_BUFFER_SIZE = 3
+	UC_OPT_TLB_SIZE = 4
+	UC_OPT_TLB_COUNT_HITS = 5
+	UC_OPT_PROFILE = 6
 
 	UC_PROT_NONE = 0
 	UC_PROT_READ = 1
@@ -26,13 +26,16 @@ typedef struct RAMBlock {
     ram_addr_t length;
     uint32_t flags;
     char idstr[256];
-    /* Reads can take either the iothread or the ramlist lock.
-     * Writes must take both locks.
-     */
-    QTAILQ_ENTRY(RAMBlock) next;
+    unsigned long *dirty_memory[DIRTY_MEMORY_NUM];  // one bit per page of the block
     int fd;
 } RAMBlock;
 
+// Unicorn: a free range of ram_addr_t between two RAM blocks
+typedef struct RAMGap {
+    ram_addr_t offset;
+    ram_addr_t length;
+} RAMGap;
+
 typedef struct {
     MemoryRegion *mr;
     void *buffer;
@@ -41,10 +44,12 @@ typedef struct {
 } BounceBuffer;
 
 typedef struct RAMList {
-    /* Protected by the iothread lock.  */
-    unsigned long *dirty_memory[DIRTY_MEMORY_NUM];
     RAMBlock *mru_block;
-    QTAILQ_HEAD(, RAMBlock) blocks;
+    RAMBlock **blocks;      // sorted by offset, see qemu_get_ram_block()
+    RAMBlock **by_host;     // the same, sorted by host, see qemu_ram_addr_from_host()
+    size_t blocks_nb, blocks_alloc;
+    RAMGap *gaps;       // the free ranges below the last block, by length then offset
+    size_t gaps_nb, gaps_alloc;
     uint32_t version;
 } RAMList;
 
@@ -73,6 +73,9 @@ typedef void (*uc_mem_unmap_t)(struct uc_struct*, MemoryRegion *mr);
 
 typedef void (*uc_readonly_mem_t)(MemoryRegion *mr, bool readonly);
 
+// invalidate translated code of guest memory [start, start + len)
+typedef void (*uc_invalidate_tb_t)(struct uc_struct *uc, uint64_t start, size_t len);
+
 // which interrupt should make emulation stop?
 typedef bool (*uc_args_int_t)(int intno);
 
@@ -82,6 +85,21 @@ typedef uint64_t (*uc_mem_redirect_t)(uint64_t address);
 // validate if Unicorn supports hooking a given instruction
 typedef bool(*uc_insn_hook_validate)(uint32_t insn_enum);
 
+// copy the user-visible CPU state to/from a context, see uc_context_alloc_user()
+typedef void (*uc_context_user_save_t)(struct uc_struct *uc, void *data);
+typedef void (*uc_context_user_restore_t)(struct uc_struct *uc, const void *data);
+
+// resize the TLB of each MMU mode, false if @entries is not supported
+typedef bool (*uc_tlb_resize_t)(struct uc_struct *uc, size_t entries);
+
+// set in @bitmap the pages of RAM [start, start + len) written to, as seen by
+// @client, DIRTY_MEMORY_USER or DIRTY_MEMORY_SNAPSHOT
+typedef void (*uc_dirty_get_t)(struct uc_struct *uc, unsigned client, uint64_t start, size_t len,
+        uint64_t *bitmap);
+
+// all RAM clean for @client, the next writes caught again
+typedef void (*uc_dirty_reset_t)(struct uc_struct *uc, unsigned client);
+
 struct hook {
     int type;            // UC_HOOK_*
     int insn;            // instruction for HOOK_INSN
@@ -124,23 +142,64 @@ enum uc_hook_idx {
         cur != NULL && ((hh) = (struct hook *)cur->data); \
         cur = cur->next)
 
+#define HOOK_FOREACH_BOUNDED_VAR_DECLARE                  \
+    struct hook **hook_cur, **hook_last
+
+// for loop macro to loop over the hooks whose range covers @addr,
+// in hook list order. Uses the address index of the hook list
+#define HOOK_FOREACH_BOUNDED(uc, hh, idx, addr)                          \
+    for (                                                                \
+        hook_cur = hook_index_find(uc, idx##_IDX, addr, &hook_last);     \
+        hook_cur < hook_last && ((hh) = *hook_cur);                      \
+        hook_cur++)
+
 // if statement to check hook bounds
 #define HOOK_BOUND_CHECK(hh, addr)                  \
     ((((addr) >= (hh)->begin && (addr) <= (hh)->end) \
         || (hh)->begin > (hh)->end) && !((hh)->to_delete))
 
+// hook types that are looked up when translating code, so translated code
+// must be thrown away when such a hook is added or removed
+#define UC_HOOK_TB_DEPENDENT (UC_HOOK_CODE | UC_HOOK_BLOCK | UC_HOOK_MEM_READ | UC_HOOK_MEM_READ_AFTER | UC_HOOK_MEM_WRITE)
+
+// hook types marked in the TLB entries of the pages they cover, so the TLB
+// must be flushed when such a hook is added or removed, see tlb_set_page()
+#define UC_HOOK_TLB_DEPENDENT (UC_HOOK_MEM_READ | UC_HOOK_MEM_READ_AFTER | UC_HOOK_MEM_WRITE)
+
+// the callback of hook @hh as a @type function, counting the call for uc_stats_get()
+#define HOOK_CALLBACK(uc, hh, idx, type) \
+    ((uc)->hook_calls[idx##_IDX]++, (type)(hh)->callback)
+
 #define HOOK_EXISTS(uc, idx) ((uc)->hook[idx##_IDX].head != NULL)
-#define HOOK_EXISTS_BOUNDED(uc, idx, addr) _hook_exists_bounded((uc)->hook[idx##_IDX].head, addr)
+#define HOOK_EXISTS_BOUNDED(uc, idx, addr) _hook_exists_bounded(uc, idx##_IDX, addr)
+// whether hooks of list @idx cover some address of [begin, end]
+#define HOOK_EXISTS_RANGE(uc, idx, begin, end) _hook_exists_range(uc, idx##_IDX, begin, end)
+
+// address index of a hook list: the address space is cut into segments
+// at every hook boundary, and each segment points to the hooks covering
+// it, in list order. Updated lazily after the hook list changes, only in
+// the address range of the hooks added or deleted.
+struct hook_index_seg {
+    uint64_t begin;     // segment spans [begin, begin of the next segment)
+    uint32_t first;     // first hook of this segment in hook_index.hooks
+    uint32_t count;     // number of hooks covering this segment
+};
 
-static inline bool _hook_exists_bounded(struct list_item *cur, uint64_t addr)
-{
-    while (cur != NULL) {
-        if (HOOK_BOUND_CHECK((struct hook *)cur->data, addr))
-            return true;
-        cur = cur->next;
-    }
-    return false;
-}
+struct hook_index {
+    struct hook_index_seg *segs;    // sorted by begin, segs[0].begin == 0
+    uint32_t seg_count;
+    struct hook **hooks;
+    bool dirty;     // hook list changed since the index was built
+    uint64_t dirty_begin, dirty_end;    // where it changed, if @dirty
+};
+
+// runs of a block in the profile, see UC_OPT_PROFILE. A block is told
+// apart by its address & the CPU flags it was translated with
+struct profile_block {
+    uc_tb_profile tb;
+    uint64_t flags;     // TranslationBlock.flags
+    uint64_t seq;       // TranslationBlock.seq of the last translation
+};
 
 //relloc increment, KEEP THIS A POWER OF 2!
 #define MEM_BLOCK_INCR 32
@@ -165,16 +224,35 @@ struct uc_struct {
     uc_args_int_uc_t vm_start;
     uc_args_tcg_enable_t tcg_enabled;
     uc_args_uc_long_t tcg_exec_init;
+    uc_args_uc_long_t tcg_exec_resize;  // reallocate translation buffer, only outside of emulation
     uc_args_uc_ram_size_t memory_map;
     uc_args_uc_ram_size_ptr_t memory_map_ptr;
     uc_mem_unmap_t memory_unmap;
+    uc_args_uc_t memory_begin, memory_commit;   // group memory map changes, see uc_mem_map_batch()
     uc_readonly_mem_t readonly_mem;
     uc_mem_redirect_t mem_redirect;
+    uc_args_uc_t tb_flush_all;      // flush translation cache, only outside of emulation
+    uc_invalidate_tb_t tb_invalidate_uc_range;
+    uc_invalidate_tb_t ram_written;     // uc_mem_write() copied to RAM at offset @start of ram_list
+    uc_args_uc_u64_t tb_invalidate_addr_end;    // invalidate TBs ending at @until address
+    uc_args_uc_t tb_profile_harvest;    // move the runs counted by TBs to @profile
+    uc_tlb_resize_t tlb_resize;     // see UC_OPT_TLB_SIZE, only outside of emulation
+    query_t tlb_query;      // TLB size & hits
+    uc_args_uc_t tlb_flush_all;     // see UC_HOOK_TLB_DEPENDENT
+    uc_dirty_get_t dirty_get;
+    uc_dirty_reset_t dirty_reset;
     // TODO: remove current_cpu, as it's a flag for something else ("cpu running"?)
     CPUState *cpu, *current_cpu;
 
     uc_insn_hook_validate insn_hook_validate;
 
+    size_t context_user_size;   // 0 if user contexts are not supported
+    uc_context_user_save_t context_user_save;
+    uc_context_user_restore_t context_user_restore;
+
+    uc_args_uc_t fastmem_update;    // set the RAM window of the CPU, NULL if fastmem is not supported
+    uc_args_uc_t env_copied;    // fix up the registers of uc->cpu copied from another engine, NULL if nothing to do
+
     MemoryRegion *system_memory;    // qemu/exec.c
     MemoryRegion io_mem_rom;    // qemu/exec.c
     MemoryRegion io_mem_notdirty;   // qemu/exec.c
@@ -193,6 +271,7 @@ struct uc_struct {
     /* memory.c */
     unsigned memory_region_transaction_depth;
     bool memory_region_update_pending;
+    bool memory_region_unassigned_stale;    // unassigned memory became RAM, see tlb_flush_memory()
     bool ioeventfd_update_pending;
     QTAILQ_HEAD(memory_listeners, MemoryListener) memory_listeners;
     QTAILQ_HEAD(, AddressSpace) address_spaces;
@@ -214,12 +293,11 @@ struct uc_struct {
     // linked lists containing hooks per type
     struct list hook[UC_HOOK_MAX];
     struct list hooks_to_del;
-
-    // hook to count number of instructions for uc_emu_start()
-    uc_hook count_hook;
-
-    size_t emu_counter; // current counter of uc_emu_start()
-    size_t emu_count; // save counter of uc_emu_start()
+    // address index of each hook list, see HOOK_FOREACH_BOUNDED
+    struct hook_index hook_index[UC_HOOK_MAX];
+    // hook_index.hooks arrays replaced while callbacks may still walk them,
+    // freed with the deleted hooks, see clear_deleted_hooks()
+    struct list hook_index_retired;
 
     uint64_t block_addr;    // save the last block address we hooked
 
@@ -228,10 +306,13 @@ struct uc_struct {
     bool init_tcg;      // already initialized local TCGv variables?
     bool stop_request;  // request to immediately stop emulation - for uc_emu_stop()
     bool quit_request;  // request to quit the current TB, but continue to emulate - for uc_mem_protect()
+    bool tb_flush_request;  // request to flush translated code before next uc_emu_start() - for uc_hook_add()
     bool emulation_done;  // emulation is done by uc_emu_start()
     bool timed_out;     // emulation timed out, that can retrieve via uc_query(UC_QUERY_TIMEOUT)
-    QemuThread timer;   // timer for emulation timeout
-    uint64_t timeout;   // timeout for uc_emu_start()
+    uint64_t timeout;   // timeout for uc_emu_start(), in nanoseconds
+    int64_t timeout_deadline;   // get_clock() when the current run times out
+    int64_t timeout_checked;    // get_clock() when the deadline was last checked
+    int32_t timeout_slice;      // instructions to run before checking the deadline again
 
     uint64_t invalid_addr;  // invalid address to be accessed
     int invalid_error;  // invalid memory code: 1 = READ, 2 = WRITE, 3 = CODE
@@ -250,6 +331,46 @@ struct uc_struct {
     uint32_t target_page_align;
     uint64_t next_pc;   // save next PC for some special cases
     bool hook_insert;	// insert new hook at begin of the hook list (append by default)
+    bool hook_direct;   // translated code calls code hooks directly, see UC_OPT_HOOK_DIRECT
+    bool fastmem;       // translated code accesses a RAM window directly, see UC_OPT_FASTMEM
+    bool fastmem_stale; // memory map changed since the window was chosen
+    MemoryRegion *fastmem_mr;   // region of the window, NULL if none
+    uint64_t fastmem_offset;    // the window: the pages from this offset in fastmem_mr,
+    uint64_t fastmem_size;      // all readable & writable
+    uint8_t *fastmem_code;      // per page of the window: 1 if translated code may be there, or writes are tracked
+    uint8_t dirty_clients;  // 1 << DIRTY_MEMORY_* of each client tracking writes to RAM
+    uint64_t snapshot_generation;   // bumped when a snapshot is taken or restored
+
+    uint64_t tb_translated; // number of TBs translated, for uc_query(UC_QUERY_TB_TRANSLATED)
+    uint64_t tb_reused;     // number of TB lookups served by already translated code
+    uint64_t tb_flushes;    // number of times all translated code was dropped
+    uint64_t tb_evicted;    // number of TBs dropped to make room in the translation buffer
+    size_t code_buffer_size;    // size of the translation buffer, see UC_OPT_CODE_BUFFER_SIZE
+    size_t code_buffer_used;    // bytes of the translation buffer holding translated code
+    size_t tlb_size;        // entries of the TLB of each MMU mode, 0 if following the working set
+    bool tlb_count_hits;    // translated code counts TLB hits, see UC_OPT_TLB_COUNT_HITS
+    uint64_t tlb_misses;    // number of lookups of the softmmu helpers missing the TLB
+    uint64_t tlb_flushes;   // number of times the whole TLB was dropped
+
+    // statistics for uc_stats_get(), on top of the counters above
+    uint64_t tb_guest_bytes;    // bytes of guest code translated
+    uint64_t tb_host_bytes;     // bytes of host code generated
+    uint64_t tb_fast_hits;      // TB lookups found in the tb_jmp_cache of the CPU
+    uint64_t tb_slow_lookups;   // TB lookups going to tb_find_slow()
+    uint64_t tb_invalidated;    // TBs dropped as guest stores wrote to their code
+    uint64_t tlb_fills;         // TLB entries set by tlb_set_page()
+    uint64_t hook_calls[UC_HOOK_MAX];   // callbacks called, per hook list
+    int64_t translate_ns;       // time spent in cpu_gen_code()
+    int64_t emu_ns;             // time spent in uc_emu_start() running the CPU
+
+    bool profile;       // translated code counts its runs, see UC_OPT_PROFILE
+    struct profile_block *profile_blocks;  // with duplicates until compacted
+    size_t profile_count, profile_size;
+
+    // RAM shared copy-on-write with the engines forked from this one, see uc_fork()
+    int fork_fd;        // file holding the RAM as it was at the last fork, -1 if none
+    uint64_t *fork_offsets;     // offset in @fork_fd of each mapped block, UINT64_MAX if not there
+    bool fork_frozen;   // RAM mapped from @fork_fd, unchanged since
 };
 
 // Metadata stub for the variable-size cpu context used with uc_context_*()
@@ -257,11 +378,121 @@ struct uc_struct {
 struct uc_context {
    size_t context_size;	// size of the real internal context structure
    unsigned int jmp_env_size; // size of cpu->jmp_env
-   char data[0]; // context + cpu->jmp_env
+   bool user; // only user-visible registers, in the arch format of uc->context_user_save()
+   char QEMU_ALIGN(16, data[0]); // context + cpu->jmp_env
+};
+
+// a region mapped when the snapshot was taken, see uc_snapshot_take()
+struct uc_snapshot_region {
+    MemoryRegion *mr;   // the region, if still the one mapped there
+    uint64_t addr;
+    uint64_t end;
+    uint32_t perms;
+    uint8_t *page_perms;    // perms of each page, NULL if they all have @perms
+    uint8_t *host;      // the memory given to uc_mem_map_ptr(), or NULL
+    uint8_t *data;      // the bytes of the region
+};
+
+struct uc_snapshot {
+    uint64_t generation;    // uc->snapshot_generation when taken or last restored
+    uint32_t region_count;
+    struct uc_snapshot_region *regions;     // sorted by address, like uc->mapped_blocks
+    uint64_t *dirty;    // room for the bitmap of written pages of any region
+    size_t context_size;
+    uint8_t *env;       // the registers, see cpu_context_size()
 };
 
 // check if this address is mapped in (via uc_mem_map())
 MemoryRegion *memory_mapping(struct uc_struct* uc, uint64_t address);
 
+// permissions of the page at @address of the region @mr, see uc_mem_protect()
+static inline uint32_t memory_region_perms(struct uc_struct *uc, MemoryRegion *mr, uint64_t address)
+{
+    if (mr->page_perms == NULL)
+        return mr->perms;
+
+    return mr->page_perms[(address - mr->addr) / uc->target_page_size];
+}
+
+// check the deadline of uc_emu_start(), and size the next slice of the budget
+bool emu_timeout_expired(struct uc_struct *uc);
+
+// serialize the guest atomics on the host RAM at @host which no host atomic
+// can make, across all engines of the process. Only around host accesses
+void uc_exclusive_start(const void *host);
+void uc_exclusive_end(const void *host);
+
+// the address index of hook list @idx is stale where @hook is, or
+// everywhere if @hook is NULL
+void hook_index_dirty(struct uc_struct *uc, int idx, struct hook *hook);
+
+// bring the address index of hook list @idx up to date
+void hook_index_rebuild(struct uc_struct *uc, int idx);
+
+// add @count runs of the block at @pc, translated with @flags as the @seq-th
+// TB, to the profile, see UC_OPT_PROFILE
+void uc_profile_keep(struct uc_struct *uc, uint64_t pc, uint64_t flags, uint64_t seq,
+        uint32_t size, uint32_t host_size, uint64_t count);
+
+// the last segment of @index beginning at or below @addr
+static inline uint32_t hook_index_seg(struct hook_index *index, uint64_t addr)
+{
+    uint32_t left = 0, right = index->seg_count, mid;
+
+    while (right - left > 1) {
+        mid = left + (right - left) / 2;
+        if (index->segs[mid].begin <= addr)
+            left = mid;
+        else
+            right = mid;
+    }
+
+    return left;
+}
+
+// find the hooks of list @idx covering @addr: they are in [result, *last)
+static inline struct hook **hook_index_find(struct uc_struct *uc, int idx, uint64_t addr, struct hook ***last)
+{
+    struct hook_index *index = &uc->hook_index[idx];
+    struct hook_index_seg *seg;
+
+    if (index->dirty)
+        hook_index_rebuild(uc, idx);
+
+    if (index->seg_count == 0) {
+        *last = NULL;
+        return NULL;
+    }
+
+    seg = &index->segs[hook_index_seg(index, addr)];
+    *last = index->hooks + seg->first + seg->count;
+    return index->hooks + seg->first;
+}
+
+static inline bool _hook_exists_bounded(struct uc_struct *uc, int idx, uint64_t addr)
+{
+    struct hook **last;
+    struct hook **cur = hook_index_find(uc, idx, addr, &last);
+
+    return cur < last;
+}
+
+static inline bool _hook_exists_range(struct uc_struct *uc, int idx, uint64_t begin, uint64_t end)
+{
+    struct hook_index *index = &uc->hook_index[idx];
+    uint32_t i;
+
+    if (index->dirty)
+        hook_index_rebuild(uc, idx);
+
+    // the segment of @begin, then those beginning up to @end
+    for (i = hook_index_seg(index, begin); i < index->seg_count && index->segs[i].begin <= end; i++) {
+        if (index->segs[i].count)
+            return true;
+    }
+
+    return false;
+}
+
 #endif
 /* vim: set ts=4 noet:  */
@@ -325,6 +325,17 @@ typedef struct uc_mem_region {
     uint32_t perms; // memory permissions of the region
 } uc_mem_region;
 
+/*
+  Pages of a memory region written since uc_mem_dirty_reset()
+  Retrieve them with uc_mem_dirty_get()
+*/
+typedef struct uc_mem_dirty {
+    uint64_t begin; // begin address of the region (inclusive)
+    uint64_t end;   // end address of the region (inclusive)
+    uint64_t *pages;    // bit (n % 64) of pages[n / 64] set if page n of the region
+                        // was written. Pages are UC_QUERY_PAGE_SIZE bytes
+} uc_mem_dirty;
+
 // All type of queries for uc_query() API.
 typedef enum uc_query_type {
     // Dynamically query current hardware mode.
@@ -332,12 +343,82 @@ typedef enum uc_query_type {
     UC_QUERY_PAGE_SIZE, // query pagesize of engine
     UC_QUERY_ARCH,  // query architecture of engine (for ARM to query Thumb mode)
     UC_QUERY_TIMEOUT,  // query if emulation stops due to timeout (indicated if result = True)
+    UC_QUERY_TB_TRANSLATED, // query number of translation blocks translated since uc_open()
+    UC_QUERY_TB_REUSED, // query number of times already translated code was looked up & reused
+    UC_QUERY_TB_FLUSHES, // query number of times all translated code was dropped
+    UC_QUERY_TB_EVICTED, // query number of TBs dropped to make room for new code
+    UC_QUERY_CODE_BUFFER_SIZE, // query size in bytes of the translation buffer
+    UC_QUERY_CODE_BUFFER_USED, // query bytes of the translation buffer holding translated code
+    UC_QUERY_TLB_SIZE,  // query number of entries of the TLB of the current MMU mode
+    UC_QUERY_TLB_HITS,  // query number of TLB lookups of translated code which hit, see UC_OPT_TLB_COUNT_HITS
+    UC_QUERY_TLB_MISSES,    // query number of memory accesses which missed the TLB
+    UC_QUERY_TLB_FLUSHES,   // query number of times the whole TLB was dropped
 } uc_query_type;
 
+// All type of options for uc_option() API.
+typedef enum uc_opt_type {
+    // Call UC_HOOK_CODE callbacks straight from translated code (value != 0),
+    // instead of looking them up at run time. ARM & ARM64 only.
+    // NOTE: hooks added or deleted during emulation then take effect
+    // at the next uc_emu_start() only.
+    UC_OPT_HOOK_DIRECT = 1,
+    // Let translated code access the largest readable & writable region
+    // at its host address straight (value != 0), instead of looking up the
+    // TLB. Other regions, memory hooks & stores to code keep the usual path.
+    // ARM on x86-64 hosts only, while the guest MMU is off.
+    UC_OPT_FASTMEM,
+    // Size in bytes of the buffer translated code is kept in, 0 for the
+    // default of 8MB. Translated code is dropped. Buffers of 2MB or more are
+    // split into regions, and when full only the oldest region is evicted
+    // instead of flushing everything. Not from hooks.
+    UC_OPT_CODE_BUFFER_SIZE,
+    // Number of entries of the TLB of each MMU mode: a power of 2 from 64
+    // to 65536, or 0 (default) for a TLB of 256 entries which grows when
+    // most of its refills evict entries, and shrinks when mostly unused.
+    // Hosts other than x86 only support 0 & 256. Not from hooks.
+    UC_OPT_TLB_SIZE,
+    // Let translated code count its TLB hits (value != 0), for
+    // UC_QUERY_TLB_HITS. Costs an increment per memory access. x86 hosts only.
+    UC_OPT_TLB_COUNT_HITS,
+    // Let translated code count how many times each block runs (value != 0),
+    // for uc_profile_get(). Costs an increment per block run.
+    UC_OPT_PROFILE,
+} uc_opt_type;
+
 // Opaque storage for CPU context, used with uc_context_*()
 struct uc_context;
 typedef struct uc_context uc_context;
 
+// Opaque storage for the state of an engine, used with uc_snapshot_*()
+struct uc_snapshot;
+typedef struct uc_snapshot uc_snapshot;
+
+// Statistics of an engine since uc_open(), see uc_stats_get()
+typedef struct uc_stats {
+    uint64_t tb_translated;     // translation blocks (TBs) translated
+    uint64_t tb_guest_bytes;    // bytes of guest code translated
+    uint64_t tb_host_bytes;     // bytes of host code generated
+    uint64_t tb_fast_hits;      // TB lookups found in the small cache of recent TBs of the CPU
+    uint64_t tb_slow_lookups;   // TB lookups going to the hash table of all TBs, translating on a miss
+    uint64_t tb_flushes;        // times all translated code was dropped
+    uint64_t tb_evicted;        // TBs dropped to make room for new code
+    uint64_t tb_invalidated;    // TBs dropped as emulated code wrote to their code
+    uint64_t tlb_fills;         // softmmu TLB entries filled on a miss
+    uint64_t tlb_misses;        // memory accesses which missed the TLB
+    uint64_t tlb_flushes;       // times the whole TLB was dropped
+    uint64_t hook_calls[32];    // callbacks called, per type: hook_calls[i] for the UC_HOOK_* 1 << i
+    uint64_t translate_ns;      // nanoseconds spent translating code
+    uint64_t execute_ns;        // other nanoseconds spent in uc_emu_start(), running code, helpers & hooks
+} uc_stats;
+
+// Runs of a block of guest code, see uc_profile_get()
+typedef struct uc_tb_profile {
+    uint64_t address;   // guest address of the block
+    uint32_t size;      // bytes of guest code
+    uint32_t host_size; // bytes of host code it was last translated to
+    uint64_t count;     // number of runs
+} uc_tb_profile;
+
 /*
  Return combined API version & major and minor version numbers.
 
@@ -399,6 +480,85 @@ uc_err uc_open(uc_arch arch, uc_mode mode, uc_engine **uc);
 UNICORN_EXPORT
 uc_err uc_close(uc_engine *uc);
 
+/*
+ Create a new engine in the state of @uc: the same memory map & memory,
+ the registers uc_context_save() saves, hooks & options.
+ Both engines then run apart from each other.
+ On Linux, RAM is shared copy-on-write: a page is only copied once either
+ engine writes to it. The first fork, and the first after @uc changed its
+ memory, writes the RAM of @uc to a file to share; the next ones map it
+ again, whatever the size of the RAM. Elsewhere, and for the memory given to
+ uc_mem_map_ptr(), the new engine gets a copy.
+ Hooks of the new engine call the same callbacks with the same @user_data,
+ and last until it is closed. Translated code is not shared.
+ Cannot be called during emulation.
+
+ NOTE: writes made through a pointer of uc_mem_get_ptr() after a fork are
+   not seen by the next forks: get the pointer again.
+
+ @uc: handle returned by uc_open()
+ @result: pointer to a handle receiving the new engine, to close with uc_close()
+
+ @return UC_ERR_OK on success, or other value on failure (refer to uc_err enum
+   for detailed error).
+*/
+UNICORN_EXPORT
+uc_err uc_fork(uc_engine *uc, uc_engine **result);
+
+/*
+ Save the state of @uc to go back to later with uc_snapshot_restore(): the
+ memory map with the permissions of each page, the content of RAM, and the
+ registers that uc_context_save() saves. Hooks and options are
+ not part of it.
+ From then on, the pages written to are tracked, like with
+ uc_mem_dirty_start(), so that a restore only copies those back.
+ Cannot be called during emulation.
+
+ @uc: handle returned by uc_open()
+ @snapshot: pointer to a variable receiving the snapshot, to free with
+   uc_snapshot_free()
+
+ @return UC_ERR_OK on success, or other value on failure (refer to uc_err enum
+   for detailed error).
+*/
+UNICORN_EXPORT
+uc_err uc_snapshot_take(uc_engine *uc, uc_snapshot **snapshot);
+
+/*
+ Put @uc back in the state saved by uc_snapshot_take(). Regions mapped
+ since are unmapped, regions unmapped or split since are mapped again, and
+ permissions changed since are set back.
+ If @snapshot is the one taken or restored last, only the pages written to
+ since are copied back, and only the code translated from those is dropped.
+ Otherwise, and for the memory given to uc_mem_map_ptr(), whose writes by
+ the host are not seen, all the bytes are copied back.
+ Cannot be called during emulation.
+
+ NOTE: writes made through a pointer of uc_mem_get_ptr() are not seen
+   either: call uc_snapshot_restore() with another snapshot in between, or
+   use uc_mem_write().
+
+ @uc: handle returned by uc_open()
+ @snapshot: snapshot taken of @uc by uc_snapshot_take()
+
+ @return UC_ERR_OK on success, or other value on failure (refer to uc_err enum
+   for detailed error). On failure, @uc is left as it was: memory map,
+   memory and registers.
+*/
+UNICORN_EXPORT
+uc_err uc_snapshot_restore(uc_engine *uc, uc_snapshot *snapshot);
+
+/*
+ Free a snapshot of uc_snapshot_take(), before or after uc_close().
+
+ @snapshot: snapshot to free
+
+ @return UC_ERR_OK on success, or other value on failure (refer to uc_err enum
+   for detailed error).
+*/
+UNICORN_EXPORT
+uc_err uc_snapshot_free(uc_snapshot *snapshot);
+
 /*
  Query internal status of engine.
 
@@ -412,6 +572,59 @@ uc_err uc_close(uc_engine *uc);
 UNICORN_EXPORT
 uc_err uc_query(uc_engine *uc, uc_query_type type, size_t *result);
 
+/*
+ Set option for Unicorn engine.
+
+ @uc: handle returned by uc_open()
+ @type: type of option to be set. See uc_opt_type
+ @value: option value corresponding with @type
+
+ @return: error code of uc_err enum type (UC_ERR_*, see above)
+*/
+UNICORN_EXPORT
+uc_err uc_option(uc_engine *uc, uc_opt_type type, size_t value);
+
+/*
+ Read the statistics of Unicorn engine, counted since uc_open().
+ They are always kept, at the cost of an increment per event.
+
+ @uc: handle returned by uc_open()
+ @stats: pointer to a uc_stats struct receiving the statistics
+
+ NOTE: code hooks called by translated code with UC_OPT_HOOK_DIRECT are
+   counted as well. Times come from the wall clock.
+
+ @return: error code of uc_err enum type (UC_ERR_*, see above)
+*/
+UNICORN_EXPORT
+uc_err uc_stats_get(uc_engine *uc, uc_stats *stats);
+
+/*
+ Read the hottest blocks of guest code, counted while UC_OPT_PROFILE is set.
+ Runs of a block are kept when its translated code is dropped. A block run
+ in several CPU modes (eg. ARM & Thumb) is listed once per mode.
+
+ @uc: handle returned by uc_open()
+ @blocks: array of @count uc_tb_profile receiving the blocks run most,
+   in decreasing order of runs
+ @count: number of entries in @blocks
+ @found: pointer to a variable receiving the number of entries filled
+
+ @return: error code of uc_err enum type (UC_ERR_*, see above)
+*/
+UNICORN_EXPORT
+uc_err uc_profile_get(uc_engine *uc, uc_tb_profile *blocks, size_t count, size_t *found);
+
+/*
+ Forget the runs counted so far for uc_profile_get().
+
+ @uc: handle returned by uc_open()
+
+ @return: error code of uc_err enum type (UC_ERR_*, see above)
+*/
+UNICORN_EXPORT
+uc_err uc_profile_reset(uc_engine *uc);
+
 /*
  Report the last error number when some API function fail.
  Like glibc's errno, uc_errno might not retain its old value once accessed.
@@ -520,6 +733,45 @@ uc_err uc_mem_write(uc_engine *uc, uint64_t address, const void *bytes, size_t s
 UNICORN_EXPORT
 uc_err uc_mem_read(uc_engine *uc, uint64_t address, void *bytes, size_t size);
 
+/*
+ Get the host address of guest memory, to access it without copying.
+
+ @uc: handle returned by uc_open()
+ @address: starting memory address.
+ @ptr: pointer to a variable receiving the host address of @address.
+ @size: pointer to a variable receiving how many bytes from @address are
+   contiguous at @ptr, up to the end of the memory region holding @address.
+
+ NOTE: @ptr stays valid until the memory region holding @address is unmapped,
+   or split by uc_mem_unmap() or uc_mem_protect() of a part of it, and until
+   uc_close(). Accesses through @ptr ignore memory permissions & hooks, and
+   writes to guest code through it are not seen by code already translated:
+   call uc_mem_code_written() after them, or use uc_mem_write() for code.
+   Writes through it are not tracked by uc_mem_dirty_get() and
+   uc_snapshot_restore() either.
+
+ @return UC_ERR_OK on success, or other value on failure (refer to uc_err enum
+   for detailed error).
+*/
+UNICORN_EXPORT
+uc_err uc_mem_get_ptr(uc_engine *uc, uint64_t address, void **ptr, size_t *size);
+
+/*
+ Drop the code translated from guest memory that the host modified without
+ uc_mem_write(), through the memory given to uc_mem_map_ptr() or a pointer
+ of uc_mem_get_ptr(), so that the next run translates it again.
+
+ @uc: handle returned by uc_open()
+ @address: starting address of the memory modified.
+ @size: size of the memory modified.
+
+ @return UC_ERR_OK on success, UC_ERR_WRITE_UNMAPPED if part of the range is
+   not mapped, or other value on failure (refer to uc_err enum for detailed
+   error).
+*/
+UNICORN_EXPORT
+uc_err uc_mem_code_written(uc_engine *uc, uint64_t address, size_t size);
+
 /*
  Emulate machine code in a specific duration of time.
 
@@ -630,6 +882,9 @@ uc_err uc_mem_map(uc_engine *uc, uint64_t address, size_t size, uint32_t perms);
  @ptr: pointer to host memory backing the newly mapped memory. This host memory is
     expected to be an equal or larger size than provided, and be mapped with at
     least PROT_READ | PROT_WRITE. If it is not, the resulting behavior is undefined.
+    NOTE: translated code is kept across uc_emu_start() calls, and writes done
+    directly through @ptr are not tracked. After modifying code that has
+    already been emulated through @ptr, call uc_mem_code_written().
 
  @return UC_ERR_OK on success, or other value on failure (refer to uc_err enum
    for detailed error).
@@ -637,6 +892,22 @@ uc_err uc_mem_map(uc_engine *uc, uint64_t address, size_t size, uint32_t perms);
 UNICORN_EXPORT
 uc_err uc_mem_map_ptr(uc_engine *uc, uint64_t address, size_t size, uint32_t perms, void *ptr);
 
+/*
+ Map many memory regions for emulation at once, as uc_mem_map() would one
+ by one, but in a single update of the memory map.
+
+ @uc: handle returned by uc_open()
+ @regions: the regions to map: @begin and @end (inclusive) must be aligned
+    to 4KB, @perms as for uc_mem_map(). They can be given in any order, but
+    must not overlap each other or what is already mapped.
+ @count: number of regions in @regions
+
+ @return UC_ERR_OK on success, or other value on failure (refer to uc_err enum
+   for detailed error). On failure, none of the regions is mapped.
+*/
+UNICORN_EXPORT
+uc_err uc_mem_map_batch(uc_engine *uc, const uc_mem_region *regions, uint32_t count);
+
 /*
  Unmap a region of emulation memory.
  This API deletes a memory mapping from the emulation memory space.
@@ -689,6 +960,51 @@ uc_err uc_mem_protect(uc_engine *uc, uint64_t address, size_t size, uint32_t per
 UNICORN_EXPORT
 uc_err uc_mem_regions(uc_engine *uc, uc_mem_region **regions, uint32_t *count);
 
+/*
+ Start tracking the pages of RAM written to, by emulated code and by
+ uc_mem_write(), and mark all pages clean. Pages written through the host
+ pointers of uc_mem_map_ptr() and uc_mem_get_ptr() are not seen.
+ Once started, the first write to each clean page costs a trip out of
+ translated code.
+
+ @uc: handle returned by uc_open()
+
+ @return UC_ERR_OK on success, or other value on failure (refer to uc_err enum
+   for detailed error).
+*/
+UNICORN_EXPORT
+uc_err uc_mem_dirty_start(uc_engine *uc);
+
+/*
+ Retrieve the pages written to since uc_mem_dirty_start() or the last
+ uc_mem_dirty_reset(), one entry per region mapped by uc_mem_map() and
+ uc_mem_map_ptr(). A region mapped since then has all of its pages dirty.
+ This API allocates memory for @regions and their @pages in one block,
+ which must be freed by the user later with uc_free().
+
+ @uc: handle returned by uc_open()
+ @regions: pointer to an array of uc_mem_dirty struct. This is allocated by
+   Unicorn, and must be freed by user later with uc_free()
+ @count: pointer to number of struct uc_mem_dirty contained in @regions
+
+ @return UC_ERR_OK on success, UC_ERR_ARG if uc_mem_dirty_start() was not
+   called, or other value on failure (refer to uc_err enum for detailed error).
+*/
+UNICORN_EXPORT
+uc_err uc_mem_dirty_get(uc_engine *uc, uc_mem_dirty **regions, uint32_t *count);
+
+/*
+ Mark all pages of RAM clean, so that uc_mem_dirty_get() only returns the
+ pages written to from now on.
+
+ @uc: handle returned by uc_open()
+
+ @return UC_ERR_OK on success, UC_ERR_ARG if uc_mem_dirty_start() was not
+   called, or other value on failure (refer to uc_err enum for detailed error).
+*/
+UNICORN_EXPORT
+uc_err uc_mem_dirty_reset(uc_engine *uc);
+
 /*
  Allocate a region that can be used with uc_context_{save,restore} to perform
  quick save/rollback of the CPU context, which includes registers and some
@@ -706,6 +1022,27 @@ uc_err uc_mem_regions(uc_engine *uc, uc_mem_region **regions, uint32_t *count);
 UNICORN_EXPORT
 uc_err uc_context_alloc(uc_engine *uc, uc_context **context);
 
+/*
+ Allocate a compact context for uc_context_{save,restore}, that only holds
+ the user-visible CPU state: general purpose, flags, FPU & SIMD registers,
+ plus thread pointers (TLS). The privilege mode and system registers are
+ not part of it, so restoring such a context needs no TLB or TB flush.
+ On X86, the EFLAGS bits that user code cannot change (IOPL, IF, VM & RF)
+ are left as they are.
+ This is the quick way to switch between guest threads.
+ Only supported on ARM, ARM64 & X86.
+
+ @uc: handle returned by uc_open()
+ @context: pointer to a uc_engine*. This will be updated with the pointer to
+   the new context on successful return of this function.
+   Later, this allocated memory must be freed with uc_free().
+
+ @return UC_ERR_OK on success, UC_ERR_ARCH on other architectures, or other
+   value on failure (refer to uc_err enum for detailed error).
+*/
+UNICORN_EXPORT
+uc_err uc_context_alloc_user(uc_engine *uc, uc_context **context);
+
 /*
  Free the memory allocated by uc_context_alloc & uc_mem_regions.
 
@@ -750,6 +1087,7 @@ uc_err uc_context_restore(uc_engine *uc, uc_context *context);
 /*
   Return the size needed to store the cpu context. Can be used to allocate a buffer
   to contain the cpu context and directly call uc_context_save.
+  It is large enough for a context of uc_context_alloc() or uc_context_alloc_user().
 
   @uc: handle returned by uc_open()
 
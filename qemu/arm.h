@@ -8,10 +8,16 @@
 #define tcg_target_deposit_valid tcg_target_deposit_valid_arm
 #define helper_power_down helper_power_down_arm
 #define check_exit_request check_exit_request_arm
+#define gen_uc_hookcode gen_uc_hookcode_arm
 #define address_space_unregister address_space_unregister_arm
 #define tb_invalidate_phys_page_fast tb_invalidate_phys_page_fast_arm
 #define phys_mem_clean phys_mem_clean_arm
 #define tb_cleanup tb_cleanup_arm
+#define tb_discard_partial tb_discard_partial_arm
+#define tb_profile_harvest tb_profile_harvest_arm
+#define tb_flush_all tb_flush_all_arm
+#define tb_invalidate_uc_range tb_invalidate_uc_range_arm
+#define tb_invalidate_addr_end tb_invalidate_addr_end_arm
 #define memory_map memory_map_arm
 #define memory_map_ptr memory_map_ptr_arm
 #define memory_unmap memory_unmap_arm
@@ -20,6 +26,7 @@
 #define helper_raise_exception helper_raise_exception_arm
 #define tcg_enabled tcg_enabled_arm
 #define tcg_exec_init tcg_exec_init_arm
+#define tcg_exec_resize tcg_exec_resize_arm
 #define memory_register_types memory_register_types_arm
 #define cpu_exec_init_all cpu_exec_init_all_arm
 #define vm_start vm_start_arm
@@ -60,6 +67,7 @@
 #define address_space_access_valid address_space_access_valid_arm
 #define address_space_destroy address_space_destroy_arm
 #define address_space_destroy_dispatch address_space_destroy_dispatch_arm
+#define address_space_dispatch_update address_space_dispatch_update_arm
 #define address_space_get_flatview address_space_get_flatview_arm
 #define address_space_init address_space_init_arm
 #define address_space_init_dispatch address_space_init_dispatch_arm
@@ -141,7 +149,15 @@
 #define arm_singlestep_active arm_singlestep_active_arm
 #define tlb_fill tlb_fill_arm
 #define tlb_flush tlb_flush_arm
+#define tlb_fastmem_set_code tlb_fastmem_set_code_arm
+#define tlb_fastmem_update tlb_fastmem_update_arm
+#define tlb_init tlb_init_arm
+#define tlb_destroy tlb_destroy_arm
+#define tlb_resize tlb_resize_arm
+#define tlb_query tlb_query_arm
+#define tlb_flush_all tlb_flush_all_arm
 #define tlb_flush_page tlb_flush_page_arm
+#define tlb_flush_memory tlb_flush_memory_arm
 #define tlb_set_page tlb_set_page_arm
 #define arm_translate_init arm_translate_init_arm
 #define arm_v7m_class_init arm_v7m_class_init_arm
@@ -266,6 +282,10 @@
 #define cpu_physical_memory_range_includes_clean cpu_physical_memory_range_includes_clean_arm
 #define cpu_physical_memory_reset_dirty cpu_physical_memory_reset_dirty_arm
 #define cpu_physical_memory_rw cpu_physical_memory_rw_arm
+#define cpu_physical_memory_written cpu_physical_memory_written_arm
+#define cpu_notdirty_write cpu_notdirty_write_arm
+#define cpu_physical_memory_dirty_get cpu_physical_memory_dirty_get_arm
+#define cpu_physical_memory_dirty_reset cpu_physical_memory_dirty_reset_arm
 #define cpu_physical_memory_set_dirty_flag cpu_physical_memory_set_dirty_flag_arm
 #define cpu_physical_memory_set_dirty_range cpu_physical_memory_set_dirty_range_arm
 #define cpu_physical_memory_unmap cpu_physical_memory_unmap_arm
@@ -925,6 +945,87 @@
 #define gen_helper_neon_qunzip8 gen_helper_neon_qunzip8_arm
 #define gen_helper_neon_qzip16 gen_helper_neon_qzip16_arm
 #define gen_helper_neon_qzip32 gen_helper_neon_qzip32_arm
+#define gen_helper_neon_add_u8_q gen_helper_neon_add_u8_q_arm
+#define gen_helper_neon_add_u16_q gen_helper_neon_add_u16_q_arm
+#define gen_helper_neon_sub_u8_q gen_helper_neon_sub_u8_q_arm
+#define gen_helper_neon_sub_u16_q gen_helper_neon_sub_u16_q_arm
+#define gen_helper_neon_mul_u8_q gen_helper_neon_mul_u8_q_arm
+#define gen_helper_neon_mul_u16_q gen_helper_neon_mul_u16_q_arm
+#define gen_helper_neon_mla_u8_q gen_helper_neon_mla_u8_q_arm
+#define gen_helper_neon_mla_u16_q gen_helper_neon_mla_u16_q_arm
+#define gen_helper_neon_mls_u8_q gen_helper_neon_mls_u8_q_arm
+#define gen_helper_neon_mls_u16_q gen_helper_neon_mls_u16_q_arm
+#define gen_helper_neon_ceq_u8_q gen_helper_neon_ceq_u8_q_arm
+#define gen_helper_neon_ceq_u16_q gen_helper_neon_ceq_u16_q_arm
+#define gen_helper_neon_ceq_u32_q gen_helper_neon_ceq_u32_q_arm
+#define gen_helper_neon_tst_u8_q gen_helper_neon_tst_u8_q_arm
+#define gen_helper_neon_tst_u16_q gen_helper_neon_tst_u16_q_arm
+#define gen_helper_neon_tst_u32_q gen_helper_neon_tst_u32_q_arm
+#define gen_helper_neon_cgt_s8_q gen_helper_neon_cgt_s8_q_arm
+#define gen_helper_neon_cgt_u8_q gen_helper_neon_cgt_u8_q_arm
+#define gen_helper_neon_cgt_s16_q gen_helper_neon_cgt_s16_q_arm
+#define gen_helper_neon_cgt_u16_q gen_helper_neon_cgt_u16_q_arm
+#define gen_helper_neon_cgt_s32_q gen_helper_neon_cgt_s32_q_arm
+#define gen_helper_neon_cgt_u32_q gen_helper_neon_cgt_u32_q_arm
+#define gen_helper_neon_cge_s8_q gen_helper_neon_cge_s8_q_arm
+#define gen_helper_neon_cge_u8_q gen_helper_neon_cge_u8_q_arm
+#define gen_helper_neon_cge_s16_q gen_helper_neon_cge_s16_q_arm
+#define gen_helper_neon_cge_u16_q gen_helper_neon_cge_u16_q_arm
+#define gen_helper_neon_cge_s32_q gen_helper_neon_cge_s32_q_arm
+#define gen_helper_neon_cge_u32_q gen_helper_neon_cge_u32_q_arm
+#define gen_helper_neon_max_s8_q gen_helper_neon_max_s8_q_arm
+#define gen_helper_neon_max_u8_q gen_helper_neon_max_u8_q_arm
+#define gen_helper_neon_max_s16_q gen_helper_neon_max_s16_q_arm
+#define gen_helper_neon_max_u16_q gen_helper_neon_max_u16_q_arm
+#define gen_helper_neon_max_s32_q gen_helper_neon_max_s32_q_arm
+#define gen_helper_neon_max_u32_q gen_helper_neon_max_u32_q_arm
+#define gen_helper_neon_min_s8_q gen_helper_neon_min_s8_q_arm
+#define gen_helper_neon_min_u8_q gen_helper_neon_min_u8_q_arm
+#define gen_helper_neon_min_s16_q gen_helper_neon_min_s16_q_arm
+#define gen_helper_neon_min_u16_q gen_helper_neon_min_u16_q_arm
+#define gen_helper_neon_min_s32_q gen_helper_neon_min_s32_q_arm
+#define gen_helper_neon_min_u32_q gen_helper_neon_min_u32_q_arm
+#define gen_helper_neon_abd_s8_q gen_helper_neon_abd_s8_q_arm
+#define gen_helper_neon_abd_u8_q gen_helper_neon_abd_u8_q_arm
+#define gen_helper_neon_abd_s16_q gen_helper_neon_abd_s16_q_arm
+#define gen_helper_neon_abd_u16_q gen_helper_neon_abd_u16_q_arm
+#define gen_helper_neon_abd_s32_q gen_helper_neon_abd_s32_q_arm
+#define gen_helper_neon_abd_u32_q gen_helper_neon_abd_u32_q_arm
+#define gen_helper_neon_aba_s8_q gen_helper_neon_aba_s8_q_arm
+#define gen_helper_neon_aba_u8_q gen_helper_neon_aba_u8_q_arm
+#define gen_helper_neon_aba_s16_q gen_helper_neon_aba_s16_q_arm
+#define gen_helper_neon_aba_u16_q gen_helper_neon_aba_u16_q_arm
+#define gen_helper_neon_aba_s32_q gen_helper_neon_aba_s32_q_arm
+#define gen_helper_neon_aba_u32_q gen_helper_neon_aba_u32_q_arm
+#define gen_helper_neon_hadd_s8_q gen_helper_neon_hadd_s8_q_arm
+#define gen_helper_neon_hadd_u8_q gen_helper_neon_hadd_u8_q_arm
+#define gen_helper_neon_hadd_s16_q gen_helper_neon_hadd_s16_q_arm
+#define gen_helper_neon_hadd_u16_q gen_helper_neon_hadd_u16_q_arm
+#define gen_helper_neon_hadd_s32_q gen_helper_neon_hadd_s32_q_arm
+#define gen_helper_neon_hadd_u32_q gen_helper_neon_hadd_u32_q_arm
+#define gen_helper_neon_rhadd_s8_q gen_helper_neon_rhadd_s8_q_arm
+#define gen_helper_neon_rhadd_u8_q gen_helper_neon_rhadd_u8_q_arm
+#define gen_helper_neon_rhadd_s16_q gen_helper_neon_rhadd_s16_q_arm
+#define gen_helper_neon_rhadd_u16_q gen_helper_neon_rhadd_u16_q_arm
+#define gen_helper_neon_rhadd_s32_q gen_helper_neon_rhadd_s32_q_arm
+#define gen_helper_neon_rhadd_u32_q gen_helper_neon_rhadd_u32_q_arm
+#define gen_helper_neon_qadd_s8_q gen_helper_neon_qadd_s8_q_arm
+#define gen_helper_neon_qadd_u8_q gen_helper_neon_qadd_u8_q_arm
+#define gen_helper_neon_qadd_s16_q gen_helper_neon_qadd_s16_q_arm
+#define gen_helper_neon_qadd_u16_q gen_helper_neon_qadd_u16_q_arm
+#define gen_helper_neon_qadd_s32_q gen_helper_neon_qadd_s32_q_arm
+#define gen_helper_neon_qadd_u32_q gen_helper_neon_qadd_u32_q_arm
+#define gen_helper_neon_qsub_s8_q gen_helper_neon_qsub_s8_q_arm
+#define gen_helper_neon_qsub_u8_q gen_helper_neon_qsub_u8_q_arm
+#define gen_helper_neon_qsub_s16_q gen_helper_neon_qsub_s16_q_arm
+#define gen_helper_neon_qsub_u16_q gen_helper_neon_qsub_u16_q_arm
+#define gen_helper_neon_qsub_s32_q gen_helper_neon_qsub_s32_q_arm
+#define gen_helper_neon_qsub_u32_q gen_helper_neon_qsub_u32_q_arm
+#define gen_helper_neon_add_f32_q gen_helper_neon_add_f32_q_arm
+#define gen_helper_neon_sub_f32_q gen_helper_neon_sub_f32_q_arm
+#define gen_helper_neon_mul_f32_q gen_helper_neon_mul_f32_q_arm
+#define gen_helper_neon_mla_f32_q gen_helper_neon_mla_f32_q_arm
+#define gen_helper_neon_mls_f32_q gen_helper_neon_mls_f32_q_arm
 #define gen_helper_neon_qzip8 gen_helper_neon_qzip8_arm
 #define gen_helper_neon_rhadd_s16 gen_helper_neon_rhadd_s16_arm
 #define gen_helper_neon_rhadd_s32 gen_helper_neon_rhadd_s32_arm
@@ -953,6 +1054,8 @@
 #define gen_helper_neon_sub_u16 gen_helper_neon_sub_u16_arm
 #define gen_helper_neon_sub_u8 gen_helper_neon_sub_u8_arm
 #define gen_helper_neon_tbl gen_helper_neon_tbl_arm
+#define gen_helper_neon_vld1 gen_helper_neon_vld1_arm
+#define gen_helper_neon_vst1 gen_helper_neon_vst1_arm
 #define gen_helper_neon_tst_u16 gen_helper_neon_tst_u16_arm
 #define gen_helper_neon_tst_u32 gen_helper_neon_tst_u32_arm
 #define gen_helper_neon_tst_u8 gen_helper_neon_tst_u8_arm
@@ -1375,6 +1478,8 @@
 #define helper_double_saturate helper_double_saturate_arm
 #define helper_exception_internal helper_exception_internal_arm
 #define helper_exception_return helper_exception_return_arm
+#define helper_strex helper_strex_arm
+#define arm_store_exclusive arm_store_exclusive_arm
 #define helper_exception_with_syndrome helper_exception_with_syndrome_arm
 #define helper_get_cp_reg helper_get_cp_reg_arm
 #define helper_get_cp_reg64 helper_get_cp_reg64_arm
@@ -1669,6 +1774,87 @@
 #define helper_neon_qunzip8 helper_neon_qunzip8_arm
 #define helper_neon_qzip16 helper_neon_qzip16_arm
 #define helper_neon_qzip32 helper_neon_qzip32_arm
+#define helper_neon_add_u8_q helper_neon_add_u8_q_arm
+#define helper_neon_add_u16_q helper_neon_add_u16_q_arm
+#define helper_neon_sub_u8_q helper_neon_sub_u8_q_arm
+#define helper_neon_sub_u16_q helper_neon_sub_u16_q_arm
+#define helper_neon_mul_u8_q helper_neon_mul_u8_q_arm
+#define helper_neon_mul_u16_q helper_neon_mul_u16_q_arm
+#define helper_neon_mla_u8_q helper_neon_mla_u8_q_arm
+#define helper_neon_mla_u16_q helper_neon_mla_u16_q_arm
+#define helper_neon_mls_u8_q helper_neon_mls_u8_q_arm
+#define helper_neon_mls_u16_q helper_neon_mls_u16_q_arm
+#define helper_neon_ceq_u8_q helper_neon_ceq_u8_q_arm
+#define helper_neon_ceq_u16_q helper_neon_ceq_u16_q_arm
+#define helper_neon_ceq_u32_q helper_neon_ceq_u32_q_arm
+#define helper_neon_tst_u8_q helper_neon_tst_u8_q_arm
+#define helper_neon_tst_u16_q helper_neon_tst_u16_q_arm
+#define helper_neon_tst_u32_q helper_neon_tst_u32_q_arm
+#define helper_neon_cgt_s8_q helper_neon_cgt_s8_q_arm
+#define helper_neon_cgt_u8_q helper_neon_cgt_u8_q_arm
+#define helper_neon_cgt_s16_q helper_neon_cgt_s16_q_arm
+#define helper_neon_cgt_u16_q helper_neon_cgt_u16_q_arm
+#define helper_neon_cgt_s32_q helper_neon_cgt_s32_q_arm
+#define helper_neon_cgt_u32_q helper_neon_cgt_u32_q_arm
+#define helper_neon_cge_s8_q helper_neon_cge_s8_q_arm
+#define helper_neon_cge_u8_q helper_neon_cge_u8_q_arm
+#define helper_neon_cge_s16_q helper_neon_cge_s16_q_arm
+#define helper_neon_cge_u16_q helper_neon_cge_u16_q_arm
+#define helper_neon_cge_s32_q helper_neon_cge_s32_q_arm
+#define helper_neon_cge_u32_q helper_neon_cge_u32_q_arm
+#define helper_neon_max_s8_q helper_neon_max_s8_q_arm
+#define helper_neon_max_u8_q helper_neon_max_u8_q_arm
+#define helper_neon_max_s16_q helper_neon_max_s16_q_arm
+#define helper_neon_max_u16_q helper_neon_max_u16_q_arm
+#define helper_neon_max_s32_q helper_neon_max_s32_q_arm
+#define helper_neon_max_u32_q helper_neon_max_u32_q_arm
+#define helper_neon_min_s8_q helper_neon_min_s8_q_arm
+#define helper_neon_min_u8_q helper_neon_min_u8_q_arm
+#define helper_neon_min_s16_q helper_neon_min_s16_q_arm
+#define helper_neon_min_u16_q helper_neon_min_u16_q_arm
+#define helper_neon_min_s32_q helper_neon_min_s32_q_arm
+#define helper_neon_min_u32_q helper_neon_min_u32_q_arm
+#define helper_neon_abd_s8_q helper_neon_abd_s8_q_arm
+#define helper_neon_abd_u8_q helper_neon_abd_u8_q_arm
+#define helper_neon_abd_s16_q helper_neon_abd_s16_q_arm
+#define helper_neon_abd_u16_q helper_neon_abd_u16_q_arm
+#define helper_neon_abd_s32_q helper_neon_abd_s32_q_arm
+#define helper_neon_abd_u32_q helper_neon_abd_u32_q_arm
+#define helper_neon_aba_s8_q helper_neon_aba_s8_q_arm
+#define helper_neon_aba_u8_q helper_neon_aba_u8_q_arm
+#define helper_neon_aba_s16_q helper_neon_aba_s16_q_arm
+#define helper_neon_aba_u16_q helper_neon_aba_u16_q_arm
+#define helper_neon_aba_s32_q helper_neon_aba_s32_q_arm
+#define helper_neon_aba_u32_q helper_neon_aba_u32_q_arm
+#define helper_neon_hadd_s8_q helper_neon_hadd_s8_q_arm
+#define helper_neon_hadd_u8_q helper_neon_hadd_u8_q_arm
+#define helper_neon_hadd_s16_q helper_neon_hadd_s16_q_arm
+#define helper_neon_hadd_u16_q helper_neon_hadd_u16_q_arm
+#define helper_neon_hadd_s32_q helper_neon_hadd_s32_q_arm
+#define helper_neon_hadd_u32_q helper_neon_hadd_u32_q_arm
+#define helper_neon_rhadd_s8_q helper_neon_rhadd_s8_q_arm
+#define helper_neon_rhadd_u8_q helper_neon_rhadd_u8_q_arm
+#define helper_neon_rhadd_s16_q helper_neon_rhadd_s16_q_arm
+#define helper_neon_rhadd_u16_q helper_neon_rhadd_u16_q_arm
+#define helper_neon_rhadd_s32_q helper_neon_rhadd_s32_q_arm
+#define helper_neon_rhadd_u32_q helper_neon_rhadd_u32_q_arm
+#define helper_neon_qadd_s8_q helper_neon_qadd_s8_q_arm
+#define helper_neon_qadd_u8_q helper_neon_qadd_u8_q_arm
+#define helper_neon_qadd_s16_q helper_neon_qadd_s16_q_arm
+#define helper_neon_qadd_u16_q helper_neon_qadd_u16_q_arm
+#define helper_neon_qadd_s32_q helper_neon_qadd_s32_q_arm
+#define helper_neon_qadd_u32_q helper_neon_qadd_u32_q_arm
+#define helper_neon_qsub_s8_q helper_neon_qsub_s8_q_arm
+#define helper_neon_qsub_u8_q helper_neon_qsub_u8_q_arm
+#define helper_neon_qsub_s16_q helper_neon_qsub_s16_q_arm
+#define helper_neon_qsub_u16_q helper_neon_qsub_u16_q_arm
+#define helper_neon_qsub_s32_q helper_neon_qsub_s32_q_arm
+#define helper_neon_qsub_u32_q helper_neon_qsub_u32_q_arm
+#define helper_neon_add_f32_q helper_neon_add_f32_q_arm
+#define helper_neon_sub_f32_q helper_neon_sub_f32_q_arm
+#define helper_neon_mul_f32_q helper_neon_mul_f32_q_arm
+#define helper_neon_mla_f32_q helper_neon_mla_f32_q_arm
+#define helper_neon_mls_f32_q helper_neon_mls_f32_q_arm
 #define helper_neon_qzip8 helper_neon_qzip8_arm
 #define helper_neon_rbit_u8 helper_neon_rbit_u8_arm
 #define helper_neon_rhadd_s16 helper_neon_rhadd_s16_arm
@@ -1702,6 +1888,8 @@
 #define helper_neon_sub_u16 helper_neon_sub_u16_arm
 #define helper_neon_sub_u8 helper_neon_sub_u8_arm
 #define helper_neon_tbl helper_neon_tbl_arm
+#define helper_neon_vld1 helper_neon_vld1_arm
+#define helper_neon_vst1 helper_neon_vst1_arm
 #define helper_neon_tst_u16 helper_neon_tst_u16_arm
 #define helper_neon_tst_u32 helper_neon_tst_u32_arm
 #define helper_neon_tst_u8 helper_neon_tst_u8_arm
@@ -2928,6 +3116,7 @@
 #define tlb_reset_dirty_range_all tlb_reset_dirty_range_all_arm
 #define tlb_set_dirty tlb_set_dirty_arm
 #define tlb_set_dirty1 tlb_set_dirty1_arm
+#define tlb_vaddr_to_host_rmw tlb_vaddr_to_host_rmw_arm
 #define tlb_unprotect_code_phys tlb_unprotect_code_phys_arm
 #define tlb_vaddr_to_host tlb_vaddr_to_host_arm
 #define token_get_type token_get_type_arm
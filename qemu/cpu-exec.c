@@ -25,6 +25,8 @@
 #include "uc_priv.h"
 
 static tcg_target_ulong cpu_tb_exec(CPUState *cpu, uint8_t *tb_ptr);
+static void cpu_exec_nocache(CPUArchState *env, int max_cycles,
+        TranslationBlock *orig_tb);
 static TranslationBlock *tb_find_slow(CPUArchState *env, target_ulong pc,
         target_ulong cs_base, uint64_t flags);
 static TranslationBlock *tb_find_fast(CPUArchState *env);
@@ -132,7 +134,7 @@ int cpu_exec(struct uc_struct *uc, CPUArchState *env)   // qq
                         HOOK_FOREACH(uc, hook, UC_HOOK_INSN_INVALID) {
                             if (hook->to_delete)
                                 continue;
-                            catched = ((uc_cb_hookinsn_invalid_t)hook->callback)(uc, hook->user_data);
+                            catched = HOOK_CALLBACK(uc, hook, UC_HOOK_INSN_INVALID, uc_cb_hookinsn_invalid_t)(uc, hook->user_data);
                             if (catched)
                                 break;
                         }
@@ -144,7 +146,7 @@ int cpu_exec(struct uc_struct *uc, CPUArchState *env)   // qq
                         HOOK_FOREACH(uc, hook, UC_HOOK_INTR) {
                             if (hook->to_delete)
                                 continue;
-                            ((uc_cb_hookintr_t)hook->callback)(uc, cpu->exception_index, hook->user_data);
+                            HOOK_CALLBACK(uc, hook, UC_HOOK_INTR, uc_cb_hookintr_t)(uc, cpu->exception_index, hook->user_data);
                             catched = true;
                         }
                         if (!catched)
@@ -269,6 +271,37 @@ int cpu_exec(struct uc_struct *uc, CPUArchState *env)   // qq
                             tb = (TranslationBlock *)(next_tb & ~TB_EXIT_MASK);
                             next_tb = 0;
                             break;
+                        case TB_EXIT_ICOUNT_EXPIRED:
+                        {
+                            /* Unicorn: the instruction budget of uc_emu_start()
+                             * does not cover this whole TB. */
+                            int insns_left;
+                            tb = (TranslationBlock *)(next_tb & ~TB_EXIT_MASK);
+                            next_tb = 0;
+                            insns_left = cpu->icount_decr.u32;
+                            if (cpu->icount_extra && insns_left >= 0) {
+                                /* Unicorn: a timeout hands out the budget in slices */
+                                if (uc->timeout && emu_timeout_expired(uc)) {
+                                    uc->stop_request = true;
+                                    cpu_loop_exit(cpu);
+                                }
+                                /* Refill decrementer and continue execution.  */
+                                cpu->icount_extra += insns_left;
+                                insns_left = MIN(cpu->icount_extra,
+                                        uc->timeout ? MAX(uc->timeout_slice, tb->icount) : INT32_MAX);
+                                cpu->icount_extra -= insns_left;
+                                cpu->icount_decr.u32 = insns_left;
+                            } else {
+                                if (insns_left > 0) {
+                                    /* Execute remaining instructions.  */
+                                    cpu_exec_nocache(env, insns_left, tb);
+                                }
+                                // budget is spent, stop emulation
+                                uc->stop_request = true;
+                                cpu_loop_exit(cpu);
+                            }
+                            break;
+                        }
                         default:
                             break;
                     }
@@ -287,6 +320,8 @@ int cpu_exec(struct uc_struct *uc, CPUArchState *env)   // qq
 #ifdef TARGET_I386
             x86_cpu = X86_CPU(uc, cpu);
 #endif
+            // Unicorn: we might have jumped out of the middle of a translation
+            tb_discard_partial(uc);
         }
     } /* for(;;) */
 
@@ -295,11 +330,6 @@ int cpu_exec(struct uc_struct *uc, CPUArchState *env)   // qq
 
     cc->cpu_exec_exit(cpu);
 
-    // Unicorn: flush JIT cache to because emulation might stop in
-    // the middle of translation, thus generate incomplete code.
-    // TODO: optimize this for better performance
-    tb_flush(env);
-
     /* fail safe : never use current_cpu outside cpu_exec() */
     // uc->current_cpu = NULL;
 
@@ -324,19 +354,20 @@ static tcg_target_ulong cpu_tb_exec(CPUState *cpu, uint8_t *tb_ptr)
         TranslationBlock *tb = (TranslationBlock *)(next_tb & ~TB_EXIT_MASK);
 
         /* Both set_pc() & synchronize_fromtb() can be ignored when code tracing hook is installed,
-         * or timer mode is in effect, since these already fix the PC.
+         * since it already fixes the PC.
+         * An expired instruction budget stops before the TB runs any hook, so
+         * the PC always needs fixing then.
          */
-        if (!HOOK_EXISTS(env->uc, UC_HOOK_CODE) && !env->uc->timeout) {
+        if ((next_tb & TB_EXIT_MASK) == TB_EXIT_ICOUNT_EXPIRED ||
+                !HOOK_EXISTS(env->uc, UC_HOOK_CODE)) {
             if (cc->synchronize_from_tb) {
                 // avoid sync twice when helper_uc_tracecode() already did this.
-                if (env->uc->emu_counter <= env->uc->emu_count &&
-                        !env->uc->stop_request && !env->uc->quit_request)
+                if (!env->uc->stop_request && !env->uc->quit_request)
                     cc->synchronize_from_tb(cpu, tb);
             } else {
                 assert(cc->set_pc);
                 // avoid sync twice when helper_uc_tracecode() already did this.
-                if (env->uc->emu_counter <= env->uc->emu_count &&
-                        !env->uc->stop_request && !env->uc->quit_request)
+                if (!env->uc->stop_request && !env->uc->quit_request)
                     cc->set_pc(cpu, tb->pc);
             }
         }
@@ -352,6 +383,39 @@ static tcg_target_ulong cpu_tb_exec(CPUState *cpu, uint8_t *tb_ptr)
     return next_tb;
 }
 
+/* Execute the code without caching the generated code. An interpreter
+   could be used if available. */
+static void cpu_exec_nocache(CPUArchState *env, int max_cycles,
+        TranslationBlock *orig_tb)
+{
+    CPUState *cpu = ENV_GET_CPU(env);
+    TCGContext *tcg_ctx = env->uc->tcg_ctx;
+    TranslationBlock *tb;
+    bool block_full = env->uc->block_full;
+
+    /* Should never happen.
+       We only end up here when an existing TB is too long.  */
+    if (max_cycles > CF_COUNT_MASK)
+        max_cycles = CF_COUNT_MASK;
+
+    tb = tb_gen_code(cpu, orig_tb->pc, orig_tb->cs_base, orig_tb->flags,
+                     max_cycles);
+    // the shortened TB does not break the block it was cut from
+    env->uc->block_full = block_full;
+    if (!tb)
+        return;
+
+    // Unicorn: dropped by tb_discard_partial() if this TB raises an exception
+    tcg_ctx->tb_ctx.tb_nocache = tb;
+    cpu->current_tb = tb;
+    /* execute the generated code */
+    cpu_tb_exec(cpu, tb->tc_ptr);
+    cpu->current_tb = NULL;
+    tcg_ctx->tb_ctx.tb_nocache = NULL;
+    tb_phys_invalidate(env->uc, tb, -1);
+    tb_free(env->uc, tb);
+}
+
 static TranslationBlock *tb_find_slow(CPUArchState *env, target_ulong pc,
         target_ulong cs_base, uint64_t flags)   // qq
 {
@@ -401,14 +465,18 @@ not_found:
     if (tb == NULL) {
         return NULL;
     }
+    goto add_jmp_cache;
 
 found:
+    // Unicorn: translated code outlives cpu_exec(), count how often it pays off
+    env->uc->tb_reused++;
     /* Move the last found TB to the head of the list */
     if (likely(*ptb1)) {
         *ptb1 = tb->phys_hash_next;
         tb->phys_hash_next = tcg_ctx->tb_ctx.tb_phys_hash[h];
         tcg_ctx->tb_ctx.tb_phys_hash[h] = tb;
     }
+add_jmp_cache:
     /* we add the TB in the virtual pc hash table */
     cpu->tb_jmp_cache[tb_jmp_cache_hash_func(pc)] = tb;
     return tb;
@@ -428,7 +496,11 @@ static TranslationBlock *tb_find_fast(CPUArchState *env)    // qq
     tb = cpu->tb_jmp_cache[tb_jmp_cache_hash_func(pc)];
     if (unlikely(!tb || tb->pc != pc || tb->cs_base != cs_base ||
                 tb->flags != flags)) {
+        env->uc->tb_slow_lookups++;
         tb = tb_find_slow(env, pc, cs_base, flags); // qq
+    } else {
+        env->uc->tb_reused++;
+        env->uc->tb_fast_hits++;
     }
     return tb;
 }
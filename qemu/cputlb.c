@@ -47,6 +47,204 @@ static void tlb_set_dirty1(CPUTLBEntry *tlb_entry, target_ulong vaddr);
 /* statistics */
 //int tlb_flush_count;
 
+/* page of a TLB entry, -1 if the entry is invalid */
+static target_ulong tlb_entry_page(CPUTLBEntry *te)
+{
+    if (!(te->addr_read & TLB_INVALID_MASK)) {
+        return te->addr_read & TARGET_PAGE_MASK;
+    }
+    if (!(te->addr_write & TLB_INVALID_MASK)) {
+        return te->addr_write & TARGET_PAGE_MASK;
+    }
+    if (!(te->addr_code & TLB_INVALID_MASK)) {
+        return te->addr_code & TARGET_PAGE_MASK;
+    }
+    return -1;
+}
+
+#ifdef CPU_TLB_DYNAMIC
+/* Unicorn: size & tables of the TLB of one MMU mode. Unless the engine
+   asked for a size with UC_OPT_TLB_SIZE, the TLB doubles when most
+   refills of its last "size" ones evicted valid entries, and halves at
+   a full flush when less than an eighth of it was used. */
+typedef struct CPUTLBDesc {
+    unsigned bits;          /* log2 of the number of entries */
+    CPUTLBEntry *table;
+    hwaddr *iotlb;
+    unsigned fills;         /* refills since the last resize */
+    unsigned evictions;     /* refills which dropped a valid entry */
+} CPUTLBDesc;
+
+static unsigned tlb_default_bits(struct uc_struct *uc)
+{
+    return uc->tlb_size ? ctz64(uc->tlb_size) : CPU_TLB_BITS;
+}
+
+/* let translated code look up the current tables of @mmu_idx */
+static void tlb_desc_sync(CPUState *cpu, int mmu_idx)
+{
+    CPUArchState *env = cpu->env_ptr;
+    CPUTLBDesc *desc = &cpu->tlb_desc[mmu_idx];
+
+    env->tlb_table[mmu_idx] = desc->table;
+    env->iotlb[mmu_idx] = desc->iotlb;
+    env->tlb_mask[mmu_idx] = (((uintptr_t)1 << desc->bits) - 1)
+                             << CPU_TLB_ENTRY_BITS;
+}
+
+/* give the TLB of @mmu_idx 1 << @bits entries. When it grows, its valid
+   entries are kept: entries in distinct slots stay in distinct slots. */
+static void tlb_desc_resize(CPUState *cpu, int mmu_idx, unsigned bits)
+{
+    CPUTLBDesc *desc = &cpu->tlb_desc[mmu_idx];
+    CPUTLBDesc old = *desc;
+    size_t i;
+
+    desc->bits = bits;
+    desc->table = g_new(CPUTLBEntry, (size_t)1 << bits);
+    /* zeroed like the static arrays were: an entry the refill left unset
+       reads as unassigned memory, see get_page_addr_code() */
+    desc->iotlb = g_new0(hwaddr, (size_t)1 << bits);
+    desc->fills = 0;
+    desc->evictions = 0;
+    memset(desc->table, -1, sizeof(CPUTLBEntry) << bits);
+
+    if (old.table && bits > old.bits) {
+        for (i = 0; i < ((size_t)1 << old.bits); i++) {
+            target_ulong page = tlb_entry_page(&old.table[i]);
+            size_t index;
+
+            if (page == (target_ulong)-1) {
+                continue;
+            }
+            index = (page >> TARGET_PAGE_BITS) & (((size_t)1 << bits) - 1);
+            desc->table[index] = old.table[i];
+            desc->iotlb[index] = old.iotlb[i];
+        }
+    }
+    g_free(old.table);
+    g_free(old.iotlb);
+
+    tlb_desc_sync(cpu, mmu_idx);
+}
+
+/* account a refill of the TLB of @mmu_idx, which dropped a valid entry
+   if @evicted, and grow the TLB if it is too small for the working set */
+static void tlb_desc_refilled(CPUState *cpu, int mmu_idx, bool evicted)
+{
+    CPUTLBDesc *desc = &cpu->tlb_desc[mmu_idx];
+
+    desc->evictions += evicted;
+    if (++desc->fills < (1u << desc->bits)) {
+        return;
+    }
+    if (cpu->uc->tlb_size == 0 && desc->evictions > desc->fills / 2 &&
+            desc->bits < CPU_TLB_DYN_MAX_BITS) {
+        tlb_desc_resize(cpu, mmu_idx, desc->bits + 1);
+    } else {
+        desc->fills = 0;
+        desc->evictions = 0;
+    }
+}
+
+/* before the TLB of @mmu_idx is flushed: shrink it if mostly unused */
+static void tlb_desc_flushing(CPUState *cpu, int mmu_idx)
+{
+    CPUTLBDesc *desc = &cpu->tlb_desc[mmu_idx];
+    size_t i, used = 0;
+
+    if (cpu->uc->tlb_size == 0 && desc->bits > CPU_TLB_BITS) {
+        for (i = 0; i < ((size_t)1 << desc->bits); i++) {
+            used += tlb_entry_page(&desc->table[i]) != (target_ulong)-1;
+        }
+        if (used < ((size_t)1 << desc->bits) / 8) {
+            tlb_desc_resize(cpu, mmu_idx, desc->bits - 1);
+        }
+    }
+    desc->fills = 0;
+    desc->evictions = 0;
+    /* a reset of the CPU cleared the pointers in env */
+    tlb_desc_sync(cpu, mmu_idx);
+}
+#endif
+
+/* Unicorn: allocate the TLB of each MMU mode of the CPU */
+void tlb_init(CPUState *cpu)
+{
+#ifdef CPU_TLB_DYNAMIC
+    int mmu_idx;
+
+    cpu->tlb_desc = g_new0(CPUTLBDesc, NB_MMU_MODES);
+    for (mmu_idx = 0; mmu_idx < NB_MMU_MODES; mmu_idx++) {
+        tlb_desc_resize(cpu, mmu_idx, tlb_default_bits(cpu->uc));
+    }
+#endif
+}
+
+/* Unicorn: free them, when the engine is closed */
+void tlb_destroy(CPUState *cpu)
+{
+#ifdef CPU_TLB_DYNAMIC
+    int mmu_idx;
+
+    if (cpu->tlb_desc == NULL) {
+        return;
+    }
+    for (mmu_idx = 0; mmu_idx < NB_MMU_MODES; mmu_idx++) {
+        g_free(cpu->tlb_desc[mmu_idx].table);
+        g_free(cpu->tlb_desc[mmu_idx].iotlb);
+    }
+    g_free(cpu->tlb_desc);
+    cpu->tlb_desc = NULL;
+#endif
+}
+
+/* Unicorn: give the TLB of each MMU mode @entries entries, or let it
+   follow the working set if 0, see UC_OPT_TLB_SIZE. Only outside of
+   emulation. */
+bool tlb_resize(struct uc_struct *uc, size_t entries)
+{
+#ifdef CPU_TLB_DYNAMIC
+    CPUState *cpu = uc->cpu;
+    int mmu_idx;
+
+    if (entries != 0 && ((entries & (entries - 1)) != 0 ||
+            entries < (1u << CPU_TLB_DYN_MIN_BITS) ||
+            entries > (1u << CPU_TLB_DYN_MAX_BITS))) {
+        return false;
+    }
+
+    uc->tlb_size = entries;
+    for (mmu_idx = 0; mmu_idx < NB_MMU_MODES; mmu_idx++) {
+        tlb_desc_resize(cpu, mmu_idx, tlb_default_bits(uc));
+    }
+    tlb_flush(cpu, 1);
+    return true;
+#else
+    return entries == 0 || entries == CPU_TLB_SIZE;
+#endif
+}
+
+/* Unicorn: the TLB counters, see uc_query() */
+uc_err tlb_query(struct uc_struct *uc, uc_query_type type, size_t *result)
+{
+    CPUArchState *env = uc->cpu->env_ptr;
+
+    switch (type) {
+    case UC_QUERY_TLB_SIZE:
+        /* of the MMU mode the CPU is in */
+        *result = tlb_entries(env, cpu_mmu_index(env));
+        break;
+    case UC_QUERY_TLB_HITS:
+        *result = env->tlb_hits;
+        break;
+    default:
+        return UC_ERR_ARG;
+    }
+
+    return UC_ERR_OK;
+}
+
 /* NOTE:
  * If flush_global is true (the usual case), flush all tlb entries.
  * If flush_global is false, flush (at least) all tlb entries not
@@ -62,6 +260,7 @@ static void tlb_set_dirty1(CPUTLBEntry *tlb_entry, target_ulong vaddr);
 void tlb_flush(CPUState *cpu, int flush_global)
 {
     CPUArchState *env = cpu->env_ptr;
+    int mmu_idx;
 
 #if defined(DEBUG_TLB)
     printf("tlb_flush:\n");
@@ -70,14 +269,28 @@ void tlb_flush(CPUState *cpu, int flush_global)
        links while we are modifying them */
     cpu->current_tb = NULL;
 
-    memset(env->tlb_table, -1, sizeof(env->tlb_table));
+    for (mmu_idx = 0; mmu_idx < NB_MMU_MODES; mmu_idx++) {
+#ifdef CPU_TLB_DYNAMIC
+        tlb_desc_flushing(cpu, mmu_idx);
+#endif
+        memset(env->tlb_table[mmu_idx], -1,
+               sizeof(CPUTLBEntry) * tlb_entries(env, mmu_idx));
+    }
     memset(env->tlb_v_table, -1, sizeof(env->tlb_v_table));
     memset(cpu->tb_jmp_cache, 0, sizeof(cpu->tb_jmp_cache));
 
     env->vtlb_index = 0;
     env->tlb_flush_addr = -1;
     env->tlb_flush_mask = 0;
-    //tlb_flush_count++;
+    /* the window may be gone too, until tlb_fastmem_update() */
+    memset(env->fastmem_end, 0, sizeof(env->fastmem_end));
+    cpu->uc->tlb_flushes++;
+}
+
+/* Unicorn: flush the whole TLB, see UC_HOOK_TLB_DEPENDENT */
+void tlb_flush_all(struct uc_struct *uc)
+{
+    tlb_flush(uc->cpu, 1);
 }
 
 void tlb_flush_page(CPUState *cpu, target_ulong addr)
@@ -104,8 +317,8 @@ void tlb_flush_page(CPUState *cpu, target_ulong addr)
     cpu->current_tb = NULL;
 
     addr &= TARGET_PAGE_MASK;
-    i = (addr >> TARGET_PAGE_BITS) & (CPU_TLB_SIZE - 1);
     for (mmu_idx = 0; mmu_idx < NB_MMU_MODES; mmu_idx++) {
+        i = tlb_index(env, mmu_idx, addr);
         tlb_flush_entry(&env->tlb_table[mmu_idx][i], addr);
     }
 
@@ -124,6 +337,7 @@ void tlb_flush_page(CPUState *cpu, target_ulong addr)
    can be detected */
 void tlb_protect_code(struct uc_struct *uc, ram_addr_t ram_addr)
 {
+    tlb_fastmem_set_code(uc, ram_addr, true);
     cpu_physical_memory_reset_dirty(uc, ram_addr, TARGET_PAGE_SIZE,
                                     DIRTY_MEMORY_CODE);
 }
@@ -159,9 +373,9 @@ void cpu_tlb_reset_dirty_all(struct uc_struct *uc,
 
     env = cpu->env_ptr;
     for (mmu_idx = 0; mmu_idx < NB_MMU_MODES; mmu_idx++) {
-        unsigned int i;
+        uintptr_t i;
 
-        for (i = 0; i < CPU_TLB_SIZE; i++) {
+        for (i = 0; i < tlb_entries(env, mmu_idx); i++) {
             tlb_reset_dirty_range(&env->tlb_table[mmu_idx][i],
                                   start1, length);
         }
@@ -173,6 +387,64 @@ void cpu_tlb_reset_dirty_all(struct uc_struct *uc,
     }
 }
 
+/* Unicorn: drop @tlb_entry if it maps the host RAM from @start, @length
+   bytes, or with @length 0, unassigned memory */
+static void tlb_flush_memory_entry(CPUState *cpu, CPUTLBEntry *tlb_entry,
+                                   hwaddr iotlb, uintptr_t start,
+                                   uintptr_t length)
+{
+    target_ulong page = tlb_entry_page(tlb_entry);
+    MemoryRegion *mr;
+
+    if (page == (target_ulong)-1) {
+        return;
+    }
+    if (length) {
+        if ((uintptr_t)page + tlb_entry->addend - start >= length) {
+            return;
+        }
+    } else {
+        mr = iotlb_to_region(cpu->as, iotlb & ~TARGET_PAGE_MASK);
+        if (!((tlb_entry->addr_read | tlb_entry->addr_write |
+               tlb_entry->addr_code) & TLB_MMIO) ||
+            mr != &cpu->uc->io_mem_unassigned) {
+            return;
+        }
+    }
+    memset(tlb_entry, -1, sizeof(*tlb_entry));
+}
+
+/* Unicorn: drop the TLB entries which a change of the memory
+   map made stale: those of the host RAM at @host, @length bytes, going
+   away, or with @host NULL, those of unassigned memory, which may be RAM
+   now. Unlike with tlb_flush(), the other entries stay. */
+void tlb_flush_memory(struct uc_struct *uc, void *host, size_t length)
+{
+    CPUState *cpu = uc->cpu;
+    CPUArchState *env = cpu->env_ptr;
+    int mmu_idx;
+
+    for (mmu_idx = 0; mmu_idx < NB_MMU_MODES; mmu_idx++) {
+        uintptr_t i;
+
+        for (i = 0; i < tlb_entries(env, mmu_idx); i++) {
+            tlb_flush_memory_entry(cpu, &env->tlb_table[mmu_idx][i],
+                                   env->iotlb[mmu_idx][i],
+                                   (uintptr_t)host, length);
+        }
+
+        for (i = 0; i < CPU_VTLB_SIZE; i++) {
+            tlb_flush_memory_entry(cpu, &env->tlb_v_table[mmu_idx][i],
+                                   env->iotlb_v[mmu_idx][i],
+                                   (uintptr_t)host, length);
+        }
+    }
+    if (host) {
+        /* the window may be in that RAM, until tlb_fastmem_update() */
+        memset(env->fastmem_end, 0, sizeof(env->fastmem_end));
+    }
+}
+
 /* update the TLB corresponding to virtual page vaddr
    so that it is no longer dirty */
 void tlb_set_dirty(CPUArchState *env, target_ulong vaddr)
@@ -181,8 +453,8 @@ void tlb_set_dirty(CPUArchState *env, target_ulong vaddr)
     int mmu_idx;
 
     vaddr &= TARGET_PAGE_MASK;
-    i = (vaddr >> TARGET_PAGE_BITS) & (CPU_TLB_SIZE - 1);
     for (mmu_idx = 0; mmu_idx < NB_MMU_MODES; mmu_idx++) {
+        i = tlb_index(env, mmu_idx, vaddr);
         tlb_set_dirty1(&env->tlb_table[mmu_idx][i], vaddr);
     }
 
@@ -194,6 +466,142 @@ void tlb_set_dirty(CPUArchState *env, target_ulong vaddr)
     }
 }
 
+/* Unicorn: host address of the @size bytes of guest RAM at @addr, which do
+   not cross a page, for the caller to read, compare & write with host
+   atomics. The TLB is filled as for a store. On a clean page, the store is
+   handled as notdirty_mem_write() does, before the caller makes it.
+   NULL for I/O, and for pages with memory hooks or lacking a permission,
+   whose accesses must go through the softmmu helpers. */
+void *tlb_vaddr_to_host_rmw(CPUArchState *env, target_ulong addr, int size,
+                            int mmu_idx, uintptr_t retaddr)
+{
+    CPUState *cpu = ENV_GET_CPU(env);
+    target_ulong page = addr & TARGET_PAGE_MASK;
+    int index = tlb_index(env, mmu_idx, addr);
+    CPUTLBEntry *te = &env->tlb_table[mmu_idx][index];
+    ram_addr_t ram_addr;
+    void *host;
+
+    if (page != (te->addr_write & (TARGET_PAGE_MASK | TLB_INVALID_MASK))) {
+        tlb_fill(cpu, addr, 1, mmu_idx, retaddr);
+        /* the refill may have resized the TLB */
+        index = tlb_index(env, mmu_idx, addr);
+        te = &env->tlb_table[mmu_idx][index];
+    }
+
+    /* the load has to be a plain one too */
+    if (te->addr_read != page || (te->addr_write & ~TLB_NOTDIRTY) != page) {
+        return NULL;
+    }
+
+    host = (void *)((uintptr_t)addr + te->addend);
+    if (te->addr_write & TLB_NOTDIRTY) {
+        if (!qemu_ram_addr_from_host_nofail(cpu->uc, host, &ram_addr)) {
+            return NULL;
+        }
+        cpu->mem_io_pc = retaddr;
+        cpu->mem_io_vaddr = addr;
+        cpu_notdirty_write(cpu->uc, ram_addr, size);
+    }
+
+    return host;
+}
+
+
+/* Unicorn: translated code stores to the RAM window only where no
+   translated code was found, so writes to code still get caught */
+void tlb_fastmem_set_code(struct uc_struct *uc, ram_addr_t ram_addr, bool code)
+{
+    MemoryRegion *mr = uc->fastmem_mr;
+    ram_addr_t offset;
+
+    /* the map is rebuilt when the window is chosen again */
+    if (uc->fastmem_code && !uc->fastmem_stale) {
+        offset = ram_addr - mr->ram_addr - uc->fastmem_offset;
+        if (offset < uc->fastmem_size) {
+            uc->fastmem_code[offset >> TARGET_PAGE_BITS] = code;
+        }
+    }
+}
+
+/* Unicorn: the window is the longest run of readable & writable pages of
+   a RAM region, so pages protected in it leave the rest of the region */
+static void tlb_fastmem_choose(struct uc_struct *uc)
+{
+    const uint8_t rw = UC_PROT_READ | UC_PROT_WRITE;
+    uint64_t i, start, pages;
+    uint32_t n;
+
+    g_free(uc->fastmem_code);
+    uc->fastmem_code = NULL;
+    uc->fastmem_mr = NULL;
+    uc->fastmem_size = 0;
+    uc->fastmem_stale = false;
+
+    for (n = 0; n < uc->mapped_block_count; n++) {
+        MemoryRegion *block = uc->mapped_blocks[n];
+
+        if (!block->ram) {
+            continue;
+        }
+        pages = (block->end - block->addr) >> TARGET_PAGE_BITS;
+        for (start = 0; start < pages; start = i + 1) {
+            /* the run of pages from start */
+            for (i = start; i < pages; i++) {
+                uint8_t perms = block->page_perms ? block->page_perms[i] : block->perms;
+
+                if ((perms & rw) != rw) {
+                    break;
+                }
+            }
+            if ((i - start) << TARGET_PAGE_BITS > uc->fastmem_size) {
+                uc->fastmem_mr = block;
+                uc->fastmem_offset = start << TARGET_PAGE_BITS;
+                uc->fastmem_size = (i - start) << TARGET_PAGE_BITS;
+            }
+        }
+    }
+
+    if (uc->fastmem_mr == NULL) {
+        return;
+    }
+
+    pages = uc->fastmem_size >> TARGET_PAGE_BITS;
+    uc->fastmem_code = g_malloc(pages);
+    for (i = 0; i < pages; i++) {
+        uc->fastmem_code[i] = cpu_physical_memory_is_clean(uc,
+                uc->fastmem_mr->ram_addr + uc->fastmem_offset + (i << TARGET_PAGE_BITS));
+    }
+}
+
+/* Unicorn: let translated code of @cpu access the RAM window straight,
+   at host address fastmem_host + (guest address - fastmem_begin).
+   @direct tells if guest addresses are physical ones, as the window
+   is none otherwise. */
+void tlb_fastmem_update(CPUState *cpu, bool direct)
+{
+    struct uc_struct *uc = cpu->uc;
+    CPUArchState *env = cpu->env_ptr;
+    MemoryRegion *mr;
+    int i;
+
+    if (uc->fastmem_stale) {
+        tlb_fastmem_choose(uc);
+    }
+
+    memset(env->fastmem_end, 0, sizeof(env->fastmem_end));
+    mr = uc->fastmem_mr;
+    if (!uc->fastmem || !direct || mr == NULL) {
+        return;
+    }
+
+    env->fastmem_begin = mr->addr + uc->fastmem_offset;
+    env->fastmem_host = (uintptr_t)qemu_get_ram_ptr(uc, mr->ram_addr) + uc->fastmem_offset;
+    env->fastmem_code = (uintptr_t)uc->fastmem_code;
+    for (i = 0; i < ARRAY_SIZE(env->fastmem_end); i++) {
+        env->fastmem_end[i] = uc->fastmem_size - (1 << i) + 1;
+    }
+}
 
 /* Add a new TLB entry. At most one entry for a given virtual address
    is permitted. Only a single TARGET_PAGE_SIZE region is mapped, the
@@ -204,13 +612,17 @@ void tlb_set_page(CPUState *cpu, target_ulong vaddr,
 {
     CPUArchState *env = cpu->env_ptr;
     MemoryRegionSection *section;
-    unsigned int index;
+    uintptr_t index;
     target_ulong address;
     target_ulong code_address;
     uintptr_t addend;
     CPUTLBEntry *te;
     hwaddr iotlb, xlat, sz;
     unsigned vidx = env->vtlb_index++ % CPU_VTLB_SIZE;
+    bool evicted;
+    target_ulong page = vaddr & TARGET_PAGE_MASK;
+    target_ulong read_hooked = 0, write_hooked = 0, code_hooked = 0;
+    uint32_t perms;
 
     assert(size >= TARGET_PAGE_SIZE);
     if (size != TARGET_PAGE_SIZE) {
@@ -242,24 +654,49 @@ void tlb_set_page(CPUState *cpu, target_ulong vaddr,
     iotlb = memory_region_section_get_iotlb(cpu, section, vaddr, paddr, xlat,
                                             prot, &address);
 
-    index = (vaddr >> TARGET_PAGE_BITS) & (CPU_TLB_SIZE - 1);
+    index = tlb_index(env, mmu_idx, vaddr);
     te = &env->tlb_table[mmu_idx][index];
+    evicted = (te->addr_read & te->addr_write & te->addr_code
+               & TLB_INVALID_MASK) == 0;
 
     /* do not discard the translation in te, evict it into a victim tlb */
     env->tlb_v_table[mmu_idx][vidx] = *te;
     env->iotlb_v[mmu_idx][vidx] = env->iotlb[mmu_idx][index];
 
+    /* Unicorn: only the pages with memory hooks take the slow path for them */
+    if (HOOK_EXISTS_RANGE(cpu->uc, UC_HOOK_MEM_READ, page, page + TARGET_PAGE_SIZE - 1) ||
+            HOOK_EXISTS_RANGE(cpu->uc, UC_HOOK_MEM_READ_AFTER, page, page + TARGET_PAGE_SIZE - 1)) {
+        read_hooked = TLB_HOOKED;
+    }
+    if (HOOK_EXISTS_RANGE(cpu->uc, UC_HOOK_MEM_WRITE, page, page + TARGET_PAGE_SIZE - 1)) {
+        write_hooked = TLB_HOOKED;
+    }
+
+    /* Unicorn: and the pages lacking a permission, which the helpers check */
+    if (section->mr->host) {
+        perms = memory_region_perms(cpu->uc, section->mr, section->mr->addr + xlat);
+        if (!(perms & UC_PROT_READ)) {
+            read_hooked = TLB_HOOKED;
+        }
+        if (!(perms & UC_PROT_WRITE)) {
+            write_hooked = TLB_HOOKED;
+        }
+        if (!(perms & UC_PROT_EXEC)) {
+            code_hooked = TLB_HOOKED;
+        }
+    }
+
     /* refill the tlb */
     env->iotlb[mmu_idx][index] = iotlb - vaddr;
     te->addend = (uintptr_t)(addend - vaddr);
     if (prot & PAGE_READ) {
-        te->addr_read = address;
+        te->addr_read = address | read_hooked;
     } else {
         te->addr_read = -1;
     }
 
     if (prot & PAGE_EXEC) {
-        te->addr_code = code_address;
+        te->addr_code = code_address | code_hooked;
     } else {
         te->addr_code = -1;
     }
@@ -267,17 +704,25 @@ void tlb_set_page(CPUState *cpu, target_ulong vaddr,
         if ((memory_region_is_ram(section->mr) && section->readonly)
             || memory_region_is_romd(section->mr)) {
             /* Write access calls the I/O callback.  */
-            te->addr_write = address | TLB_MMIO;
+            te->addr_write = address | TLB_MMIO | write_hooked;
         } else if (memory_region_is_ram(section->mr)
                    && cpu_physical_memory_is_clean(cpu->uc, (ram_addr_t)(section->mr->ram_addr
                                                    + xlat))) {
-            te->addr_write = address | TLB_NOTDIRTY;
+            te->addr_write = address | TLB_NOTDIRTY | write_hooked;
         } else {
-            te->addr_write = address;
+            te->addr_write = address | write_hooked;
+            if (memory_region_is_ram(section->mr)) {
+                tlb_fastmem_set_code(cpu->uc, section->mr->ram_addr + xlat, false);
+            }
         }
     } else {
         te->addr_write = -1;
     }
+    cpu->uc->tlb_fills++;
+
+#ifdef CPU_TLB_DYNAMIC
+    tlb_desc_refilled(cpu, mmu_idx, evicted);
+#endif
 }
 
 /* NOTE: this function can trigger an exception */
@@ -293,12 +738,12 @@ tb_page_addr_t get_page_addr_code(CPUArchState *env1, target_ulong addr)
     ram_addr_t  ram_addr;
     CPUState *cpu = ENV_GET_CPU(env1);
 
-    page_index = (addr >> TARGET_PAGE_BITS) & (CPU_TLB_SIZE - 1);
     mmu_idx = cpu_mmu_index(env1);
 
     if ((mmu_idx < 0) || (mmu_idx >= NB_MMU_MODES)) {
         return -1;
     }
+    page_index = tlb_index(env1, mmu_idx, addr);
 
     if (unlikely(env1->tlb_table[mmu_idx][page_index].addr_code !=
                  (addr & TARGET_PAGE_MASK))) {
@@ -307,6 +752,8 @@ tb_page_addr_t get_page_addr_code(CPUArchState *env1, target_ulong addr)
         if (env1->invalid_error == UC_ERR_FETCH_PROT) {
             return -1;
         }
+        /* the refill may have resized the TLB */
+        page_index = tlb_index(env1, mmu_idx, addr);
     }
     pd = env1->iotlb[mmu_idx][page_index] & ~TARGET_PAGE_MASK;
     mr = iotlb_to_region(cpu->as, pd);
@@ -344,8 +791,8 @@ static bool qemu_ram_addr_from_host_nofail(struct uc_struct *uc, void *ptr, ram_
 
 static void tlb_set_dirty1(CPUTLBEntry *tlb_entry, target_ulong vaddr)
 {
-    if (tlb_entry->addr_write == (vaddr | TLB_NOTDIRTY)) {
-        tlb_entry->addr_write = vaddr;
+    if ((tlb_entry->addr_write & ~TLB_HOOKED) == (vaddr | TLB_NOTDIRTY)) {
+        tlb_entry->addr_write &= ~TLB_NOTDIRTY;
     }
 }
 
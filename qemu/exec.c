@@ -94,6 +94,11 @@ typedef struct PhysPageMap {
     unsigned nodes_nb_alloc;
     Node *nodes;
     MemoryRegionSection *sections;
+    /* Unicorn: what address_space_dispatch_update() freed, to reuse */
+    uint32_t nodes_free;        /* first free node, the next in its entry 0 */
+    uint16_t *sections_free;
+    unsigned sections_free_nb;
+    unsigned sections_free_alloc;
 } PhysPageMap;
 
 struct AddressSpaceDispatch {
@@ -139,9 +144,14 @@ static uint32_t phys_map_node_alloc(PhysPageMap *map)
     unsigned i;
     uint32_t ret;
 
-    ret = map->nodes_nb++;
-    assert(ret != PHYS_MAP_NODE_NIL);
-    assert(ret != map->nodes_nb_alloc);
+    if (map->nodes_free != PHYS_MAP_NODE_NIL) {
+        ret = map->nodes_free;
+        map->nodes_free = map->nodes[ret][0].ptr;
+    } else {
+        ret = map->nodes_nb++;
+        assert(ret != PHYS_MAP_NODE_NIL);
+        assert(ret != map->nodes_nb_alloc);
+    }
     for (i = 0; i < P_L2_SIZE; ++i) {
         map->nodes[ret][i].skip = 1;
         map->nodes[ret][i].ptr = PHYS_MAP_NODE_NIL;
@@ -149,6 +159,22 @@ static uint32_t phys_map_node_alloc(PhysPageMap *map)
     return ret;
 }
 
+/* Unicorn: give back @node, whose entries are at @level, and the nodes
+   below it, once a leaf replaced it */
+static void phys_map_node_free(PhysPageMap *map, uint32_t node, int level)
+{
+    PhysPageEntry *p = map->nodes[node];
+    int i;
+
+    for (i = 0; level > 0 && i < P_L2_SIZE; i++) {
+        if (p[i].skip && p[i].ptr != PHYS_MAP_NODE_NIL) {
+            phys_map_node_free(map, p[i].ptr, level - 1);
+        }
+    }
+    p[0].ptr = map->nodes_free;
+    map->nodes_free = node;
+}
+
 static void phys_page_set_level(PhysPageMap *map, PhysPageEntry *lp,
         hwaddr *index, hwaddr *nb, uint16_t leaf,
         int level)
@@ -166,6 +192,17 @@ static void phys_page_set_level(PhysPageMap *map, PhysPageEntry *lp,
                 p[i].ptr = PHYS_SECTION_UNASSIGNED;
             }
         }
+    } else if (!lp->skip) {
+        /* Unicorn: a leaf of a larger range, updated in place: split it */
+        uint32_t old = lp->ptr;
+
+        lp->ptr = phys_map_node_alloc(map);
+        lp->skip = 1;
+        p = map->nodes[lp->ptr];
+        for (i = 0; i < P_L2_SIZE; i++) {
+            p[i].skip = 0;
+            p[i].ptr = old;
+        }
     } else {
         p = map->nodes[lp->ptr];
     }
@@ -173,6 +210,9 @@ static void phys_page_set_level(PhysPageMap *map, PhysPageEntry *lp,
 
     while (*nb && lp < &p[P_L2_SIZE]) {
         if ((*index & (step - 1)) == 0 && *nb >= step) {
+            if (lp->skip && lp->ptr != PHYS_MAP_NODE_NIL) {
+                phys_map_node_free(map, lp->ptr, level - 1);
+            }
             lp->skip = 0;
             lp->ptr = leaf;
             *index += step;
@@ -194,70 +234,6 @@ static void phys_page_set(AddressSpaceDispatch *d,
     phys_page_set_level(&d->map, &d->phys_map, &index, &nb, leaf, P_L2_LEVELS - 1);
 }
 
-/* Compact a non leaf page entry. Simply detect that the entry has a single child,
- * and update our entry so we can skip it and go directly to the destination.
- */
-static void phys_page_compact(PhysPageEntry *lp, Node *nodes, unsigned long *compacted)
-{
-    unsigned valid_ptr = P_L2_SIZE;
-    int valid = 0;
-    PhysPageEntry *p;
-    int i;
-
-    if (lp->ptr == PHYS_MAP_NODE_NIL) {
-        return;
-    }
-
-    p = nodes[lp->ptr];
-    for (i = 0; i < P_L2_SIZE; i++) {
-        if (p[i].ptr == PHYS_MAP_NODE_NIL) {
-            continue;
-        }
-
-        valid_ptr = i;
-        valid++;
-        if (p[i].skip) {
-            phys_page_compact(&p[i], nodes, compacted);
-        }
-    }
-
-    /* We can only compress if there's only one child. */
-    if (valid != 1) {
-        return;
-    }
-
-    assert(valid_ptr < P_L2_SIZE);
-
-    /* Don't compress if it won't fit in the # of bits we have. */
-    if (lp->skip + p[valid_ptr].skip >= (1 << 3)) {
-        return;
-    }
-
-    lp->ptr = p[valid_ptr].ptr;
-    if (!p[valid_ptr].skip) {
-        /* If our only child is a leaf, make this a leaf. */
-        /* By design, we should have made this node a leaf to begin with so we
-         * should never reach here.
-         * But since it's so simple to handle this, let's do it just in case we
-         * change this rule.
-         */
-        lp->skip = 0;
-    } else {
-        lp->skip += p[valid_ptr].skip;
-    }
-}
-
-static void phys_page_compact_all(AddressSpaceDispatch *d, int nodes_nb)
-{
-    //DECLARE_BITMAP(compacted, nodes_nb);
-    // this isnt actually used
-    unsigned long* compacted = NULL;
-
-    if (d->phys_map.skip) {
-        phys_page_compact(&d->phys_map, d->map.nodes, compacted);
-    }
-}
-
 static MemoryRegionSection *phys_page_find(PhysPageEntry lp, hwaddr addr,
         Node *nodes, MemoryRegionSection *sections)
 {
@@ -424,6 +400,8 @@ void cpu_exec_init(CPUArchState *env, void *opaque)
 
     // TODO: assert uc does not already have a cpu?
     uc->cpu = cpu;
+
+    tlb_init(cpu);
 }
 
 #if defined(TARGET_HAS_ICE)
@@ -679,25 +657,58 @@ void cpu_abort(CPUState *cpu, const char *fmt, ...)
 }
 
 #if !defined(CONFIG_USER_ONLY)
-static RAMBlock *qemu_get_ram_block(struct uc_struct *uc, ram_addr_t addr)
+/* Unicorn: index of the first block of ram_list ending after @addr */
+static size_t ram_block_bsearch(RAMList *list, ram_addr_t addr)
+{
+    size_t left = 0, right = list->blocks_nb, mid;
+
+    while (left < right) {
+        mid = left + (right - left) / 2;
+        if (list->blocks[mid]->offset + list->blocks[mid]->length <= addr) {
+            left = mid + 1;
+        } else {
+            right = mid;
+        }
+    }
+
+    return left;
+}
+
+/* Unicorn: index of the first block of ram_list.by_host starting after @host */
+static size_t ram_block_host_bsearch(RAMList *list, uint8_t *host)
+{
+    size_t left = 0, right = list->blocks_nb, mid;
+
+    while (left < right) {
+        mid = left + (right - left) / 2;
+        if ((uintptr_t)list->by_host[mid]->host <= (uintptr_t)host) {
+            left = mid + 1;
+        } else {
+            right = mid;
+        }
+    }
+
+    return left;
+}
+
+RAMBlock *qemu_get_ram_block(struct uc_struct *uc, ram_addr_t addr)
 {
     RAMBlock *block;
+    size_t i;
 
-    /* The list is protected by the iothread lock here.  */
     block = uc->ram_list.mru_block;
     if (block && addr - block->offset < block->length) {
-        goto found;
-    }
-    QTAILQ_FOREACH(block, &uc->ram_list.blocks, next) {
-        if (addr - block->offset < block->length) {
-            goto found;
-        }
+        return block;
     }
 
-    fprintf(stderr, "Bad ram offset %" PRIx64 "\n", (uint64_t)addr);
-    abort();
+    i = ram_block_bsearch(&uc->ram_list, addr);
+    if (i == uc->ram_list.blocks_nb ||
+        addr - uc->ram_list.blocks[i]->offset >= uc->ram_list.blocks[i]->length) {
+        fprintf(stderr, "Bad ram offset %" PRIx64 "\n", (uint64_t)addr);
+        abort();
+    }
 
-found:
+    block = uc->ram_list.blocks[i];
     uc->ram_list.mru_block = block;
     return block;
 }
@@ -794,6 +805,15 @@ void phys_mem_set_alloc(void *(*alloc)(size_t, uint64_t *align))
 static uint16_t phys_section_add(PhysPageMap *map,
         MemoryRegionSection *section)
 {
+    uint16_t index;
+
+    if (map->sections_free_nb > 0) {
+        index = map->sections_free[--map->sections_free_nb];
+        map->sections[index] = *section;
+        memory_region_ref(section->mr);
+        return index;
+    }
+
     /* The physical section number is ORed with a page-aligned
      * pointer to produce the iotlb entries.  Thus it should
      * never overflow into the page-aligned value.
@@ -821,13 +841,29 @@ static void phys_section_destroy(MemoryRegion *mr)
     }
 }
 
+/* Unicorn: give back the section @index, which no page uses anymore */
+static void phys_section_free(PhysPageMap *map, uint16_t index)
+{
+    if (map->sections_free_nb == map->sections_free_alloc) {
+        map->sections_free_alloc = MAX(map->sections_free_alloc * 2, 16);
+        map->sections_free = g_renew(uint16_t, map->sections_free,
+                map->sections_free_alloc);
+    }
+    phys_section_destroy(map->sections[index].mr);
+    map->sections[index].mr = NULL;
+    map->sections_free[map->sections_free_nb++] = index;
+}
+
 static void phys_sections_free(PhysPageMap *map)
 {
     while (map->sections_nb > 0) {
         MemoryRegionSection *section = &map->sections[--map->sections_nb];
-        phys_section_destroy(section->mr);
+        if (section->mr) {
+            phys_section_destroy(section->mr);
+        }
     }
     g_free(map->sections);
+    g_free(map->sections_free);
     g_free(map->nodes);
 }
 
@@ -914,33 +950,85 @@ static void mem_add(MemoryListener *listener, MemoryRegionSection *section)
 
 #endif
 
-static ram_addr_t find_ram_offset(struct uc_struct *uc, ram_addr_t size)
+/* Unicorn: index of the first gap of ram_list not below @length, @offset */
+static size_t ram_gap_bsearch(RAMList *list, ram_addr_t length, ram_addr_t offset)
 {
-    RAMBlock *block, *next_block;
-    ram_addr_t offset = RAM_ADDR_MAX, mingap = RAM_ADDR_MAX;
+    size_t left = 0, right = list->gaps_nb, mid;
+    RAMGap *gap;
 
-    assert(size != 0); /* it would hand out same offset multiple times */
+    while (left < right) {
+        mid = left + (right - left) / 2;
+        gap = &list->gaps[mid];
+        if (gap->length < length ||
+            (gap->length == length && gap->offset < offset)) {
+            left = mid + 1;
+        } else {
+            right = mid;
+        }
+    }
 
-    if (QTAILQ_EMPTY(&uc->ram_list.blocks))
-        return 0;
+    return left;
+}
 
-    QTAILQ_FOREACH(block, &uc->ram_list.blocks, next) {
-        ram_addr_t end, next = RAM_ADDR_MAX;
+static void ram_gap_add(RAMList *list, ram_addr_t offset, ram_addr_t length)
+{
+    size_t i;
 
-        end = block->offset + block->length;
+    if (length == 0) {
+        return;
+    }
 
-        QTAILQ_FOREACH(next_block, &uc->ram_list.blocks, next) {
-            if (next_block->offset >= end) {
-                next = MIN(next, next_block->offset);
-            }
-        }
-        if (next - end >= size && next - end < mingap) {
-            offset = end;
-            mingap = next - end;
-        }
+    if (list->gaps_nb == list->gaps_alloc) {
+        list->gaps_alloc = MAX(16, list->gaps_alloc * 2);
+        list->gaps = g_renew(RAMGap, list->gaps, list->gaps_alloc);
     }
 
-    if (offset == RAM_ADDR_MAX) {
+    i = ram_gap_bsearch(list, length, offset);
+    memmove(&list->gaps[i + 1], &list->gaps[i],
+            (list->gaps_nb - i) * sizeof(RAMGap));
+    list->gaps[i].offset = offset;
+    list->gaps[i].length = length;
+    list->gaps_nb++;
+}
+
+static void ram_gap_del(RAMList *list, ram_addr_t offset, ram_addr_t length)
+{
+    size_t i;
+
+    if (length == 0) {
+        return;
+    }
+
+    i = ram_gap_bsearch(list, length, offset);
+    assert(i < list->gaps_nb && list->gaps[i].offset == offset);
+    list->gaps_nb--;
+    memmove(&list->gaps[i], &list->gaps[i + 1],
+            (list->gaps_nb - i) * sizeof(RAMGap));
+}
+
+/* Unicorn: the smallest gap between blocks that fits @size, as QEMU
+   picks, but found by a binary search over the gaps sorted by length
+   rather than by comparing every block with every other one. Without
+   such a gap, the block goes after the last one. */
+static ram_addr_t find_ram_offset(struct uc_struct *uc, ram_addr_t size)
+{
+    RAMList *list = &uc->ram_list;
+    ram_addr_t offset;
+    RAMGap gap;
+    size_t i;
+
+    assert(size != 0); /* it would hand out same offset multiple times */
+
+    i = ram_gap_bsearch(list, size, 0);
+    if (i < list->gaps_nb) {
+        gap = list->gaps[i];
+        ram_gap_del(list, gap.offset, gap.length);
+        ram_gap_add(list, gap.offset + size, gap.length - size);
+        return gap.offset;
+    }
+
+    offset = last_ram_offset(uc);
+    if (offset + size < offset) {
         fprintf(stderr, "Failed to find gap of requested size: %" PRIu64 "\n",
                 (uint64_t)size);
         abort();
@@ -951,13 +1039,58 @@ static ram_addr_t find_ram_offset(struct uc_struct *uc, ram_addr_t size)
 
 ram_addr_t last_ram_offset(struct uc_struct *uc)
 {
-    RAMBlock *block;
-    ram_addr_t last = 0;
+    RAMList *list = &uc->ram_list;
+    RAMBlock *last;
+
+    if (list->blocks_nb == 0) {
+        return 0;
+    }
+
+    last = list->blocks[list->blocks_nb - 1];
+    return last->offset + last->length;
+}
+
+/* Unicorn: take the block at @i out of ram_list, its range joining the
+   gaps around it */
+static void ram_block_remove(struct uc_struct *uc, size_t i)
+{
+    RAMList *list = &uc->ram_list;
+    RAMBlock *block = list->blocks[i];
+    ram_addr_t begin = 0, end;
+    size_t j;
+
+    if (i > 0) {
+        begin = list->blocks[i - 1]->offset + list->blocks[i - 1]->length;
+    }
+    ram_gap_del(list, begin, block->offset - begin);
+    if (i + 1 < list->blocks_nb) {
+        end = block->offset + block->length;
+        ram_gap_del(list, end, list->blocks[i + 1]->offset - end);
+        ram_gap_add(list, begin, list->blocks[i + 1]->offset - begin);
+    }
 
-    QTAILQ_FOREACH(block, &uc->ram_list.blocks, next)
-        last = MAX(last, block->offset + block->length);
+    /* blocks given the same host memory start at the same place */
+    j = ram_block_host_bsearch(list, block->host) - 1;
+    while (list->by_host[j] != block) {
+        j--;
+    }
 
-    return last;
+    list->blocks_nb--;
+    memmove(&list->blocks[i], &list->blocks[i + 1],
+            (list->blocks_nb - i) * sizeof(RAMBlock *));
+    memmove(&list->by_host[j], &list->by_host[j + 1],
+            (list->blocks_nb - j) * sizeof(RAMBlock *));
+    list->mru_block = NULL;
+    list->version++;
+}
+
+static void ram_block_free_dirty(RAMBlock *block)
+{
+    int i;
+
+    for (i = 0; i < DIRTY_MEMORY_NUM; i++) {
+        g_free(block->dirty_memory[i]);
+    }
 }
 
 static void qemu_ram_setup_dump(void *addr, ram_addr_t size)
@@ -966,12 +1099,10 @@ static void qemu_ram_setup_dump(void *addr, ram_addr_t size)
 
 static RAMBlock *find_ram_block(struct uc_struct *uc, ram_addr_t addr)
 {
-    RAMBlock *block;
+    size_t i = ram_block_bsearch(&uc->ram_list, addr);
 
-    QTAILQ_FOREACH(block, &uc->ram_list.blocks, next) {
-        if (block->offset == addr) {
-            return block;
-        }
+    if (i < uc->ram_list.blocks_nb && uc->ram_list.blocks[i]->offset == addr) {
+        return uc->ram_list.blocks[i];
     }
 
     return NULL;
@@ -993,12 +1124,8 @@ static int memory_try_enable_merging(void *addr, size_t len)
 
 static ram_addr_t ram_block_add(struct uc_struct *uc, RAMBlock *new_block, Error **errp)
 {
-    RAMBlock *block;
-    ram_addr_t old_ram_size, new_ram_size;
-
-    old_ram_size = last_ram_offset(uc) >> TARGET_PAGE_BITS;
-
-    new_block->offset = find_ram_offset(uc, new_block->length);
+    RAMList *list = &uc->ram_list;
+    size_t i;
 
     if (!new_block->host) {
         new_block->host = phys_mem_alloc(new_block->length,
@@ -1012,30 +1139,31 @@ static ram_addr_t ram_block_add(struct uc_struct *uc, RAMBlock *new_block, Error
         memory_try_enable_merging(new_block->host, new_block->length);
     }
 
-    /* Keep the list sorted from biggest to smallest block.  */
-    QTAILQ_FOREACH(block, &uc->ram_list.blocks, next) {
-        if (block->length < new_block->length) {
-            break;
-        }
-    }
-    if (block) {
-        QTAILQ_INSERT_BEFORE(block, new_block, next);
-    } else {
-        QTAILQ_INSERT_TAIL(&uc->ram_list.blocks, new_block, next);
-    }
-    uc->ram_list.mru_block = NULL;
-
-    uc->ram_list.version++;
-
-    new_ram_size = last_ram_offset(uc) >> TARGET_PAGE_BITS;
+    new_block->offset = find_ram_offset(uc, new_block->length);
 
-    if (new_ram_size > old_ram_size) {
-        int i;
-        for (i = 0; i < DIRTY_MEMORY_NUM; i++) {
-            uc->ram_list.dirty_memory[i] =
-                bitmap_zero_extend(uc->ram_list.dirty_memory[i],
-                        old_ram_size, new_ram_size);
-        }
+    /* Unicorn: keep the blocks sorted by offset, each with its own dirty
+       bitmaps rather than bitmaps of the whole ram_addr_t space */
+    if (list->blocks_nb == list->blocks_alloc) {
+        list->blocks_alloc = MAX(16, list->blocks_alloc * 2);
+        list->blocks = g_renew(RAMBlock *, list->blocks, list->blocks_alloc);
+        list->by_host = g_renew(RAMBlock *, list->by_host, list->blocks_alloc);
+    }
+    i = ram_block_bsearch(list, new_block->offset);
+    memmove(&list->blocks[i + 1], &list->blocks[i],
+            (list->blocks_nb - i) * sizeof(RAMBlock *));
+    list->blocks[i] = new_block;
+    i = ram_block_host_bsearch(list, new_block->host);
+    memmove(&list->by_host[i + 1], &list->by_host[i],
+            (list->blocks_nb - i) * sizeof(RAMBlock *));
+    list->by_host[i] = new_block;
+    list->blocks_nb++;
+    list->mru_block = NULL;
+
+    list->version++;
+
+    for (i = 0; i < DIRTY_MEMORY_NUM; i++) {
+        new_block->dirty_memory[i] =
+            g_new0(unsigned long, BITS_TO_LONGS(new_block->length >> TARGET_PAGE_BITS));
     }
     cpu_physical_memory_set_dirty_range(uc, new_block->offset, new_block->length);
 
@@ -1083,40 +1211,36 @@ ram_addr_t qemu_ram_alloc(ram_addr_t size, MemoryRegion *mr, Error **errp)
 void qemu_ram_free_from_ptr(struct uc_struct *uc, ram_addr_t addr)
 {
     RAMBlock *block;
+    size_t i = ram_block_bsearch(&uc->ram_list, addr);
 
-    QTAILQ_FOREACH(block, &uc->ram_list.blocks, next) {
-        if (addr == block->offset) {
-            QTAILQ_REMOVE(&uc->ram_list.blocks, block, next);
-            uc->ram_list.mru_block = NULL;
-            uc->ram_list.version++;
-            g_free(block);
-            break;
-        }
+    if (i < uc->ram_list.blocks_nb && uc->ram_list.blocks[i]->offset == addr) {
+        block = uc->ram_list.blocks[i];
+        ram_block_remove(uc, i);
+        ram_block_free_dirty(block);
+        g_free(block);
     }
 }
 
 void qemu_ram_free(struct uc_struct *uc, ram_addr_t addr)
 {
     RAMBlock *block;
+    size_t i = ram_block_bsearch(&uc->ram_list, addr);
 
-    QTAILQ_FOREACH(block, &uc->ram_list.blocks, next) {
-        if (addr == block->offset) {
-            QTAILQ_REMOVE(&uc->ram_list.blocks, block, next);
-            uc->ram_list.mru_block = NULL;
-            uc->ram_list.version++;
-            if (block->flags & RAM_PREALLOC) {
-                ;
+    if (i < uc->ram_list.blocks_nb && uc->ram_list.blocks[i]->offset == addr) {
+        block = uc->ram_list.blocks[i];
+        ram_block_remove(uc, i);
+        if (block->flags & RAM_PREALLOC) {
+            ;
 #ifndef _WIN32
-            } else if (block->fd >= 0) {
-                munmap(block->host, block->length);
-                close(block->fd);
+        } else if (block->fd >= 0) {
+            munmap(block->host, block->length);
+            close(block->fd);
 #endif
-            } else {
-                qemu_anon_ram_free(block->host, block->length);
-            }
-            g_free(block);
-            break;
+        } else {
+            qemu_anon_ram_free(block->host, block->length);
         }
+        ram_block_free_dirty(block);
+        g_free(block);
     }
 }
 
@@ -1127,8 +1251,10 @@ void qemu_ram_remap(struct uc_struct *uc, ram_addr_t addr, ram_addr_t length)
     ram_addr_t offset;
     int flags;
     void *area, *vaddr;
+    size_t i;
 
-    QTAILQ_FOREACH(block, &uc->ram_list.blocks, next) {
+    for (i = 0; i < uc->ram_list.blocks_nb; i++) {
+        block = uc->ram_list.blocks[i];
         offset = addr - block->offset;
         if (offset < block->length) {
             vaddr = block->host + offset;
@@ -1207,16 +1333,10 @@ static void *qemu_ram_ptr_length(struct uc_struct *uc, ram_addr_t addr, hwaddr *
         return NULL;
     }
 
-    QTAILQ_FOREACH(block, &uc->ram_list.blocks, next) {
-        if (addr - block->offset < block->length) {
-            if (addr - block->offset + *size > block->length)
-                *size = block->length - addr + block->offset;
-            return block->host + (addr - block->offset);
-        }
-    }
-
-    fprintf(stderr, "Bad ram offset %" PRIx64 "\n", (uint64_t)addr);
-    abort();
+    block = qemu_get_ram_block(uc, addr);
+    if (addr - block->offset + *size > block->length)
+        *size = block->length - addr + block->offset;
+    return block->host + (addr - block->offset);
 }
 
 /* Some of the softmmu routines need to translate from a host pointer
@@ -1225,13 +1345,26 @@ MemoryRegion *qemu_ram_addr_from_host(struct uc_struct *uc, void *ptr, ram_addr_
 {
     RAMBlock *block;
     uint8_t *host = ptr;
+    size_t i;
 
     block = uc->ram_list.mru_block;
     if (block && block->host && host - block->host < block->length) {
         goto found;
     }
 
-    QTAILQ_FOREACH(block, &uc->ram_list.blocks, next) {
+    /* the last block starting at or before @host */
+    i = ram_block_host_bsearch(&uc->ram_list, host);
+    if (i > 0) {
+        block = uc->ram_list.by_host[i - 1];
+        if (block->host && host - block->host < block->length) {
+            goto found;
+        }
+    }
+
+    /* the memory of uc_mem_map_ptr() may be given to several blocks, which
+       may then overlap: another one starting before may hold @host */
+    for (i = 0; i < uc->ram_list.blocks_nb; i++) {
+        block = uc->ram_list.blocks[i];
         /* This case append when the block is not mapped. */
         if (block->host == NULL) {
             continue;
@@ -1340,12 +1473,29 @@ static int subpage_register (subpage_t *mmio, uint32_t start, uint32_t end,
     return 0;
 }
 
-static void notdirty_mem_write(struct uc_struct* uc, void *opaque, hwaddr ram_addr,
-                               uint64_t val, unsigned size)
+/* Unicorn: @size bytes at @ram_addr, on a clean page, are about to be
+   stored to by the current CPU, at current_cpu->mem_io_vaddr: drop the
+   code translated from them and mark them dirty. Also for stores made with
+   host atomics, see tlb_vaddr_to_host_rmw() */
+void cpu_notdirty_write(struct uc_struct *uc, ram_addr_t ram_addr, unsigned size)
 {
     if (!cpu_physical_memory_get_dirty_flag(uc, ram_addr, DIRTY_MEMORY_CODE)) {
         tb_invalidate_phys_page_fast(uc, ram_addr, size);
     }
+    cpu_physical_memory_set_dirty_tracked(uc, ram_addr, size);
+    /* we remove the notdirty callback only if the code has been
+       flushed */
+    if (!cpu_physical_memory_is_clean(uc, ram_addr)) {
+        CPUArchState *env = uc->current_cpu->env_ptr;
+        tlb_set_dirty(env, uc->current_cpu->mem_io_vaddr);
+        tlb_fastmem_set_code(uc, ram_addr, false);
+    }
+}
+
+static void notdirty_mem_write(struct uc_struct* uc, void *opaque, hwaddr ram_addr,
+                               uint64_t val, unsigned size)
+{
+    cpu_notdirty_write(uc, ram_addr, size);
     switch (size) {
     case 1:
         stb_p(qemu_get_ram_ptr(uc, ram_addr), val);
@@ -1359,12 +1509,6 @@ static void notdirty_mem_write(struct uc_struct* uc, void *opaque, hwaddr ram_ad
     default:
         abort();
     }
-    /* we remove the notdirty callback only if the code has been
-       flushed */
-    if (!cpu_physical_memory_is_clean(uc, ram_addr)) {
-        CPUArchState *env = uc->current_cpu->env_ptr;
-        tlb_set_dirty(env, uc->current_cpu->mem_io_vaddr);
-    }
 }
 
 static bool notdirty_mem_accepts(void *opaque, hwaddr addr,
@@ -1457,6 +1601,7 @@ static void mem_begin(MemoryListener *listener)
     // assert(n == PHYS_SECTION_WATCH);
 
     d->phys_map = ppe;
+    d->map.nodes_free = PHYS_MAP_NODE_NIL;
     d->as = as;
     as->next_dispatch = d;
 }
@@ -1467,8 +1612,8 @@ static void mem_commit(MemoryListener *listener)
     AddressSpaceDispatch *cur = as->dispatch;
     AddressSpaceDispatch *next = as->next_dispatch;
 
-    phys_page_compact_all(next, next->map.nodes_nb);
-
+    /* Unicorn: not compacted, as address_space_dispatch_update() changes
+       it in place. Lookups walk every level of the map instead */
     as->dispatch = next;
 
     if (cur) {
@@ -1477,6 +1622,28 @@ static void mem_commit(MemoryListener *listener)
     }
 }
 
+/* Unicorn: add @section to (@add) or remove it from the dispatch of @as
+   in place, rather than building it again, see memory_region_update_in_place().
+   @section covers whole pages. */
+void address_space_dispatch_update(AddressSpace *as, MemoryRegionSection *section, bool add)
+{
+    AddressSpaceDispatch *d = as->dispatch;
+    hwaddr start = section->offset_within_address_space;
+    uint64_t num_pages = int128_get64(int128_rshift(section->size, TARGET_PAGE_BITS));
+    MemoryRegionSection *found;
+
+    assert(d == as->next_dispatch);
+    if (add) {
+        register_multipage(d, section);
+        return;
+    }
+
+    found = phys_page_find(d->phys_map, start, d->map.nodes, d->map.sections);
+    assert(found->mr == section->mr);
+    phys_page_set(d, start >> TARGET_PAGE_BITS, num_pages, PHYS_SECTION_UNASSIGNED);
+    phys_section_free(&d->map, found - d->map.sections);
+}
+
 static void tcg_commit(MemoryListener *listener)
 {
     struct uc_struct* uc = listener->address_space_filter->uc;
@@ -1513,11 +1680,13 @@ void address_space_destroy_dispatch(AddressSpace *as)
 
     memory_listener_unregister(as->uc, &as->dispatch_listener);
     g_free(d->map.nodes);
+    g_free(d->map.sections_free);
     g_free(d);
 
     if (as->dispatch != as->next_dispatch) {
         d = as->next_dispatch;
         g_free(d->map.nodes);
+        g_free(d->map.sections_free);
         g_free(d);
     }
 
@@ -1597,6 +1766,53 @@ static void invalidate_and_set_dirty(struct uc_struct *uc, hwaddr addr,
     if (cpu_physical_memory_range_includes_clean(uc, addr, length)) {
         tb_invalidate_phys_range(uc, addr, addr + length, 0);
     }
+    if (length) {
+        cpu_physical_memory_set_dirty_tracked(uc, addr, length);
+    }
+}
+
+/* Unicorn: guest RAM [addr, addr + length[ was written straight to by
+   uc_mem_write(), so drop the code translated from it */
+void cpu_physical_memory_written(struct uc_struct *uc, uint64_t addr, size_t length)
+{
+    invalidate_and_set_dirty(uc, addr, length);
+}
+
+/* Unicorn: set bit n of @bitmap, zeroed by the caller, if RAM page n from
+   @start, which starts a RAM block, was written since the last reset of
+   @client */
+void cpu_physical_memory_dirty_get(struct uc_struct *uc, unsigned client, uint64_t start,
+                                   size_t len, uint64_t *bitmap)
+{
+    unsigned long page = start >> TARGET_PAGE_BITS;
+    unsigned long end = page + (TARGET_PAGE_ALIGN(len) >> TARGET_PAGE_BITS);
+    unsigned long *dirty, n;
+
+    dirty = cpu_physical_memory_dirty_bitmap(uc, &page, &end, client);
+    for (n = find_next_bit(dirty, end, page); n < end; n = find_next_bit(dirty, end, n + 1)) {
+        bitmap[(n - page) / 64] |= 1ULL << ((n - page) % 64);
+    }
+}
+
+/* Unicorn: make all RAM clean for @client, and the TLB & the fast RAM
+   window catch the next write to each page */
+void cpu_physical_memory_dirty_reset(struct uc_struct *uc, unsigned client)
+{
+    size_t i;
+
+    for (i = 0; i < uc->ram_list.blocks_nb; i++) {
+        RAMBlock *block = uc->ram_list.blocks[i];
+
+        bitmap_clear(block->dirty_memory[client], 0,
+                     block->length >> TARGET_PAGE_BITS);
+    }
+
+    if (tcg_enabled(uc)) {
+        cpu_tlb_reset_dirty_all(uc, 0, RAM_ADDR_MAX);
+    }
+    if (uc->fastmem_code && !uc->fastmem_stale) {
+        memset(uc->fastmem_code, 1, uc->fastmem_size >> TARGET_PAGE_BITS);
+    }
 }
 
 static int memory_access_size(MemoryRegion *mr, unsigned l, hwaddr addr)
@@ -2339,8 +2555,10 @@ bool cpu_physical_memory_is_io(AddressSpace *as, hwaddr phys_addr)
 void qemu_ram_foreach_block(struct uc_struct *uc, RAMBlockIterFunc func, void *opaque)
 {
     RAMBlock *block;
+    size_t i;
 
-    QTAILQ_FOREACH(block, &uc->ram_list.blocks, next) {
+    for (i = 0; i < uc->ram_list.blocks_nb; i++) {
+        block = uc->ram_list.blocks[i];
         func(block->host, block->offset, block->length, opaque);
     }
 }
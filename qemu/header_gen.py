@@ -14,10 +14,16 @@ symbols = (
     'tcg_target_deposit_valid',
     'helper_power_down',
     'check_exit_request',
+    'gen_uc_hookcode',
     'address_space_unregister',
     'tb_invalidate_phys_page_fast',
     'phys_mem_clean',
     'tb_cleanup',
+    'tb_discard_partial',
+    'tb_profile_harvest',
+    'tb_flush_all',
+    'tb_invalidate_uc_range',
+    'tb_invalidate_addr_end',
     'memory_map',
     'memory_map_ptr',
     'memory_unmap',
@@ -26,6 +32,7 @@ symbols = (
     'helper_raise_exception',
     'tcg_enabled',
     'tcg_exec_init',
+    'tcg_exec_resize',
     'memory_register_types',
     'cpu_exec_init_all',
     'vm_start',
@@ -66,6 +73,7 @@ symbols = (
     'address_space_access_valid',
     'address_space_destroy',
     'address_space_destroy_dispatch',
+    'address_space_dispatch_update',
     'address_space_get_flatview',
     'address_space_init',
     'address_space_init_dispatch',
@@ -147,7 +155,15 @@ symbols = (
     'arm_singlestep_active',
     'tlb_fill',
     'tlb_flush',
+    'tlb_fastmem_set_code',
+    'tlb_fastmem_update',
+    'tlb_init',
+    'tlb_destroy',
+    'tlb_resize',
+    'tlb_query',
+    'tlb_flush_all',
     'tlb_flush_page',
+    'tlb_flush_memory',
     'tlb_set_page',
     'arm_translate_init',
     'arm_v7m_class_init',
@@ -272,6 +288,10 @@ symbols = (
     'cpu_physical_memory_range_includes_clean',
     'cpu_physical_memory_reset_dirty',
     'cpu_physical_memory_rw',
+    'cpu_physical_memory_written',
+    'cpu_notdirty_write',
+    'cpu_physical_memory_dirty_get',
+    'cpu_physical_memory_dirty_reset',
     'cpu_physical_memory_set_dirty_flag',
     'cpu_physical_memory_set_dirty_range',
     'cpu_physical_memory_unmap',
@@ -931,6 +951,87 @@ symbols = (
     'gen_helper_neon_qunzip8',
     'gen_helper_neon_qzip16',
     'gen_helper_neon_qzip32',
+    'gen_helper_neon_add_u8_q',
+    'gen_helper_neon_add_u16_q',
+    'gen_helper_neon_sub_u8_q',
+    'gen_helper_neon_sub_u16_q',
+    'gen_helper_neon_mul_u8_q',
+    'gen_helper_neon_mul_u16_q',
+    'gen_helper_neon_mla_u8_q',
+    'gen_helper_neon_mla_u16_q',
+    'gen_helper_neon_mls_u8_q',
+    'gen_helper_neon_mls_u16_q',
+    'gen_helper_neon_ceq_u8_q',
+    'gen_helper_neon_ceq_u16_q',
+    'gen_helper_neon_ceq_u32_q',
+    'gen_helper_neon_tst_u8_q',
+    'gen_helper_neon_tst_u16_q',
+    'gen_helper_neon_tst_u32_q',
+    'gen_helper_neon_cgt_s8_q',
+    'gen_helper_neon_cgt_u8_q',
+    'gen_helper_neon_cgt_s16_q',
+    'gen_helper_neon_cgt_u16_q',
+    'gen_helper_neon_cgt_s32_q',
+    'gen_helper_neon_cgt_u32_q',
+    'gen_helper_neon_cge_s8_q',
+    'gen_helper_neon_cge_u8_q',
+    'gen_helper_neon_cge_s16_q',
+    'gen_helper_neon_cge_u16_q',
+    'gen_helper_neon_cge_s32_q',
+    'gen_helper_neon_cge_u32_q',
+    'gen_helper_neon_max_s8_q',
+    'gen_helper_neon_max_u8_q',
+    'gen_helper_neon_max_s16_q',
+    'gen_helper_neon_max_u16_q',
+    'gen_helper_neon_max_s32_q',
+    'gen_helper_neon_max_u32_q',
+    'gen_helper_neon_min_s8_q',
+    'gen_helper_neon_min_u8_q',
+    'gen_helper_neon_min_s16_q',
+    'gen_helper_neon_min_u16_q',
+    'gen_helper_neon_min_s32_q',
+    'gen_helper_neon_min_u32_q',
+    'gen_helper_neon_abd_s8_q',
+    'gen_helper_neon_abd_u8_q',
+    'gen_helper_neon_abd_s16_q',
+    'gen_helper_neon_abd_u16_q',
+    'gen_helper_neon_abd_s32_q',
+    'gen_helper_neon_abd_u32_q',
+    'gen_helper_neon_aba_s8_q',
+    'gen_helper_neon_aba_u8_q',
+    'gen_helper_neon_aba_s16_q',
+    'gen_helper_neon_aba_u16_q',
+    'gen_helper_neon_aba_s32_q',
+    'gen_helper_neon_aba_u32_q',
+    'gen_helper_neon_hadd_s8_q',
+    'gen_helper_neon_hadd_u8_q',
+    'gen_helper_neon_hadd_s16_q',
+    'gen_helper_neon_hadd_u16_q',
+    'gen_helper_neon_hadd_s32_q',
+    'gen_helper_neon_hadd_u32_q',
+    'gen_helper_neon_rhadd_s8_q',
+    'gen_helper_neon_rhadd_u8_q',
+    'gen_helper_neon_rhadd_s16_q',
+    'gen_helper_neon_rhadd_u16_q',
+    'gen_helper_neon_rhadd_s32_q',
+    'gen_helper_neon_rhadd_u32_q',
+    'gen_helper_neon_qadd_s8_q',
+    'gen_helper_neon_qadd_u8_q',
+    'gen_helper_neon_qadd_s16_q',
+    'gen_helper_neon_qadd_u16_q',
+    'gen_helper_neon_qadd_s32_q',
+    'gen_helper_neon_qadd_u32_q',
+    'gen_helper_neon_qsub_s8_q',
+    'gen_helper_neon_qsub_u8_q',
+    'gen_helper_neon_qsub_s16_q',
+    'gen_helper_neon_qsub_u16_q',
+    'gen_helper_neon_qsub_s32_q',
+    'gen_helper_neon_qsub_u32_q',
+    'gen_helper_neon_add_f32_q',
+    'gen_helper_neon_sub_f32_q',
+    'gen_helper_neon_mul_f32_q',
+    'gen_helper_neon_mla_f32_q',
+    'gen_helper_neon_mls_f32_q',
     'gen_helper_neon_qzip8',
     'gen_helper_neon_rhadd_s16',
     'gen_helper_neon_rhadd_s32',
@@ -959,6 +1060,8 @@ symbols = (
     'gen_helper_neon_sub_u16',
     'gen_helper_neon_sub_u8',
     'gen_helper_neon_tbl',
+    'gen_helper_neon_vld1',
+    'gen_helper_neon_vst1',
     'gen_helper_neon_tst_u16',
     'gen_helper_neon_tst_u32',
     'gen_helper_neon_tst_u8',
@@ -1381,6 +1484,8 @@ symbols = (
     'helper_double_saturate',
     'helper_exception_internal',
     'helper_exception_return',
+    'helper_strex',
+    'arm_store_exclusive',
     'helper_exception_with_syndrome',
     'helper_get_cp_reg',
     'helper_get_cp_reg64',
@@ -1675,6 +1780,87 @@ symbols = (
     'helper_neon_qunzip8',
     'helper_neon_qzip16',
     'helper_neon_qzip32',
+    'helper_neon_add_u8_q',
+    'helper_neon_add_u16_q',
+    'helper_neon_sub_u8_q',
+    'helper_neon_sub_u16_q',
+    'helper_neon_mul_u8_q',
+    'helper_neon_mul_u16_q',
+    'helper_neon_mla_u8_q',
+    'helper_neon_mla_u16_q',
+    'helper_neon_mls_u8_q',
+    'helper_neon_mls_u16_q',
+    'helper_neon_ceq_u8_q',
+    'helper_neon_ceq_u16_q',
+    'helper_neon_ceq_u32_q',
+    'helper_neon_tst_u8_q',
+    'helper_neon_tst_u16_q',
+    'helper_neon_tst_u32_q',
+    'helper_neon_cgt_s8_q',
+    'helper_neon_cgt_u8_q',
+    'helper_neon_cgt_s16_q',
+    'helper_neon_cgt_u16_q',
+    'helper_neon_cgt_s32_q',
+    'helper_neon_cgt_u32_q',
+    'helper_neon_cge_s8_q',
+    'helper_neon_cge_u8_q',
+    'helper_neon_cge_s16_q',
+    'helper_neon_cge_u16_q',
+    'helper_neon_cge_s32_q',
+    'helper_neon_cge_u32_q',
+    'helper_neon_max_s8_q',
+    'helper_neon_max_u8_q',
+    'helper_neon_max_s16_q',
+    'helper_neon_max_u16_q',
+    'helper_neon_max_s32_q',
+    'helper_neon_max_u32_q',
+    'helper_neon_min_s8_q',
+    'helper_neon_min_u8_q',
+    'helper_neon_min_s16_q',
+    'helper_neon_min_u16_q',
+    'helper_neon_min_s32_q',
+    'helper_neon_min_u32_q',
+    'helper_neon_abd_s8_q',
+    'helper_neon_abd_u8_q',
+    'helper_neon_abd_s16_q',
+    'helper_neon_abd_u16_q',
+    'helper_neon_abd_s32_q',
+    'helper_neon_abd_u32_q',
+    'helper_neon_aba_s8_q',
+    'helper_neon_aba_u8_q',
+    'helper_neon_aba_s16_q',
+    'helper_neon_aba_u16_q',
+    'helper_neon_aba_s32_q',
+    'helper_neon_aba_u32_q',
+    'helper_neon_hadd_s8_q',
+    'helper_neon_hadd_u8_q',
+    'helper_neon_hadd_s16_q',
+    'helper_neon_hadd_u16_q',
+    'helper_neon_hadd_s32_q',
+    'helper_neon_hadd_u32_q',
+    'helper_neon_rhadd_s8_q',
+    'helper_neon_rhadd_u8_q',
+    'helper_neon_rhadd_s16_q',
+    'helper_neon_rhadd_u16_q',
+    'helper_neon_rhadd_s32_q',
+    'helper_neon_rhadd_u32_q',
+    'helper_neon_qadd_s8_q',
+    'helper_neon_qadd_u8_q',
+    'helper_neon_qadd_s16_q',
+    'helper_neon_qadd_u16_q',
+    'helper_neon_qadd_s32_q',
+    'helper_neon_qadd_u32_q',
+    'helper_neon_qsub_s8_q',
+    'helper_neon_qsub_u8_q',
+    'helper_neon_qsub_s16_q',
+    'helper_neon_qsub_u16_q',
+    'helper_neon_qsub_s32_q',
+    'helper_neon_qsub_u32_q',
+    'helper_neon_add_f32_q',
+    'helper_neon_sub_f32_q',
+    'helper_neon_mul_f32_q',
+    'helper_neon_mla_f32_q',
+    'helper_neon_mls_f32_q',
     'helper_neon_qzip8',
     'helper_neon_rbit_u8',
     'helper_neon_rhadd_s16',
@@ -1708,6 +1894,8 @@ symbols = (
     'helper_neon_sub_u16',
     'helper_neon_sub_u8',
     'helper_neon_tbl',
+    'helper_neon_vld1',
+    'helper_neon_vst1',
     'helper_neon_tst_u16',
     'helper_neon_tst_u32',
     'helper_neon_tst_u8',
@@ -2934,6 +3122,7 @@ symbols = (
     'tlb_reset_dirty_range_all',
     'tlb_set_dirty',
     'tlb_set_dirty1',
+    'tlb_vaddr_to_host_rmw',
     'tlb_unprotect_code_phys',
     'tlb_vaddr_to_host',
     'token_get_type',
@@ -3065,6 +3254,7 @@ aarch64_symbols = (
     'helper_fcvtx_f64_to_f32',
     'helper_crc32_64',
     'helper_crc32c_64',
+    'helper_stxr',
     'aarch64_cpu_do_interrupt',
 
 )
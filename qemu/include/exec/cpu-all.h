@@ -297,6 +297,10 @@ CPUArchState *cpu_copy(CPUArchState *env);
 #define TLB_NOTDIRTY    (1 << 4)
 /* Set if TLB entry is an IO callback.  */
 #define TLB_MMIO        (1 << 5)
+/* Unicorn: set if memory hooks cover some of the page, or if the page lacks
+   the permission, so that accesses take the slow path calling or checking
+   them. Not an IO access by itself.  */
+#define TLB_HOOKED      (1 << 6)
 
 ram_addr_t last_ram_offset(struct uc_struct *uc);
 void qemu_mutex_lock_ramlist(struct uc_struct *uc);
@@ -62,6 +62,7 @@ static inline void cpu_physical_memory_write(AddressSpace *as, hwaddr addr,
 {
     cpu_physical_memory_rw(as, addr, (void *)buf, len, 1);
 }
+void cpu_physical_memory_written(struct uc_struct *uc, uint64_t addr, size_t length);
 void *cpu_physical_memory_map(AddressSpace *as, hwaddr addr,
                               hwaddr *plen,
                               int is_write);
@@ -74,6 +74,16 @@ typedef uint64_t target_ulong;
 /* use a fully associative victim tlb of 8 entries */
 #define CPU_VTLB_SIZE 8
 
+/* Unicorn: on hosts whose TCG backend looks the TLB up through
+   tlb_mask[] & tlb_table[], each MMU mode has a TLB of its own size,
+   from CPU_TLB_DYN_MIN_BITS to CPU_TLB_DYN_MAX_BITS, see tlb_resize().
+   Other hosts keep CPU_TLB_SIZE entries. */
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define CPU_TLB_DYNAMIC
+#define CPU_TLB_DYN_MIN_BITS 6
+#define CPU_TLB_DYN_MAX_BITS 16
+#endif
+
 #if HOST_LONG_BITS == 32 && TARGET_LONG_BITS == 32
 #define CPU_TLB_ENTRY_BITS 4
 #else
@@ -121,15 +131,37 @@ typedef struct CPUTLBEntry {
 
 QEMU_BUILD_BUG_ON(sizeof(CPUTLBEntry) != (1 << CPU_TLB_ENTRY_BITS));
 
+#ifdef CPU_TLB_DYNAMIC
+/* tlb_mask[mmu_idx] is (number of entries - 1) << CPU_TLB_ENTRY_BITS.
+   Reset clears these, tlb_flush() sets them again from cpu->tlb_desc. */
+#define CPU_COMMON_TLB_TABLES                                           \
+    CPUTLBEntry *tlb_table[NB_MMU_MODES];                               \
+    uintptr_t tlb_mask[NB_MMU_MODES];                                   \
+    hwaddr *iotlb[NB_MMU_MODES];
+#else
+#define CPU_COMMON_TLB_TABLES                                           \
+    CPUTLBEntry tlb_table[NB_MMU_MODES][CPU_TLB_SIZE];                  \
+    hwaddr iotlb[NB_MMU_MODES][CPU_TLB_SIZE];
+#endif
+
 #define CPU_COMMON_TLB \
     /* The meaning of the MMU modes is defined in the target code. */   \
-    CPUTLBEntry tlb_table[NB_MMU_MODES][CPU_TLB_SIZE];                  \
+    CPU_COMMON_TLB_TABLES                                               \
     CPUTLBEntry tlb_v_table[NB_MMU_MODES][CPU_VTLB_SIZE];               \
-    hwaddr iotlb[NB_MMU_MODES][CPU_TLB_SIZE];                           \
     hwaddr iotlb_v[NB_MMU_MODES][CPU_VTLB_SIZE];                        \
+    /* Unicorn: lookups of translated code found in the TLB, counted    \
+       with UC_OPT_TLB_COUNT_HITS only */                               \
+    uintptr_t tlb_hits;                                                 \
     target_ulong tlb_flush_addr;                                        \
     target_ulong tlb_flush_mask;                                        \
     target_ulong vtlb_index;                                            \
+    /* Unicorn: RAM window translated code accesses without the TLB,    \
+       see tlb_fastmem_update(). fastmem_end[n] bounds the offset of    \
+       accesses of 1 << n bytes, all 0 if there is no window */         \
+    target_ulong fastmem_begin;                                         \
+    uint64_t fastmem_end[4];                                            \
+    uintptr_t fastmem_host;                                             \
+    uintptr_t fastmem_code;                                             \
 
 #else
 
@@ -163,6 +163,23 @@
 /* The memory helpers for tcg-generated code need tcg_target_long etc.  */
 #include "tcg.h"
 
+/* number of entries of the TLB of @mmu_idx */
+static inline uintptr_t tlb_entries(CPUArchState *env, int mmu_idx)
+{
+#ifdef CPU_TLB_DYNAMIC
+    return (env->tlb_mask[mmu_idx] >> CPU_TLB_ENTRY_BITS) + 1;
+#else
+    return CPU_TLB_SIZE;
+#endif
+}
+
+/* index of the TLB entry of @addr in the TLB of @mmu_idx */
+static inline uintptr_t tlb_index(CPUArchState *env, int mmu_idx,
+                                  target_ulong addr)
+{
+    return (addr >> TARGET_PAGE_BITS) & (tlb_entries(env, mmu_idx) - 1);
+}
+
 uint8_t helper_ldb_mmu(CPUArchState *env, target_ulong addr, int mmu_idx);
 uint16_t helper_ldw_mmu(CPUArchState *env, target_ulong addr, int mmu_idx);
 uint32_t helper_ldl_mmu(CPUArchState *env, target_ulong addr, int mmu_idx);
@@ -361,7 +378,7 @@ uint64_t helper_ldq_cmmu(CPUArchState *env, target_ulong addr, int mmu_idx);
 static inline void *tlb_vaddr_to_host(CPUArchState *env, target_ulong addr,
                                       int access_type, int mmu_idx)
 {
-    int index = (addr >> TARGET_PAGE_BITS) & (CPU_TLB_SIZE - 1);
+    int index = tlb_index(env, mmu_idx, addr);
     CPUTLBEntry *tlbentry = &env->tlb_table[mmu_idx][index];
     target_ulong tlb_addr;
     uintptr_t haddr;
@@ -395,6 +412,9 @@ static inline void *tlb_vaddr_to_host(CPUArchState *env, target_ulong addr,
     return (void *)haddr;
 }
 
+void *tlb_vaddr_to_host_rmw(CPUArchState *env, target_ulong addr, int size,
+                            int mmu_idx, uintptr_t retaddr);
+
 #endif /* defined(CONFIG_USER_ONLY) */
 
 #endif /* CPU_LDST_H */
@@ -28,6 +28,7 @@ void tlb_reset_dirty_range(CPUTLBEntry *tlb_entry,
     uintptr_t start, uintptr_t length);
 void cpu_tlb_reset_dirty_all(struct uc_struct *uc, ram_addr_t start1, ram_addr_t length);
 void tlb_set_dirty(CPUArchState *env, target_ulong vaddr);
+void tlb_fastmem_set_code(struct uc_struct *uc, ram_addr_t ram_addr, bool code);
 //extern int tlb_flush_count;
 
 /* exec.c */
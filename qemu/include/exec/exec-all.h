@@ -94,11 +94,15 @@ void tb_invalidate_phys_range(struct uc_struct *uc, tb_page_addr_t start, tb_pag
 #if !defined(CONFIG_USER_ONLY)
 void tcg_cpu_address_space_init(CPUState *cpu, AddressSpace *as);
 /* cputlb.c */
+void tlb_init(CPUState *cpu);
+void tlb_destroy(CPUState *cpu);
 void tlb_flush_page(CPUState *cpu, target_ulong addr);
 void tlb_flush(CPUState *cpu, int flush_global);
+void tlb_flush_memory(struct uc_struct *uc, void *host, size_t length);
 void tlb_set_page(CPUState *cpu, target_ulong vaddr,
                   hwaddr paddr, int prot,
                   int mmu_idx, target_ulong size);
+void tlb_fastmem_update(CPUState *cpu, bool direct);
 
 void tb_invalidate_phys_addr(AddressSpace *as, hwaddr addr);
 
@@ -167,8 +171,30 @@ struct TranslationBlock {
     struct TranslationBlock *jmp_next[2];
     struct TranslationBlock *jmp_first;
     uint32_t icount;
+    /* Unicorn: set once invalidated, so that evicting the region of the
+       translation buffer holding this TB skips it */
+    bool invalid;
+    /* Unicorn: bytes of host code, and number of runs counted by the code
+       since the last tb_profile_keep(), see UC_OPT_PROFILE */
+    uint32_t tc_size;
+    uint64_t exec_count;
+    /* Unicorn: number of TBs translated before this one, to tell which
+       translation of a block is the last one in the profile */
+    uint64_t seq;
 };
 
+/* Unicorn: the translation buffer is split into regions filled in turn,
+   each with its own slice of TBContext.tbs. When the current region is
+   full, the oldest one is evicted & reused instead of flushing it all */
+#define TB_MAX_REGIONS 8
+
+typedef struct TBRegion {
+    void *start;            /* code of this region */
+    void *end;              /* end of its code, once the next region is filled */
+    TranslationBlock *tbs;  /* TBs of this region, in code order */
+    int nb_tbs;
+} TBRegion;
+
 typedef struct TBContext TBContext;
 
 struct TBContext {
@@ -177,11 +203,24 @@ struct TBContext {
     TranslationBlock *tb_phys_hash[CODE_GEN_PHYS_HASH_SIZE];
     int nb_tbs;
 
+    TBRegion regions[TB_MAX_REGIONS];
+    int nb_regions;
+    int region;             /* region being filled */
+    size_t region_size;
+    size_t region_max_size; /* code size above which a region is full */
+    int region_max_tbs;
+
     /* statistics */
     int tb_flush_count;
     int tb_phys_invalidate_count;
 
     int tb_invalidated_flag;
+
+    /* Unicorn: TB allocated by tb_gen_code() but not linked yet, if a fault
+       during translation longjmps out of cpu_exec() it must be discarded */
+    TranslationBlock *tb_partial;
+    /* Unicorn: single use TB run by cpu_exec_nocache() */
+    TranslationBlock *tb_nocache;
 };
 
 static inline unsigned int tb_jmp_cache_hash_page(target_ulong pc)
@@ -206,6 +245,11 @@ static inline unsigned int tb_phys_hash_func(tb_page_addr_t pc)
 
 void tb_free(struct uc_struct *uc, TranslationBlock *tb);
 void tb_flush(CPUArchState *env);
+void tb_discard_partial(struct uc_struct *uc);
+void tb_profile_harvest(struct uc_struct *uc);
+void tb_flush_all(struct uc_struct *uc);
+void tb_invalidate_uc_range(struct uc_struct *uc, uint64_t start, size_t len);
+void tb_invalidate_addr_end(struct uc_struct *uc, uint64_t addr);
 void tb_phys_invalidate(struct uc_struct *uc,
     TranslationBlock *tb, tb_page_addr_t page_addr);
 
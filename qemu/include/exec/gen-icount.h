@@ -5,52 +5,116 @@
 
 /* Helpers for instruction counting code generation.  */
 
-//static TCGArg *icount_arg;
-//static int icount_label;
+// Unicorn: take this TB off the instruction budget of uc_emu_start()
+static inline void gen_tb_start_icount(TCGContext *tcg_ctx)
+{
+    TCGv_i32 count;
+
+    tcg_ctx->icount_label = gen_new_label(tcg_ctx);
+    count = tcg_temp_local_new_i32(tcg_ctx);
+    tcg_gen_ld_i32(tcg_ctx, count, tcg_ctx->cpu_env,
+                   offsetof(CPUState, icount_decr.u32) - ENV_OFFSET);
+    /* This is a horrid hack to allow fixing up the value later.  */
+    tcg_ctx->icount_arg = tcg_ctx->gen_opparam_ptr + 1;
+    tcg_gen_subi_i32(tcg_ctx, count, count, 0xdeadbeef);
+
+    tcg_gen_brcondi_i32(tcg_ctx, TCG_COND_LT, count, 0, tcg_ctx->icount_label);
+    tcg_gen_st_i32(tcg_ctx, count, tcg_ctx->cpu_env,
+                   offsetof(CPUState, icount_decr.u32) - ENV_OFFSET);
+    tcg_temp_free_i32(tcg_ctx, count);
+}
+
+// Unicorn: the whole TB is taken off the budget on entry. A hook that stops
+// it partway, or moves the PC, leaves through exitreq_label, which gives back
+// the instructions from @num_insns on, so note it before each instruction
+static inline void gen_insn_start_icount(TCGContext *tcg_ctx, int num_insns)
+{
+    TCGv_i32 insn;
+
+    // the first instruction is noted by gen_tb_start()
+    if (!tcg_ctx->icount_insn || num_insns == 0)
+        return;
+
+    insn = tcg_const_i32(tcg_ctx, num_insns);
+    tcg_gen_st_i32(tcg_ctx, insn, tcg_ctx->cpu_env,
+                   offsetof(CPUState, icount_insn) - ENV_OFFSET);
+    tcg_temp_free_i32(tcg_ctx, insn);
+}
+
+// Unicorn: count the runs of @tb, see UC_OPT_PROFILE
+static inline void gen_tb_start_profile(TCGContext *tcg_ctx, TranslationBlock *tb)
+{
+    TCGv_ptr ptr = tcg_const_ptr(tcg_ctx, &tb->exec_count);
+    TCGv_i64 count = tcg_temp_new_i64(tcg_ctx);
+
+    tcg_gen_ld_i64(tcg_ctx, count, ptr, 0);
+    tcg_gen_addi_i64(tcg_ctx, count, count, 1);
+    tcg_gen_st_i64(tcg_ctx, count, ptr, 0);
+    tcg_temp_free_i64(tcg_ctx, count);
+    tcg_temp_free_ptr(tcg_ctx, ptr);
+}
 
-static inline void gen_tb_start(TCGContext *tcg_ctx)
+// Unicorn: hooks that can leave a TB partway, see gen_insn_start_icount().
+// Adding or removing them flushes translated code, see UC_HOOK_TB_DEPENDENT
+static inline bool tb_hooks_exit(struct uc_struct *uc)
+{
+    return HOOK_EXISTS(uc, UC_HOOK_CODE) || HOOK_EXISTS(uc, UC_HOOK_BLOCK) ||
+        HOOK_EXISTS(uc, UC_HOOK_MEM_READ) || HOOK_EXISTS(uc, UC_HOOK_MEM_READ_AFTER) ||
+        HOOK_EXISTS(uc, UC_HOOK_MEM_WRITE);
+}
+
+static inline void gen_tb_start(TCGContext *tcg_ctx, TranslationBlock *tb)
 {
-    // TCGv_i32 count;
     TCGv_i32 flag;
 
-    tcg_ctx->exitreq_label = gen_new_label(tcg_ctx);
+    tcg_ctx->exitreq_start_label = gen_new_label(tcg_ctx);
     flag = tcg_temp_new_i32(tcg_ctx);
     tcg_gen_ld_i32(tcg_ctx, flag, tcg_ctx->cpu_env,
                    offsetof(CPUState, tcg_exit_req) - ENV_OFFSET);
-    tcg_gen_brcondi_i32(tcg_ctx, TCG_COND_NE, flag, 0, tcg_ctx->exitreq_label);
+    tcg_gen_brcondi_i32(tcg_ctx, TCG_COND_NE, flag, 0, tcg_ctx->exitreq_start_label);
     tcg_temp_free_i32(tcg_ctx, flag);
 
-#if 0
-    if (!use_icount)
-        return;
+    gen_tb_start_icount(tcg_ctx);
 
-    icount_label = gen_new_label();
-    count = tcg_temp_local_new_i32();
-    tcg_gen_ld_i32(count, cpu_env,
-                   -ENV_OFFSET + offsetof(CPUState, icount_decr.u32));
-    /* This is a horrid hack to allow fixing up the value later.  */
-    icount_arg = tcg_ctx.gen_opparam_ptr + 1;
-    tcg_gen_subi_i32(count, count, 0xdeadbeef);
+    // exits from here on give back the instructions that did not run
+    tcg_ctx->exitreq_label = gen_new_label(tcg_ctx);
+    tcg_ctx->icount_insn = tb_hooks_exit(tcg_ctx->uc);
+    if (tcg_ctx->icount_insn) {
+        flag = tcg_const_i32(tcg_ctx, 0);
+        tcg_gen_st_i32(tcg_ctx, flag, tcg_ctx->cpu_env,
+                       offsetof(CPUState, icount_insn) - ENV_OFFSET);
+        tcg_temp_free_i32(tcg_ctx, flag);
+    }
 
-    tcg_gen_brcondi_i32(TCG_COND_LT, count, 0, icount_label);
-    tcg_gen_st16_i32(count, cpu_env,
-                     -ENV_OFFSET + offsetof(CPUState, icount_decr.u16.low));
-    tcg_temp_free_i32(count);
-#endif
+    if (tcg_ctx->uc->profile)
+        gen_tb_start_profile(tcg_ctx, tb);
 }
 
 static inline void gen_tb_end(TCGContext *tcg_ctx, TranslationBlock *tb, int num_insns)
 {
+    TCGv_i32 count, insn;
+
     gen_set_label(tcg_ctx, tcg_ctx->exitreq_label);
+    if (tcg_ctx->icount_insn) {
+        count = tcg_temp_new_i32(tcg_ctx);
+        insn = tcg_temp_new_i32(tcg_ctx);
+        tcg_gen_ld_i32(tcg_ctx, count, tcg_ctx->cpu_env,
+                       offsetof(CPUState, icount_decr.u32) - ENV_OFFSET);
+        tcg_gen_ld_i32(tcg_ctx, insn, tcg_ctx->cpu_env,
+                       offsetof(CPUState, icount_insn) - ENV_OFFSET);
+        tcg_gen_addi_i32(tcg_ctx, count, count, num_insns);
+        tcg_gen_sub_i32(tcg_ctx, count, count, insn);
+        tcg_gen_st_i32(tcg_ctx, count, tcg_ctx->cpu_env,
+                       offsetof(CPUState, icount_decr.u32) - ENV_OFFSET);
+        tcg_temp_free_i32(tcg_ctx, insn);
+        tcg_temp_free_i32(tcg_ctx, count);
+    }
+    gen_set_label(tcg_ctx, tcg_ctx->exitreq_start_label);
     tcg_gen_exit_tb(tcg_ctx, (uintptr_t)tb + TB_EXIT_REQUESTED);
 
-#if 0
-    if (use_icount) {
-        *icount_arg = num_insns;
-        gen_set_label(icount_label);
-        tcg_gen_exit_tb((uintptr_t)tb + TB_EXIT_ICOUNT_EXPIRED);
-    }
-#endif
+    *tcg_ctx->icount_arg = num_insns;
+    gen_set_label(tcg_ctx, tcg_ctx->icount_label);
+    tcg_gen_exit_tb(tcg_ctx, (uintptr_t)tb + TB_EXIT_ICOUNT_EXPIRED);
 }
 
 #if 0
@@ -24,6 +24,7 @@ typedef struct AddressSpaceDispatch AddressSpaceDispatch;
 
 void address_space_init_dispatch(AddressSpace *as);
 void address_space_destroy_dispatch(AddressSpace *as);
+void address_space_dispatch_update(AddressSpace *as, MemoryRegionSection *section, bool add);
 
 extern const MemoryRegionOps unassigned_mem_ops;
 
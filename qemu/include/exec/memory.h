@@ -17,7 +17,9 @@
 #ifndef CONFIG_USER_ONLY
 
 #define DIRTY_MEMORY_CODE      0
-#define DIRTY_MEMORY_NUM       1        /* num of dirty bits */
+#define DIRTY_MEMORY_USER      1        /* Unicorn: see uc_mem_dirty_start() */
+#define DIRTY_MEMORY_SNAPSHOT  2        /* Unicorn: see uc_snapshot_restore() */
+#define DIRTY_MEMORY_NUM       3        /* num of dirty bits */
 
 #include "unicorn/platform.h"
 #include "qemu-common.h"
@@ -151,13 +153,18 @@ struct MemoryRegion {
     hwaddr alias_offset;
     int32_t priority;
     bool may_overlap;
+    bool subregions_overlap;    // Unicorn: subregions may hide others, see memory_region_update_in_place()
     QTAILQ_HEAD(subregions, MemoryRegion) subregions;
     QTAILQ_ENTRY(MemoryRegion) subregions_link;
     const char *name;
     uint8_t dirty_log_mask;
     struct uc_struct *uc;
-    uint32_t perms;   //all perms, partially redundant with readonly
+    uint32_t perms;   //all perms, partially redundant with readonly. With @page_perms, those all pages have
+    uint8_t *page_perms;    // Unicorn: perms of each target page, NULL if they all have @perms
+    uint64_t perms_pages[8];    // Unicorn: number of pages with each perms, if @page_perms
     uint64_t end;
+    uint8_t *host;    // Unicorn: host address of a RAM region mapped by the API, or NULL
+    bool host_user;   // Unicorn: @host was given to uc_mem_map_ptr()
 };
 
 /**
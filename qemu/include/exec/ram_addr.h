@@ -31,35 +31,67 @@ void *qemu_get_ram_block_host_ptr(struct uc_struct *uc, ram_addr_t addr);
 void *qemu_get_ram_ptr(struct uc_struct *uc, ram_addr_t addr);
 void qemu_ram_free(struct uc_struct *c, ram_addr_t addr);
 void qemu_ram_free_from_ptr(struct uc_struct *uc, ram_addr_t addr);
+RAMBlock *qemu_get_ram_block(struct uc_struct *uc, ram_addr_t addr);
+
+/* Unicorn: the dirty bitmap of @client in the RAM block of page @*page,
+   with @*page made relative to the block and @*end clipped to it */
+static inline unsigned long *cpu_physical_memory_dirty_bitmap(struct uc_struct *uc,
+                                                              unsigned long *page,
+                                                              unsigned long *end,
+                                                              unsigned client)
+{
+    RAMBlock *block = qemu_get_ram_block(uc, (ram_addr_t)*page << TARGET_PAGE_BITS);
+    unsigned long base = block->offset >> TARGET_PAGE_BITS;
+
+    *page -= base;
+    *end = MIN(*end - base, block->length >> TARGET_PAGE_BITS);
+    return block->dirty_memory[client];
+}
 
 static inline bool cpu_physical_memory_get_dirty(struct uc_struct *uc, ram_addr_t start,
                                                  ram_addr_t length,
                                                  unsigned client)
 {
-    unsigned long end, page, next;
+    unsigned long end, page, first, last, *bitmap;
 
     assert(client < DIRTY_MEMORY_NUM);
 
     end = TARGET_PAGE_ALIGN(start + length) >> TARGET_PAGE_BITS;
     page = start >> TARGET_PAGE_BITS;
-    next = find_next_bit(uc->ram_list.dirty_memory[client], end, page);
+    while (page < end) {
+        first = page;
+        last = end;
+        bitmap = cpu_physical_memory_dirty_bitmap(uc, &first, &last, client);
+        if (find_next_bit(bitmap, last, first) < last) {
+            return true;
+        }
+        page += last - first;
+    }
 
-    return next < end;
+    return false;
 }
 
 static inline bool cpu_physical_memory_get_clean(struct uc_struct *uc, ram_addr_t start,
                                                  ram_addr_t length,
                                                  unsigned client)
 {
-    unsigned long end, page, next;
+    unsigned long end, page, first, last, *bitmap;
 
     assert(client < DIRTY_MEMORY_NUM);
 
     end = TARGET_PAGE_ALIGN(start + length) >> TARGET_PAGE_BITS;
     page = start >> TARGET_PAGE_BITS;
-    next = find_next_zero_bit(uc->ram_list.dirty_memory[client], end, page);
+    while (page < end) {
+        first = page;
+        last = end;
+        bitmap = cpu_physical_memory_dirty_bitmap(uc, &first, &last, client);
+        if (find_next_zero_bit(bitmap, last, first) < last) {
+            return true;
+        }
+        page += last - first;
+    }
 
-    return next < end;
+    return false;
 }
 
 static inline bool cpu_physical_memory_get_dirty_flag(struct uc_struct *uc, ram_addr_t addr,
@@ -68,9 +100,23 @@ static inline bool cpu_physical_memory_get_dirty_flag(struct uc_struct *uc, ram_
     return cpu_physical_memory_get_dirty(uc, addr, 1, client);
 }
 
+/* Unicorn: a page is also clean until written for the clients tracking
+   writes, see uc->dirty_clients */
 static inline bool cpu_physical_memory_is_clean(struct uc_struct *uc, ram_addr_t addr)
 {
-    return !cpu_physical_memory_get_dirty_flag(uc, addr, DIRTY_MEMORY_CODE);
+    unsigned client;
+
+    if (!cpu_physical_memory_get_dirty_flag(uc, addr, DIRTY_MEMORY_CODE)) {
+        return true;
+    }
+    for (client = DIRTY_MEMORY_CODE + 1; client < DIRTY_MEMORY_NUM; client++) {
+        if ((uc->dirty_clients & (1 << client)) &&
+            !cpu_physical_memory_get_dirty_flag(uc, addr, client)) {
+            return true;
+        }
+    }
+
+    return false;
 }
 
 static inline bool cpu_physical_memory_range_includes_clean(struct uc_struct *uc, ram_addr_t start,
@@ -82,18 +128,55 @@ static inline bool cpu_physical_memory_range_includes_clean(struct uc_struct *uc
 static inline void cpu_physical_memory_set_dirty_flag(struct uc_struct *uc, ram_addr_t addr,
                                                       unsigned client)
 {
+    unsigned long page = addr >> TARGET_PAGE_BITS, end = page + 1, *bitmap;
+
     assert(client < DIRTY_MEMORY_NUM);
-    set_bit(addr >> TARGET_PAGE_BITS, uc->ram_list.dirty_memory[client]);
+    bitmap = cpu_physical_memory_dirty_bitmap(uc, &page, &end, client);
+    set_bit(page, bitmap);
 }
 
-static inline void cpu_physical_memory_set_dirty_range(struct uc_struct *uc, ram_addr_t start,
-                                                       ram_addr_t length)
+static inline void cpu_physical_memory_set_dirty_client_range(struct uc_struct *uc,
+                                                              ram_addr_t start,
+                                                              ram_addr_t length,
+                                                              unsigned client)
 {
-    unsigned long end, page;
+    unsigned long end, page, first, last, *bitmap;
 
+    assert(client < DIRTY_MEMORY_NUM);
     end = TARGET_PAGE_ALIGN(start + length) >> TARGET_PAGE_BITS;
     page = start >> TARGET_PAGE_BITS;
-    bitmap_set(uc->ram_list.dirty_memory[DIRTY_MEMORY_CODE], page, end - page);
+    while (page < end) {
+        first = page;
+        last = end;
+        bitmap = cpu_physical_memory_dirty_bitmap(uc, &first, &last, client);
+        bitmap_set(bitmap, first, last - first);
+        page += last - first;
+    }
+}
+
+/* Unicorn: RAM [start, start + length[ was written, as seen by the clients
+   tracking writes */
+static inline void cpu_physical_memory_set_dirty_tracked(struct uc_struct *uc,
+                                                         ram_addr_t start,
+                                                         ram_addr_t length)
+{
+    unsigned client;
+
+    for (client = DIRTY_MEMORY_CODE + 1; client < DIRTY_MEMORY_NUM; client++) {
+        if (uc->dirty_clients & (1 << client)) {
+            cpu_physical_memory_set_dirty_client_range(uc, start, length, client);
+        }
+    }
+}
+
+static inline void cpu_physical_memory_set_dirty_range(struct uc_struct *uc, ram_addr_t start,
+                                                       ram_addr_t length)
+{
+    unsigned client;
+
+    for (client = 0; client < DIRTY_MEMORY_NUM; client++) {
+        cpu_physical_memory_set_dirty_client_range(uc, start, length, client);
+    }
 }
 
 #if !defined(_WIN32)
@@ -107,38 +190,25 @@ static inline void cpu_physical_memory_set_dirty_lebitmap(struct uc_struct *uc,
     ram_addr_t ram_addr;
     unsigned long len = (pages + HOST_LONG_BITS - 1) / HOST_LONG_BITS;
     unsigned long hpratio = getpagesize() / TARGET_PAGE_SIZE;
-    unsigned long page = BIT_WORD(start >> TARGET_PAGE_BITS);
-
-    /* start address is aligned at the start of a word? */
-    if ((((page * BITS_PER_LONG) << TARGET_PAGE_BITS) == start) &&
-        (hpratio == 1)) {
-        long k;
-        long nr = BITS_TO_LONGS(pages);
-
-        for (k = 0; k < nr; k++) {
-            if (bitmap[k]) {
-                unsigned long temp = leul_to_cpu(bitmap[k]);
-                uc->ram_list.dirty_memory[DIRTY_MEMORY_CODE][page + k] |= temp;
-            }
-        }
-    } else {
-        /*
-         * bitmap-traveling is faster than memory-traveling (for addr...)
-         * especially when most of the memory is not dirty.
-         */
-        for (i = 0; i < len; i++) {
-            if (bitmap[i] != 0) {
-                c = leul_to_cpu(bitmap[i]);
-                do {
-                    j = ctzl(c);
-                    c &= ~(1ul << j);
-                    page_number = (i * HOST_LONG_BITS + j) * hpratio;
-                    addr = page_number * TARGET_PAGE_SIZE;
-                    ram_addr = start + addr;
-                    cpu_physical_memory_set_dirty_range(uc, ram_addr,
-                                       TARGET_PAGE_SIZE * hpratio);
-                } while (c != 0);
-            }
+
+    /*
+     * bitmap-traveling is faster than memory-traveling (for addr...)
+     * especially when most of the memory is not dirty.
+     * Unicorn: the dirty bitmaps are per RAM block, so @bitmap is never
+     * or-ed straight into them.
+     */
+    for (i = 0; i < len; i++) {
+        if (bitmap[i] != 0) {
+            c = leul_to_cpu(bitmap[i]);
+            do {
+                j = ctzl(c);
+                c &= ~(1ul << j);
+                page_number = (i * HOST_LONG_BITS + j) * hpratio;
+                addr = page_number * TARGET_PAGE_SIZE;
+                ram_addr = start + addr;
+                cpu_physical_memory_set_dirty_range(uc, ram_addr,
+                                   TARGET_PAGE_SIZE * hpratio);
+            } while (c != 0);
         }
     }
 }
@@ -148,16 +218,23 @@ static inline void cpu_physical_memory_clear_dirty_range(struct uc_struct *uc, r
                                                          ram_addr_t length,
                                                          unsigned client)
 {
-    unsigned long end, page;
+    unsigned long end, page, first, last, *bitmap;
 
     assert(client < DIRTY_MEMORY_NUM);
     end = TARGET_PAGE_ALIGN(start + length) >> TARGET_PAGE_BITS;
     page = start >> TARGET_PAGE_BITS;
-    bitmap_clear(uc->ram_list.dirty_memory[client], page, end - page);
+    while (page < end) {
+        first = page;
+        last = end;
+        bitmap = cpu_physical_memory_dirty_bitmap(uc, &first, &last, client);
+        bitmap_clear(bitmap, first, last - first);
+        page += last - first;
+    }
 }
 
 void cpu_physical_memory_reset_dirty(struct uc_struct *uc,
     ram_addr_t start, ram_addr_t length, unsigned client);
+void cpu_notdirty_write(struct uc_struct *uc, ram_addr_t ram_addr, unsigned size);
 
 #endif
 #endif
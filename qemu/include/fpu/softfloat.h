@@ -427,6 +427,11 @@ static inline int float32_is_zero_or_denormal(float32 a)
     return (float32_val(a) & 0x7f800000) == 0;
 }
 
+static inline int float32_is_normal(float32 a)
+{
+    return ((float32_val(a) >> 23) & 0xff) - 1 < 0xfe;
+}
+
 static inline float32 float32_set_sign(float32 a, int sign)
 {
     return make_float32((float32_val(a) & 0x7fffffff) | (sign << 31));
@@ -539,6 +544,11 @@ static inline int float64_is_zero_or_denormal(float64 a)
     return (float64_val(a) & 0x7ff0000000000000LL) == 0;
 }
 
+static inline int float64_is_normal(float64 a)
+{
+    return ((float64_val(a) >> 52) & 0x7ff) - 1 < 0x7fe;
+}
+
 static inline float64 float64_set_sign(float64 a, int sign)
 {
     return make_float64((float64_val(a) & 0x7fffffffffffffffULL)
@@ -166,6 +166,7 @@ void *qemu_oom_check(void *ptr);
 /* Error handling.  */
 
 void tcg_exec_init(struct uc_struct *uc, unsigned long tb_size);
+void tcg_exec_resize(struct uc_struct *uc, unsigned long tb_size);
 bool tcg_enabled(struct uc_struct *uc);
 
 struct uc_struct;
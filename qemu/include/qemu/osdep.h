@@ -107,6 +107,11 @@ void *qemu_memalign(size_t alignment, size_t size);
 void *qemu_anon_ram_alloc(size_t size, uint64_t *align);
 void qemu_vfree(void *ptr);
 void qemu_anon_ram_free(void *ptr, size_t size);
+void *qemu_ram_move(void *from, void *to, size_t size);
+int qemu_ram_cow_file(uint64_t size);
+void qemu_ram_cow_close(int fd);
+bool qemu_ram_cow_map(int fd, uint64_t offset, void *host, size_t size);
+bool qemu_ram_cow_freeze(int fd, uint64_t offset, void *host, size_t size);
 
 #if defined(__HAIKU__) && defined(__i386__)
 #define FMT_pid "%ld"
@@ -191,6 +191,8 @@ struct kvm_run;
  * @icount_decr: Number of cycles left, with interrupt flag in high bit.
  * This allows a single read-compare-cbranch-write sequence to test
  * for both decrementer underflow and exceptions.
+ * @icount_insn: Instructions of the current TB before the one running,
+ * for hooks leaving it partway, see gen_insn_start_icount().
  * @can_do_io: Nonzero if memory-mapped IO is safe.
  * @env_ptr: Pointer to subclass-specific CPUArchState field.
  * @current_tb: Currently executing TB.
@@ -198,6 +200,7 @@ struct kvm_run;
  * @opaque: User data.
  * @mem_io_pc: Host Program Counter at which the memory was accessed.
  * @mem_io_vaddr: Target virtual address at which the memory was accessed.
+ * @tlb_desc: Size & tables of the TLB of each MMU mode, see cputlb.c.
  * @kvm_fd: vCPU file descriptor for KVM.
  *
  * State of one CPU core or thread.
@@ -251,6 +254,8 @@ struct CPUState {
     uintptr_t mem_io_pc;
     vaddr mem_io_vaddr;
 
+    struct CPUTLBDesc *tlb_desc;
+
     int kvm_fd;
     bool kvm_vcpu_dirty;
     struct KVMState *kvm_state;
@@ -263,6 +268,7 @@ struct CPUState {
         uint32_t u32;
         icount_decr_u16 u16;
     } icount_decr;
+    int32_t icount_insn;
     uint32_t can_do_io;
     int32_t exception_index; /* used by m68k TCG */
 
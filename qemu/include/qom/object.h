@@ -412,8 +412,11 @@ struct Object
     ObjectClass *class_;
     ObjectFree *free;
     QTAILQ_HEAD(, ObjectProperty) properties;
+    GHashTable *property_names;     // Unicorn: @properties by name, NULL until the first one
+    unsigned int property_index;    // Unicorn: next index tried for "name[*]" properties
     uint32_t ref;
     Object *parent;
+    ObjectProperty *parent_property;    // Unicorn: the child<> property of @parent holding this object
 };
 
 /**
@@ -73,7 +73,7 @@ void cpu_outb(struct uc_struct *uc, pio_addr_t addr, uint8_t val)
         if (hook->to_delete)
             continue;
         if (hook->insn == UC_X86_INS_OUT)
-            ((uc_cb_insn_out_t)hook->callback)(uc, addr, 1, val, hook->user_data);
+            HOOK_CALLBACK(uc, hook, UC_HOOK_INSN, uc_cb_insn_out_t)(uc, addr, 1, val, hook->user_data);
     }
 }
 
@@ -87,7 +87,7 @@ void cpu_outw(struct uc_struct *uc, pio_addr_t addr, uint16_t val)
         if (hook->to_delete)
             continue;
         if (hook->insn == UC_X86_INS_OUT)
-            ((uc_cb_insn_out_t)hook->callback)(uc, addr, 2, val, hook->user_data);
+            HOOK_CALLBACK(uc, hook, UC_HOOK_INSN, uc_cb_insn_out_t)(uc, addr, 2, val, hook->user_data);
     }
 }
 
@@ -101,7 +101,7 @@ void cpu_outl(struct uc_struct *uc, pio_addr_t addr, uint32_t val)
         if (hook->to_delete)
             continue;
         if (hook->insn == UC_X86_INS_OUT)
-            ((uc_cb_insn_out_t)hook->callback)(uc, addr, 4, val, hook->user_data);
+            HOOK_CALLBACK(uc, hook, UC_HOOK_INSN, uc_cb_insn_out_t)(uc, addr, 4, val, hook->user_data);
     }
 }
 
@@ -115,7 +115,7 @@ uint8_t cpu_inb(struct uc_struct *uc, pio_addr_t addr)
         if (hook->to_delete)
             continue;
         if (hook->insn == UC_X86_INS_IN)
-            return ((uc_cb_insn_in_t)hook->callback)(uc, addr, 1, hook->user_data);
+            return HOOK_CALLBACK(uc, hook, UC_HOOK_INSN, uc_cb_insn_in_t)(uc, addr, 1, hook->user_data);
     }
 
     return 0;
@@ -131,7 +131,7 @@ uint16_t cpu_inw(struct uc_struct *uc, pio_addr_t addr)
         if (hook->to_delete)
             continue;
         if (hook->insn == UC_X86_INS_IN)
-            return ((uc_cb_insn_in_t)hook->callback)(uc, addr, 2, hook->user_data);
+            return HOOK_CALLBACK(uc, hook, UC_HOOK_INSN, uc_cb_insn_in_t)(uc, addr, 2, hook->user_data);
     }
 
     return 0;
@@ -147,7 +147,7 @@ uint32_t cpu_inl(struct uc_struct *uc, pio_addr_t addr)
         if (hook->to_delete)
             continue;
         if (hook->insn == UC_X86_INS_IN)
-            return ((uc_cb_insn_in_t)hook->callback)(uc, addr, 4, hook->user_data);
+            return HOOK_CALLBACK(uc, hook, UC_HOOK_INSN, uc_cb_insn_in_t)(uc, addr, 4, hook->user_data);
     }
 
     return 0;
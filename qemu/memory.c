@@ -39,12 +39,12 @@ MemoryRegion *memory_map(struct uc_struct *uc, hwaddr begin, size_t size, uint32
     if (ram->ram_addr == -1)
         // out of memory
         return NULL;
+    ram->host = memory_region_get_ram_ptr(ram);
+    ram->host_user = false;
+    ram->page_perms = NULL;
 
     memory_region_add_subregion(get_system_memory(uc), begin, ram);
 
-    if (uc->current_cpu)
-        tlb_flush(uc->current_cpu, 1);
-
     return ram;
 }
 
@@ -57,12 +57,12 @@ MemoryRegion *memory_map_ptr(struct uc_struct *uc, hwaddr begin, size_t size, ui
     if (ram->ram_addr == -1)
         // out of memory
         return NULL;
+    ram->host = memory_region_get_ram_ptr(ram);
+    ram->host_user = true;
+    ram->page_perms = NULL;
 
     memory_region_add_subregion(get_system_memory(uc), begin, ram);
 
-    if (uc->current_cpu)
-        tlb_flush(uc->current_cpu, 1);
-
     return ram;
 }
 
@@ -71,16 +71,11 @@ static void memory_region_update_container_subregions(MemoryRegion *subregion);
 void memory_unmap(struct uc_struct *uc, MemoryRegion *mr)
 {
     int i;
-    target_ulong addr;
     Object *obj;
 
-    // Make sure all pages associated with the MemoryRegion are flushed
-    // Only need to do this if we are in a running state
-    if (uc->current_cpu) {
-        for (addr = mr->addr; addr < mr->end; addr += uc->target_page_size) {
-           tlb_flush_page(uc->current_cpu, addr);
-        }
-    }
+    // Removing the region drops the TLB entries of its pages.
+    // Translated code outlives uc_emu_start(), so drop the TBs of this region
+    tb_invalidate_uc_range(uc, mr->addr, int128_get64(mr->size));
     memory_region_del_subregion(get_system_memory(uc), mr);
 
     for (i = 0; i < uc->mapped_block_count; i++) {
@@ -89,6 +84,8 @@ void memory_unmap(struct uc_struct *uc, MemoryRegion *mr)
             //shift remainder of array down over deleted pointer
             memmove(&uc->mapped_blocks[i], &uc->mapped_blocks[i + 1], sizeof(MemoryRegion*) * (uc->mapped_block_count - i));
             mr->destructor(mr);
+            g_free(mr->page_perms);
+            mr->page_perms = NULL;
             obj = OBJECT(mr);
             obj->ref = 1;
             obj->free = g_free;
@@ -717,6 +714,7 @@ void memory_region_transaction_begin(struct uc_struct *uc)
 static void memory_region_clear_pending(struct uc_struct *uc)
 {
     uc->memory_region_update_pending = false;
+    uc->memory_region_unassigned_stale = false;
 }
 
 void memory_region_transaction_commit(struct uc_struct *uc)
@@ -734,6 +732,8 @@ void memory_region_transaction_commit(struct uc_struct *uc)
             }
 
             MEMORY_LISTENER_CALL_GLOBAL(commit, Forward);
+        } else if (uc->memory_region_unassigned_stale) {
+            tlb_flush_memory(uc, NULL, 0);
         }
         memory_region_clear_pending(uc);
    }
@@ -1202,6 +1202,10 @@ bool memory_region_is_iommu(MemoryRegion *mr)
     return mr->iommu_ops != 0;
 }
 
+static bool memory_region_update_in_place(MemoryRegion *container,
+                                          MemoryRegion *mr,
+                                          bool del, bool add);
+
 void memory_region_set_readonly(MemoryRegion *mr, bool readonly)
 {
     if (mr->readonly != readonly) {
@@ -1213,7 +1217,10 @@ void memory_region_set_readonly(MemoryRegion *mr, bool readonly)
         else {
             mr->perms |= UC_PROT_WRITE;
         }
-        mr->uc->memory_region_update_pending |= mr->enabled;
+        if (mr->enabled && !(mr->container && mr->container->enabled &&
+                memory_region_update_in_place(mr->container, mr, true, true))) {
+            mr->uc->memory_region_update_pending = true;
+        }
         memory_region_transaction_commit(mr->uc);
     }
 }
@@ -1250,36 +1257,111 @@ void *memory_region_get_ram_ptr(MemoryRegion *mr)
     return qemu_get_ram_ptr(mr->uc, mr->ram_addr & TARGET_PAGE_MASK);
 }
 
-static void memory_region_update_container_subregions(MemoryRegion *subregion)
+static FlatRange *flatview_lookup(FlatView *view, AddrRange addr);
+
+/* Unicorn: index of the first range of @view from @addr on */
+static unsigned flatview_find_pos(FlatView *view, Int128 addr)
 {
-    hwaddr offset = subregion->addr;
-    MemoryRegion *mr = subregion->container;
-    MemoryRegion *other;
+    unsigned lo = 0, hi = view->nr, mid;
 
-    memory_region_transaction_begin(mr->uc);
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (int128_lt(view->ranges[mid].addr.start, addr)) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
 
-    memory_region_ref(subregion);
-    QTAILQ_FOREACH(other, &mr->subregions, subregions_link) {
-        if (subregion->may_overlap || other->may_overlap) {
+/* Unicorn: a RAM region overlapping nothing, as memory_map() adds, is one
+   FlatRange of the views of its address spaces, and one section of their
+   dispatch. Rather than rendering the whole memory again, remove (@del)
+   and/or insert (@add) that one range and section of @mr, a subregion of
+   @container, and only drop the TLB entries of @mr, or of unassigned
+   memory at the end of the transaction. Returns false if the change needs
+   a full update. */
+static bool memory_region_update_in_place(MemoryRegion *container,
+                                          MemoryRegion *mr,
+                                          bool del, bool add)
+{
+    struct uc_struct *uc = container->uc;
+    MemoryRegionSection section;
+    AddressSpace *as;
+    AddrRange range;
+    FlatView *view;
+    FlatRange fr, *found;
+
+    if (uc->memory_region_update_pending || container->container ||
+        container->terminates || container->subregions_overlap ||
+        mr->may_overlap || mr->alias || !mr->terminates ||
+        !memory_region_is_ram(mr) || !QTAILQ_EMPTY(&mr->subregions) ||
+        !int128_lt(mr->size, int128_2_64()) ||
+        ((mr->addr | int128_get64(mr->size)) & ~TARGET_PAGE_MASK)) {
+        return false;
+    }
+
+    range = addrrange_make(int128_make64(container->addr + mr->addr), mr->size);
+    QTAILQ_FOREACH(as, &uc->address_spaces, address_spaces_link) {
+        if (as->root != container) {
             continue;
         }
-        if (int128_ge(int128_make64(offset),
-                      int128_add(int128_make64(other->addr), other->size))
-            || int128_le(int128_add(int128_make64(offset), subregion->size),
-                         int128_make64(other->addr))) {
+        found = flatview_lookup(as->current_map, range);
+        if (del && (!found || found->mr != mr || found->offset_in_region ||
+                    !addrrange_equal(found->addr, range))) {
+            return false;
+        }
+        if (!del && found) {
+            return false;
+        }
+    }
+
+    QTAILQ_FOREACH(as, &uc->address_spaces, address_spaces_link) {
+        if (as->root != container) {
             continue;
         }
-#if 0
-        printf("warning: subregion collision %llx/%llx (%s) "
-               "vs %llx/%llx (%s)\n",
-               (unsigned long long)offset,
-               (unsigned long long)int128_get64(subregion->size),
-               subregion->name,
-               (unsigned long long)other->addr,
-               (unsigned long long)int128_get64(other->size),
-               other->name);
-#endif
+        view = as->current_map;
+        if (del) {
+            found = flatview_lookup(view, range);
+            section = MemoryRegionSection_make(mr, as, 0, range.size,
+                    int128_get64(range.start), found->readonly);
+            address_space_dispatch_update(as, &section, false);
+            memmove(found, found + 1,
+                    (view->ranges + view->nr - found - 1) * sizeof(FlatRange));
+            view->nr--;
+            memory_region_unref(mr);
+        }
+        if (add) {
+            fr.mr = mr;
+            fr.offset_in_region = 0;
+            fr.addr = range;
+            fr.dirty_log_mask = mr->dirty_log_mask;
+            fr.romd_mode = mr->romd_mode;
+            fr.readonly = container->readonly || mr->readonly;
+            flatview_insert(view, flatview_find_pos(view, range.start), &fr);
+            section = MemoryRegionSection_make(mr, as, 0, range.size,
+                    int128_get64(range.start), fr.readonly);
+            address_space_dispatch_update(as, &section, true);
+        }
     }
+
+    if (del) {
+        tlb_flush_memory(uc, memory_region_get_ram_ptr(mr), int128_get64(mr->size));
+    } else {
+        uc->memory_region_unassigned_stale = true;
+    }
+    return true;
+}
+
+static void memory_region_update_container_subregions(MemoryRegion *subregion)
+{
+    MemoryRegion *mr = subregion->container;
+    MemoryRegion *other;
+
+    memory_region_transaction_begin(mr->uc);
+
+    memory_region_ref(subregion);
     QTAILQ_FOREACH(other, &mr->subregions, subregions_link) {
         if (subregion->priority >= other->priority) {
             QTAILQ_INSERT_BEFORE(other, subregion, subregions_link);
@@ -1288,7 +1370,12 @@ static void memory_region_update_container_subregions(MemoryRegion *subregion)
     }
     QTAILQ_INSERT_TAIL(&mr->subregions, subregion, subregions_link);
 done:
-    mr->uc->memory_region_update_pending |= mr->enabled && subregion->enabled;
+    // Unicorn: once a subregion is not added in place, another may hide it
+    if (mr->enabled && subregion->enabled &&
+        !memory_region_update_in_place(mr, subregion, false, true)) {
+        mr->subregions_overlap = true;
+        mr->uc->memory_region_update_pending = true;
+    }
     memory_region_transaction_commit(mr->uc);
 }
 
@@ -1327,10 +1414,13 @@ void memory_region_del_subregion(MemoryRegion *mr,
 {
     memory_region_transaction_begin(mr->uc);
     assert(subregion->container == mr);
+    if (mr->enabled && subregion->enabled &&
+        !memory_region_update_in_place(mr, subregion, true, false)) {
+        mr->uc->memory_region_update_pending = true;
+    }
     subregion->container = NULL;
     QTAILQ_REMOVE(&mr->subregions, subregion, subregions_link);
     memory_region_unref(subregion);
-    mr->uc->memory_region_update_pending |= mr->enabled && subregion->enabled;
     memory_region_transaction_commit(mr->uc);
 }
 
@@ -1341,6 +1431,9 @@ void memory_region_set_enabled(MemoryRegion *mr, bool enabled)
     }
     memory_region_transaction_begin(mr->uc);
     mr->enabled = enabled;
+    if (mr->container) {
+        mr->container->subregions_overlap = true;
+    }
     mr->uc->memory_region_update_pending = true;
     memory_region_transaction_commit(mr->uc);
 }
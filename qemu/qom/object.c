@@ -358,6 +358,7 @@ static void object_property_del_all(struct uc_struct *uc, Object *obj)
         ObjectProperty *prop = QTAILQ_FIRST(&obj->properties);
 
         QTAILQ_REMOVE(&obj->properties, prop, node);
+        g_hash_table_remove(obj->property_names, prop->name);
 
         if (prop->release) {
             prop->release(uc, obj, prop->name, prop->opaque);
@@ -368,17 +369,17 @@ static void object_property_del_all(struct uc_struct *uc, Object *obj)
         g_free(prop->description);
         g_free(prop);
     }
+
+    if (obj->property_names) {
+        g_hash_table_destroy(obj->property_names);
+        obj->property_names = NULL;
+    }
 }
 
 void object_property_del_child(struct uc_struct *uc, Object *obj, Object *child, Error **errp)
 {
-    ObjectProperty *prop;
-
-    QTAILQ_FOREACH(prop, &obj->properties, node) {
-        if (object_property_is_child(prop) && prop->opaque == child) {
-            object_property_del(uc, obj, prop->name, errp);
-            break;
-        }
+    if (child->parent == obj) {
+        object_property_del(uc, obj, child->parent_property->name, errp);
     }
 }
 
@@ -722,14 +723,16 @@ object_property_add(Object *obj, const char *name, const char *type,
     ObjectProperty *prop;
     size_t name_len = strlen(name);
 
+    /* Unicorn: indexes are not reused, so that adding the n-th "name[*]"
+     * does not try the n - 1 names taken before it */
     if (name_len >= 3 && !memcmp(name + name_len - 3, "[*]", 4)) {
-        int i;
         ObjectProperty *ret;
         char *name_no_array = g_strdup(name);
 
         name_no_array[name_len - 3] = '\0';
-        for (i = 0; ; ++i) {
-            char *full_name = g_strdup_printf("%s[%d]", name_no_array, i);
+        for (;;) {
+            char *full_name = g_strdup_printf("%s[%u]", name_no_array,
+                                              obj->property_index++);
 
             ret = object_property_add(obj, full_name, type, get, set,
                                       release, opaque, NULL);
@@ -742,13 +745,15 @@ object_property_add(Object *obj, const char *name, const char *type,
         return ret;
     }
 
-    QTAILQ_FOREACH(prop, &obj->properties, node) {
-        if (strcmp(prop->name, name) == 0) {
-            error_setg(errp, "attempt to add duplicate property '%s'"
-                       " to object (type '%s')", name,
-                       object_get_typename(obj));
-            return NULL;
-        }
+    if (!obj->property_names) {
+        obj->property_names = g_hash_table_new(g_str_hash, g_str_equal);
+    }
+
+    if (g_hash_table_lookup(obj->property_names, name)) {
+        error_setg(errp, "attempt to add duplicate property '%s'"
+                   " to object (type '%s')", name,
+                   object_get_typename(obj));
+        return NULL;
     }
 
     prop = g_malloc0(sizeof(*prop));
@@ -762,18 +767,20 @@ object_property_add(Object *obj, const char *name, const char *type,
     prop->opaque = opaque;
 
     QTAILQ_INSERT_TAIL(&obj->properties, prop, node);
+    g_hash_table_insert(obj->property_names, prop->name, prop);
     return prop;
 }
 
 ObjectProperty *object_property_find(Object *obj, const char *name,
                                      Error **errp)
 {
-    ObjectProperty *prop;
+    ObjectProperty *prop = NULL;
 
-    QTAILQ_FOREACH(prop, &obj->properties, node) {
-        if (strcmp(prop->name, name) == 0) {
-            return prop;
-        }
+    if (obj->property_names) {
+        prop = g_hash_table_lookup(obj->property_names, name);
+    }
+    if (prop) {
+        return prop;
     }
 
     error_setg(errp, "Property '.%s' not found", name);
@@ -792,6 +799,7 @@ void object_property_del(struct uc_struct *uc, Object *obj, const char *name, Er
     }
 
     QTAILQ_REMOVE(&obj->properties, prop, node);
+    g_hash_table_remove(obj->property_names, prop->name);
 
     g_free(prop->name);
     g_free(prop->type);
@@ -1006,6 +1014,7 @@ static void object_finalize_child_property(struct uc_struct *uc, Object *obj, co
         (child->class_->unparent)(uc, child);
     }
     child->parent = NULL;
+    child->parent_property = NULL;
     object_unref(uc, child);
 }
 
@@ -1033,6 +1042,7 @@ void object_property_add_child(Object *obj, const char *name,
     op->resolve = object_resolve_child_property;
     object_ref(child);
     child->parent = obj;
+    child->parent_property = op;
 
 out:
     g_free(type);
@@ -184,14 +184,14 @@ static QEMU_UNUSED_FUNC
 WORD_TYPE helper_le_ld_name(CPUArchState *env, target_ulong addr, int mmu_idx,
                             uintptr_t retaddr)
 {
-    int index = (addr >> TARGET_PAGE_BITS) & (CPU_TLB_SIZE - 1);
-    target_ulong tlb_addr = env->tlb_table[mmu_idx][index].ADDR_READ;
+    uintptr_t index;
+    target_ulong tlb_addr;
     uintptr_t haddr;
     DATA_TYPE res;
     int error_code;
     struct hook *hook;
     bool handled;
-    HOOK_FOREACH_VAR_DECLARE;
+    HOOK_FOREACH_BOUNDED_VAR_DECLARE;
 
     struct uc_struct *uc = env->uc;
     MemoryRegion *mr = memory_mapping(uc, addr);
@@ -201,22 +201,18 @@ WORD_TYPE helper_le_ld_name(CPUArchState *env, target_ulong addr, int mmu_idx,
         handled = false;
 #if defined(SOFTMMU_CODE_ACCESS)
         error_code = UC_ERR_FETCH_UNMAPPED;
-        HOOK_FOREACH(uc, hook, UC_HOOK_MEM_FETCH_UNMAPPED) {
+        HOOK_FOREACH_BOUNDED(uc, hook, UC_HOOK_MEM_FETCH_UNMAPPED, addr) {
             if (hook->to_delete)
                 continue;
-            if (!HOOK_BOUND_CHECK(hook, addr))
-                continue;
-            if ((handled = ((uc_cb_eventmem_t)hook->callback)(uc, UC_MEM_FETCH_UNMAPPED, addr, DATA_SIZE - uc->size_recur_mem, 0, hook->user_data)))
+            if ((handled = HOOK_CALLBACK(uc, hook, UC_HOOK_MEM_FETCH_UNMAPPED, uc_cb_eventmem_t)(uc, UC_MEM_FETCH_UNMAPPED, addr, DATA_SIZE - uc->size_recur_mem, 0, hook->user_data)))
                 break;
         }
 #else
         error_code = UC_ERR_READ_UNMAPPED;
-        HOOK_FOREACH(uc, hook, UC_HOOK_MEM_READ_UNMAPPED) {
+        HOOK_FOREACH_BOUNDED(uc, hook, UC_HOOK_MEM_READ_UNMAPPED, addr) {
             if (hook->to_delete)
                 continue;
-            if (!HOOK_BOUND_CHECK(hook, addr))
-                continue;
-            if ((handled = ((uc_cb_eventmem_t)hook->callback)(uc, UC_MEM_READ_UNMAPPED, addr, DATA_SIZE - uc->size_recur_mem, 0, hook->user_data)))
+            if ((handled = HOOK_CALLBACK(uc, hook, UC_HOOK_MEM_READ_UNMAPPED, uc_cb_eventmem_t)(uc, UC_MEM_READ_UNMAPPED, addr, DATA_SIZE - uc->size_recur_mem, 0, hook->user_data)))
                 break;
         }
 #endif
@@ -234,14 +230,12 @@ WORD_TYPE helper_le_ld_name(CPUArchState *env, target_ulong addr, int mmu_idx,
 
 #if defined(SOFTMMU_CODE_ACCESS)
     // Unicorn: callback on fetch from NX
-    if (mr != NULL && !(mr->perms & UC_PROT_EXEC)) {  // non-executable
+    if (mr != NULL && !(memory_region_perms(uc, mr, addr) & UC_PROT_EXEC)) {  // non-executable
         handled = false;
-        HOOK_FOREACH(uc, hook, UC_HOOK_MEM_FETCH_PROT) {
+        HOOK_FOREACH_BOUNDED(uc, hook, UC_HOOK_MEM_FETCH_PROT, addr) {
             if (hook->to_delete)
                 continue;
-            if (!HOOK_BOUND_CHECK(hook, addr))
-                continue;
-            if ((handled = ((uc_cb_eventmem_t)hook->callback)(uc, UC_MEM_FETCH_PROT, addr, DATA_SIZE - uc->size_recur_mem, 0, hook->user_data)))
+            if ((handled = HOOK_CALLBACK(uc, hook, UC_HOOK_MEM_FETCH_PROT, uc_cb_eventmem_t)(uc, UC_MEM_FETCH_PROT, addr, DATA_SIZE - uc->size_recur_mem, 0, hook->user_data)))
                 break;
         }
 
@@ -264,25 +258,21 @@ WORD_TYPE helper_le_ld_name(CPUArchState *env, target_ulong addr, int mmu_idx,
     // about successful read
     if (READ_ACCESS_TYPE == MMU_DATA_LOAD) {
         if (!uc->size_recur_mem) { // disabling read callback if in recursive call
-            HOOK_FOREACH(uc, hook, UC_HOOK_MEM_READ) {
+            HOOK_FOREACH_BOUNDED(uc, hook, UC_HOOK_MEM_READ, addr) {
               if (hook->to_delete)
                   continue;
-              if (!HOOK_BOUND_CHECK(hook, addr))
-                    continue;
-                ((uc_cb_hookmem_t)hook->callback)(env->uc, UC_MEM_READ, addr, DATA_SIZE, 0, hook->user_data);
+                HOOK_CALLBACK(uc, hook, UC_HOOK_MEM_READ, uc_cb_hookmem_t)(env->uc, UC_MEM_READ, addr, DATA_SIZE, 0, hook->user_data);
             }
         }
     }
 
     // Unicorn: callback on non-readable memory
-    if (READ_ACCESS_TYPE == MMU_DATA_LOAD && mr != NULL && !(mr->perms & UC_PROT_READ)) {  //non-readable
+    if (READ_ACCESS_TYPE == MMU_DATA_LOAD && mr != NULL && !(memory_region_perms(uc, mr, addr) & UC_PROT_READ)) {  //non-readable
         handled = false;
-        HOOK_FOREACH(uc, hook, UC_HOOK_MEM_READ_PROT) {
+        HOOK_FOREACH_BOUNDED(uc, hook, UC_HOOK_MEM_READ_PROT, addr) {
             if (hook->to_delete)
                 continue;
-            if (!HOOK_BOUND_CHECK(hook, addr))
-                continue;
-            if ((handled = ((uc_cb_eventmem_t)hook->callback)(uc, UC_MEM_READ_PROT, addr, DATA_SIZE - uc->size_recur_mem, 0, hook->user_data)))
+            if ((handled = HOOK_CALLBACK(uc, hook, UC_HOOK_MEM_READ_PROT, uc_cb_eventmem_t)(uc, UC_MEM_READ_PROT, addr, DATA_SIZE - uc->size_recur_mem, 0, hook->user_data)))
                 break;
         }
 
@@ -297,6 +287,10 @@ WORD_TYPE helper_le_ld_name(CPUArchState *env, target_ulong addr, int mmu_idx,
         }
     }
 
+    /* hooks may have flushed & resized the TLB */
+    index = tlb_index(env, mmu_idx, addr);
+    tlb_addr = env->tlb_table[mmu_idx][index].ADDR_READ;
+
     /* Adjust the given return address.  */
     retaddr -= GETPC_ADJ;
 
@@ -306,6 +300,7 @@ WORD_TYPE helper_le_ld_name(CPUArchState *env, target_ulong addr, int mmu_idx,
     if ((addr & TARGET_PAGE_MASK)
          != (tlb_addr & (TARGET_PAGE_MASK | TLB_INVALID_MASK))
          || env->tlb_table[mmu_idx][index].addend == -1) {
+        uc->tlb_misses++;
 #ifdef ALIGNED_ONLY
         if ((addr & (DATA_SIZE - 1)) != 0) {
             //cpu_unaligned_access(ENV_GET_CPU(env), addr, READ_ACCESS_TYPE,
@@ -323,12 +318,13 @@ WORD_TYPE helper_le_ld_name(CPUArchState *env, target_ulong addr, int mmu_idx,
         if (!victim_tlb_hit_read(env, addr, mmu_idx, index)) {
             tlb_fill(ENV_GET_CPU(env), addr, READ_ACCESS_TYPE,
                      mmu_idx, retaddr);
+            index = tlb_index(env, mmu_idx, addr);
         }
         tlb_addr = env->tlb_table[mmu_idx][index].ADDR_READ;
     }
 
     /* Handle an IO access.  */
-    if (unlikely(tlb_addr & ~TARGET_PAGE_MASK)) {
+    if (unlikely(tlb_addr & ~(TARGET_PAGE_MASK | TLB_HOOKED))) {
         hwaddr ioaddr;
         if ((addr & (DATA_SIZE - 1)) != 0) {
             goto do_unaligned_access;
@@ -414,12 +410,10 @@ _out:
     // Unicorn: callback on successful read
     if (READ_ACCESS_TYPE == MMU_DATA_LOAD) {
         if (!uc->size_recur_mem) { // disabling read callback if in recursive call
-            HOOK_FOREACH(uc, hook, UC_HOOK_MEM_READ_AFTER) {
+            HOOK_FOREACH_BOUNDED(uc, hook, UC_HOOK_MEM_READ_AFTER, addr) {
               if (hook->to_delete)
                   continue;
-              if (!HOOK_BOUND_CHECK(hook, addr))
-                    continue;
-                ((uc_cb_hookmem_t)hook->callback)(env->uc, UC_MEM_READ_AFTER, addr, DATA_SIZE, res, hook->user_data);
+                HOOK_CALLBACK(uc, hook, UC_HOOK_MEM_READ_AFTER, uc_cb_hookmem_t)(env->uc, UC_MEM_READ_AFTER, addr, DATA_SIZE, res, hook->user_data);
             }
         }
     }
@@ -434,14 +428,14 @@ static QEMU_UNUSED_FUNC
 WORD_TYPE helper_be_ld_name(CPUArchState *env, target_ulong addr, int mmu_idx,
                             uintptr_t retaddr)
 {
-    int index = (addr >> TARGET_PAGE_BITS) & (CPU_TLB_SIZE - 1);
-    target_ulong tlb_addr = env->tlb_table[mmu_idx][index].ADDR_READ;
+    uintptr_t index;
+    target_ulong tlb_addr;
     uintptr_t haddr;
     DATA_TYPE res;
     int error_code;
     struct hook *hook;
     bool handled;
-    HOOK_FOREACH_VAR_DECLARE;
+    HOOK_FOREACH_BOUNDED_VAR_DECLARE;
 
     struct uc_struct *uc = env->uc;
     MemoryRegion *mr = memory_mapping(uc, addr);
@@ -451,22 +445,18 @@ WORD_TYPE helper_be_ld_name(CPUArchState *env, target_ulong addr, int mmu_idx,
         handled = false;
 #if defined(SOFTMMU_CODE_ACCESS)
         error_code = UC_ERR_FETCH_UNMAPPED;
-        HOOK_FOREACH(uc, hook, UC_HOOK_MEM_FETCH_UNMAPPED) {
+        HOOK_FOREACH_BOUNDED(uc, hook, UC_HOOK_MEM_FETCH_UNMAPPED, addr) {
             if (hook->to_delete)
                 continue;
-            if (!HOOK_BOUND_CHECK(hook, addr))
-                continue;
-            if ((handled = ((uc_cb_eventmem_t)hook->callback)(uc, UC_MEM_FETCH_UNMAPPED, addr, DATA_SIZE - uc->size_recur_mem, 0, hook->user_data)))
+            if ((handled = HOOK_CALLBACK(uc, hook, UC_HOOK_MEM_FETCH_UNMAPPED, uc_cb_eventmem_t)(uc, UC_MEM_FETCH_UNMAPPED, addr, DATA_SIZE - uc->size_recur_mem, 0, hook->user_data)))
                 break;
         }
 #else
         error_code = UC_ERR_READ_UNMAPPED;
-        HOOK_FOREACH(uc, hook, UC_HOOK_MEM_READ_UNMAPPED) {
+        HOOK_FOREACH_BOUNDED(uc, hook, UC_HOOK_MEM_READ_UNMAPPED, addr) {
             if (hook->to_delete)
                 continue;
-            if (!HOOK_BOUND_CHECK(hook, addr))
-                continue;
-            if ((handled = ((uc_cb_eventmem_t)hook->callback)(uc, UC_MEM_READ_UNMAPPED, addr, DATA_SIZE - uc->size_recur_mem, 0, hook->user_data)))
+            if ((handled = HOOK_CALLBACK(uc, hook, UC_HOOK_MEM_READ_UNMAPPED, uc_cb_eventmem_t)(uc, UC_MEM_READ_UNMAPPED, addr, DATA_SIZE - uc->size_recur_mem, 0, hook->user_data)))
                 break;
         }
 #endif
@@ -484,14 +474,12 @@ WORD_TYPE helper_be_ld_name(CPUArchState *env, target_ulong addr, int mmu_idx,
 
 #if defined(SOFTMMU_CODE_ACCESS)
     // Unicorn: callback on fetch from NX
-    if (mr != NULL && !(mr->perms & UC_PROT_EXEC)) {  // non-executable
+    if (mr != NULL && !(memory_region_perms(uc, mr, addr) & UC_PROT_EXEC)) {  // non-executable
         handled = false;
-        HOOK_FOREACH(uc, hook, UC_HOOK_MEM_FETCH_PROT) {
+        HOOK_FOREACH_BOUNDED(uc, hook, UC_HOOK_MEM_FETCH_PROT, addr) {
             if (hook->to_delete)
                 continue;
-            if (!HOOK_BOUND_CHECK(hook, addr))
-                continue;
-            if ((handled = ((uc_cb_eventmem_t)hook->callback)(uc, UC_MEM_FETCH_PROT, addr, DATA_SIZE - uc->size_recur_mem, 0, hook->user_data)))
+            if ((handled = HOOK_CALLBACK(uc, hook, UC_HOOK_MEM_FETCH_PROT, uc_cb_eventmem_t)(uc, UC_MEM_FETCH_PROT, addr, DATA_SIZE - uc->size_recur_mem, 0, hook->user_data)))
                 break;
         }
 
@@ -514,25 +502,21 @@ WORD_TYPE helper_be_ld_name(CPUArchState *env, target_ulong addr, int mmu_idx,
     // about successful read
     if (READ_ACCESS_TYPE == MMU_DATA_LOAD) {
         if (!uc->size_recur_mem) { // disabling read callback if in recursive call
-            HOOK_FOREACH(uc, hook, UC_HOOK_MEM_READ) {
+            HOOK_FOREACH_BOUNDED(uc, hook, UC_HOOK_MEM_READ, addr) {
               if (hook->to_delete)
                   continue;
-              if (!HOOK_BOUND_CHECK(hook, addr))
-                    continue;
-                ((uc_cb_hookmem_t)hook->callback)(env->uc, UC_MEM_READ, addr, DATA_SIZE, 0, hook->user_data);
+                HOOK_CALLBACK(uc, hook, UC_HOOK_MEM_READ, uc_cb_hookmem_t)(env->uc, UC_MEM_READ, addr, DATA_SIZE, 0, hook->user_data);
             }
         }
     }
 
     // Unicorn: callback on non-readable memory
-    if (READ_ACCESS_TYPE == MMU_DATA_LOAD && mr != NULL && !(mr->perms & UC_PROT_READ)) {  //non-readable
+    if (READ_ACCESS_TYPE == MMU_DATA_LOAD && mr != NULL && !(memory_region_perms(uc, mr, addr) & UC_PROT_READ)) {  //non-readable
         handled = false;
-        HOOK_FOREACH(uc, hook, UC_HOOK_MEM_READ_PROT) {
+        HOOK_FOREACH_BOUNDED(uc, hook, UC_HOOK_MEM_READ_PROT, addr) {
             if (hook->to_delete)
                 continue;
-            if (!HOOK_BOUND_CHECK(hook, addr))
-                continue;
-            if ((handled = ((uc_cb_eventmem_t)hook->callback)(uc, UC_MEM_READ_PROT, addr, DATA_SIZE - uc->size_recur_mem, 0, hook->user_data)))
+            if ((handled = HOOK_CALLBACK(uc, hook, UC_HOOK_MEM_READ_PROT, uc_cb_eventmem_t)(uc, UC_MEM_READ_PROT, addr, DATA_SIZE - uc->size_recur_mem, 0, hook->user_data)))
                 break;
         }
 
@@ -547,6 +531,10 @@ WORD_TYPE helper_be_ld_name(CPUArchState *env, target_ulong addr, int mmu_idx,
         }
     }
 
+    /* hooks may have flushed & resized the TLB */
+    index = tlb_index(env, mmu_idx, addr);
+    tlb_addr = env->tlb_table[mmu_idx][index].ADDR_READ;
+
     /* Adjust the given return address.  */
     retaddr -= GETPC_ADJ;
 
@@ -556,6 +544,7 @@ WORD_TYPE helper_be_ld_name(CPUArchState *env, target_ulong addr, int mmu_idx,
     if ((addr & TARGET_PAGE_MASK)
          != (tlb_addr & (TARGET_PAGE_MASK | TLB_INVALID_MASK))
          || env->tlb_table[mmu_idx][index].addend == -1) {
+        uc->tlb_misses++;
 #ifdef ALIGNED_ONLY
         if ((addr & (DATA_SIZE - 1)) != 0) {
             //cpu_unaligned_access(ENV_GET_CPU(env), addr, READ_ACCESS_TYPE,
@@ -573,12 +562,13 @@ WORD_TYPE helper_be_ld_name(CPUArchState *env, target_ulong addr, int mmu_idx,
         if (!victim_tlb_hit_read(env, addr, mmu_idx, index)) {
             tlb_fill(ENV_GET_CPU(env), addr, READ_ACCESS_TYPE,
                      mmu_idx, retaddr);
+            index = tlb_index(env, mmu_idx, addr);
         }
         tlb_addr = env->tlb_table[mmu_idx][index].ADDR_READ;
     }
 
     /* Handle an IO access.  */
-    if (unlikely(tlb_addr & ~TARGET_PAGE_MASK)) {
+    if (unlikely(tlb_addr & ~(TARGET_PAGE_MASK | TLB_HOOKED))) {
         hwaddr ioaddr;
         if ((addr & (DATA_SIZE - 1)) != 0) {
             goto do_unaligned_access;
@@ -659,12 +649,10 @@ _out:
     // Unicorn: callback on successful read
     if (READ_ACCESS_TYPE == MMU_DATA_LOAD) {
         if (!uc->size_recur_mem) { // disabling read callback if in recursive call
-            HOOK_FOREACH(uc, hook, UC_HOOK_MEM_READ_AFTER) {
+            HOOK_FOREACH_BOUNDED(uc, hook, UC_HOOK_MEM_READ_AFTER, addr) {
               if (hook->to_delete)
                   continue;
-              if (!HOOK_BOUND_CHECK(hook, addr))
-                    continue;
-                ((uc_cb_hookmem_t)hook->callback)(env->uc, UC_MEM_READ_AFTER, addr, DATA_SIZE, res, hook->user_data);
+                HOOK_CALLBACK(uc, hook, UC_HOOK_MEM_READ_AFTER, uc_cb_hookmem_t)(env->uc, UC_MEM_READ_AFTER, addr, DATA_SIZE, res, hook->user_data);
             }
         }
     }
@@ -723,36 +711,32 @@ static inline void glue(io_write, SUFFIX)(CPUArchState *env,
 void helper_le_st_name(CPUArchState *env, target_ulong addr, DATA_TYPE val,
                        int mmu_idx, uintptr_t retaddr)
 {
-    int index = (addr >> TARGET_PAGE_BITS) & (CPU_TLB_SIZE - 1);
-    target_ulong tlb_addr = env->tlb_table[mmu_idx][index].addr_write;
+    uintptr_t index;
+    target_ulong tlb_addr;
     uintptr_t haddr;
     struct hook *hook;
     bool handled;
-    HOOK_FOREACH_VAR_DECLARE;
+    HOOK_FOREACH_BOUNDED_VAR_DECLARE;
 
     struct uc_struct *uc = env->uc;
     MemoryRegion *mr = memory_mapping(uc, addr);
 
     if (!uc->size_recur_mem) { // disabling write callback if in recursive call
         // Unicorn: callback on memory write
-        HOOK_FOREACH(uc, hook, UC_HOOK_MEM_WRITE) {
+        HOOK_FOREACH_BOUNDED(uc, hook, UC_HOOK_MEM_WRITE, addr) {
           if (hook->to_delete)
               continue;
-          if (!HOOK_BOUND_CHECK(hook, addr))
-              continue;
-            ((uc_cb_hookmem_t)hook->callback)(uc, UC_MEM_WRITE, addr, DATA_SIZE, val, hook->user_data);
+            HOOK_CALLBACK(uc, hook, UC_HOOK_MEM_WRITE, uc_cb_hookmem_t)(uc, UC_MEM_WRITE, addr, DATA_SIZE, val, hook->user_data);
         }
     }
 
     // Unicorn: callback on invalid memory
     if (mr == NULL) {
         handled = false;
-        HOOK_FOREACH(uc, hook, UC_HOOK_MEM_WRITE_UNMAPPED) {
+        HOOK_FOREACH_BOUNDED(uc, hook, UC_HOOK_MEM_WRITE_UNMAPPED, addr) {
             if (hook->to_delete)
                 continue;
-            if (!HOOK_BOUND_CHECK(hook, addr))
-                continue;
-            if ((handled = ((uc_cb_eventmem_t)hook->callback)(uc, UC_MEM_WRITE_UNMAPPED, addr, DATA_SIZE, val, hook->user_data)))
+            if ((handled = HOOK_CALLBACK(uc, hook, UC_HOOK_MEM_WRITE_UNMAPPED, uc_cb_eventmem_t)(uc, UC_MEM_WRITE_UNMAPPED, addr, DATA_SIZE, val, hook->user_data)))
                 break;
         }
 
@@ -770,14 +754,12 @@ void helper_le_st_name(CPUArchState *env, target_ulong addr, DATA_TYPE val,
     }
 
     // Unicorn: callback on non-writable memory
-    if (mr != NULL && !(mr->perms & UC_PROT_WRITE)) {  //non-writable
+    if (mr != NULL && !(memory_region_perms(uc, mr, addr) & UC_PROT_WRITE)) {  //non-writable
         handled = false;
-        HOOK_FOREACH(uc, hook, UC_HOOK_MEM_WRITE_PROT) {
+        HOOK_FOREACH_BOUNDED(uc, hook, UC_HOOK_MEM_WRITE_PROT, addr) {
             if (hook->to_delete)
                 continue;
-            if (!HOOK_BOUND_CHECK(hook, addr))
-                continue;
-            if ((handled = ((uc_cb_eventmem_t)hook->callback)(uc, UC_MEM_WRITE_PROT, addr, DATA_SIZE, val, hook->user_data)))
+            if ((handled = HOOK_CALLBACK(uc, hook, UC_HOOK_MEM_WRITE_PROT, uc_cb_eventmem_t)(uc, UC_MEM_WRITE_PROT, addr, DATA_SIZE, val, hook->user_data)))
                 break;
         }
 
@@ -792,12 +774,17 @@ void helper_le_st_name(CPUArchState *env, target_ulong addr, DATA_TYPE val,
         }
     }
 
+    /* hooks may have flushed & resized the TLB */
+    index = tlb_index(env, mmu_idx, addr);
+    tlb_addr = env->tlb_table[mmu_idx][index].addr_write;
+
     /* Adjust the given return address.  */
     retaddr -= GETPC_ADJ;
 
     /* If the TLB entry is for a different page, reload and try again.  */
     if ((addr & TARGET_PAGE_MASK)
         != (tlb_addr & (TARGET_PAGE_MASK | TLB_INVALID_MASK))) {
+        uc->tlb_misses++;
 #ifdef ALIGNED_ONLY
         if ((addr & (DATA_SIZE - 1)) != 0) {
             //cpu_unaligned_access(ENV_GET_CPU(env), addr, MMU_DATA_STORE,
@@ -810,12 +797,13 @@ void helper_le_st_name(CPUArchState *env, target_ulong addr, DATA_TYPE val,
 #endif
         if (!victim_tlb_hit_write(env, addr, mmu_idx, index)) {
             tlb_fill(ENV_GET_CPU(env), addr, MMU_DATA_STORE, mmu_idx, retaddr);
+            index = tlb_index(env, mmu_idx, addr);
         }
         tlb_addr = env->tlb_table[mmu_idx][index].addr_write;
     }
 
     /* Handle an IO access.  */
-    if (unlikely(tlb_addr & ~TARGET_PAGE_MASK)) {
+    if (unlikely(tlb_addr & ~(TARGET_PAGE_MASK | TLB_HOOKED))) {
         hwaddr ioaddr;
         if ((addr & (DATA_SIZE - 1)) != 0) {
             goto do_unaligned_access;
@@ -893,36 +881,32 @@ void helper_le_st_name(CPUArchState *env, target_ulong addr, DATA_TYPE val,
 void helper_be_st_name(CPUArchState *env, target_ulong addr, DATA_TYPE val,
                        int mmu_idx, uintptr_t retaddr)
 {
-    int index = (addr >> TARGET_PAGE_BITS) & (CPU_TLB_SIZE - 1);
-    target_ulong tlb_addr = env->tlb_table[mmu_idx][index].addr_write;
+    uintptr_t index;
+    target_ulong tlb_addr;
     uintptr_t haddr;
     struct hook *hook;
     bool handled;
-    HOOK_FOREACH_VAR_DECLARE;
+    HOOK_FOREACH_BOUNDED_VAR_DECLARE;
 
     struct uc_struct *uc = env->uc;
     MemoryRegion *mr = memory_mapping(uc, addr);
 
     if (!uc->size_recur_mem) { // disabling write callback if in recursive call
         // Unicorn: callback on memory write
-        HOOK_FOREACH(uc, hook, UC_HOOK_MEM_WRITE) {
+        HOOK_FOREACH_BOUNDED(uc, hook, UC_HOOK_MEM_WRITE, addr) {
           if (hook->to_delete)
               continue;
-          if (!HOOK_BOUND_CHECK(hook, addr))
-                continue;
-            ((uc_cb_hookmem_t)hook->callback)(uc, UC_MEM_WRITE, addr, DATA_SIZE, val, hook->user_data);
+            HOOK_CALLBACK(uc, hook, UC_HOOK_MEM_WRITE, uc_cb_hookmem_t)(uc, UC_MEM_WRITE, addr, DATA_SIZE, val, hook->user_data);
         }
     }
 
     // Unicorn: callback on invalid memory
     if (mr == NULL) {
         handled = false;
-        HOOK_FOREACH(uc, hook, UC_HOOK_MEM_WRITE_UNMAPPED) {
+        HOOK_FOREACH_BOUNDED(uc, hook, UC_HOOK_MEM_WRITE_UNMAPPED, addr) {
             if (hook->to_delete)
                 continue;
-            if (!HOOK_BOUND_CHECK(hook, addr))
-                continue;
-            if ((handled = ((uc_cb_eventmem_t)hook->callback)(uc, UC_MEM_WRITE_UNMAPPED, addr, DATA_SIZE, val, hook->user_data)))
+            if ((handled = HOOK_CALLBACK(uc, hook, UC_HOOK_MEM_WRITE_UNMAPPED, uc_cb_eventmem_t)(uc, UC_MEM_WRITE_UNMAPPED, addr, DATA_SIZE, val, hook->user_data)))
                 break;
         }
 
@@ -940,14 +924,12 @@ void helper_be_st_name(CPUArchState *env, target_ulong addr, DATA_TYPE val,
     }
 
     // Unicorn: callback on non-writable memory
-    if (mr != NULL && !(mr->perms & UC_PROT_WRITE)) {  //non-writable
+    if (mr != NULL && !(memory_region_perms(uc, mr, addr) & UC_PROT_WRITE)) {  //non-writable
         handled = false;
-        HOOK_FOREACH(uc, hook, UC_HOOK_MEM_WRITE_PROT) {
+        HOOK_FOREACH_BOUNDED(uc, hook, UC_HOOK_MEM_WRITE_PROT, addr) {
             if (hook->to_delete)
                 continue;
-            if (!HOOK_BOUND_CHECK(hook, addr))
-                continue;
-            if ((handled = ((uc_cb_eventmem_t)hook->callback)(uc, UC_MEM_WRITE_PROT, addr, DATA_SIZE, val, hook->user_data)))
+            if ((handled = HOOK_CALLBACK(uc, hook, UC_HOOK_MEM_WRITE_PROT, uc_cb_eventmem_t)(uc, UC_MEM_WRITE_PROT, addr, DATA_SIZE, val, hook->user_data)))
                 break;
         }
 
@@ -962,12 +944,17 @@ void helper_be_st_name(CPUArchState *env, target_ulong addr, DATA_TYPE val,
         }
     }
 
+    /* hooks may have flushed & resized the TLB */
+    index = tlb_index(env, mmu_idx, addr);
+    tlb_addr = env->tlb_table[mmu_idx][index].addr_write;
+
     /* Adjust the given return address.  */
     retaddr -= GETPC_ADJ;
 
     /* If the TLB entry is for a different page, reload and try again.  */
     if ((addr & TARGET_PAGE_MASK)
         != (tlb_addr & (TARGET_PAGE_MASK | TLB_INVALID_MASK))) {
+        uc->tlb_misses++;
 #ifdef ALIGNED_ONLY
         if ((addr & (DATA_SIZE - 1)) != 0) {
             cpu_unaligned_access(ENV_GET_CPU(env), addr, MMU_DATA_STORE,
@@ -980,12 +967,13 @@ void helper_be_st_name(CPUArchState *env, target_ulong addr, DATA_TYPE val,
 #endif
         if (!victim_tlb_hit_write(env, addr, mmu_idx, index)) {
             tlb_fill(ENV_GET_CPU(env), addr, MMU_DATA_STORE, mmu_idx, retaddr);
+            index = tlb_index(env, mmu_idx, addr);
         }
         tlb_addr = env->tlb_table[mmu_idx][index].addr_write;
     }
 
     /* Handle an IO access.  */
-    if (unlikely(tlb_addr & ~TARGET_PAGE_MASK)) {
+    if (unlikely(tlb_addr & ~(TARGET_PAGE_MASK | TLB_HOOKED))) {
         hwaddr ioaddr;
         if ((addr & (DATA_SIZE - 1)) != 0) {
             goto do_unaligned_access;
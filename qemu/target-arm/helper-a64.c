@@ -186,6 +186,21 @@ uint64_t HELPER(simd_tbl)(CPUARMState *env, uint64_t result, uint64_t indices,
     return result;
 }
 
+#ifndef CONFIG_USER_ONLY
+/* STXR & STLXR, and STXP & STLXP when @desc has the pair bit */
+uint64_t HELPER(stxr)(CPUARMState *env, uint64_t addr, uint64_t val, uint64_t val2,
+                      uint32_t desc)
+{
+    int size = desc & 3;
+    int count = (desc & 4) ? 2 : 1;
+    int mmu_idx = desc >> 3;
+    uint64_t old[2] = { env->exclusive_val, env->exclusive_high };
+    uint64_t vals[2] = { val, val2 };
+
+    return arm_store_exclusive(env, addr, size, count, old, vals, mmu_idx, GETPC());
+}
+#endif
+
 /* 64bit/double versions of the neon float compare functions */
 uint64_t HELPER(neon_ceq_f64)(float64 a, float64 b, void *fpstp)
 {
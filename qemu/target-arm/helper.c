@@ -1,3 +1,14 @@
+#include <float.h>
+#include <math.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <xmmintrin.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#elif !defined(__aarch64__)
+#include <fenv.h>
+#endif
+
 #include "cpu.h"
 #include "internals.h"
 #include "exec/helper-proto.h"
@@ -4928,6 +4939,124 @@ void vfp_set_fpscr(CPUARMState *env, uint32_t val)
 
 #define VFP_HELPER(name, p) HELPER(glue(glue(vfp_,name),p))
 
+/* The host FPU in its default mode rounds to nearest even like softfloat,
+ * and computes the same when the operands and the result are normal
+ * numbers or exact zeroes: there are no NaNs, infinities or denormals to
+ * handle, hence no dependence on flush-to-zero or default NaN, and no flag
+ * to raise but inexact.  So the host does the common case once inexact is
+ * already set in the cumulative flags; softfloat does anything else, and
+ * raises the flags until then.  Only with hosts which do not evaluate
+ * floats in a wider precision, which would round twice.
+ */
+#if defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD == 0
+#define VFP_HOST_FPU
+
+/* The application may have changed the host rounding mode, or set
+ * flush-to-zero, which also flushes results the checks below take for
+ * exact zeroes.
+ */
+static inline bool host_fpu_default(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    /* MXCSR rounding control, FTZ and DAZ */
+    return (_mm_getcsr() & 0xe040) == 0;
+#elif defined(__aarch64__)
+    uint64_t fpcr;
+
+    /* FPCR RMode and FZ */
+    asm volatile("mrs %0, fpcr" : "=r"(fpcr));
+    return (fpcr & 0x1c00000) == 0;
+#else
+    return fegetround() == FE_TONEAREST;
+#endif
+}
+
+static inline bool vfp_host_fpu(float_status *fpst)
+{
+    return get_float_rounding_mode(fpst) == float_round_nearest_even &&
+           (get_float_exception_flags(fpst) & float_flag_inexact) &&
+           host_fpu_default();
+}
+
+static inline float float32_to_host(float32 a)
+{
+    uint32_t v = float32_val(a);
+    float f;
+
+    memcpy(&f, &v, sizeof(f));
+    return f;
+}
+
+static inline float32 float32_from_host(float f)
+{
+    uint32_t v;
+
+    memcpy(&v, &f, sizeof(v));
+    return make_float32(v);
+}
+
+static inline double float64_to_host(float64 a)
+{
+    uint64_t v = float64_val(a);
+    double f;
+
+    memcpy(&f, &v, sizeof(f));
+    return f;
+}
+
+static inline float64 float64_from_host(double f)
+{
+    uint64_t v;
+
+    memcpy(&v, &f, sizeof(v));
+    return make_float64(v);
+}
+
+/* Results of the smallest normal exponent may have been rounded up from
+ * tiny ones, which softfloat flushes or flags as underflow.
+ */
+static inline bool float32_host_result(float32 r)
+{
+    return ((float32_val(r) >> 23) & 0xff) - 2 < 0xfd;
+}
+
+static inline bool float64_host_result(float64 r)
+{
+    return ((float64_val(r) >> 52) & 0x7ff) - 2 < 0x7fd;
+}
+
+/* Operands & result the host computes the same with, for each operation.
+ * A zero result is exact when it is a sum, or when an operand of a
+ * product or dividend is zero; otherwise it may have underflowed.
+ */
+#define VFP_HOST_OPERAND(fsz, a) \
+    (float##fsz##_is_normal(a) || float##fsz##_is_zero(a))
+#define VFP_HOST_OK_add(fsz, a, b, r) \
+    (float##fsz##_host_result(r) || float##fsz##_is_zero(r))
+#define VFP_HOST_OK_sub(fsz, a, b, r) VFP_HOST_OK_add(fsz, a, b, r)
+#define VFP_HOST_OK_mul(fsz, a, b, r) \
+    (float##fsz##_host_result(r) || float##fsz##_is_zero(a) || float##fsz##_is_zero(b))
+#define VFP_HOST_OK_div(fsz, a, b, r) \
+    (!float##fsz##_is_zero(b) && \
+     (float##fsz##_host_result(r) || float##fsz##_is_zero(a)))
+
+#define VFP_HOST_add(a, b) ((a) + (b))
+#define VFP_HOST_sub(a, b) ((a) - (b))
+#define VFP_HOST_mul(a, b) ((a) * (b))
+#define VFP_HOST_div(a, b) ((a) / (b))
+
+#define VFP_HOST_BINOP(name, fsz) \
+    if (vfp_host_fpu(fpst) && VFP_HOST_OPERAND(fsz, a) && VFP_HOST_OPERAND(fsz, b)) { \
+        float##fsz r = float##fsz##_from_host( \
+            VFP_HOST_##name(float##fsz##_to_host(a), float##fsz##_to_host(b))); \
+        if (VFP_HOST_OK_##name(fsz, a, b, r)) { \
+            return r; \
+        } \
+    }
+#else
+#define VFP_HOST_BINOP(name, fsz)
+#endif
+
 #define VFP_BINOP(name) \
 float32 VFP_HELPER(name, s)(float32 a, float32 b, void *fpstp) \
 { \
@@ -4939,15 +5068,132 @@ float64 VFP_HELPER(name, d)(float64 a, float64 b, void *fpstp) \
     float_status *fpst = fpstp; \
     return float64_ ## name(a, b, fpst); \
 }
-VFP_BINOP(add)
-VFP_BINOP(sub)
-VFP_BINOP(mul)
-VFP_BINOP(div)
+
+/* The same with the host FPU for the common case */
+#define VFP_HOST_FPU_BINOP(name) \
+float32 VFP_HELPER(name, s)(float32 a, float32 b, void *fpstp) \
+{ \
+    float_status *fpst = fpstp; \
+    VFP_HOST_BINOP(name, 32) \
+    return float32_ ## name(a, b, fpst); \
+} \
+float64 VFP_HELPER(name, d)(float64 a, float64 b, void *fpstp) \
+{ \
+    float_status *fpst = fpstp; \
+    VFP_HOST_BINOP(name, 64) \
+    return float64_ ## name(a, b, fpst); \
+}
+VFP_HOST_FPU_BINOP(add)
+VFP_HOST_FPU_BINOP(sub)
+VFP_HOST_FPU_BINOP(mul)
+VFP_HOST_FPU_BINOP(div)
 VFP_BINOP(min)
 VFP_BINOP(max)
 VFP_BINOP(minnum)
 VFP_BINOP(maxnum)
 #undef VFP_BINOP
+#undef VFP_HOST_FPU_BINOP
+
+/* NEON float ops on whole Q registers, with pointers to the destination
+ * and the two operand registers, and the standard FPSCR status.  With
+ * SSE2 the host does the four elements at once when it would do each of
+ * them alone, checking the operands and results of all four; otherwise,
+ * or when one of them needs softfloat, each goes through the VFP helper.
+ * The multiply-accumulates round the product then the sum, like VMLA.
+ */
+#if defined(VFP_HOST_FPU) && defined(__SSE2__)
+static inline __m128i neon_host_abs(__m128 x)
+{
+    return _mm_and_si128(_mm_castps_si128(x), _mm_set1_epi32(0x7fffffff));
+}
+
+static inline __m128i neon_host_zero(__m128 x)
+{
+    return _mm_cmpeq_epi32(neon_host_abs(x), _mm_setzero_si128());
+}
+
+/* Elements which are neither normal numbers nor zeroes */
+static inline __m128i neon_host_bad_operand(__m128 x)
+{
+    __m128i abs = neon_host_abs(x);
+
+    return _mm_or_si128(_mm_cmpgt_epi32(abs, _mm_set1_epi32(0x7f7fffff)),
+                        _mm_andnot_si128(neon_host_zero(x),
+                                         _mm_cmplt_epi32(abs, _mm_set1_epi32(0x800000))));
+}
+
+/* Results float32_host_result() does not take, but for the @exact ones */
+static inline __m128i neon_host_bad_result(__m128 r, __m128i exact)
+{
+    __m128i abs = neon_host_abs(r);
+
+    return _mm_andnot_si128(exact,
+                            _mm_or_si128(_mm_cmplt_epi32(abs, _mm_set1_epi32(0x1000000)),
+                                         _mm_cmpgt_epi32(abs, _mm_set1_epi32(0x7f7fffff))));
+}
+
+/* *r = x + y, false if an element needs softfloat: VFP_HOST_OK_add */
+static inline bool neon_host_add(__m128 x, __m128 y, __m128 *r)
+{
+    __m128i bad = _mm_or_si128(neon_host_bad_operand(x), neon_host_bad_operand(y));
+
+    *r = _mm_add_ps(x, y);
+    bad = _mm_or_si128(bad, neon_host_bad_result(*r, neon_host_zero(*r)));
+    return _mm_movemask_epi8(bad) == 0;
+}
+
+/* *r = x * y, VFP_HOST_OK_mul */
+static inline bool neon_host_mul(__m128 x, __m128 y, __m128 *r)
+{
+    __m128i bad = _mm_or_si128(neon_host_bad_operand(x), neon_host_bad_operand(y));
+
+    *r = _mm_mul_ps(x, y);
+    bad = _mm_or_si128(bad, neon_host_bad_result(*r, _mm_or_si128(neon_host_zero(x),
+                                                                  neon_host_zero(y))));
+    return _mm_movemask_epi8(bad) == 0;
+}
+
+/* x - y is exactly x + -y, zeroes included */
+#define NEON_HOST_NEG(x) _mm_xor_ps(x, _mm_set1_ps(-0.0f))
+
+#define NEON_F32_Q_HOST(ok) \
+    if (vfp_host_fpu(fpstp)) { \
+        __m128 a = _mm_loadu_ps(vd), x = _mm_loadu_ps(vn), y = _mm_loadu_ps(vm), r; \
+        (void)a; \
+        if (ok) { \
+            _mm_storeu_ps(vd, r); \
+            return; \
+        } \
+    }
+#else
+#define NEON_F32_Q_HOST(ok)
+#endif
+
+#define NEON_F32_Q(name, expr, host_ok) \
+void HELPER(glue(name, _q))(void *vd, void *vn, void *vm, void *fpstp) \
+{ \
+    float32 *d = vd, *n = vn, *m = vm; \
+    int i; \
+    NEON_F32_Q_HOST(host_ok) \
+    for (i = 0; i < 4; i++) { \
+        float32 a = d[i], x = n[i], y = m[i]; \
+        (void)a; \
+        d[i] = expr; \
+    } \
+}
+
+NEON_F32_Q(neon_add_f32, HELPER(vfp_adds)(x, y, fpstp),
+           neon_host_add(x, y, &r))
+NEON_F32_Q(neon_sub_f32, HELPER(vfp_subs)(x, y, fpstp),
+           neon_host_add(x, NEON_HOST_NEG(y), &r))
+NEON_F32_Q(neon_mul_f32, HELPER(vfp_muls)(x, y, fpstp),
+           neon_host_mul(x, y, &r))
+NEON_F32_Q(neon_mla_f32, HELPER(vfp_adds)(HELPER(vfp_muls)(x, y, fpstp), a, fpstp),
+           neon_host_mul(x, y, &r) && neon_host_add(r, a, &r))
+NEON_F32_Q(neon_mls_f32, HELPER(vfp_subs)(a, HELPER(vfp_muls)(x, y, fpstp), fpstp),
+           neon_host_mul(x, y, &r) && neon_host_add(a, NEON_HOST_NEG(r), &r))
+#undef NEON_F32_Q
+#undef NEON_F32_Q_HOST
 
 float32 VFP_HELPER(neg, s)(float32 a)
 {
@@ -4971,11 +5217,24 @@ float64 VFP_HELPER(abs, d)(float64 a)
 
 float32 VFP_HELPER(sqrt, s)(float32 a, CPUARMState *env)
 {
+#ifdef VFP_HOST_FPU
+    /* positive normal numbers have normal roots */
+    if (vfp_host_fpu(&env->vfp.fp_status) && float32_is_normal(a) &&
+        !float32_is_neg(a)) {
+        return float32_from_host(sqrtf(float32_to_host(a)));
+    }
+#endif
     return float32_sqrt(a, &env->vfp.fp_status);
 }
 
 float64 VFP_HELPER(sqrt, d)(float64 a, CPUARMState *env)
 {
+#ifdef VFP_HOST_FPU
+    if (vfp_host_fpu(&env->vfp.fp_status) && float64_is_normal(a) &&
+        !float64_is_neg(a)) {
+        return float64_from_host(sqrt(float64_to_host(a)));
+    }
+#endif
     return float64_sqrt(a, &env->vfp.fp_status);
 }
 
@@ -5681,12 +5940,33 @@ uint32_t HELPER(rsqrte_u32)(uint32_t a, void *fpstp)
 float32 VFP_HELPER(muladd, s)(float32 a, float32 b, float32 c, void *fpstp)
 {
     float_status *fpst = fpstp;
+#ifdef VFP_HOST_FPU
+    /* rounded once too: a normal result cannot have under or overflowed */
+    if (vfp_host_fpu(fpst) && VFP_HOST_OPERAND(32, a) &&
+        VFP_HOST_OPERAND(32, b) && VFP_HOST_OPERAND(32, c)) {
+        float32 r = float32_from_host(fmaf(float32_to_host(a), float32_to_host(b),
+                                           float32_to_host(c)));
+        if (float32_host_result(r)) {
+            return r;
+        }
+    }
+#endif
     return float32_muladd(a, b, c, 0, fpst);
 }
 
 float64 VFP_HELPER(muladd, d)(float64 a, float64 b, float64 c, void *fpstp)
 {
     float_status *fpst = fpstp;
+#ifdef VFP_HOST_FPU
+    if (vfp_host_fpu(fpst) && VFP_HOST_OPERAND(64, a) &&
+        VFP_HOST_OPERAND(64, b) && VFP_HOST_OPERAND(64, c)) {
+        float64 r = float64_from_host(fma(float64_to_host(a), float64_to_host(b),
+                                          float64_to_host(c)));
+        if (float64_host_result(r)) {
+            return r;
+        }
+    }
+#endif
     return float64_muladd(a, b, c, 0, fpst);
 }
 
@@ -368,6 +368,15 @@ void hw_breakpoint_update_all(ARMCPU *cpu);
 /* Callback function for when a watchpoint or breakpoint triggers. */
 void arm_debug_excp_handler(CPUState *cs);
 
+#ifndef CONFIG_USER_ONLY
+/* Store-exclusive of @count elements of 1 << @size bytes, for STREX & STXR.
+ * Returns 0 on success, 1 if the exclusive monitor was lost.
+ */
+uint32_t arm_store_exclusive(CPUARMState *env, target_ulong addr, int size, int count,
+                             const uint64_t *old, const uint64_t *vals,
+                             int mmu_idx, uintptr_t ra);
+#endif
+
 #ifdef CONFIG_USER_ONLY
 static inline bool arm_is_psci_call(ARMCPU *cpu, int excp_type)
 {
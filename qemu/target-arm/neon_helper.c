@@ -13,6 +13,11 @@
 #include "exec/exec-all.h"
 #include "exec/helper-proto.h"
 
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define NEON_SSE2
+#endif
+
 #define SIGNBIT (uint32_t)0x80000000
 #define SIGNBIT64 ((uint64_t)1 << 63)
 
@@ -2028,6 +2033,23 @@ uint64_t HELPER(neon_acgt_f64)(uint64_t a, uint64_t b, void *fpstp)
 
 #define ELEM(V, N, SIZE) (((V) >> ((N) * (SIZE))) & ((1ull << (SIZE)) - 1))
 
+#ifdef NEON_SSE2
+/* A Q register is two adjacent D registers, lowest element first.  */
+#define NEON_Q_REG(env, r) ((__m128i *)&(env)->vfp.regs[r])
+
+void HELPER(neon_qunzip8)(CPUARMState *env, uint32_t rd, uint32_t rm)
+{
+    __m128i d = _mm_loadu_si128(NEON_Q_REG(env, rd));
+    __m128i m = _mm_loadu_si128(NEON_Q_REG(env, rm));
+
+    __m128i even = _mm_set1_epi16(0xff);
+
+    _mm_storeu_si128(NEON_Q_REG(env, rd),
+                     _mm_packus_epi16(_mm_and_si128(d, even), _mm_and_si128(m, even)));
+    _mm_storeu_si128(NEON_Q_REG(env, rm),
+                     _mm_packus_epi16(_mm_srli_epi16(d, 8), _mm_srli_epi16(m, 8)));
+}
+#else
 void HELPER(neon_qunzip8)(CPUARMState *env, uint32_t rd, uint32_t rm)
 {
     uint64_t zm0 = float64_val(env->vfp.regs[rm]);
@@ -2055,7 +2077,22 @@ void HELPER(neon_qunzip8)(CPUARMState *env, uint32_t rd, uint32_t rm)
     env->vfp.regs[rd] = make_float64(d0);
     env->vfp.regs[rd + 1] = make_float64(d1);
 }
+#endif
+
+#ifdef NEON_SSE2
+void HELPER(neon_qunzip16)(CPUARMState *env, uint32_t rd, uint32_t rm)
+{
+    __m128i d = _mm_loadu_si128(NEON_Q_REG(env, rd));
+    __m128i m = _mm_loadu_si128(NEON_Q_REG(env, rm));
 
+    /* sign extended halves, so that packing does not saturate */
+    _mm_storeu_si128(NEON_Q_REG(env, rd),
+                     _mm_packs_epi32(_mm_srai_epi32(_mm_slli_epi32(d, 16), 16),
+                                     _mm_srai_epi32(_mm_slli_epi32(m, 16), 16)));
+    _mm_storeu_si128(NEON_Q_REG(env, rm),
+                     _mm_packs_epi32(_mm_srai_epi32(d, 16), _mm_srai_epi32(m, 16)));
+}
+#else
 void HELPER(neon_qunzip16)(CPUARMState *env, uint32_t rd, uint32_t rm)
 {
     uint64_t zm0 = float64_val(env->vfp.regs[rm]);
@@ -2075,7 +2112,21 @@ void HELPER(neon_qunzip16)(CPUARMState *env, uint32_t rd, uint32_t rm)
     env->vfp.regs[rd] = make_float64(d0);
     env->vfp.regs[rd + 1] = make_float64(d1);
 }
+#endif
+
+#ifdef NEON_SSE2
+void HELPER(neon_qunzip32)(CPUARMState *env, uint32_t rd, uint32_t rm)
+{
+    __m128i d = _mm_loadu_si128(NEON_Q_REG(env, rd));
+    __m128i m = _mm_loadu_si128(NEON_Q_REG(env, rm));
 
+    /* even words first in each register */
+    d = _mm_shuffle_epi32(d, _MM_SHUFFLE(3, 1, 2, 0));
+    m = _mm_shuffle_epi32(m, _MM_SHUFFLE(3, 1, 2, 0));
+    _mm_storeu_si128(NEON_Q_REG(env, rd), _mm_unpacklo_epi64(d, m));
+    _mm_storeu_si128(NEON_Q_REG(env, rm), _mm_unpackhi_epi64(d, m));
+}
+#else
 void HELPER(neon_qunzip32)(CPUARMState *env, uint32_t rd, uint32_t rm)
 {
     uint64_t zm0 = float64_val(env->vfp.regs[rm]);
@@ -2091,6 +2142,7 @@ void HELPER(neon_qunzip32)(CPUARMState *env, uint32_t rd, uint32_t rm)
     env->vfp.regs[rd] = make_float64(d0);
     env->vfp.regs[rd + 1] = make_float64(d1);
 }
+#endif
 
 void HELPER(neon_unzip8)(CPUARMState *env, uint32_t rd, uint32_t rm)
 {
@@ -2120,6 +2172,16 @@ void HELPER(neon_unzip16)(CPUARMState *env, uint32_t rd, uint32_t rm)
     env->vfp.regs[rd] = make_float64(d0);
 }
 
+#ifdef NEON_SSE2
+void HELPER(neon_qzip8)(CPUARMState *env, uint32_t rd, uint32_t rm)
+{
+    __m128i d = _mm_loadu_si128(NEON_Q_REG(env, rd));
+    __m128i m = _mm_loadu_si128(NEON_Q_REG(env, rm));
+
+    _mm_storeu_si128(NEON_Q_REG(env, rd), _mm_unpacklo_epi8(d, m));
+    _mm_storeu_si128(NEON_Q_REG(env, rm), _mm_unpackhi_epi8(d, m));
+}
+#else
 void HELPER(neon_qzip8)(CPUARMState *env, uint32_t rd, uint32_t rm)
 {
     uint64_t zm0 = float64_val(env->vfp.regs[rm]);
@@ -2147,7 +2209,18 @@ void HELPER(neon_qzip8)(CPUARMState *env, uint32_t rd, uint32_t rm)
     env->vfp.regs[rd] = make_float64(d0);
     env->vfp.regs[rd + 1] = make_float64(d1);
 }
+#endif
+
+#ifdef NEON_SSE2
+void HELPER(neon_qzip16)(CPUARMState *env, uint32_t rd, uint32_t rm)
+{
+    __m128i d = _mm_loadu_si128(NEON_Q_REG(env, rd));
+    __m128i m = _mm_loadu_si128(NEON_Q_REG(env, rm));
 
+    _mm_storeu_si128(NEON_Q_REG(env, rd), _mm_unpacklo_epi16(d, m));
+    _mm_storeu_si128(NEON_Q_REG(env, rm), _mm_unpackhi_epi16(d, m));
+}
+#else
 void HELPER(neon_qzip16)(CPUARMState *env, uint32_t rd, uint32_t rm)
 {
     uint64_t zm0 = float64_val(env->vfp.regs[rm]);
@@ -2167,7 +2240,18 @@ void HELPER(neon_qzip16)(CPUARMState *env, uint32_t rd, uint32_t rm)
     env->vfp.regs[rd] = make_float64(d0);
     env->vfp.regs[rd + 1] = make_float64(d1);
 }
+#endif
 
+#ifdef NEON_SSE2
+void HELPER(neon_qzip32)(CPUARMState *env, uint32_t rd, uint32_t rm)
+{
+    __m128i d = _mm_loadu_si128(NEON_Q_REG(env, rd));
+    __m128i m = _mm_loadu_si128(NEON_Q_REG(env, rm));
+
+    _mm_storeu_si128(NEON_Q_REG(env, rd), _mm_unpacklo_epi32(d, m));
+    _mm_storeu_si128(NEON_Q_REG(env, rm), _mm_unpackhi_epi32(d, m));
+}
+#else
 void HELPER(neon_qzip32)(CPUARMState *env, uint32_t rd, uint32_t rm)
 {
     uint64_t zm0 = float64_val(env->vfp.regs[rm]);
@@ -2183,6 +2267,7 @@ void HELPER(neon_qzip32)(CPUARMState *env, uint32_t rd, uint32_t rm)
     env->vfp.regs[rd] = make_float64(d0);
     env->vfp.regs[rd + 1] = make_float64(d1);
 }
+#endif
 
 void HELPER(neon_zip8)(CPUARMState *env, uint32_t rd, uint32_t rm)
 {
@@ -2241,3 +2326,207 @@ uint64_t HELPER(neon_pmull_64_hi)(uint64_t op1, uint64_t op2)
     }
     return res;
 }
+
+/* Whole Q register operations.  The translator calls these once per
+ * instruction instead of once per 32-bit pass, with pointers to the
+ * destination and the two operand registers; elementwise operations do
+ * not depend on the host byte order.  Each is one SSE2 operation (or a
+ * few) when the host has it, and a loop over the elements otherwise.
+ * x and y are the operand elements, a the destination one.
+ */
+#ifdef NEON_SSE2
+#define NEON_Q_OP(name, type, expr, sse2) \
+void HELPER(glue(name, _q))(void *vd, void *vn, void *vm) \
+{ \
+    __m128i a = _mm_loadu_si128(vd); \
+    __m128i x = _mm_loadu_si128(vn); \
+    __m128i y = _mm_loadu_si128(vm); \
+    (void)a; \
+    _mm_storeu_si128(vd, sse2); \
+}
+
+/* QC is set when the saturated result differs from the wrapped one.  */
+#define NEON_Q_SAT(name, type, wtype, op, min, max, sse2, sse2_wrap) \
+void HELPER(glue(name, _q))(CPUARMState *env, void *vd, void *vn, void *vm) \
+{ \
+    __m128i x = _mm_loadu_si128(vn); \
+    __m128i y = _mm_loadu_si128(vm); \
+    __m128i r = sse2; \
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(r, sse2_wrap)) != 0xffff) { \
+        SET_QC(); \
+    } \
+    _mm_storeu_si128(vd, r); \
+}
+
+#define NEON_SSE2_ONES _mm_set1_epi32(-1)
+#define NEON_SSE2_SIGN8 _mm_set1_epi8(-0x80)
+#define NEON_SSE2_SIGN16 _mm_set1_epi16(-0x8000)
+#define NEON_SSE2_SIGN32 _mm_set1_epi32(INT32_MIN)
+/* Unsigned elements are biased to compare as signed ones.  */
+#define NEON_SSE2_BIAS_s(n, x) (x)
+#define NEON_SSE2_BIAS_u(n, x) _mm_xor_si128(x, NEON_SSE2_SIGN##n)
+#define NEON_SSE2_GT(t, n, x, y) \
+    _mm_cmpgt_epi##n(NEON_SSE2_BIAS_##t(n, x), NEON_SSE2_BIAS_##t(n, y))
+#define NEON_SSE2_GE(t, n, x, y) \
+    _mm_andnot_si128(NEON_SSE2_GT(t, n, y, x), NEON_SSE2_ONES)
+#define NEON_SSE2_SELECT(mask, x, y) \
+    _mm_or_si128(_mm_and_si128(mask, x), _mm_andnot_si128(mask, y))
+#define NEON_SSE2_MAX(t, n, x, y) NEON_SSE2_SELECT(NEON_SSE2_GT(t, n, x, y), x, y)
+#define NEON_SSE2_MIN(t, n, x, y) NEON_SSE2_SELECT(NEON_SSE2_GT(t, n, x, y), y, x)
+#define NEON_SSE2_ABD(t, n, x, y) \
+    _mm_sub_epi##n(NEON_SSE2_MAX(t, n, x, y), NEON_SSE2_MIN(t, n, x, y))
+#define NEON_SSE2_TST(n, x, y) \
+    _mm_andnot_si128(_mm_cmpeq_epi##n(_mm_and_si128(x, y), _mm_setzero_si128()), \
+                     NEON_SSE2_ONES)
+
+/* The rounding average of 8 and 16 bits elements is one instruction, and
+ * the truncating one differs from it by the low bit of x ^ y.  32 bits
+ * ones are (x | y) - ((x ^ y) >> 1) and (x & y) + ((x ^ y) >> 1).
+ */
+#define NEON_SSE2_RHADD_u(n, x, y) _mm_avg_epu##n(x, y)
+#define NEON_SSE2_RHADD_s(n, x, y) \
+    _mm_xor_si128(_mm_avg_epu##n(_mm_xor_si128(x, NEON_SSE2_SIGN##n), \
+                                 _mm_xor_si128(y, NEON_SSE2_SIGN##n)), \
+                  NEON_SSE2_SIGN##n)
+#define NEON_SSE2_HADD(t, n, x, y) \
+    _mm_sub_epi##n(NEON_SSE2_RHADD_##t(n, x, y), \
+                   _mm_and_si128(_mm_xor_si128(x, y), _mm_set1_epi##n(1)))
+#define NEON_SSE2_HALF_s(x) _mm_srai_epi32(x, 1)
+#define NEON_SSE2_HALF_u(x) _mm_srli_epi32(x, 1)
+#define NEON_SSE2_RHADD32(t, x, y) \
+    _mm_sub_epi32(_mm_or_si128(x, y), NEON_SSE2_HALF_##t(_mm_xor_si128(x, y)))
+#define NEON_SSE2_HADD32(t, x, y) \
+    _mm_add_epi32(_mm_and_si128(x, y), NEON_SSE2_HALF_##t(_mm_xor_si128(x, y)))
+
+/* There is no 8 bits multiply: the low bytes of the 16 bits products of
+ * the even and of the odd bytes.
+ */
+static inline __m128i neon_sse2_mul8(__m128i x, __m128i y)
+{
+    __m128i even = _mm_mullo_epi16(x, y);
+    __m128i odd = _mm_mullo_epi16(_mm_srli_epi16(x, 8), _mm_srli_epi16(y, 8));
+
+    return _mm_or_si128(_mm_and_si128(even, _mm_set1_epi16(0xff)),
+                        _mm_slli_epi16(odd, 8));
+}
+#else
+#define NEON_Q_OP(name, type, expr, sse2) \
+void HELPER(glue(name, _q))(void *vd, void *vn, void *vm) \
+{ \
+    type *d = vd, *n = vn, *m = vm; \
+    int i; \
+    for (i = 0; i < 16 / sizeof(type); i++) { \
+        type a = d[i], x = n[i], y = m[i]; \
+        (void)a; \
+        d[i] = expr; \
+    } \
+}
+
+#define NEON_Q_SAT(name, type, wtype, op, min, max, sse2, sse2_wrap) \
+    NEON_Q_SAT_LOOP(name, type, wtype, op, min, max)
+#endif
+
+#define NEON_Q_SAT_LOOP(name, type, wtype, op, min, max) \
+void HELPER(glue(name, _q))(CPUARMState *env, void *vd, void *vn, void *vm) \
+{ \
+    type *d = vd, *n = vn, *m = vm; \
+    int i; \
+    for (i = 0; i < 16 / sizeof(type); i++) { \
+        wtype r = (wtype)n[i] op m[i]; \
+        if (r > max) { \
+            r = max; \
+            SET_QC(); \
+        } else if (r < min) { \
+            r = min; \
+            SET_QC(); \
+        } \
+        d[i] = r; \
+    } \
+}
+
+/* Signed & unsigned variants of an op on elements of n bits */
+#define NEON_Q_SU(name, n, expr, sse2_s, sse2_u) \
+    NEON_Q_OP(name##_s##n, int##n##_t, expr, sse2_s) \
+    NEON_Q_OP(name##_u##n, uint##n##_t, expr, sse2_u)
+
+NEON_Q_OP(neon_add_u8, uint8_t, x + y, _mm_add_epi8(x, y))
+NEON_Q_OP(neon_add_u16, uint16_t, x + y, _mm_add_epi16(x, y))
+NEON_Q_OP(neon_sub_u8, uint8_t, x - y, _mm_sub_epi8(x, y))
+NEON_Q_OP(neon_sub_u16, uint16_t, x - y, _mm_sub_epi16(x, y))
+NEON_Q_OP(neon_mul_u8, uint8_t, x * y, neon_sse2_mul8(x, y))
+NEON_Q_OP(neon_mul_u16, uint16_t, x * y, _mm_mullo_epi16(x, y))
+NEON_Q_OP(neon_mla_u8, uint8_t, a + x * y, _mm_add_epi8(a, neon_sse2_mul8(x, y)))
+NEON_Q_OP(neon_mla_u16, uint16_t, a + x * y, _mm_add_epi16(a, _mm_mullo_epi16(x, y)))
+NEON_Q_OP(neon_mls_u8, uint8_t, a - x * y, _mm_sub_epi8(a, neon_sse2_mul8(x, y)))
+NEON_Q_OP(neon_mls_u16, uint16_t, a - x * y, _mm_sub_epi16(a, _mm_mullo_epi16(x, y)))
+
+NEON_Q_OP(neon_ceq_u8, uint8_t, -(x == y), _mm_cmpeq_epi8(x, y))
+NEON_Q_OP(neon_ceq_u16, uint16_t, -(x == y), _mm_cmpeq_epi16(x, y))
+NEON_Q_OP(neon_ceq_u32, uint32_t, -(x == y), _mm_cmpeq_epi32(x, y))
+NEON_Q_OP(neon_tst_u8, uint8_t, -((x & y) != 0), NEON_SSE2_TST(8, x, y))
+NEON_Q_OP(neon_tst_u16, uint16_t, -((x & y) != 0), NEON_SSE2_TST(16, x, y))
+NEON_Q_OP(neon_tst_u32, uint32_t, -((x & y) != 0), NEON_SSE2_TST(32, x, y))
+
+NEON_Q_SU(neon_cgt, 8, -(x > y), NEON_SSE2_GT(s, 8, x, y), NEON_SSE2_GT(u, 8, x, y))
+NEON_Q_SU(neon_cgt, 16, -(x > y), NEON_SSE2_GT(s, 16, x, y), NEON_SSE2_GT(u, 16, x, y))
+NEON_Q_SU(neon_cgt, 32, -(x > y), NEON_SSE2_GT(s, 32, x, y), NEON_SSE2_GT(u, 32, x, y))
+NEON_Q_SU(neon_cge, 8, -(x >= y), NEON_SSE2_GE(s, 8, x, y), NEON_SSE2_GE(u, 8, x, y))
+NEON_Q_SU(neon_cge, 16, -(x >= y), NEON_SSE2_GE(s, 16, x, y), NEON_SSE2_GE(u, 16, x, y))
+NEON_Q_SU(neon_cge, 32, -(x >= y), NEON_SSE2_GE(s, 32, x, y), NEON_SSE2_GE(u, 32, x, y))
+
+NEON_Q_SU(neon_max, 8, x > y ? x : y, NEON_SSE2_MAX(s, 8, x, y), NEON_SSE2_MAX(u, 8, x, y))
+NEON_Q_SU(neon_max, 16, x > y ? x : y, NEON_SSE2_MAX(s, 16, x, y), NEON_SSE2_MAX(u, 16, x, y))
+NEON_Q_SU(neon_max, 32, x > y ? x : y, NEON_SSE2_MAX(s, 32, x, y), NEON_SSE2_MAX(u, 32, x, y))
+NEON_Q_SU(neon_min, 8, x < y ? x : y, NEON_SSE2_MIN(s, 8, x, y), NEON_SSE2_MIN(u, 8, x, y))
+NEON_Q_SU(neon_min, 16, x < y ? x : y, NEON_SSE2_MIN(s, 16, x, y), NEON_SSE2_MIN(u, 16, x, y))
+NEON_Q_SU(neon_min, 32, x < y ? x : y, NEON_SSE2_MIN(s, 32, x, y), NEON_SSE2_MIN(u, 32, x, y))
+NEON_Q_SU(neon_abd, 8, x > y ? x - y : y - x,
+          NEON_SSE2_ABD(s, 8, x, y), NEON_SSE2_ABD(u, 8, x, y))
+NEON_Q_SU(neon_abd, 16, x > y ? x - y : y - x,
+          NEON_SSE2_ABD(s, 16, x, y), NEON_SSE2_ABD(u, 16, x, y))
+NEON_Q_SU(neon_abd, 32, x > y ? x - y : y - x,
+          NEON_SSE2_ABD(s, 32, x, y), NEON_SSE2_ABD(u, 32, x, y))
+NEON_Q_SU(neon_aba, 8, a + (x > y ? x - y : y - x),
+          _mm_add_epi8(a, NEON_SSE2_ABD(s, 8, x, y)),
+          _mm_add_epi8(a, NEON_SSE2_ABD(u, 8, x, y)))
+NEON_Q_SU(neon_aba, 16, a + (x > y ? x - y : y - x),
+          _mm_add_epi16(a, NEON_SSE2_ABD(s, 16, x, y)),
+          _mm_add_epi16(a, NEON_SSE2_ABD(u, 16, x, y)))
+NEON_Q_SU(neon_aba, 32, a + (x > y ? x - y : y - x),
+          _mm_add_epi32(a, NEON_SSE2_ABD(s, 32, x, y)),
+          _mm_add_epi32(a, NEON_SSE2_ABD(u, 32, x, y)))
+
+NEON_Q_SU(neon_hadd, 8, ((int64_t)x + y) >> 1,
+          NEON_SSE2_HADD(s, 8, x, y), NEON_SSE2_HADD(u, 8, x, y))
+NEON_Q_SU(neon_hadd, 16, ((int64_t)x + y) >> 1,
+          NEON_SSE2_HADD(s, 16, x, y), NEON_SSE2_HADD(u, 16, x, y))
+NEON_Q_SU(neon_hadd, 32, ((int64_t)x + y) >> 1,
+          NEON_SSE2_HADD32(s, x, y), NEON_SSE2_HADD32(u, x, y))
+NEON_Q_SU(neon_rhadd, 8, ((int64_t)x + y + 1) >> 1,
+          NEON_SSE2_RHADD_s(8, x, y), NEON_SSE2_RHADD_u(8, x, y))
+NEON_Q_SU(neon_rhadd, 16, ((int64_t)x + y + 1) >> 1,
+          NEON_SSE2_RHADD_s(16, x, y), NEON_SSE2_RHADD_u(16, x, y))
+NEON_Q_SU(neon_rhadd, 32, ((int64_t)x + y + 1) >> 1,
+          NEON_SSE2_RHADD32(s, x, y), NEON_SSE2_RHADD32(u, x, y))
+
+NEON_Q_SAT(neon_qadd_s8, int8_t, int, +, INT8_MIN, INT8_MAX,
+           _mm_adds_epi8(x, y), _mm_add_epi8(x, y))
+NEON_Q_SAT(neon_qadd_u8, uint8_t, int, +, 0, UINT8_MAX,
+           _mm_adds_epu8(x, y), _mm_add_epi8(x, y))
+NEON_Q_SAT(neon_qadd_s16, int16_t, int, +, INT16_MIN, INT16_MAX,
+           _mm_adds_epi16(x, y), _mm_add_epi16(x, y))
+NEON_Q_SAT(neon_qadd_u16, uint16_t, int, +, 0, UINT16_MAX,
+           _mm_adds_epu16(x, y), _mm_add_epi16(x, y))
+NEON_Q_SAT(neon_qsub_s8, int8_t, int, -, INT8_MIN, INT8_MAX,
+           _mm_subs_epi8(x, y), _mm_sub_epi8(x, y))
+NEON_Q_SAT(neon_qsub_u8, uint8_t, int, -, 0, UINT8_MAX,
+           _mm_subs_epu8(x, y), _mm_sub_epi8(x, y))
+NEON_Q_SAT(neon_qsub_s16, int16_t, int, -, INT16_MIN, INT16_MAX,
+           _mm_subs_epi16(x, y), _mm_sub_epi16(x, y))
+NEON_Q_SAT(neon_qsub_u16, uint16_t, int, -, 0, UINT16_MAX,
+           _mm_subs_epu16(x, y), _mm_sub_epi16(x, y))
+/* SSE2 has no saturating 32 bits arithmetic */
+NEON_Q_SAT_LOOP(neon_qadd_s32, int32_t, int64_t, +, INT32_MIN, INT32_MAX)
+NEON_Q_SAT_LOOP(neon_qadd_u32, uint32_t, int64_t, +, 0, UINT32_MAX)
+NEON_Q_SAT_LOOP(neon_qsub_s32, int32_t, int64_t, -, INT32_MIN, INT32_MAX)
+NEON_Q_SAT_LOOP(neon_qsub_u32, uint32_t, int64_t, -, 0, UINT32_MAX)
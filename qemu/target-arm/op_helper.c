@@ -20,6 +20,9 @@
 #include "exec/helper-proto.h"
 #include "internals.h"
 #include "exec/cpu_ldst.h"
+#include "qemu/atomic.h"
+
+#include "uc_priv.h"
 
 #define SIGNBIT (uint32_t)0x80000000
 #define SIGNBIT64 ((uint64_t)1 << 63)
@@ -33,23 +36,23 @@ static void raise_exception(CPUARMState *env, int tt)
     cpu_loop_exit(cs);
 }
 
-uint32_t HELPER(neon_tbl)(CPUARMState *env, uint32_t ireg, uint32_t def,
+uint64_t HELPER(neon_tbl)(CPUARMState *env, uint64_t ireg, uint64_t def,
                           uint32_t rn, uint32_t maxindex)
 {
-    uint32_t val;
-    uint32_t tmp;
+    uint64_t val;
+    uint64_t tmp;
     int index;
     int shift;
     uint64_t *table;
     table = (uint64_t *)&env->vfp.regs[rn];
     val = 0;
-    for (shift = 0; shift < 32; shift += 8) {
+    for (shift = 0; shift < 64; shift += 8) {
         index = (ireg >> shift) & 0xff;
         if (index < maxindex) {
             tmp = (table[index >> 3] >> ((index & 7) << 3)) & 0xff;
             val |= tmp << shift;
         } else {
-            val |= def & (0xffU << shift);
+            val |= def & (0xffULL << shift);
         }
     }
     return val;
@@ -78,6 +81,350 @@ void tlb_fill(CPUState *cs, target_ulong addr, int is_write, int mmu_idx,
         raise_exception(env, cs->exception_index);
     }
 }
+
+/* Compare-and-swap @bytes of host RAM, @old & @val being memory images */
+static bool cmpxchg_host(void *host, int bytes, uint64_t old, uint64_t val)
+{
+    switch (bytes) {
+#ifdef _MSC_VER
+    case 1:
+        return _InterlockedCompareExchange8(host, (char)val, (char)old) == (char)old;
+    case 2:
+        return _InterlockedCompareExchange16(host, (short)val, (short)old) == (short)old;
+    case 4:
+        return _InterlockedCompareExchange(host, (long)val, (long)old) == (long)old;
+    default:
+        return _InterlockedCompareExchange64(host, (__int64)val, (__int64)old) == (__int64)old;
+#else
+    case 1:
+        return atomic_cmpxchg((uint8_t *)host, (uint8_t)old, (uint8_t)val) == (uint8_t)old;
+    case 2:
+        return atomic_cmpxchg((uint16_t *)host, (uint16_t)old, (uint16_t)val) == (uint16_t)old;
+    case 4:
+        return atomic_cmpxchg((uint32_t *)host, (uint32_t)old, (uint32_t)val) == (uint32_t)old;
+    default:
+        return atomic_cmpxchg((uint64_t *)host, old, val) == old;
+#endif
+    }
+}
+
+/* The same for 16 bytes, @old & @val being the memory images of the two
+ * halves. Without a host 16 bytes compare-and-swap, or RAM aligned for it,
+ * a lock striped by host address covers just these host accesses.
+ */
+static bool cmpxchg16_host(void *host, const uint64_t *old, const uint64_t *val)
+{
+    bool ok;
+
+#if defined(_MSC_VER) && defined(_M_X64)
+    if (!((uintptr_t)host & 15)) {
+        __int64 cmp[2] = { (__int64)old[0], (__int64)old[1] };
+
+        return _InterlockedCompareExchange128(host, (__int64)val[1], (__int64)val[0], cmp);
+    }
+#elif defined(__x86_64__)
+    if (!((uintptr_t)host & 15)) {
+        uint64_t lo = old[0], hi = old[1];
+        uint8_t eq;
+
+        __asm__ __volatile__("lock cmpxchg16b %1\n\tsete %0"
+                             : "=q"(eq), "+m"(*(uint64_t (*)[2])host), "+a"(lo), "+d"(hi)
+                             : "b"(val[0]), "c"(val[1])
+                             : "memory", "cc");
+        return eq;
+    }
+#endif
+
+    uc_exclusive_start(host);
+    ok = memcmp(host, old, 16) == 0;
+    if (ok) {
+        memcpy(host, val, 16);
+    }
+    uc_exclusive_end(host);
+    return ok;
+}
+
+/* An element of 1 << @size bytes in guest byte order at host address @p */
+static uint64_t ld_elem_p(const void *p, int size)
+{
+    switch (size) {
+    case 0:
+        return ldub_p(p);
+    case 1:
+        return lduw_p(p);
+    case 2:
+        return (uint32_t)ldl_p(p);
+    default:
+        return ldq_p(p);
+    }
+}
+
+static void st_elem_p(void *p, uint64_t val, int size)
+{
+    switch (size) {
+    case 0:
+        stb_p(p, val);
+        break;
+    case 1:
+        stw_p(p, val);
+        break;
+    case 2:
+        stl_p(p, val);
+        break;
+    default:
+        stq_p(p, val);
+        break;
+    }
+}
+
+/* The D register value of the 8 bytes at @p, elements of 1 << @size bytes
+ * being in lane order, and the reverse.
+ */
+static uint64_t ld_dreg_p(const uint8_t *p, int size)
+{
+    uint64_t val = 0;
+    int n;
+
+#ifndef TARGET_WORDS_BIGENDIAN
+    /* the same bytes whatever the element size */
+    size = 3;
+#endif
+    if (size == 3) {
+        return ldq_p(p);
+    }
+    for (n = 0; n < 8; n += 1 << size) {
+        val |= ld_elem_p(p + n, size) << (n * 8);
+    }
+    return val;
+}
+
+static void st_dreg_p(uint8_t *p, uint64_t val, int size)
+{
+    int n;
+
+#ifndef TARGET_WORDS_BIGENDIAN
+    size = 3;
+#endif
+    if (size == 3) {
+        stq_p(p, val);
+        return;
+    }
+    for (n = 0; n < 8; n += 1 << size) {
+        st_elem_p(p + n, val >> (n * 8), size);
+    }
+}
+
+/* Guest memory image of @count elements of 1 << @size bytes */
+static uint64_t mem_image(const uint64_t *vals, int size, int count)
+{
+    union {
+        uint8_t b[8];
+        uint8_t u8;
+        uint16_t u16;
+        uint32_t u32;
+        uint64_t u64;
+    } u;
+    int i;
+
+    for (i = 0; i < count; i++) {
+        st_elem_p(u.b + (i << size), vals[i], size);
+    }
+
+    switch (count << size) {
+    case 1:
+        return u.u8;
+    case 2:
+        return u.u16;
+    case 4:
+        return u.u32;
+    default:
+        return u.u64;
+    }
+}
+
+/* One element access of 1 << @size bytes through the softmmu helpers */
+static uint64_t softmmu_load(CPUARMState *env, target_ulong addr, int size,
+                             int mmu_idx, uintptr_t ra)
+{
+    switch (size) {
+    case 0:
+        return helper_ret_ldub_mmu(env, addr, mmu_idx, ra);
+    case 1:
+        return helper_ret_lduw_mmu(env, addr, mmu_idx, ra);
+    case 2:
+        return helper_ret_ldul_mmu(env, addr, mmu_idx, ra);
+    default:
+        return helper_ret_ldq_mmu(env, addr, mmu_idx, ra);
+    }
+}
+
+static void softmmu_store(CPUARMState *env, target_ulong addr, uint64_t val,
+                          int size, int mmu_idx, uintptr_t ra)
+{
+    switch (size) {
+    case 0:
+        helper_ret_stb_mmu(env, addr, val, mmu_idx, ra);
+        break;
+    case 1:
+        helper_ret_stw_mmu(env, addr, val, mmu_idx, ra);
+        break;
+    case 2:
+        helper_ret_stl_mmu(env, addr, val, mmu_idx, ra);
+        break;
+    default:
+        helper_ret_stq_mmu(env, addr, val, mmu_idx, ra);
+        break;
+    }
+}
+
+/* Store-exclusive of @count (1 or 2) elements of 1 << @size bytes.
+ * If the monitor still holds @addr and memory still has the values the
+ * load-exclusive saw (@old), store @vals and return 0, else return 1.
+ * On RAM, clean pages and pages with translated code included, the compare
+ * & store is a single host compare-and-swap, so it is atomic towards
+ * engines sharing that RAM from other host threads. The rest (I/O, memory
+ * hooks or protections, unaligned) goes through the softmmu helpers, which
+ * run user callbacks, so without any lock and not atomically. An access
+ * failing there stops the emulation, and the store-exclusive fails.
+ */
+uint32_t arm_store_exclusive(CPUARMState *env, target_ulong addr, int size, int count,
+                             const uint64_t *old, const uint64_t *vals,
+                             int mmu_idx, uintptr_t ra)
+{
+    CPUState *cs = ENV_GET_CPU(env);
+    int bytes = count << size;
+    void *host = NULL;
+    uint32_t failed = 1;
+    uint64_t val;
+    int i;
+
+    if (env->exclusive_addr != addr) {
+        goto done;
+    }
+
+    if (!(addr & (bytes - 1))) {
+        host = tlb_vaddr_to_host_rmw(env, addr, bytes, mmu_idx, ra);
+    }
+
+    if (host) {
+        if (bytes <= 8) {
+            failed = !cmpxchg_host(host, bytes, mem_image(old, size, count),
+                                   mem_image(vals, size, count));
+        } else {
+            uint64_t old_image[2] = { mem_image(old, size, 1), mem_image(old + 1, size, 1) };
+            uint64_t new_image[2] = { mem_image(vals, size, 1), mem_image(vals + 1, size, 1) };
+
+            failed = !cmpxchg16_host(host, old_image, new_image);
+        }
+        goto done;
+    }
+
+    /* guest MMU faults longjmp, so take them before any access is made */
+    tlb_fill(cs, addr, 1, mmu_idx, ra);
+    if ((addr ^ (addr + bytes - 1)) & TARGET_PAGE_MASK) {
+        tlb_fill(cs, addr + bytes - 1, 1, mmu_idx, ra);
+    }
+
+    for (i = 0; i < count; i++) {
+        val = softmmu_load(env, addr + (i << size), size, mmu_idx, ra);
+        if (env->invalid_error != UC_ERR_OK || val != old[i]) {
+            goto done;
+        }
+    }
+    for (i = 0; i < count; i++) {
+        softmmu_store(env, addr + (i << size), vals[i], size, mmu_idx, ra);
+        if (env->invalid_error != UC_ERR_OK) {
+            goto done;
+        }
+    }
+    failed = 0;
+
+done:
+    env->exclusive_addr = -1;
+    return failed;
+}
+
+uint32_t HELPER(strex)(CPUARMState *env, uint32_t addr, uint32_t val, uint32_t val2,
+                       uint32_t desc)
+{
+    int size = desc & 3;
+    int mmu_idx = desc >> 2;
+    uint64_t old[2], vals[2] = { val, val2 };
+
+    if (size == 3) {
+        /* STREXD: two words, the monitor holds them as one 64 bits value */
+        old[0] = (uint32_t)env->exclusive_val;
+        old[1] = env->exclusive_val >> 32;
+        return arm_store_exclusive(env, addr, 2, 2, old, vals, mmu_idx, GETPC());
+    }
+
+    old[0] = env->exclusive_val;
+    return arm_store_exclusive(env, addr, size, 1, old, vals, mmu_idx, GETPC());
+}
+
+/* VLD1 & VST1 (multiple single elements) of @nregs D registers from @rd,
+ * with elements of 1 << @size bytes.  When they are all on one RAM page
+ * the TLB has, they are copied at once; otherwise each element goes
+ * through the softmmu helpers like the loads & stores of the other forms,
+ * stopping after an invalid access as the engine does.
+ */
+static void *neon_ldst_host(CPUARMState *env, uint32_t addr, int len, int is_write)
+{
+    if ((addr & ~TARGET_PAGE_MASK) + len > TARGET_PAGE_SIZE) {
+        return NULL;
+    }
+    return tlb_vaddr_to_host(env, addr, is_write, cpu_mmu_index(env));
+}
+
+void HELPER(neon_vld1)(CPUARMState *env, uint32_t addr, uint32_t rd,
+                       uint32_t nregs, uint32_t size)
+{
+    CPUState *cs = ENV_GET_CPU(env);
+    uint8_t *host = neon_ldst_host(env, addr, nregs * 8, 0);
+    uintptr_t ra = GETRA();
+    uint64_t val;
+    int i, n;
+
+    for (i = 0; i < nregs; i++) {
+        if (host) {
+            val = ld_dreg_p(host + i * 8, size);
+        } else {
+            for (val = 0, n = 0; n < 8; n += 1 << size) {
+                val |= softmmu_load(env, addr + i * 8 + n, size,
+                                    cpu_mmu_index(env), ra) << (n * 8);
+                if (cs->tcg_exit_req) {
+                    return;
+                }
+            }
+        }
+        env->vfp.regs[rd + i] = make_float64(val);
+    }
+}
+
+void HELPER(neon_vst1)(CPUARMState *env, uint32_t addr, uint32_t rd,
+                       uint32_t nregs, uint32_t size)
+{
+    CPUState *cs = ENV_GET_CPU(env);
+    uint8_t *host = neon_ldst_host(env, addr, nregs * 8, 1);
+    uintptr_t ra = GETRA();
+    uint64_t val;
+    int i, n;
+
+    for (i = 0; i < nregs; i++) {
+        val = float64_val(env->vfp.regs[rd + i]);
+        if (host) {
+            st_dreg_p(host + i * 8, val, size);
+        } else {
+            for (n = 0; n < 8; n += 1 << size) {
+                softmmu_store(env, addr + i * 8 + n, val >> (n * 8), size,
+                              cpu_mmu_index(env), ra);
+                if (cs->tcg_exit_req) {
+                    return;
+                }
+            }
+        }
+    }
+}
 #endif
 
 uint32_t HELPER(add_setq)(CPUARMState *env, uint32_t a, uint32_t b)
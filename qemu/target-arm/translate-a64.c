@@ -165,6 +165,20 @@ void gen_a64_set_pc_im(DisasContext *s, uint64_t val)
     tcg_gen_movi_i64(tcg_ctx, tcg_ctx->cpu_pc, val);
 }
 
+// Unicorn: call the code hooks of the instruction at @pc
+static void gen_uc_code_hooks(DisasContext *s, uint64_t pc, uint32_t size)
+{
+    TCGContext *tcg_ctx = s->uc->tcg_ctx;
+
+    if (s->uc->hook_direct) {
+        // sync PC like helper_uc_tracecode() does
+        gen_a64_set_pc_im(s, pc);
+        gen_uc_hookcode(tcg_ctx, pc, size);
+    } else {
+        gen_uc_tracecode(tcg_ctx, size, UC_HOOK_CODE_IDX, s->uc, pc);
+    }
+}
+
 static void gen_exception_internal(DisasContext *s, int excp)
 {
     TCGContext *tcg_ctx = s->uc->tcg_ctx;
@@ -1709,7 +1723,7 @@ static void gen_store_exclusive(DisasContext *s, int rd, int rt, int rt2,
 }
 #else
 static void gen_store_exclusive(DisasContext *s, int rd, int rt, int rt2,
-                                TCGv_i64 inaddr, int size, int is_pair)
+                                TCGv_i64 addr, int size, int is_pair)
 {
     TCGContext *tcg_ctx = s->uc->tcg_ctx;
     /* if (env->exclusive_addr == addr && env->exclusive_val == [addr]
@@ -1723,55 +1737,17 @@ static void gen_store_exclusive(DisasContext *s, int rd, int rt, int rt2,
      *     {Rd} = 1;
      * }
      * env->exclusive_addr = -1;
+     *
+     * done by the helper as one host compare-and-swap where possible
      */
-    int fail_label = gen_new_label(tcg_ctx);
-    int done_label = gen_new_label(tcg_ctx);
-    TCGv_i64 addr = tcg_temp_local_new_i64(tcg_ctx);
-    TCGv_i64 tmp;
-
-    /* Copy input into a local temp so it is not trashed when the
-     * basic block ends at the branch insn.
-     */
-    tcg_gen_mov_i64(tcg_ctx, addr, inaddr);
-    tcg_gen_brcond_i64(tcg_ctx, TCG_COND_NE, addr, tcg_ctx->cpu_exclusive_addr, fail_label);
+    TCGv_i32 desc = tcg_const_i32(tcg_ctx, size | is_pair << 2 | get_mem_index(s) << 3);
+    TCGv_i64 tmp = tcg_temp_new_i64(tcg_ctx);
 
-    tmp = tcg_temp_new_i64(tcg_ctx);
-    tcg_gen_qemu_ld_i64(s->uc, tmp, addr, get_mem_index(s), MO_TE + size);
-    tcg_gen_brcond_i64(tcg_ctx, TCG_COND_NE, tmp, tcg_ctx->cpu_exclusive_val, fail_label);
+    gen_helper_stxr(tcg_ctx, tmp, tcg_ctx->cpu_env, addr, cpu_reg(s, rt),
+                    is_pair ? cpu_reg(s, rt2) : cpu_reg(s, rt), desc);
+    tcg_gen_mov_i64(tcg_ctx, cpu_reg(s, rd), tmp);
     tcg_temp_free_i64(tcg_ctx, tmp);
-
-    if (is_pair) {
-        TCGv_i64 addrhi = tcg_temp_new_i64(tcg_ctx);
-        TCGv_i64 tmphi = tcg_temp_new_i64(tcg_ctx);
-
-        tcg_gen_addi_i64(tcg_ctx, addrhi, addr, 1ULL << size);
-        tcg_gen_qemu_ld_i64(s->uc, tmphi, addrhi, get_mem_index(s), MO_TE + size);
-        tcg_gen_brcond_i64(tcg_ctx, TCG_COND_NE, tmphi, tcg_ctx->cpu_exclusive_high, fail_label);
-
-        tcg_temp_free_i64(tcg_ctx, tmphi);
-        tcg_temp_free_i64(tcg_ctx, addrhi);
-    }
-
-    /* We seem to still have the exclusive monitor, so do the store */
-    tcg_gen_qemu_st_i64(s->uc, cpu_reg(s, rt), addr, get_mem_index(s), MO_TE + size);
-    if (is_pair) {
-        TCGv_i64 addrhi = tcg_temp_new_i64(tcg_ctx);
-
-        tcg_gen_addi_i64(tcg_ctx, addrhi, addr, 1ULL << size);
-        tcg_gen_qemu_st_i64(s->uc, cpu_reg(s, rt2), addrhi,
-                            get_mem_index(s), MO_TE + size);
-        tcg_temp_free_i64(tcg_ctx, addrhi);
-    }
-
-    tcg_temp_free_i64(tcg_ctx, addr);
-
-    tcg_gen_movi_i64(tcg_ctx, cpu_reg(s, rd), 0);
-    tcg_gen_br(tcg_ctx, done_label);
-    gen_set_label(tcg_ctx, fail_label);
-    tcg_gen_movi_i64(tcg_ctx, cpu_reg(s, rd), 1);
-    gen_set_label(tcg_ctx, done_label);
-    tcg_gen_movi_i64(tcg_ctx, tcg_ctx->cpu_exclusive_addr, -1);
-
+    tcg_temp_free_i32(tcg_ctx, desc);
 }
 #endif
 
@@ -10992,7 +10968,7 @@ static void disas_a64_insn(CPUARMState *env, DisasContext *s)
 
     // Unicorn: trace this instruction on request
     if (HOOK_EXISTS_BOUNDED(env->uc, UC_HOOK_CODE, s->pc - 4)) {
-        gen_uc_tracecode(tcg_ctx, 4, UC_HOOK_CODE_IDX, env->uc, s->pc - 4);
+        gen_uc_code_hooks(s, s->pc - 4, 4);
         // the callback might want to stop emulation immediately
         check_exit_request(tcg_ctx);
     }
@@ -11115,25 +11091,29 @@ void gen_intermediate_code_internal_a64(ARMCPU *cpu,
     // Unicorn: early check to see if the address of this block is the until address
     if (tb->pc == env->uc->addr_end) {
         // imitate WFI instruction to halt emulation
-        gen_tb_start(tcg_ctx);
+        gen_tb_start(tcg_ctx, tb);
         dc->is_jmp = DISAS_WFI;
         goto tb_end;
     }
 
+    // the instruction budget is checked before the block hook, which must
+    // not see a block that does not run
+    gen_tb_start(tcg_ctx, tb);
+
     // Unicorn: trace this block on request
     // Only hook this block if it is not broken from previous translation due to
     // full translation cache
     if (!env->uc->block_full && HOOK_EXISTS_BOUNDED(env->uc, UC_HOOK_BLOCK, pc_start)) {
         // save block address to see if we need to patch block size later
         env->uc->block_addr = pc_start;
-        env->uc->size_arg = tcg_ctx->gen_opparam_buf - tcg_ctx->gen_opparam_ptr + 1;
+        env->uc->size_arg = tcg_ctx->gen_opparam_ptr - tcg_ctx->gen_opparam_buf + 1;
         gen_uc_tracecode(tcg_ctx, 0xf8f8f8f8, UC_HOOK_BLOCK_IDX, env->uc, pc_start);
+        // the callback might want to stop emulation immediately
+        check_exit_request(tcg_ctx);
     } else {
         env->uc->size_arg = -1;
     }
 
-    gen_tb_start(tcg_ctx);
-
     do {
         if (unlikely(!QTAILQ_EMPTY(&cs->breakpoints))) {
             QTAILQ_FOREACH(bp, &cs->breakpoints, entry) {
@@ -11157,8 +11137,9 @@ void gen_intermediate_code_internal_a64(ARMCPU *cpu,
             }
             tcg_ctx->gen_opc_pc[lj] = dc->pc;
             tcg_ctx->gen_opc_instr_start[lj] = 1;
-            //tcg_ctx->gen_opc_icount[lj] = num_insns;
+            tcg_ctx->gen_opc_icount[lj] = num_insns;
         }
+        gen_insn_start_icount(tcg_ctx, num_insns);
 
         //if (num_insns + 1 == max_insns && (tb->cflags & CF_LAST_IO)) {
         //    gen_io_start();
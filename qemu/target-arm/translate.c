@@ -972,6 +972,20 @@ static inline void gen_set_pc_im(DisasContext *s, target_ulong val)
     tcg_gen_movi_i32(tcg_ctx, tcg_ctx->cpu_R[15], val);
 }
 
+// Unicorn: call the code hooks of the instruction at @pc
+static void gen_uc_code_hooks(DisasContext *s, target_ulong pc, uint32_t size)
+{
+    TCGContext *tcg_ctx = s->uc->tcg_ctx;
+
+    if (s->uc->hook_direct) {
+        // sync PC like helper_uc_tracecode() does
+        gen_set_pc_im(s, pc);
+        gen_uc_hookcode(tcg_ctx, pc, size);
+    } else {
+        gen_uc_tracecode(tcg_ctx, size, UC_HOOK_CODE_IDX, s->uc, pc);
+    }
+}
+
 static inline void gen_hvc(DisasContext *s, int imm16)
 {
     TCGContext *tcg_ctx = s->uc->tcg_ctx;
@@ -4486,96 +4500,112 @@ static int disas_neon_ls_insn(DisasContext *s, uint32_t insn)
         addr = tcg_temp_new_i32(tcg_ctx);
         load_reg_var(s, addr, rn);
         stride = (1 << size) * interleave;
-        for (reg = 0; reg < nregs; reg++) {
-            if (interleave > 2 || (interleave == 2 && nregs == 2)) {
-                load_reg_var(s, addr, rn);
-                tcg_gen_addi_i32(tcg_ctx, addr, addr, (1 << size) * reg);
-            } else if (interleave == 2 && nregs == 4 && reg == 2) {
-                load_reg_var(s, addr, rn);
-                tcg_gen_addi_i32(tcg_ctx, addr, addr, 1 << size);
+        if (interleave == 1 && (nregs > 1 || size < 3)) {
+            /* VLD1, VST1: all the registers in one call */
+            TCGv_i32 trd = tcg_const_i32(tcg_ctx, rd);
+            TCGv_i32 tnregs = tcg_const_i32(tcg_ctx, nregs);
+            TCGv_i32 tsize = tcg_const_i32(tcg_ctx, size);
+            if (load) {
+                gen_helper_neon_vld1(tcg_ctx, tcg_ctx->cpu_env, addr, trd, tnregs, tsize);
+            } else {
+                gen_helper_neon_vst1(tcg_ctx, tcg_ctx->cpu_env, addr, trd, tnregs, tsize);
             }
-            if (size == 3) {
-                tmp64 = tcg_temp_new_i64(tcg_ctx);
-                if (load) {
-                    gen_aa32_ld64(s, tmp64, addr, get_mem_index(s));
-                    neon_store_reg64(tcg_ctx, tmp64, rd);
-                } else {
-                    neon_load_reg64(tcg_ctx, tmp64, rd);
-                    gen_aa32_st64(s, tmp64, addr, get_mem_index(s));
+            check_exit_request(tcg_ctx);
+            tcg_temp_free_i32(tcg_ctx, tsize);
+            tcg_temp_free_i32(tcg_ctx, tnregs);
+            tcg_temp_free_i32(tcg_ctx, trd);
+        } else {
+            for (reg = 0; reg < nregs; reg++) {
+                if (interleave > 2 || (interleave == 2 && nregs == 2)) {
+                    load_reg_var(s, addr, rn);
+                    tcg_gen_addi_i32(tcg_ctx, addr, addr, (1 << size) * reg);
+                } else if (interleave == 2 && nregs == 4 && reg == 2) {
+                    load_reg_var(s, addr, rn);
+                    tcg_gen_addi_i32(tcg_ctx, addr, addr, 1 << size);
                 }
-                tcg_temp_free_i64(tcg_ctx, tmp64);
-                tcg_gen_addi_i32(tcg_ctx, addr, addr, stride);
-            } else {
-                for (pass = 0; pass < 2; pass++) {
-                    if (size == 2) {
-                        if (load) {
-                            tmp = tcg_temp_new_i32(tcg_ctx);
-                            gen_aa32_ld32u(s, tmp, addr, get_mem_index(s));
-                            neon_store_reg(tcg_ctx, rd, pass, tmp);
-                        } else {
-                            tmp = neon_load_reg(tcg_ctx, rd, pass);
-                            gen_aa32_st32(s, tmp, addr, get_mem_index(s));
-                            tcg_temp_free_i32(tcg_ctx, tmp);
-                        }
-                        tcg_gen_addi_i32(tcg_ctx, addr, addr, stride);
-                    } else if (size == 1) {
-                        if (load) {
-                            tmp = tcg_temp_new_i32(tcg_ctx);
-                            gen_aa32_ld16u(s, tmp, addr, get_mem_index(s));
-                            tcg_gen_addi_i32(tcg_ctx, addr, addr, stride);
-                            tmp2 = tcg_temp_new_i32(tcg_ctx);
-                            gen_aa32_ld16u(s, tmp2, addr, get_mem_index(s));
-                            tcg_gen_addi_i32(tcg_ctx, addr, addr, stride);
-                            tcg_gen_shli_i32(tcg_ctx, tmp2, tmp2, 16);
-                            tcg_gen_or_i32(tcg_ctx, tmp, tmp, tmp2);
-                            tcg_temp_free_i32(tcg_ctx, tmp2);
-                            neon_store_reg(tcg_ctx, rd, pass, tmp);
-                        } else {
-                            tmp = neon_load_reg(tcg_ctx, rd, pass);
-                            tmp2 = tcg_temp_new_i32(tcg_ctx);
-                            tcg_gen_shri_i32(tcg_ctx, tmp2, tmp, 16);
-                            gen_aa32_st16(s, tmp, addr, get_mem_index(s));
-                            tcg_temp_free_i32(tcg_ctx, tmp);
-                            tcg_gen_addi_i32(tcg_ctx, addr, addr, stride);
-                            gen_aa32_st16(s, tmp2, addr, get_mem_index(s));
-                            tcg_temp_free_i32(tcg_ctx, tmp2);
-                            tcg_gen_addi_i32(tcg_ctx, addr, addr, stride);
-                        }
-                    } else /* size == 0 */ {
-                        if (load) {
-                            TCGV_UNUSED_I32(tmp2);
-                            for (n = 0; n < 4; n++) {
+                if (size == 3) {
+                    tmp64 = tcg_temp_new_i64(tcg_ctx);
+                    if (load) {
+                        gen_aa32_ld64(s, tmp64, addr, get_mem_index(s));
+                        neon_store_reg64(tcg_ctx, tmp64, rd);
+                    } else {
+                        neon_load_reg64(tcg_ctx, tmp64, rd);
+                        gen_aa32_st64(s, tmp64, addr, get_mem_index(s));
+                    }
+                    tcg_temp_free_i64(tcg_ctx, tmp64);
+                    tcg_gen_addi_i32(tcg_ctx, addr, addr, stride);
+                } else {
+                    for (pass = 0; pass < 2; pass++) {
+                        if (size == 2) {
+                            if (load) {
                                 tmp = tcg_temp_new_i32(tcg_ctx);
-                                gen_aa32_ld8u(s, tmp, addr, get_mem_index(s));
-                                tcg_gen_addi_i32(tcg_ctx, addr, addr, stride);
-                                if (n == 0) {
-                                    tmp2 = tmp;
-                                } else {
-                                    tcg_gen_shli_i32(tcg_ctx, tmp, tmp, n * 8);
-                                    tcg_gen_or_i32(tcg_ctx, tmp2, tmp2, tmp);
-                                    tcg_temp_free_i32(tcg_ctx, tmp);
-                                }
+                                gen_aa32_ld32u(s, tmp, addr, get_mem_index(s));
+                                neon_store_reg(tcg_ctx, rd, pass, tmp);
+                            } else {
+                                tmp = neon_load_reg(tcg_ctx, rd, pass);
+                                gen_aa32_st32(s, tmp, addr, get_mem_index(s));
+                                tcg_temp_free_i32(tcg_ctx, tmp);
                             }
-                            neon_store_reg(tcg_ctx, rd, pass, tmp2);
-                        } else {
-                            tmp2 = neon_load_reg(tcg_ctx, rd, pass);
-                            for (n = 0; n < 4; n++) {
+                            tcg_gen_addi_i32(tcg_ctx, addr, addr, stride);
+                        } else if (size == 1) {
+                            if (load) {
                                 tmp = tcg_temp_new_i32(tcg_ctx);
-                                if (n == 0) {
-                                    tcg_gen_mov_i32(tcg_ctx, tmp, tmp2);
-                                } else {
-                                    tcg_gen_shri_i32(tcg_ctx, tmp, tmp2, n * 8);
-                                }
-                                gen_aa32_st8(s, tmp, addr, get_mem_index(s));
+                                gen_aa32_ld16u(s, tmp, addr, get_mem_index(s));
+                                tcg_gen_addi_i32(tcg_ctx, addr, addr, stride);
+                                tmp2 = tcg_temp_new_i32(tcg_ctx);
+                                gen_aa32_ld16u(s, tmp2, addr, get_mem_index(s));
+                                tcg_gen_addi_i32(tcg_ctx, addr, addr, stride);
+                                tcg_gen_shli_i32(tcg_ctx, tmp2, tmp2, 16);
+                                tcg_gen_or_i32(tcg_ctx, tmp, tmp, tmp2);
+                                tcg_temp_free_i32(tcg_ctx, tmp2);
+                                neon_store_reg(tcg_ctx, rd, pass, tmp);
+                            } else {
+                                tmp = neon_load_reg(tcg_ctx, rd, pass);
+                                tmp2 = tcg_temp_new_i32(tcg_ctx);
+                                tcg_gen_shri_i32(tcg_ctx, tmp2, tmp, 16);
+                                gen_aa32_st16(s, tmp, addr, get_mem_index(s));
                                 tcg_temp_free_i32(tcg_ctx, tmp);
                                 tcg_gen_addi_i32(tcg_ctx, addr, addr, stride);
+                                gen_aa32_st16(s, tmp2, addr, get_mem_index(s));
+                                tcg_temp_free_i32(tcg_ctx, tmp2);
+                                tcg_gen_addi_i32(tcg_ctx, addr, addr, stride);
+                            }
+                        } else /* size == 0 */ {
+                            if (load) {
+                                TCGV_UNUSED_I32(tmp2);
+                                for (n = 0; n < 4; n++) {
+                                    tmp = tcg_temp_new_i32(tcg_ctx);
+                                    gen_aa32_ld8u(s, tmp, addr, get_mem_index(s));
+                                    tcg_gen_addi_i32(tcg_ctx, addr, addr, stride);
+                                    if (n == 0) {
+                                        tmp2 = tmp;
+                                    } else {
+                                        tcg_gen_shli_i32(tcg_ctx, tmp, tmp, n * 8);
+                                        tcg_gen_or_i32(tcg_ctx, tmp2, tmp2, tmp);
+                                        tcg_temp_free_i32(tcg_ctx, tmp);
+                                    }
+                                }
+                                neon_store_reg(tcg_ctx, rd, pass, tmp2);
+                            } else {
+                                tmp2 = neon_load_reg(tcg_ctx, rd, pass);
+                                for (n = 0; n < 4; n++) {
+                                    tmp = tcg_temp_new_i32(tcg_ctx);
+                                    if (n == 0) {
+                                        tcg_gen_mov_i32(tcg_ctx, tmp, tmp2);
+                                    } else {
+                                        tcg_gen_shri_i32(tcg_ctx, tmp, tmp2, n * 8);
+                                    }
+                                    gen_aa32_st8(s, tmp, addr, get_mem_index(s));
+                                    tcg_temp_free_i32(tcg_ctx, tmp);
+                                    tcg_gen_addi_i32(tcg_ctx, addr, addr, stride);
+                                }
+                                tcg_temp_free_i32(tcg_ctx, tmp2);
                             }
-                            tcg_temp_free_i32(tcg_ctx, tmp2);
                         }
                     }
                 }
+                rd += spacing;
             }
-            rd += spacing;
         }
         tcg_temp_free_i32(tcg_ctx, addr);
         stride = nregs * 8;
@@ -5173,6 +5203,101 @@ static const uint8_t neon_2rm_sizes[] = {
     /*NEON_2RM_VCVT_UF*/ 0x4,
 };
 
+typedef void NeonGenQFn(TCGContext *t, TCGv_ptr, TCGv_ptr, TCGv_ptr);
+typedef void NeonGenQEnvFn(TCGContext *t, TCGv_ptr, TCGv_ptr, TCGv_ptr, TCGv_ptr);
+typedef void NeonGenQFPFn(TCGContext *t, TCGv_ptr, TCGv_ptr, TCGv_ptr, TCGv_ptr);
+
+/* Elementwise Q register helpers of three-register-same ops, indexed by
+ * [(size << 1) | u].  Missing entries are left to the per pass code: the
+ * 32 bits element add/sub/mul ops are already single TCG ops there.
+ */
+#define NEON_Q_FNS_SU(name) { \
+    gen_helper_neon_##name##_s8_q, gen_helper_neon_##name##_u8_q, \
+    gen_helper_neon_##name##_s16_q, gen_helper_neon_##name##_u16_q, \
+    gen_helper_neon_##name##_s32_q, gen_helper_neon_##name##_u32_q }
+
+static NeonGenQFn * const neon_3r_q_fns[][6] = {
+    [NEON_3R_VHADD] = NEON_Q_FNS_SU(hadd),
+    [NEON_3R_VRHADD] = NEON_Q_FNS_SU(rhadd),
+    [NEON_3R_VCGT] = NEON_Q_FNS_SU(cgt),
+    [NEON_3R_VCGE] = NEON_Q_FNS_SU(cge),
+    [NEON_3R_VMAX] = NEON_Q_FNS_SU(max),
+    [NEON_3R_VMIN] = NEON_Q_FNS_SU(min),
+    [NEON_3R_VABD] = NEON_Q_FNS_SU(abd),
+    [NEON_3R_VABA] = NEON_Q_FNS_SU(aba),
+    [NEON_3R_VADD_VSUB] = {
+        gen_helper_neon_add_u8_q, gen_helper_neon_sub_u8_q,
+        gen_helper_neon_add_u16_q, gen_helper_neon_sub_u16_q },
+    [NEON_3R_VTST_VCEQ] = {
+        gen_helper_neon_tst_u8_q, gen_helper_neon_ceq_u8_q,
+        gen_helper_neon_tst_u16_q, gen_helper_neon_ceq_u16_q,
+        gen_helper_neon_tst_u32_q, gen_helper_neon_ceq_u32_q },
+    [NEON_3R_VML] = {
+        gen_helper_neon_mla_u8_q, gen_helper_neon_mls_u8_q,
+        gen_helper_neon_mla_u16_q, gen_helper_neon_mls_u16_q },
+    [NEON_3R_VMUL] = {
+        gen_helper_neon_mul_u8_q, NULL, gen_helper_neon_mul_u16_q },
+};
+
+static NeonGenQEnvFn * const neon_3r_q_env_fns[][6] = {
+    [NEON_3R_VQADD] = NEON_Q_FNS_SU(qadd),
+    [NEON_3R_VQSUB] = NEON_Q_FNS_SU(qsub),
+};
+
+/* Translate a three-register-same op on whole Q registers with a single
+ * helper call.  Return false if it has none, to be done pass by pass.
+ */
+static bool gen_neon_3reg_q(DisasContext *s, int op, int u, int size,
+                            int rd, int rn, int rm)
+{
+    TCGContext *tcg_ctx = s->uc->tcg_ctx;
+    NeonGenQFn *fn = NULL;
+    NeonGenQEnvFn *env_fn = NULL;
+    NeonGenQFPFn *fp_fn = NULL;
+    TCGv_ptr pd, pn, pm;
+
+    if (size > 2) {
+        return false;
+    }
+    if (op == NEON_3R_FLOAT_ARITH && !u) {
+        /* VADD, VSUB; size bit 1 encodes op */
+        fp_fn = size ? gen_helper_neon_sub_f32_q : gen_helper_neon_add_f32_q;
+    } else if (op == NEON_3R_FLOAT_MULTIPLY) {
+        /* VMUL, VMLA, VMLS */
+        fp_fn = u ? gen_helper_neon_mul_f32_q :
+                size ? gen_helper_neon_mls_f32_q : gen_helper_neon_mla_f32_q;
+    }
+    if (op < ARRAY_SIZE(neon_3r_q_fns)) {
+        fn = neon_3r_q_fns[op][(size << 1) | u];
+    }
+    if (op < ARRAY_SIZE(neon_3r_q_env_fns)) {
+        env_fn = neon_3r_q_env_fns[op][(size << 1) | u];
+    }
+    if (!fn && !env_fn && !fp_fn) {
+        return false;
+    }
+
+    pd = tcg_temp_new_ptr(tcg_ctx);
+    pn = tcg_temp_new_ptr(tcg_ctx);
+    pm = tcg_temp_new_ptr(tcg_ctx);
+    tcg_gen_addi_ptr(tcg_ctx, pd, tcg_ctx->cpu_env, vfp_reg_offset(1, rd));
+    tcg_gen_addi_ptr(tcg_ctx, pn, tcg_ctx->cpu_env, vfp_reg_offset(1, rn));
+    tcg_gen_addi_ptr(tcg_ctx, pm, tcg_ctx->cpu_env, vfp_reg_offset(1, rm));
+    if (fn) {
+        fn(tcg_ctx, pd, pn, pm);
+    } else if (env_fn) {
+        env_fn(tcg_ctx, tcg_ctx->cpu_env, pd, pn, pm);
+    } else {
+        TCGv_ptr fpstatus = get_fpstatus_ptr(s, 1);
+        fp_fn(tcg_ctx, pd, pn, pm, fpstatus);
+        tcg_temp_free_ptr(tcg_ctx, fpstatus);
+    }
+    tcg_temp_free_ptr(tcg_ctx, pd);
+    tcg_temp_free_ptr(tcg_ctx, pn);
+    tcg_temp_free_ptr(tcg_ctx, pm);
+    return true;
+}
+
 /* Translate a NEON data processing instruction.  Return nonzero if the
    instruction is invalid.
    We process data in a mixture of 32-bit and 64-bit chunks.
@@ -5404,6 +5529,10 @@ static int disas_neon_data_insn(DisasContext *s, uint32_t insn)
             return 1;
         }
 
+        if (q && gen_neon_3reg_q(s, op, u, size, rd, rn, rm)) {
+            return 0;
+        }
+
         for (pass = 0; pass < (q ? 4 : 2); pass++) {
 
         if (pairwise) {
@@ -7118,30 +7247,21 @@ static int disas_neon_data_insn(DisasContext *s, uint32_t insn)
                     return 1;
                 }
                 n <<= 3;
+                /* the whole D register in one call */
+                tmp64 = tcg_temp_new_i64(tcg_ctx);
                 if (insn & (1 << 6)) {
-                    tmp = neon_load_reg(tcg_ctx, rd, 0);
+                    neon_load_reg64(tcg_ctx, tmp64, rd);
                 } else {
-                    tmp = tcg_temp_new_i32(tcg_ctx);
-                    tcg_gen_movi_i32(tcg_ctx, tmp, 0);
+                    tcg_gen_movi_i64(tcg_ctx, tmp64, 0);
                 }
-                tmp2 = neon_load_reg(tcg_ctx, rm, 0);
+                neon_load_reg64(tcg_ctx, tcg_ctx->cpu_V1, rm);
                 tmp4 = tcg_const_i32(tcg_ctx, rn);
                 tmp5 = tcg_const_i32(tcg_ctx, n);
-                gen_helper_neon_tbl(tcg_ctx, tmp2, tcg_ctx->cpu_env, tmp2, tmp, tmp4, tmp5);
-                tcg_temp_free_i32(tcg_ctx, tmp);
-                if (insn & (1 << 6)) {
-                    tmp = neon_load_reg(tcg_ctx, rd, 1);
-                } else {
-                    tmp = tcg_temp_new_i32(tcg_ctx);
-                    tcg_gen_movi_i32(tcg_ctx, tmp, 0);
-                }
-                tmp3 = neon_load_reg(tcg_ctx, rm, 1);
-                gen_helper_neon_tbl(tcg_ctx, tmp3, tcg_ctx->cpu_env, tmp3, tmp, tmp4, tmp5);
+                gen_helper_neon_tbl(tcg_ctx, tmp64, tcg_ctx->cpu_env, tcg_ctx->cpu_V1, tmp64, tmp4, tmp5);
                 tcg_temp_free_i32(tcg_ctx, tmp5);
                 tcg_temp_free_i32(tcg_ctx, tmp4);
-                neon_store_reg(tcg_ctx, rd, 0, tmp2);
-                neon_store_reg(tcg_ctx, rd, 1, tmp3);
-                tcg_temp_free_i32(tcg_ctx, tmp);
+                neon_store_reg64(tcg_ctx, tmp64, rd);
+                tcg_temp_free_i64(tcg_ctx, tmp64);
             } else if ((insn & 0x380) == 0) {
                 /* VDUP */
                 if ((insn & (7 << 16)) == 0 || (q && (rd & 1))) {
@@ -7539,85 +7659,22 @@ static void gen_store_exclusive(DisasContext *s, int rd, int rt, int rt2,
                                 TCGv_i32 addr, int size)
 {
     TCGContext *tcg_ctx = s->uc->tcg_ctx;
-    TCGv_i32 tmp;
-    TCGv_i64 val64, extaddr;
-    int done_label;
-    int fail_label;
+    TCGv_i32 tmp, tmp2, desc;
 
     /* if (env->exclusive_addr == addr && env->exclusive_val == [addr]) {
          [addr] = {Rt};
          {Rd} = 0;
        } else {
          {Rd} = 1;
-       } */
-    fail_label = gen_new_label(tcg_ctx);
-    done_label = gen_new_label(tcg_ctx);
-    extaddr = tcg_temp_new_i64(tcg_ctx);
-    tcg_gen_extu_i32_i64(tcg_ctx, extaddr, addr);
-    tcg_gen_brcond_i64(tcg_ctx, TCG_COND_NE, extaddr, tcg_ctx->cpu_exclusive_addr, fail_label);
-    tcg_temp_free_i64(tcg_ctx, extaddr);
-
-    tmp = tcg_temp_new_i32(tcg_ctx);
-    switch (size) {
-    case 0:
-        gen_aa32_ld8u(s, tmp, addr, get_mem_index(s));
-        break;
-    case 1:
-        gen_aa32_ld16u(s, tmp, addr, get_mem_index(s));
-        break;
-    case 2:
-    case 3:
-        gen_aa32_ld32u(s, tmp, addr, get_mem_index(s));
-        break;
-    default:
-        abort();
-    }
-
-    val64 = tcg_temp_new_i64(tcg_ctx);
-    if (size == 3) {
-        TCGv_i32 tmp2 = tcg_temp_new_i32(tcg_ctx);
-        TCGv_i32 tmp3 = tcg_temp_new_i32(tcg_ctx);
-        tcg_gen_addi_i32(tcg_ctx, tmp2, addr, 4);
-        gen_aa32_ld32u(s, tmp3, tmp2, get_mem_index(s));
-        tcg_temp_free_i32(tcg_ctx, tmp2);
-        tcg_gen_concat_i32_i64(tcg_ctx, val64, tmp, tmp3);
-        tcg_temp_free_i32(tcg_ctx, tmp3);
-    } else {
-        tcg_gen_extu_i32_i64(tcg_ctx, val64, tmp);
-    }
-    tcg_temp_free_i32(tcg_ctx, tmp);
-
-    tcg_gen_brcond_i64(tcg_ctx, TCG_COND_NE, val64, tcg_ctx->cpu_exclusive_val, fail_label);
-    tcg_temp_free_i64(tcg_ctx, val64);
-
+       }
+       done by the helper as one host compare-and-swap where possible */
     tmp = load_reg(s, rt);
-    switch (size) {
-    case 0:
-        gen_aa32_st8(s, tmp, addr, get_mem_index(s));
-        break;
-    case 1:
-        gen_aa32_st16(s, tmp, addr, get_mem_index(s));
-        break;
-    case 2:
-    case 3:
-        gen_aa32_st32(s, tmp, addr, get_mem_index(s));
-        break;
-    default:
-        abort();
-    }
+    tmp2 = size == 3 ? load_reg(s, rt2) : tcg_const_i32(tcg_ctx, 0);
+    desc = tcg_const_i32(tcg_ctx, size | (get_mem_index(s) << 2));
+    gen_helper_strex(tcg_ctx, tcg_ctx->cpu_R[rd], tcg_ctx->cpu_env, addr, tmp, tmp2, desc);
+    tcg_temp_free_i32(tcg_ctx, desc);
+    tcg_temp_free_i32(tcg_ctx, tmp2);
     tcg_temp_free_i32(tcg_ctx, tmp);
-    if (size == 3) {
-        tcg_gen_addi_i32(tcg_ctx, addr, addr, 4);
-        tmp = load_reg(s, rt2);
-        gen_aa32_st32(s, tmp, addr, get_mem_index(s));
-        tcg_temp_free_i32(tcg_ctx, tmp);
-    }
-    tcg_gen_movi_i32(tcg_ctx, tcg_ctx->cpu_R[rd], 0);
-    tcg_gen_br(tcg_ctx, done_label);
-    gen_set_label(tcg_ctx, fail_label);
-    tcg_gen_movi_i32(tcg_ctx, tcg_ctx->cpu_R[rd], 1);
-    gen_set_label(tcg_ctx, done_label);
-    tcg_gen_movi_i64(tcg_ctx, tcg_ctx->cpu_exclusive_addr, -1);
 }
 #endif
 
@@ -7705,7 +7762,7 @@ static void disas_arm_insn(DisasContext *s, unsigned int insn)  // qq
 
     // Unicorn: trace this instruction on request
     if (HOOK_EXISTS_BOUNDED(s->uc, UC_HOOK_CODE, s->pc - 4)) {
-        gen_uc_tracecode(tcg_ctx, 4, UC_HOOK_CODE_IDX, s->uc, s->pc - 4);
+        gen_uc_code_hooks(s, s->pc - 4, 4);
         // the callback might want to stop emulation immediately
         check_exit_request(tcg_ctx);
     }
@@ -10439,11 +10496,11 @@ static void disas_thumb_insn(CPUARMState *env, DisasContext *s) // qq
             case 0xe800:
             case 0xf000:
             case 0xf800:
-                gen_uc_tracecode(tcg_ctx, 4, UC_HOOK_CODE_IDX, s->uc, s->pc);
+                gen_uc_code_hooks(s, s->pc, 4);
                 break;
             // Thumb: 16-bit
             default:
-                gen_uc_tracecode(tcg_ctx, 2, UC_HOOK_CODE_IDX, s->uc, s->pc);
+                gen_uc_code_hooks(s, s->pc, 2);
                 break;
         }
         // the callback might want to stop emulation immediately
@@ -11259,25 +11316,29 @@ static inline void gen_intermediate_code_internal(ARMCPU *cpu,
     // Unicorn: early check to see if the address of this block is the until address
     if (tb->pc == env->uc->addr_end) {
         // imitate WFI instruction to halt emulation
-        gen_tb_start(tcg_ctx);
+        gen_tb_start(tcg_ctx, tb);
         dc->is_jmp = DISAS_WFI;
         goto tb_end;
     }
 
+    // the instruction budget is checked before the block hook, which must
+    // not see a block that does not run
+    gen_tb_start(tcg_ctx, tb);
+
     // Unicorn: trace this block on request
     // Only hook this block if it is not broken from previous translation due to
     // full translation cache
     if (!env->uc->block_full && HOOK_EXISTS_BOUNDED(env->uc, UC_HOOK_BLOCK, pc_start)) {
         // save block address to see if we need to patch block size later
         env->uc->block_addr = pc_start;
-        env->uc->size_arg = tcg_ctx->gen_opparam_buf - tcg_ctx->gen_opparam_ptr + 1;
+        env->uc->size_arg = tcg_ctx->gen_opparam_ptr - tcg_ctx->gen_opparam_buf + 1;
         gen_uc_tracecode(tcg_ctx, 0xf8f8f8f8, UC_HOOK_BLOCK_IDX, env->uc, pc_start);
+        // the callback might want to stop emulation immediately
+        check_exit_request(tcg_ctx);
     } else {
         env->uc->size_arg = -1;
     }
 
-    gen_tb_start(tcg_ctx);
-
     /* A note on handling of the condexec (IT) bits:
      *
      * We want to avoid the overhead of having to write the updated condexec
@@ -11359,8 +11420,9 @@ static inline void gen_intermediate_code_internal(ARMCPU *cpu,
             tcg_ctx->gen_opc_pc[lj] = dc->pc;
             tcg_ctx->gen_opc_condexec_bits[lj] = (dc->condexec_cond << 4) | (dc->condexec_mask >> 1);
             tcg_ctx->gen_opc_instr_start[lj] = 1;
-            //tcg_ctx->gen_opc_icount[lj] = num_insns;
+            tcg_ctx->gen_opc_icount[lj] = num_insns;
         }
+        gen_insn_start_icount(tcg_ctx, num_insns);
 
         //if (num_insns + 1 == max_insns && (tb->cflags & CF_LAST_IO))
         //    gen_io_start();
@@ -11548,7 +11610,7 @@ done_generating:
             tcg_ctx->gen_opc_instr_start[lj++] = 0;
     } else {
         tb->size = dc->pc - pc_start;
-        //tb->icount = num_insns;
+        tb->icount = num_insns;
     }
 
     env->uc->block_full = block_full;
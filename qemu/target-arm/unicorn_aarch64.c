@@ -228,6 +228,64 @@ int arm64_reg_write(struct uc_struct *uc, unsigned int *regs, void* const* vals,
     return 0;
 }
 
+// user-visible CPU state, for uc_context_alloc_user(): general purpose,
+// SIMD & FP registers, NZCV, FPCR/FPSR, TLS registers and the exclusive
+// monitor. The exception level & system registers are left alone
+struct arm64_context_user {
+    uint64_t xregs[32];
+    uint64_t pc;
+    uint32_t CF, VF, NF, ZF;
+    float64 vfp_regs[64];
+    uint32_t fpscr;
+    float_status fp_status, standard_fp_status;
+    uint64_t tpidr_el0, tpidrro_el0;
+    uint64_t exclusive_addr, exclusive_val, exclusive_high;
+};
+
+static void arm64_context_user_save(struct uc_struct *uc, void *data)
+{
+    CPUARMState *env = uc->cpu->env_ptr;
+    struct arm64_context_user *ctx = data;
+
+    memcpy(ctx->xregs, env->xregs, sizeof(ctx->xregs));
+    ctx->pc = env->pc;
+    ctx->CF = env->CF;
+    ctx->VF = env->VF;
+    ctx->NF = env->NF;
+    ctx->ZF = env->ZF;
+    memcpy(ctx->vfp_regs, env->vfp.regs, sizeof(ctx->vfp_regs));
+    ctx->fpscr = env->vfp.xregs[ARM_VFP_FPSCR];
+    ctx->fp_status = env->vfp.fp_status;
+    ctx->standard_fp_status = env->vfp.standard_fp_status;
+    ctx->tpidr_el0 = env->cp15.tpidr_el0;
+    ctx->tpidrro_el0 = env->cp15.tpidrro_el0;
+    ctx->exclusive_addr = env->exclusive_addr;
+    ctx->exclusive_val = env->exclusive_val;
+    ctx->exclusive_high = env->exclusive_high;
+}
+
+static void arm64_context_user_restore(struct uc_struct *uc, const void *data)
+{
+    CPUARMState *env = uc->cpu->env_ptr;
+    const struct arm64_context_user *ctx = data;
+
+    memcpy(env->xregs, ctx->xregs, sizeof(ctx->xregs));
+    env->pc = ctx->pc;
+    env->CF = ctx->CF;
+    env->VF = ctx->VF;
+    env->NF = ctx->NF;
+    env->ZF = ctx->ZF;
+    memcpy(env->vfp.regs, ctx->vfp_regs, sizeof(ctx->vfp_regs));
+    env->vfp.xregs[ARM_VFP_FPSCR] = ctx->fpscr;
+    env->vfp.fp_status = ctx->fp_status;
+    env->vfp.standard_fp_status = ctx->standard_fp_status;
+    env->cp15.tpidr_el0 = ctx->tpidr_el0;
+    env->cp15.tpidrro_el0 = ctx->tpidrro_el0;
+    env->exclusive_addr = ctx->exclusive_addr;
+    env->exclusive_val = ctx->exclusive_val;
+    env->exclusive_high = ctx->exclusive_high;
+}
+
 DEFAULT_VISIBILITY
 #ifdef TARGET_WORDS_BIGENDIAN
 void arm64eb_uc_init(struct uc_struct* uc)
@@ -244,5 +302,8 @@ void arm64_uc_init(struct uc_struct* uc)
     uc->reg_reset = arm64_reg_reset;
     uc->set_pc = arm64_set_pc;
     uc->release = arm64_release;
+    uc->context_user_size = sizeof(struct arm64_context_user);
+    uc->context_user_save = arm64_context_user_save;
+    uc->context_user_restore = arm64_context_user_restore;
     uc_common_init(uc);
 }
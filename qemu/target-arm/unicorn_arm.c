@@ -194,6 +194,76 @@ int arm_reg_write(struct uc_struct *uc, unsigned int *regs, void* const* vals, i
     return 0;
 }
 
+// user-visible CPU state, for uc_context_alloc_user(): core & VFP/NEON
+// registers, flags, IT state, TLS registers and the exclusive monitor.
+// The processor mode & system registers are left alone
+struct arm_context_user {
+    uint32_t regs[16];
+    uint32_t CF, VF, NF, ZF, QF, GE;
+    uint32_t thumb, condexec_bits;
+    float64 vfp_regs[32];
+    uint32_t fpscr;
+    int vec_len, vec_stride;
+    float_status fp_status, standard_fp_status;
+    uint64_t tpidr_el0, tpidrro_el0;
+    uint64_t exclusive_addr, exclusive_val, exclusive_high;
+};
+
+static void arm_context_user_save(struct uc_struct *uc, void *data)
+{
+    CPUARMState *env = uc->cpu->env_ptr;
+    struct arm_context_user *ctx = data;
+
+    memcpy(ctx->regs, env->regs, sizeof(ctx->regs));
+    ctx->CF = env->CF;
+    ctx->VF = env->VF;
+    ctx->NF = env->NF;
+    ctx->ZF = env->ZF;
+    ctx->QF = env->QF;
+    ctx->GE = env->GE;
+    ctx->thumb = env->thumb;
+    ctx->condexec_bits = env->condexec_bits;
+    memcpy(ctx->vfp_regs, env->vfp.regs, sizeof(ctx->vfp_regs));
+    ctx->fpscr = env->vfp.xregs[ARM_VFP_FPSCR];
+    ctx->vec_len = env->vfp.vec_len;
+    ctx->vec_stride = env->vfp.vec_stride;
+    ctx->fp_status = env->vfp.fp_status;
+    ctx->standard_fp_status = env->vfp.standard_fp_status;
+    ctx->tpidr_el0 = env->cp15.tpidr_el0;
+    ctx->tpidrro_el0 = env->cp15.tpidrro_el0;
+    ctx->exclusive_addr = env->exclusive_addr;
+    ctx->exclusive_val = env->exclusive_val;
+    ctx->exclusive_high = env->exclusive_high;
+}
+
+static void arm_context_user_restore(struct uc_struct *uc, const void *data)
+{
+    CPUARMState *env = uc->cpu->env_ptr;
+    const struct arm_context_user *ctx = data;
+
+    memcpy(env->regs, ctx->regs, sizeof(ctx->regs));
+    env->pc = ctx->regs[15];
+    env->CF = ctx->CF;
+    env->VF = ctx->VF;
+    env->NF = ctx->NF;
+    env->ZF = ctx->ZF;
+    env->QF = ctx->QF;
+    env->GE = ctx->GE;
+    env->thumb = ctx->thumb;
+    env->condexec_bits = ctx->condexec_bits;
+    memcpy(env->vfp.regs, ctx->vfp_regs, sizeof(ctx->vfp_regs));
+    env->vfp.xregs[ARM_VFP_FPSCR] = ctx->fpscr;
+    env->vfp.vec_len = ctx->vec_len;
+    env->vfp.vec_stride = ctx->vec_stride;
+    env->vfp.fp_status = ctx->fp_status;
+    env->vfp.standard_fp_status = ctx->standard_fp_status;
+    env->cp15.tpidr_el0 = ctx->tpidr_el0;
+    env->cp15.tpidrro_el0 = ctx->tpidrro_el0;
+    env->exclusive_addr = ctx->exclusive_addr;
+    env->exclusive_val = ctx->exclusive_val;
+    env->exclusive_high = ctx->exclusive_high;
+}
+
 static bool arm_stop_interrupt(int intno)
 {
     switch(intno) {
@@ -223,6 +293,16 @@ static uc_err arm_query(struct uc_struct *uc, uc_query_type type, size_t *result
     }
 }
 
+#if defined(__x86_64__) || defined(_M_X64)
+// guest addresses are physical ones while the MMU & FCSE are off
+static void arm_fastmem_update(struct uc_struct *uc)
+{
+    CPUARMState *env = &ARM_CPU(uc, uc->cpu)->env;
+
+    tlb_fastmem_update(uc->cpu, !(env->cp15.c1_sys & SCTLR_M) && !env->cp15.c13_fcse);
+}
+#endif
+
 #ifdef TARGET_WORDS_BIGENDIAN
 void armeb_uc_init(struct uc_struct* uc)
 #else
@@ -239,5 +319,11 @@ void arm_uc_init(struct uc_struct* uc)
     uc->stop_interrupt = arm_stop_interrupt;
     uc->release = arm_release;
     uc->query = arm_query;
+    uc->context_user_size = sizeof(struct arm_context_user);
+    uc->context_user_save = arm_context_user_save;
+    uc->context_user_restore = arm_context_user_restore;
+#if defined(__x86_64__) || defined(_M_X64)
+    uc->fastmem_update = arm_fastmem_update;
+#endif
     uc_common_init(uc);
 }
@@ -947,14 +947,12 @@ void helper_syscall(CPUX86State *env, int next_eip_addend)
 {
     // Unicorn: call registered syscall hooks
     struct hook *hook;
-    HOOK_FOREACH_VAR_DECLARE;
-    HOOK_FOREACH(env->uc, hook, UC_HOOK_INSN) {
+    HOOK_FOREACH_BOUNDED_VAR_DECLARE;
+    HOOK_FOREACH_BOUNDED(env->uc, hook, UC_HOOK_INSN, env->eip) {
         if (hook->to_delete)
             continue;
-        if (!HOOK_BOUND_CHECK(hook, env->eip))
-            continue;
         if (hook->insn == UC_X86_INS_SYSCALL)
-            ((uc_cb_insn_syscall_t)hook->callback)(env->uc, hook->user_data);
+            HOOK_CALLBACK(env->uc, hook, UC_HOOK_INSN, uc_cb_insn_syscall_t)(env->uc, hook->user_data);
     }
 
     env->eip += next_eip_addend;
@@ -2389,14 +2387,12 @@ void helper_sysenter(CPUX86State *env, int next_eip_addend)
 {
     // Unicorn: call registered SYSENTER hooks
     struct hook *hook;
-    HOOK_FOREACH_VAR_DECLARE;
-    HOOK_FOREACH(env->uc, hook, UC_HOOK_INSN) {
+    HOOK_FOREACH_BOUNDED_VAR_DECLARE;
+    HOOK_FOREACH_BOUNDED(env->uc, hook, UC_HOOK_INSN, env->eip) {
         if (hook->to_delete)
             continue;
-        if (!HOOK_BOUND_CHECK(hook, env->eip))
-            continue;
         if (hook->insn == UC_X86_INS_SYSENTER)
-            ((uc_cb_insn_syscall_t)hook->callback)(env->uc, hook->user_data);
+            HOOK_CALLBACK(env->uc, hook, UC_HOOK_INSN, uc_cb_insn_syscall_t)(env->uc, hook->user_data);
     }
 
     env->eip += next_eip_addend;
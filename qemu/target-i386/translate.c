@@ -8689,7 +8689,7 @@ static inline void gen_intermediate_code_internal(uint8_t *gen_opc_cc_op,
     // early check to see if the address of this block is the until address
     if (tb->pc == env->uc->addr_end) {
         // imitate the HLT instruction
-        gen_tb_start(tcg_ctx);
+        gen_tb_start(tcg_ctx, tb);
         gen_jmp_im(dc, tb->pc - tb->cs_base);
         gen_helper_hlt(tcg_ctx, tcg_ctx->cpu_env, tcg_const_i32(tcg_ctx, 0));
         dc->is_jmp = DISAS_TB_JUMP;
@@ -8703,17 +8703,22 @@ static inline void gen_intermediate_code_internal(uint8_t *gen_opc_cc_op,
     if (max_insns == 0)
         max_insns = CF_COUNT_MASK;
 
+    // the instruction budget is checked before the block hook, which must
+    // not see a block that does not run
+    gen_tb_start(tcg_ctx, tb);
+
     // Unicorn: trace this block on request
     // Only hook this block if the previous block was not truncated due to space
     if (!env->uc->block_full && HOOK_EXISTS_BOUNDED(env->uc, UC_HOOK_BLOCK, pc_start)) {
         env->uc->block_addr = pc_start;
-        env->uc->size_arg = tcg_ctx->gen_opparam_buf - tcg_ctx->gen_opparam_ptr + 1;
+        env->uc->size_arg = tcg_ctx->gen_opparam_ptr - tcg_ctx->gen_opparam_buf + 1;
         gen_uc_tracecode(tcg_ctx, 0xf8f8f8f8, UC_HOOK_BLOCK_IDX, env->uc, pc_start);
+        // the callback might want to stop emulation immediately
+        check_exit_request(tcg_ctx);
     } else {
         env->uc->size_arg = -1;
     }
 
-    gen_tb_start(tcg_ctx);
     for(;;) {
         if (unlikely(!QTAILQ_EMPTY(&cs->breakpoints))) {
             QTAILQ_FOREACH(bp, &cs->breakpoints, entry) {
@@ -8734,8 +8739,9 @@ static inline void gen_intermediate_code_internal(uint8_t *gen_opc_cc_op,
             tcg_ctx->gen_opc_pc[lj] = pc_ptr;
             gen_opc_cc_op[lj] = dc->cc_op;
             tcg_ctx->gen_opc_instr_start[lj] = 1;
-            // tcg_ctx->gen_opc_icount[lj] = num_insns;
+            tcg_ctx->gen_opc_icount[lj] = num_insns;
         }
+        gen_insn_start_icount(tcg_ctx, num_insns);
         //if (num_insns + 1 == max_insns && (tb->cflags & CF_LAST_IO))
         //    gen_io_start();
 
@@ -8782,6 +8788,7 @@ done_generating:
 
     if (!search_pc) {
         tb->size = pc_ptr - pc_start;
+        tb->icount = num_insns;
     }
 
     env->uc->block_full = block_full;
@@ -1501,6 +1501,85 @@ static bool x86_insn_hook_validate(uint32_t insn_enum)
     return true;
 }
 
+// user-visible CPU state, for uc_context_alloc_user(): general purpose
+// registers, EIP, EFLAGS, FS & GS (for TLS), x87, MMX & SSE registers.
+// CS, SS & the CPU mode are left alone, so are the EFLAGS bits that
+// POPF cannot change in user mode, see X86_USER_EFLAGS
+struct x86_context_user {
+    target_ulong regs[CPU_NB_REGS];
+    target_ulong eip, eflags0, eflags;
+    target_ulong cc_dst, cc_src, cc_src2;
+    uint32_t cc_op;
+    int32_t df;
+    SegmentCache fs, gs;
+    unsigned int fpstt;
+    uint16_t fpus, fpuc;
+    uint8_t fptags[8];
+    FPReg fpregs[8];
+    float_status fp_status;
+    float_status sse_status;
+    uint32_t mxcsr;
+    XMMReg xmm_regs[CPU_NB_REGS];
+};
+
+// the EFLAGS bits set by POPF at CPL 3: not IOPL, IF, VM nor RF
+#define X86_USER_EFLAGS (CC_O | CC_S | CC_Z | CC_A | CC_P | CC_C | \
+        DF_MASK | TF_MASK | NT_MASK | AC_MASK | ID_MASK)
+
+static void x86_context_user_save(struct uc_struct *uc, void *data)
+{
+    CPUX86State *env = uc->cpu->env_ptr;
+    struct x86_context_user *ctx = data;
+
+    memcpy(ctx->regs, env->regs, sizeof(ctx->regs));
+    ctx->eip = env->eip;
+    ctx->eflags0 = env->eflags0;
+    ctx->eflags = env->eflags;
+    ctx->cc_dst = env->cc_dst;
+    ctx->cc_src = env->cc_src;
+    ctx->cc_src2 = env->cc_src2;
+    ctx->cc_op = env->cc_op;
+    ctx->df = env->df;
+    ctx->fs = env->segs[R_FS];
+    ctx->gs = env->segs[R_GS];
+    ctx->fpstt = env->fpstt;
+    ctx->fpus = env->fpus;
+    ctx->fpuc = env->fpuc;
+    memcpy(ctx->fptags, env->fptags, sizeof(ctx->fptags));
+    memcpy(ctx->fpregs, env->fpregs, sizeof(ctx->fpregs));
+    ctx->fp_status = env->fp_status;
+    ctx->sse_status = env->sse_status;
+    ctx->mxcsr = env->mxcsr;
+    memcpy(ctx->xmm_regs, env->xmm_regs, sizeof(ctx->xmm_regs));
+}
+
+static void x86_context_user_restore(struct uc_struct *uc, const void *data)
+{
+    CPUX86State *env = uc->cpu->env_ptr;
+    const struct x86_context_user *ctx = data;
+
+    memcpy(env->regs, ctx->regs, sizeof(ctx->regs));
+    env->eip = ctx->eip;
+    env->eflags0 = (env->eflags0 & ~X86_USER_EFLAGS) | (ctx->eflags0 & X86_USER_EFLAGS);
+    env->eflags = (env->eflags & ~X86_USER_EFLAGS) | (ctx->eflags & X86_USER_EFLAGS);
+    env->cc_dst = ctx->cc_dst;
+    env->cc_src = ctx->cc_src;
+    env->cc_src2 = ctx->cc_src2;
+    env->cc_op = ctx->cc_op;
+    env->df = ctx->df;
+    env->segs[R_FS] = ctx->fs;
+    env->segs[R_GS] = ctx->gs;
+    env->fpstt = ctx->fpstt;
+    env->fpus = ctx->fpus;
+    env->fpuc = ctx->fpuc;
+    memcpy(env->fptags, ctx->fptags, sizeof(ctx->fptags));
+    memcpy(env->fpregs, ctx->fpregs, sizeof(ctx->fpregs));
+    env->fp_status = ctx->fp_status;
+    env->sse_status = ctx->sse_status;
+    env->mxcsr = ctx->mxcsr;
+    memcpy(env->xmm_regs, ctx->xmm_regs, sizeof(ctx->xmm_regs));
+}
+
 DEFAULT_VISIBILITY
 void x86_uc_init(struct uc_struct* uc)
 {
@@ -1517,6 +1596,9 @@ void x86_uc_init(struct uc_struct* uc)
     uc->set_pc = x86_set_pc;
     uc->stop_interrupt = x86_stop_interrupt;
     uc->insn_hook_validate = x86_insn_hook_validate;
+    uc->context_user_size = sizeof(struct x86_context_user);
+    uc->context_user_save = x86_context_user_save;
+    uc->context_user_restore = x86_context_user_restore;
     uc_common_init(uc);
 }
 
@@ -19207,25 +19207,30 @@ gen_intermediate_code_internal(MIPSCPU *cpu, TranslationBlock *tb,
 
     // Unicorn: early check to see if the address of this block is the until address
     if (tb->pc == env->uc->addr_end) {
-        gen_tb_start(tcg_ctx);
+        gen_tb_start(tcg_ctx, tb);
         gen_helper_wait(tcg_ctx, tcg_ctx->cpu_env);
         ctx.bstate = BS_EXCP;
         goto done_generating;
     }
 
+    // the instruction budget is checked before the block hook, which must
+    // not see a block that does not run
+    gen_tb_start(tcg_ctx, tb);
+
     // Unicorn: trace this block on request
     // Only hook this block if it is not broken from previous translation due to
     // full translation cache
     if (!env->uc->block_full && HOOK_EXISTS_BOUNDED(env->uc, UC_HOOK_BLOCK, pc_start)) {
         // save block address to see if we need to patch block size later
         env->uc->block_addr = pc_start;
-        env->uc->size_arg = tcg_ctx->gen_opparam_buf - tcg_ctx->gen_opparam_ptr + 1;
+        env->uc->size_arg = tcg_ctx->gen_opparam_ptr - tcg_ctx->gen_opparam_buf + 1;
         gen_uc_tracecode(tcg_ctx, 0xf8f8f8f8, UC_HOOK_BLOCK_IDX, env->uc, pc_start);
+        // the callback might want to stop emulation immediately
+        check_exit_request(tcg_ctx);
     } else {
         env->uc->size_arg = -1;
     }
 
-    gen_tb_start(tcg_ctx);
     while (ctx.bstate == BS_NONE) {
         // printf(">>> mips pc = %x\n", ctx.pc);
         if (unlikely(!QTAILQ_EMPTY(&cs->breakpoints))) {
@@ -19255,6 +19260,7 @@ gen_intermediate_code_internal(MIPSCPU *cpu, TranslationBlock *tb,
             tcg_ctx->gen_opc_instr_start[lj] = 1;
             tcg_ctx->gen_opc_icount[lj] = num_insns;
         }
+        gen_insn_start_icount(tcg_ctx, num_insns);
         //if (num_insns + 1 == max_insns && (tb->cflags & CF_LAST_IO))
         //    gen_io_start();
 
@@ -2637,6 +2637,7 @@ static void disas_sparc_insn(DisasContext * dc, unsigned int insn, bool hook_ins
         check_exit_request(tcg_ctx);
     }
 
+
     opc = GET_FIELD(insn, 0, 1);
     rd = GET_FIELD(insn, 2, 6);
 
@@ -5397,7 +5398,7 @@ static inline void gen_intermediate_code_internal(SPARCCPU *cpu,
 
     // early check to see if the address of this block is the until address
     if (pc_start == env->uc->addr_end) {
-        gen_tb_start(tcg_ctx);
+        gen_tb_start(tcg_ctx, tb);
         gen_helper_power_down(tcg_ctx, tcg_ctx->cpu_env);
         goto done_generating;
     }
@@ -5408,23 +5409,29 @@ static inline void gen_intermediate_code_internal(SPARCCPU *cpu,
 
     // Unicorn: early check to see if the address of this block is the until address
     if (tb->pc == env->uc->addr_end) {
-        gen_tb_start(tcg_ctx);
+        gen_tb_start(tcg_ctx, tb);
         save_state(dc);
         gen_helper_power_down(tcg_ctx, tcg_ctx->cpu_env);
         goto done_generating;
     }
 
+    // the instruction budget is checked before the block hook, which must
+    // not see a block that does not run
+    gen_tb_start(tcg_ctx, tb);
+
     // Unicorn: trace this block on request
     // Only hook this block if it is not broken from previous translation due to
     // full translation cache
     if (!env->uc->block_full && HOOK_EXISTS_BOUNDED(env->uc, UC_HOOK_BLOCK, pc_start)) {
         // save block address to see if we need to patch block size later
         env->uc->block_addr = pc_start;
-        env->uc->size_arg = tcg_ctx->gen_opparam_buf - tcg_ctx->gen_opparam_ptr + 1;
+        env->uc->size_arg = tcg_ctx->gen_opparam_ptr - tcg_ctx->gen_opparam_buf + 1;
         gen_uc_tracecode(tcg_ctx, 0xf8f8f8f8, UC_HOOK_BLOCK_IDX, env->uc, pc_start);
+        // the callback might want to stop emulation immediately
+        check_exit_request(tcg_ctx);
+    } else {
+        env->uc->size_arg = -1;
     }
-
-    gen_tb_start(tcg_ctx);
     do {
         if (unlikely(!QTAILQ_EMPTY(&cs->breakpoints))) {
             QTAILQ_FOREACH(bp, &cs->breakpoints, entry) {
@@ -5451,6 +5458,7 @@ static inline void gen_intermediate_code_internal(SPARCCPU *cpu,
                 tcg_ctx->gen_opc_icount[lj] = num_insns;
             }
         }
+        gen_insn_start_icount(tcg_ctx, num_insns);
         //if (num_insns + 1 == max_insns && (tb->cflags & CF_LAST_IO))
         //    gen_io_start();
         // Unicorn: end address tells us to stop emulation
@@ -1288,6 +1288,7 @@ static inline void tcg_out_tlb_load(TCGContext *s, TCGReg addrlo, TCGReg addrhi,
     TCGType ttype = TCG_TYPE_I32;
     TCGType htype = TCG_TYPE_I32;
     int trexw = 0, hrexw = 0;
+    int ofs = 0;
 
     if (TCG_TARGET_REG_BITS == 64) {
         if (TARGET_LONG_BITS == 64) {
@@ -1308,15 +1309,25 @@ static inline void tcg_out_tlb_load(TCGContext *s, TCGReg addrlo, TCGReg addrhi,
 
     tgen_arithi(s, ARITH_AND + trexw, r1,
                 TARGET_PAGE_MASK | ((1 << s_bits) - 1), 0);
+#ifdef CPU_TLB_DYNAMIC
+    /* Unicorn: the TLB of each MMU mode has its own size & table,
+       so r0 ends up at the entry instead of at its field WHICH */
+    ofs = which;
+    tcg_out_modrm_offset(s, OPC_ARITH_GvEv + (ARITH_AND << 3) + hrexw, r0,
+                         TCG_AREG0, offsetof(CPUArchState, tlb_mask[mem_index]));
+    tcg_out_modrm_offset(s, OPC_ADD_GvEv + hrexw, r0, TCG_AREG0,
+                         offsetof(CPUArchState, tlb_table[mem_index]));
+#else
     tgen_arithi(s, ARITH_AND + hrexw, r0,
                 (CPU_TLB_SIZE - 1) << CPU_TLB_ENTRY_BITS, 0);
 
     tcg_out_modrm_sib_offset(s, OPC_LEA + hrexw, r0, TCG_AREG0, r0, 0,
                              offsetof(CPUArchState, tlb_table[mem_index][0])
                              + which);
+#endif
 
-    /* cmp 0(r0), r1 */
-    tcg_out_modrm_offset(s, OPC_CMP_GvEv + trexw, r1, r0, 0);
+    /* cmp ofs(r0), r1 */
+    tcg_out_modrm_offset(s, OPC_CMP_GvEv + trexw, r1, r0, ofs);
 
     /* Prepare for both the fast path add of the tlb addend, and the slow
        path function argument setup.  There are two cases worth note:
@@ -1326,17 +1337,15 @@ static inline void tcg_out_tlb_load(TCGContext *s, TCGReg addrlo, TCGReg addrhi,
        for the 32-bit host happens with the fastpath ADDL below.  */
     tcg_out_mov(s, ttype, r1, addrlo);
 
-    // Unicorn: fast path if hookmem is not enable
-    if (!HOOK_EXISTS(s->uc, UC_HOOK_MEM_READ) && !HOOK_EXISTS(s->uc, UC_HOOK_MEM_WRITE))
-        tcg_out_opc(s, OPC_JCC_long + JCC_JNE, 0, 0, 0);
-    else
-        tcg_out_opc(s, OPC_JMP_long, 0, 0, 0); /* slow_path */
+    /* jne slow_path */
+    // Unicorn: entries of pages with memory hooks never match, see TLB_HOOKED
+    tcg_out_opc(s, OPC_JCC_long + JCC_JNE, 0, 0, 0);
     label_ptr[0] = s->code_ptr;
     s->code_ptr += 4;
 
     if (TARGET_LONG_BITS > TCG_TARGET_REG_BITS) {
-        /* cmp 4(r0), addrhi */
-        tcg_out_modrm_offset(s, OPC_CMP_GvEv, addrhi, r0, 4);
+        /* cmp ofs+4(r0), addrhi */
+        tcg_out_modrm_offset(s, OPC_CMP_GvEv, addrhi, r0, ofs + 4);
 
         /* jne slow_path */
         tcg_out_opc(s, OPC_JCC_long + JCC_JNE, 0, 0, 0);
@@ -1346,9 +1355,89 @@ static inline void tcg_out_tlb_load(TCGContext *s, TCGReg addrlo, TCGReg addrhi,
 
     /* TLB Hit.  */
 
-    /* add addend(r0), r1 */
+    // Unicorn: count it, see UC_OPT_TLB_COUNT_HITS
+    if (s->uc->tlb_count_hits) {
+        /* add $1, tlb_hits(env) */
+        tcg_out_modrm_offset(s, OPC_ARITH_EvIb + hrexw, ARITH_ADD, TCG_AREG0,
+                             offsetof(CPUArchState, tlb_hits));
+        tcg_out8(s, 1);
+    }
+
+    /* add addend-which+ofs(r0), r1 */
     tcg_out_modrm_offset(s, OPC_ADD_GvEv + hrexw, r1, r0,
-                         offsetof(CPUTLBEntry, addend) - which);
+                         offsetof(CPUTLBEntry, addend) - which + ofs);
+}
+
+/*
+ * Unicorn: with UC_OPT_FASTMEM, try the RAM window of the CPU before the TLB,
+ * see tlb_fastmem_update(). On a hit, L1 is left with the host address.
+ * Misses jump to LABEL_PTR, which the caller patches to the TLB lookup.
+ * Stores to pages with translated code are misses, to catch SMC.
+ */
+static bool tcg_out_fastmem_check(TCGContext *s, TCGReg addrlo, TCGMemOp s_bits,
+                                  bool is_store, tcg_insn_unit **label_ptr)
+{
+#if TCG_TARGET_REG_BITS == 64 && TARGET_LONG_BITS == 32
+    const TCGReg r0 = TCG_REG_L0;
+    const TCGReg r1 = TCG_REG_L1;
+
+    if (!s->uc->fastmem || HOOK_EXISTS(s->uc, UC_HOOK_MEM_READ)
+            || HOOK_EXISTS(s->uc, UC_HOOK_MEM_READ_AFTER)
+            || HOOK_EXISTS(s->uc, UC_HOOK_MEM_WRITE)) {
+        return false;
+    }
+
+    /* offset into the window: MOVL zero-extends, and below the window
+       the 32-bit SUB wraps to an offset past its end */
+    tcg_out_mov(s, TCG_TYPE_I32, r1, addrlo);
+    tcg_out_modrm_offset(s, OPC_ARITH_GvEv | (ARITH_SUB << 3), r1, TCG_AREG0,
+                         offsetof(CPUArchState, fastmem_begin));
+    tcg_out_modrm_offset(s, OPC_CMP_GvEv + P_REXW, r1, TCG_AREG0,
+                         offsetof(CPUArchState, fastmem_end[s_bits]));
+    tcg_out_opc(s, OPC_JCC_long + JCC_JAE, 0, 0, 0);
+    label_ptr[0] = s->code_ptr;
+    s->code_ptr += 4;
+
+    if (is_store) {
+        /* movzbl code[offset >> TARGET_PAGE_BITS], r0 */
+        tcg_out_mov(s, TCG_TYPE_I64, r0, r1);
+        tcg_out_shifti(s, SHIFT_SHR + P_REXW, r0, TARGET_PAGE_BITS);
+        tcg_out_modrm_offset(s, OPC_ADD_GvEv + P_REXW, r0, TCG_AREG0,
+                             offsetof(CPUArchState, fastmem_code));
+        tcg_out_modrm_offset(s, OPC_MOVZBL, r0, r0, 0);
+        tcg_out_modrm(s, OPC_TESTL, r0, r0);
+        tcg_out_opc(s, OPC_JCC_long + JCC_JNE, 0, 0, 0);
+        label_ptr[1] = s->code_ptr;
+        s->code_ptr += 4;
+    }
+
+    tcg_out_modrm_offset(s, OPC_ADD_GvEv + P_REXW, r1, TCG_AREG0,
+                         offsetof(CPUArchState, fastmem_host));
+    return true;
+#else
+    return false;
+#endif
+}
+
+/*
+ * Unicorn: after the access from the RAM window, skip the TLB lookup
+ * that its misses go to, and return where to patch the end of the lookup.
+ */
+static tcg_insn_unit *tcg_out_fastmem_done(TCGContext *s, bool is_store,
+                                           tcg_insn_unit **label_ptr)
+{
+    tcg_insn_unit *done_ptr;
+
+    tcg_out_opc(s, OPC_JMP_long, 0, 0, 0);
+    done_ptr = s->code_ptr;
+    s->code_ptr += 4;
+
+    tcg_patch32(label_ptr[0], s->code_ptr - label_ptr[0] - 4);
+    if (is_store) {
+        tcg_patch32(label_ptr[1], s->code_ptr - label_ptr[1] - 4);
+    }
+
+    return done_ptr;
 }
 
 /*
@@ -1645,6 +1734,7 @@ static void tcg_out_qemu_ld(TCGContext *s, const TCGArg *args, bool is64)
     int mem_index;
     TCGMemOp s_bits;
     tcg_insn_unit *label_ptr[2];
+    tcg_insn_unit *fastmem_done = NULL;
 #endif
 
     datalo = *args++;
@@ -1657,6 +1747,11 @@ static void tcg_out_qemu_ld(TCGContext *s, const TCGArg *args, bool is64)
     mem_index = *args++;
     s_bits = opc & MO_SIZE;
 
+    if (tcg_out_fastmem_check(s, addrlo, s_bits, false, label_ptr)) {
+        tcg_out_qemu_ld_direct(s, datalo, datahi, TCG_REG_L1, 0, 0, opc);
+        fastmem_done = tcg_out_fastmem_done(s, false, label_ptr);
+    }
+
     tcg_out_tlb_load(s, addrlo, addrhi, mem_index, s_bits,
                      label_ptr, offsetof(CPUTLBEntry, addr_read));
 
@@ -1666,6 +1761,10 @@ static void tcg_out_qemu_ld(TCGContext *s, const TCGArg *args, bool is64)
     /* Record the current context of a load into ldst label */
     add_qemu_ldst_label(s, true, opc, datalo, datahi, addrlo, addrhi,
                         mem_index, s->code_ptr, label_ptr);
+
+    if (fastmem_done) {
+        tcg_patch32(fastmem_done, s->code_ptr - fastmem_done - 4);
+    }
 #else
     {
         int32_t offset = GUEST_BASE;
@@ -1776,6 +1875,7 @@ static void tcg_out_qemu_st(TCGContext *s, const TCGArg *args, bool is64)
     int mem_index;
     TCGMemOp s_bits;
     tcg_insn_unit *label_ptr[2];
+    tcg_insn_unit *fastmem_done = NULL;
 #endif
 
     datalo = *args++;
@@ -1788,6 +1888,11 @@ static void tcg_out_qemu_st(TCGContext *s, const TCGArg *args, bool is64)
     mem_index = *args++;
     s_bits = opc & MO_SIZE;
 
+    if (tcg_out_fastmem_check(s, addrlo, s_bits, true, label_ptr)) {
+        tcg_out_qemu_st_direct(s, datalo, datahi, TCG_REG_L1, 0, 0, opc);
+        fastmem_done = tcg_out_fastmem_done(s, true, label_ptr);
+    }
+
     tcg_out_tlb_load(s, addrlo, addrhi, mem_index, s_bits,
                      label_ptr, offsetof(CPUTLBEntry, addr_write));
 
@@ -1797,6 +1902,10 @@ static void tcg_out_qemu_st(TCGContext *s, const TCGArg *args, bool is64)
     /* Record the current context of a store into ldst label */
     add_qemu_ldst_label(s, false, opc, datalo, datahi, addrlo, addrhi,
                         mem_index, s->code_ptr, label_ptr);
+
+    if (fastmem_done) {
+        tcg_patch32(fastmem_done, s->code_ptr - fastmem_done - 4);
+    }
 #else
     {
         int32_t offset = GUEST_BASE;
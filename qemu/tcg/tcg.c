@@ -61,6 +61,8 @@
 
 #include "elf.h"
 
+#include "uc_priv.h"
+
 /* Forward declarations for functions declared in tcg-target.c and used here. */
 static void tcg_target_init(TCGContext *s);
 static void tcg_target_qemu_prologue(TCGContext *s);
@@ -947,6 +949,64 @@ void check_exit_request(TCGContext *tcg_ctx)
     tcg_temp_free_i32(tcg_ctx, flag);
 }
 
+// Unicorn engine
+// signature of uc_cb_hookcode_t, to call code hooks like TCG helpers
+static const TCGHelperInfo uc_hookcode_info = {
+    .name = "uc_hookcode",
+    .flags = 0,
+    .sizemask = dh_sizemask(void, 0) | dh_sizemask(ptr, 1) | dh_sizemask(i64, 2)
+        | dh_sizemask(i32, 3) | dh_sizemask(ptr, 4),
+};
+
+// call the code hooks covering @pc right from the translated code,
+// rather than through helper_uc_tracecode(). The caller syncs the PC.
+void gen_uc_hookcode(TCGContext *tcg_ctx, uint64_t pc, uint32_t size)
+{
+    struct hook **cur, **last;
+    struct hook *hook;
+    TCGv_ptr tuc, tdata;
+    TCGv_i64 tpc, tcalls;
+    TCGv_i32 tsize;
+    TCGArg args[4];
+    int calls = 0;
+
+    tuc = tcg_const_ptr(tcg_ctx, tcg_ctx->uc);
+    tpc = tcg_const_i64(tcg_ctx, pc);
+    tsize = tcg_const_i32(tcg_ctx, size);
+
+    for (cur = hook_index_find(tcg_ctx->uc, UC_HOOK_CODE_IDX, pc, &last); cur < last; cur++) {
+        hook = *cur;
+        if (hook->to_delete)
+            continue;
+
+        // tcg_gen_callN() looks up the calling convention by function
+        if (!g_hash_table_lookup(tcg_ctx->helpers, hook->callback))
+            g_hash_table_insert(tcg_ctx->helpers, hook->callback, (gpointer)&uc_hookcode_info);
+
+        tdata = tcg_const_ptr(tcg_ctx, hook->user_data);
+        args[0] = GET_TCGV_PTR(tuc);
+        args[1] = GET_TCGV_I64(tpc);
+        args[2] = GET_TCGV_I32(tsize);
+        args[3] = GET_TCGV_PTR(tdata);
+        tcg_gen_callN(tcg_ctx, hook->callback, TCG_CALL_DUMMY_ARG, 4, args);
+        tcg_temp_free_ptr(tcg_ctx, tdata);
+        calls++;
+    }
+
+    // count them for uc_stats_get(), as helper_uc_tracecode() does
+    if (calls) {
+        tcalls = tcg_temp_new_i64(tcg_ctx);
+        tcg_gen_ld_i64(tcg_ctx, tcalls, tuc, offsetof(struct uc_struct, hook_calls[UC_HOOK_CODE_IDX]));
+        tcg_gen_addi_i64(tcg_ctx, tcalls, tcalls, calls);
+        tcg_gen_st_i64(tcg_ctx, tcalls, tuc, offsetof(struct uc_struct, hook_calls[UC_HOOK_CODE_IDX]));
+        tcg_temp_free_i64(tcg_ctx, tcalls);
+    }
+
+    tcg_temp_free_i32(tcg_ctx, tsize);
+    tcg_temp_free_i64(tcg_ctx, tpc);
+    tcg_temp_free_ptr(tcg_ctx, tuc);
+}
+
 void tcg_gen_qemu_ld_i32(struct uc_struct *uc, TCGv_i32 val, TCGv addr, TCGArg idx, TCGMemOp memop)
 {
     TCGContext *tcg_ctx = uc->tcg_ctx;
@@ -758,7 +758,11 @@ struct TCGContext {
     void *cpu_hintp, *cpu_htba, *cpu_hver, *cpu_ssr, *cpu_ver;
     void *cpu_wim;
 
-    int exitreq_label;  // gen_tb_start()
+    int exitreq_start_label;    // gen_tb_start(), before the TB is counted
+    int exitreq_label;  // gen_tb_start(), for check_exit_request()
+    int icount_label;   // gen_tb_start()
+    bool icount_insn;   // gen_insn_start_icount() notes the instruction
+    TCGArg *icount_arg; // gen_tb_end() patches the TB instruction count here
 };
 
 typedef struct TCGTargetOpDef {
@@ -1006,6 +1010,7 @@ void helper_be_stq_mmu(CPUArchState *env, target_ulong addr, uint64_t val,
 #endif
 
 void check_exit_request(TCGContext *tcg_ctx);
+void gen_uc_hookcode(TCGContext *tcg_ctx, uint64_t pc, uint32_t size);
 
 #endif /* CONFIG_SOFTMMU */
 
@@ -210,6 +210,9 @@ static int cpu_gen_code(CPUArchState *env, TranslationBlock *tb, int *gen_code_s
 #endif
     tcg_func_start(s);
 
+    // Unicorn: the TB at the until address has no block hook, so the slot of
+    // the last TB translated must not be patched in it
+    env->uc->size_arg = -1;
     gen_intermediate_code(env, tb);
 
     // Unicorn: when tracing block, patch block size operand for callback
@@ -299,7 +302,9 @@ static int cpu_restore_state_from_tb(CPUState *cpu, TranslationBlock *tb,
     while (s->gen_opc_instr_start[j] == 0) {
         j--;
     }
-    cpu->icount_decr.u16.low -= s->gen_opc_icount[j];
+    // Unicorn: the whole TB was taken off the instruction budget on entry,
+    // give back what did not run
+    cpu->icount_decr.u32 += tb->icount - s->gen_opc_icount[j];
 
     restore_state_to_opc(env, tb, j);
 
@@ -735,6 +740,37 @@ static inline void *alloc_code_gen_buffer(struct uc_struct *uc)
 }
 #endif /* USE_STATIC_CODE_GEN_BUFFER, USE_MMAP */
 
+/* Unicorn: split the translation buffer into regions of at least
+   MIN_CODE_GEN_BUFFER_SIZE, so that running out of room only evicts the
+   oldest region. A buffer of the minimum size is still flushed as a whole */
+static void code_gen_alloc_regions(struct uc_struct *uc)
+{
+    TCGContext *tcg_ctx = uc->tcg_ctx;
+    TBContext *tb_ctx = &tcg_ctx->tb_ctx;
+    int i;
+
+    tb_ctx->nb_regions = uc->code_buffer_size / MIN_CODE_GEN_BUFFER_SIZE;
+    if (tb_ctx->nb_regions < 1) {
+        tb_ctx->nb_regions = 1;
+    }
+    if (tb_ctx->nb_regions > TB_MAX_REGIONS) {
+        tb_ctx->nb_regions = TB_MAX_REGIONS;
+    }
+    tb_ctx->region_size = (tcg_ctx->code_gen_buffer_size / tb_ctx->nb_regions) &
+        ~(size_t)(CODE_GEN_ALIGN - 1);
+    tb_ctx->region_max_size = tb_ctx->region_size - (TCG_MAX_OP_SIZE * OPC_BUF_SIZE);
+    tb_ctx->region_max_tbs = tcg_ctx->code_gen_max_blocks / tb_ctx->nb_regions;
+
+    for (i = 0; i < tb_ctx->nb_regions; i++) {
+        tb_ctx->regions[i].start = (char *)tcg_ctx->code_gen_buffer + i * tb_ctx->region_size;
+        tb_ctx->regions[i].end = tb_ctx->regions[i].start;
+        tb_ctx->regions[i].tbs = tb_ctx->tbs + i * tb_ctx->region_max_tbs;
+        tb_ctx->regions[i].nb_tbs = 0;
+    }
+    tb_ctx->region = 0;
+    tb_ctx->nb_tbs = 0;
+}
+
 static inline void code_gen_alloc(struct uc_struct *uc, size_t tb_size)
 {
     TCGContext *tcg_ctx = uc->tcg_ctx;
@@ -745,6 +781,8 @@ static inline void code_gen_alloc(struct uc_struct *uc, size_t tb_size)
         fprintf(stderr, "Could not allocate dynamic translator buffer\n");
         exit(1);
     }
+    uc->code_buffer_size = tcg_ctx->code_gen_buffer_size;
+    uc->code_buffer_used = 0;
 
     //qemu_madvise(tcg_ctx.code_gen_buffer, tcg_ctx.code_gen_buffer_size,
     //        QEMU_MADV_HUGEPAGE);
@@ -764,6 +802,8 @@ static inline void code_gen_alloc(struct uc_struct *uc, size_t tb_size)
             CODE_GEN_AVG_BLOCK_SIZE;
     tcg_ctx->tb_ctx.tbs =
             g_malloc(tcg_ctx->code_gen_max_blocks * sizeof(TranslationBlock));
+
+    code_gen_alloc_regions(uc);
 }
 
 /* Must be called before using the QEMU cpus. 'tb_size' is the size
@@ -786,40 +826,96 @@ void tcg_exec_init(struct uc_struct *uc, unsigned long tb_size)
 #endif
 }
 
+/* Unicorn: replace the translation buffer by one of 'tb_size' bytes, see
+   UC_OPT_CODE_BUFFER_SIZE. Translated code is dropped, so this must not be
+   called while it is running */
+void tcg_exec_resize(struct uc_struct *uc, unsigned long tb_size)
+{
+    TCGContext *tcg_ctx = uc->tcg_ctx;
+
+    tb_flush_all(uc);
+    free_code_gen_buffer(uc);
+    g_free(tcg_ctx->tb_ctx.tbs);
+    code_gen_alloc(uc, tb_size);
+    tcg_ctx->code_gen_ptr = tcg_ctx->code_gen_buffer;
+    tcg_prologue_init(tcg_ctx);
+}
+
 bool tcg_enabled(struct uc_struct *uc)
 {
     TCGContext *tcg_ctx = uc->tcg_ctx;
     return tcg_ctx->code_gen_buffer != NULL;
 }
 
-/* Allocate a new translation block. Flush the translation buffer if
-   too many translation blocks or too much generated code. */
+/* Allocate a new translation block in the current region of the buffer.
+   Return NULL if it has too many translation blocks or too much generated
+   code, see tb_evict_region(). */
 static TranslationBlock *tb_alloc(struct uc_struct *uc, target_ulong pc)
 {
     TranslationBlock *tb;
     TCGContext *tcg_ctx = uc->tcg_ctx;
+    TBRegion *region = &tcg_ctx->tb_ctx.regions[tcg_ctx->tb_ctx.region];
 
-    if (tcg_ctx->tb_ctx.nb_tbs >= tcg_ctx->code_gen_max_blocks ||
-        (size_t)(((char*)tcg_ctx->code_gen_ptr - (char*)tcg_ctx->code_gen_buffer)) >=
-         tcg_ctx->code_gen_buffer_max_size) {
+    if (region->nb_tbs >= tcg_ctx->tb_ctx.region_max_tbs ||
+        (size_t)(((char*)tcg_ctx->code_gen_ptr - (char*)region->start)) >=
+         tcg_ctx->tb_ctx.region_max_size) {
         return NULL;
     }
-    tb = &tcg_ctx->tb_ctx.tbs[tcg_ctx->tb_ctx.nb_tbs++];
+    tb = &region->tbs[region->nb_tbs++];
+    tcg_ctx->tb_ctx.nb_tbs++;
     tb->pc = pc;
     tb->cflags = 0;
+    tb->invalid = false;
+    tb->exec_count = 0;
     return tb;
 }
 
+/* Unicorn: move the runs counted by the code of 'tb' to the profile of the
+   engine, before the TB is dropped or when the profile is read */
+static inline void tb_profile_keep(struct uc_struct *uc, TranslationBlock *tb)
+{
+    /* the empty TB at the until address of uc_emu_start() is no guest code */
+    if (tb->exec_count && tb->size) {
+        uc_profile_keep(uc, tb->pc, tb->flags, tb->seq, tb->size, tb->tc_size,
+                tb->exec_count);
+    }
+    tb->exec_count = 0;
+}
+
+static void tb_profile_keep_region(struct uc_struct *uc, TBRegion *region)
+{
+    int i;
+
+    for (i = 0; i < region->nb_tbs; i++) {
+        tb_profile_keep(uc, &region->tbs[i]);
+    }
+}
+
+/* Unicorn: move the runs counted by all TBs to the profile, see uc_profile_get() */
+void tb_profile_harvest(struct uc_struct *uc)
+{
+    TCGContext *tcg_ctx = uc->tcg_ctx;
+    int i;
+
+    for (i = 0; i < tcg_ctx->tb_ctx.nb_regions; i++) {
+        tb_profile_keep_region(uc, &tcg_ctx->tb_ctx.regions[i]);
+    }
+}
+
 void tb_free(struct uc_struct *uc, TranslationBlock *tb)
 {
     TCGContext *tcg_ctx = uc->tcg_ctx;
+    TBRegion *region = &tcg_ctx->tb_ctx.regions[tcg_ctx->tb_ctx.region];
 
     /* In practice this is mostly used for single use temporary TB
        Ignore the hard cases and just back up if this TB happens to
        be the last one generated.  */
-    if (tcg_ctx->tb_ctx.nb_tbs > 0 &&
-            tb == &tcg_ctx->tb_ctx.tbs[tcg_ctx->tb_ctx.nb_tbs - 1]) {
+    if (region->nb_tbs > 0 &&
+            tb == &region->tbs[region->nb_tbs - 1]) {
+        tb_profile_keep(uc, tb);
+        uc->code_buffer_used -= (char*)tcg_ctx->code_gen_ptr - (char*)tb->tc_ptr;
         tcg_ctx->code_gen_ptr = tb->tc_ptr;
+        region->nb_tbs--;
         tcg_ctx->tb_ctx.nb_tbs--;
     }
 }
@@ -876,6 +972,7 @@ void tb_flush(CPUArchState *env1)
     CPUState *cpu = ENV_GET_CPU(env1);
     struct uc_struct* uc = cpu->uc;
     TCGContext *tcg_ctx = uc->tcg_ctx;
+    int i;
 
 #if defined(DEBUG_FLUSH)
     printf("qemu: flush code_size=%ld nb_tbs=%d avg_tb_size=%ld\n",
@@ -888,7 +985,13 @@ void tb_flush(CPUArchState *env1)
         > tcg_ctx->code_gen_buffer_size) {
         cpu_abort(cpu, "Internal error: code buffer overflow\n");
     }
+    tb_profile_harvest(uc);
     tcg_ctx->tb_ctx.nb_tbs = 0;
+    for (i = 0; i < tcg_ctx->tb_ctx.nb_regions; i++) {
+        tcg_ctx->tb_ctx.regions[i].end = tcg_ctx->tb_ctx.regions[i].start;
+        tcg_ctx->tb_ctx.regions[i].nb_tbs = 0;
+    }
+    tcg_ctx->tb_ctx.region = 0;
 
     memset(cpu->tb_jmp_cache, 0, sizeof(cpu->tb_jmp_cache));
 
@@ -899,6 +1002,42 @@ void tb_flush(CPUArchState *env1)
     /* XXX: flush processor icache at this point if cache flush is
        expensive */
     tcg_ctx->tb_ctx.tb_flush_count++;
+    uc->code_buffer_used = 0;
+    uc->tb_flushes++;
+}
+
+/* Unicorn: make room in the translation buffer by moving on to the next
+   region, and dropping the TBs it holds, which are the oldest ones */
+static void tb_evict_region(CPUArchState *env)
+{
+    struct uc_struct *uc = env->uc;
+    TCGContext *tcg_ctx = uc->tcg_ctx;
+    TBContext *tb_ctx = &tcg_ctx->tb_ctx;
+    TBRegion *region;
+    int i;
+
+    if (tb_ctx->nb_regions == 1) {
+        tb_flush(env);
+        return;
+    }
+
+    tb_ctx->regions[tb_ctx->region].end = tcg_ctx->code_gen_ptr;
+    tb_ctx->region = (tb_ctx->region + 1) % tb_ctx->nb_regions;
+    region = &tb_ctx->regions[tb_ctx->region];
+
+    /* newest first: page lists start with the TBs linked last */
+    for (i = region->nb_tbs - 1; i >= 0; i--) {
+        if (!region->tbs[i].invalid) {
+            tb_phys_invalidate(uc, &region->tbs[i], -1);
+            uc->tb_evicted++;
+        }
+    }
+    tb_profile_keep_region(uc, region);
+    tb_ctx->nb_tbs -= region->nb_tbs;
+    region->nb_tbs = 0;
+    uc->code_buffer_used -= (char*)region->end - (char*)region->start;
+    region->end = region->start;
+    tcg_ctx->code_gen_ptr = region->start;
 }
 
 #ifdef DEBUG_TB_CHECK
@@ -1064,6 +1203,7 @@ void tb_phys_invalidate(struct uc_struct *uc,
         tb1 = tb2;
     }
     tb->jmp_first = (TranslationBlock *)((uintptr_t)tb | 2); /* fail safe */
+    tb->invalid = true;
 
     tcg_ctx->tb_ctx.tb_phys_invalidate_count++;
 }
@@ -1134,12 +1274,13 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
     tb_page_addr_t phys_pc, phys_page2;
     int code_gen_size;
     int ret;
+    int64_t start;
 
     phys_pc = get_page_addr_code(env, pc);
     tb = tb_alloc(env->uc, pc);
     if (!tb) {
-        /* flush must be done */
-        tb_flush(env);
+        /* eviction must be done */
+        tb_evict_region(env);
         /* cannot fail at this point */
         tb = tb_alloc(env->uc, pc);
         /* Don't forget to invalidate previous TB info.  */
@@ -1149,13 +1290,19 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
     tb->cs_base = cs_base;
     tb->flags = flags;
     tb->cflags = cflags;
+    // Unicorn: remember this TB until it is linked, in case translation faults
+    tcg_ctx->tb_ctx.tb_partial = tb;
+    start = get_clock();
     ret = cpu_gen_code(env, tb, &code_gen_size);  // qq
+    env->uc->translate_ns += get_clock() - start;
+    tcg_ctx->tb_ctx.tb_partial = NULL;
     if (ret == -1) {
         tb_free(env->uc, tb);
         return NULL;
     }
     tcg_ctx->code_gen_ptr = (void *)(((uintptr_t)tcg_ctx->code_gen_ptr +
             code_gen_size + CODE_GEN_ALIGN - 1) & ~(CODE_GEN_ALIGN - 1));
+    env->uc->code_buffer_used += (char*)tcg_ctx->code_gen_ptr - (char*)tb->tc_ptr;
 
     phys_page2 = -1;
     /* check next page if needed */
@@ -1166,9 +1313,96 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
         }
     }
     tb_link_page(cpu->uc, tb, phys_pc, phys_page2);
+    tb->seq = env->uc->tb_translated++;
+    env->uc->tb_guest_bytes += tb->size;
+    env->uc->tb_host_bytes += code_gen_size;
+    tb->tc_size = code_gen_size;
     return tb;
 }
 
+/* Unicorn: drop the TB left behind when translation was aborted by a
+   longjmp (eg. fetching code from unmapped memory), so that it does not
+   linger in the TB array once the translation cache outlives cpu_exec() */
+void tb_discard_partial(struct uc_struct *uc)
+{
+    TCGContext *tcg_ctx = uc->tcg_ctx;
+
+    if (tcg_ctx->tb_ctx.tb_partial) {
+        tb_free(uc, tcg_ctx->tb_ctx.tb_partial);
+        tcg_ctx->tb_ctx.tb_partial = NULL;
+    }
+
+    // same for a TB of cpu_exec_nocache() leaving through an exception
+    if (tcg_ctx->tb_ctx.tb_nocache) {
+        tb_phys_invalidate(uc, tcg_ctx->tb_ctx.tb_nocache, -1);
+        tb_free(uc, tcg_ctx->tb_ctx.tb_nocache);
+        tcg_ctx->tb_ctx.tb_nocache = NULL;
+    }
+}
+
+/* Unicorn: flush the whole translation cache. Must not be called while
+   translated code is running */
+void tb_flush_all(struct uc_struct *uc)
+{
+    TCGContext *tcg_ctx = uc->tcg_ctx;
+
+    if (tcg_ctx->tb_ctx.nb_tbs > 0) {
+        tb_flush(uc->cpu->env_ptr);
+    }
+}
+
+/* Unicorn: invalidate all TBs translated from the guest memory
+   [start, start + len[, as mapped by uc_mem_map() */
+void tb_invalidate_uc_range(struct uc_struct *uc, uint64_t start, size_t len)
+{
+    TCGContext *tcg_ctx = uc->tcg_ctx;
+    MemoryRegion *mr;
+    ram_addr_t ram_addr;
+    uint64_t end = start + len;
+    size_t l;
+
+    if (tcg_ctx->tb_ctx.nb_tbs == 0) {
+        return;
+    }
+
+    while (start < end) {
+        mr = memory_mapping(uc, start);
+        if (mr == NULL) {
+            // skip the unmapped page
+            start = (start & TARGET_PAGE_MASK) + TARGET_PAGE_SIZE;
+            continue;
+        }
+        l = (size_t)MIN(end - start, mr->end - start);
+        ram_addr = memory_region_get_ram_addr(mr) + (start - mr->addr);
+        tb_invalidate_phys_range(uc, ram_addr, ram_addr + l, 0);
+        start += l;
+    }
+}
+
+static void tb_invalidate_vaddr(struct uc_struct *uc, target_ulong addr)
+{
+    hwaddr phys = cpu_get_phys_page_debug(uc->cpu, addr);
+
+    if (phys != -1) {
+        tb_invalidate_phys_addr(&uc->as, phys | (addr & ~TARGET_PAGE_MASK));
+    }
+}
+
+/* Unicorn: translation stops at the @until address of uc_emu_start(), so the
+   TBs covering @addr, the TB cut short right before it and the stub TB
+   starting at it are only valid for this very @until address */
+void tb_invalidate_addr_end(struct uc_struct *uc, uint64_t addr)
+{
+    TCGContext *tcg_ctx = uc->tcg_ctx;
+
+    if (tcg_ctx->tb_ctx.nb_tbs == 0) {
+        return;
+    }
+
+    tb_invalidate_vaddr(uc, (target_ulong)addr - 1);
+    tb_invalidate_vaddr(uc, (target_ulong)addr);
+}
+
 /*
  * Invalidate all TBs which intersect with the target physical address range
  * [start;end[. NOTE: start and end may refer to *different* physical pages.
@@ -1242,7 +1476,9 @@ void tb_invalidate_phys_page_range(struct uc_struct *uc, tb_page_addr_t start, t
             /* NOTE: tb_end may be after the end of the page, but
                it is not a problem */
             tb_start = tb->page_addr[0] + (tb->pc & ~TARGET_PAGE_MASK);
-            tb_end = tb_start + tb->size;
+            /* Unicorn: the empty TB emitted at the @until address of
+               uc_emu_start() still depends on its first byte */
+            tb_end = tb_start + (tb->size ? tb->size : 1);
         } else {
             tb_start = tb->page_addr[1];
             tb_end = tb_start + ((tb->pc + tb->size) & ~TARGET_PAGE_MASK);
@@ -1280,6 +1516,9 @@ void tb_invalidate_phys_page_range(struct uc_struct *uc, tb_page_addr_t start, t
                 cpu->current_tb = NULL;
             }
             tb_phys_invalidate(uc, tb, -1);
+            if (is_cpu_write_access) {
+                uc->tb_invalidated++;
+            }
             if (cpu != NULL) {
                 cpu->current_tb = saved_tb;
                 if (cpu->interrupt_request && cpu->current_tb) {
@@ -1520,23 +1759,34 @@ static void tb_link_page(struct uc_struct *uc,
 static TranslationBlock *tb_find_pc(struct uc_struct *uc, uintptr_t tc_ptr)
 {
     TCGContext *tcg_ctx = uc->tcg_ctx;
+    TBRegion *region;
     int m_min, m_max, m;
+    size_t r;
     uintptr_t v;
     TranslationBlock *tb;
 
     if (tcg_ctx->tb_ctx.nb_tbs <= 0) {
         return NULL;
     }
-    if (tc_ptr < (uintptr_t)tcg_ctx->code_gen_buffer ||
-        tc_ptr >= (uintptr_t)tcg_ctx->code_gen_ptr) {
+    if (tc_ptr < (uintptr_t)tcg_ctx->code_gen_buffer) {
+        return NULL;
+    }
+    /* TBs are sorted within the region holding their code */
+    r = (tc_ptr - (uintptr_t)tcg_ctx->code_gen_buffer) / tcg_ctx->tb_ctx.region_size;
+    if (r >= tcg_ctx->tb_ctx.nb_regions) {
+        return NULL;
+    }
+    region = &tcg_ctx->tb_ctx.regions[r];
+    if (region->nb_tbs <= 0 || (r == tcg_ctx->tb_ctx.region &&
+            tc_ptr >= (uintptr_t)tcg_ctx->code_gen_ptr)) {
         return NULL;
     }
     /* binary search (cf Knuth) */
     m_min = 0;
-    m_max = tcg_ctx->tb_ctx.nb_tbs - 1;
+    m_max = region->nb_tbs - 1;
     while (m_min <= m_max) {
         m = (m_min + m_max) >> 1;
-        tb = &tcg_ctx->tb_ctx.tbs[m];
+        tb = &region->tbs[m];
         v = (uintptr_t)tb->tc_ptr;
         if (v == tc_ptr) {
             return tb;
@@ -1546,7 +1796,7 @@ static TranslationBlock *tb_find_pc(struct uc_struct *uc, uintptr_t tc_ptr)
             m_min = m + 1;
         }
     }
-    return &tcg_ctx->tb_ctx.tbs[m_max];
+    return &region->tbs[m_max];
 }
 
 #if defined(TARGET_HAS_ICE) && !defined(CONFIG_USER_ONLY)
@@ -21,6 +21,12 @@ static inline bool cpu_physical_mem_write(AddressSpace *as, hwaddr addr,
 
 void tb_cleanup(struct uc_struct *uc);
 void free_code_gen_buffer(struct uc_struct *uc);
+bool tlb_resize(struct uc_struct *uc, size_t entries);
+uc_err tlb_query(struct uc_struct *uc, uc_query_type type, size_t *result);
+void tlb_flush_all(struct uc_struct *uc);
+void cpu_physical_memory_dirty_get(struct uc_struct *uc, unsigned client, uint64_t start,
+                                   size_t len, uint64_t *bitmap);
+void cpu_physical_memory_dirty_reset(struct uc_struct *uc, unsigned client);
 
 /** Freeing common resources */
 static void release_common(void *t)
@@ -53,6 +59,7 @@ static void release_common(void *t)
     free_code_gen_buffer(s->uc);
     cpu_watchpoint_remove_all(CPU(s->uc->cpu), BP_CPU);
     cpu_breakpoint_remove_all(CPU(s->uc->cpu), BP_CPU);
+    tlb_destroy(s->uc->cpu);
 
 #if TCG_TARGET_REG_BITS == 32
     for(i = 0; i < s->nb_globals; i++) {
@@ -74,12 +81,25 @@ static inline void uc_common_init(struct uc_struct* uc)
     uc->read_mem = cpu_physical_mem_read;
     uc->tcg_enabled = tcg_enabled;
     uc->tcg_exec_init = tcg_exec_init;
+    uc->tcg_exec_resize = tcg_exec_resize;
     uc->cpu_exec_init_all = cpu_exec_init_all;
     uc->vm_start = vm_start;
     uc->memory_map = memory_map;
     uc->memory_map_ptr = memory_map_ptr;
     uc->memory_unmap = memory_unmap;
+    uc->memory_begin = memory_region_transaction_begin;
+    uc->memory_commit = memory_region_transaction_commit;
     uc->readonly_mem = memory_region_set_readonly;
+    uc->tb_flush_all = tb_flush_all;
+    uc->tb_invalidate_uc_range = tb_invalidate_uc_range;
+    uc->ram_written = cpu_physical_memory_written;
+    uc->tb_invalidate_addr_end = tb_invalidate_addr_end;
+    uc->tb_profile_harvest = tb_profile_harvest;
+    uc->tlb_resize = tlb_resize;
+    uc->tlb_query = tlb_query;
+    uc->tlb_flush_all = tlb_flush_all;
+    uc->dirty_get = cpu_physical_memory_dirty_get;
+    uc->dirty_reset = cpu_physical_memory_dirty_reset;
 
     uc->target_page_size = TARGET_PAGE_SIZE;
     uc->target_page_align = TARGET_PAGE_SIZE - 1;
@@ -139,3 +139,123 @@ void qemu_anon_ram_free(void *ptr, size_t size)
         munmap(ptr, size);
     }
 }
+
+/* Unicorn: move the RAM pages at @from to @to, replacing what is mapped
+   there, or anywhere if @to is NULL. Returns where they went, or NULL if
+   they have to be copied instead. */
+void *qemu_ram_move(void *from, void *to, size_t size)
+{
+#ifdef CONFIG_LINUX
+    size_t page = getpagesize();
+    void *ptr;
+
+    if (((uintptr_t)from | (uintptr_t)to | size) & (page - 1)) {
+        return NULL;
+    }
+    if (to == NULL) {
+        /* mremap() leaves pages where they are if it can: make room */
+        ptr = mmap(NULL, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ptr == MAP_FAILED) {
+            return NULL;
+        }
+        if (mremap(from, size, size, MREMAP_MAYMOVE | MREMAP_FIXED, ptr) == MAP_FAILED) {
+            munmap(ptr, size);
+            return NULL;
+        }
+        return ptr;
+    }
+    ptr = mremap(from, size, size, MREMAP_MAYMOVE | MREMAP_FIXED, to);
+    return ptr == MAP_FAILED ? NULL : ptr;
+#else
+    return NULL;
+#endif
+}
+
+/* Unicorn: copy-on-write RAM, see uc_fork(). A file of @size bytes, to
+   map RAM blocks from privately, or -1 if not supported. */
+int qemu_ram_cow_file(uint64_t size)
+{
+#if defined(CONFIG_LINUX) && defined(__NR_memfd_create)
+    int fd = syscall(__NR_memfd_create, "unicorn-ram", 1 /* MFD_CLOEXEC */);
+
+    if (fd < 0) {
+        return -1;
+    }
+    /* pages left out by qemu_ram_cow_freeze() are holes, reading as 0 */
+    if (ftruncate(fd, size) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+#else
+    return -1;
+#endif
+}
+
+void qemu_ram_cow_close(int fd)
+{
+    close(fd);
+}
+
+/* whole host pages only: a mapping rounded up would replace what follows */
+static bool ram_cow_aligned(uint64_t offset, void *host, size_t size)
+{
+    size_t page = getpagesize();
+
+    return !((offset | (uintptr_t)host | size) & (page - 1));
+}
+
+/* map @size bytes of @fd at @offset over the RAM at @host, copy-on-write.
+   False if it has to be copied instead */
+bool qemu_ram_cow_map(int fd, uint64_t offset, void *host, size_t size)
+{
+    if (!ram_cow_aligned(offset, host, size)) {
+        return false;
+    }
+    return mmap(host, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED,
+                fd, offset) != MAP_FAILED;
+}
+
+static bool page_is_zero(const uint64_t *page, size_t size)
+{
+    size_t i;
+
+    for (i = 0; i < size / sizeof(*page); i++) {
+        if (page[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* write the RAM at @host to @fd at @offset, then map it from there. False
+   if it has to be copied instead */
+bool qemu_ram_cow_freeze(int fd, uint64_t offset, void *host, size_t size)
+{
+    size_t page = getpagesize(), start, end;
+    uint8_t *ram = host;
+    ssize_t done;
+
+    if (!ram_cow_aligned(offset, host, size)) {
+        return false;
+    }
+    /* guest RAM is mostly untouched: write the runs of non-zero pages only */
+    for (start = 0; start < size; start = end) {
+        while (start < size && page_is_zero((uint64_t *)(ram + start), page)) {
+            start += page;
+        }
+        for (end = start; end < size && !page_is_zero((uint64_t *)(ram + end), page); end += page) {
+        }
+        while (start < end) {
+            done = pwrite(fd, ram + start, end - start, offset + start);
+            if (done < 0 && errno != EINTR) {
+                return false;
+            }
+            if (done > 0) {
+                start += done;
+            }
+        }
+    }
+
+    return qemu_ram_cow_map(fd, offset, host, size);
+}
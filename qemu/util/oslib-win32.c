@@ -94,6 +94,32 @@ void qemu_anon_ram_free(void *ptr, size_t size)
     }
 }
 
+/* Unicorn: RAM pages cannot be moved, they are copied */
+void *qemu_ram_move(void *from, void *to, size_t size)
+{
+    return NULL;
+}
+
+/* Unicorn: copy-on-write RAM is not supported, uc_fork() copies it */
+int qemu_ram_cow_file(uint64_t size)
+{
+    return -1;
+}
+
+void qemu_ram_cow_close(int fd)
+{
+}
+
+bool qemu_ram_cow_map(int fd, uint64_t offset, void *host, size_t size)
+{
+    return false;
+}
+
+bool qemu_ram_cow_freeze(int fd, uint64_t offset, void *host, size_t size)
+{
+    return false;
+}
+
 size_t getpagesize(void)
 {
     SYSTEM_INFO system_info;
@@ -0,0 +1,88 @@
+/*
+   Cost of hooks on a tight loop of chained blocks.
+
+   Runs an ARM loop of 3 instructions without hooks, with one block hook
+   and with one code hook, and prints the time per iteration and the TB
+   lookups. The lookups must stay flat: hooks are called from the
+   translated code, which keeps jumping from block to block.
+
+   Usage: hook_chain [iterations], 10000000 by default.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <unicorn/unicorn.h>
+
+#define ADDRESS 0x100000
+
+// loop: add r1, r1, #1; subs r0, r0, #1; bne loop
+#define ARM_CODE "\x01\x10\x81\xe2\x01\x00\x50\xe2\xfc\xff\xff\x1a"
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void hook_count(uc_engine *uc, uint64_t address, uint32_t size, void *user_data)
+{
+    (*(uint64_t *)user_data)++;
+}
+
+static int bench(const char *name, uc_hook_type type, uint32_t iterations)
+{
+    uc_engine *uc;
+    uc_hook hook;
+    uc_stats stats;
+    uint64_t calls = 0;
+    uc_err err;
+    double t0, t;
+
+    err = uc_open(UC_ARCH_ARM, UC_MODE_ARM, &uc);
+    if (err) {
+        printf("uc_open() failed: %s\n", uc_strerror(err));
+        return -1;
+    }
+
+    uc_mem_map(uc, ADDRESS, 0x1000, UC_PROT_ALL);
+    uc_mem_write(uc, ADDRESS, ARM_CODE, sizeof(ARM_CODE) - 1);
+    uc_reg_write(uc, UC_ARM_REG_R0, &iterations);
+    if (type)
+        uc_hook_add(uc, &hook, type, hook_count, &calls, 1, 0);
+
+    t0 = now();
+    err = uc_emu_start(uc, ADDRESS, ADDRESS + sizeof(ARM_CODE) - 1, 0, 0);
+    t = now() - t0;
+    if (err) {
+        printf("uc_emu_start() failed: %s\n", uc_strerror(err));
+        uc_close(uc);
+        return -1;
+    }
+
+    uc_stats_get(uc, &stats);
+    printf("%-10s: %7.2f ns per iteration, %10llu hook calls, %llu TB lookups\n",
+            name, t * 1e9 / iterations, (unsigned long long)calls,
+            (unsigned long long)(stats.tb_fast_hits + stats.tb_slow_lookups));
+
+    uc_close(uc);
+    return 0;
+}
+
+int main(int argc, char **argv, char **envp)
+{
+    uint32_t iterations = 10000000;
+
+    if (argc > 1)
+        iterations = strtoul(argv[1], NULL, 0);
+
+    if (bench("no hook", 0, iterations) ||
+            bench("block hook", UC_HOOK_BLOCK, iterations) ||
+            bench("code hook", UC_HOOK_CODE, iterations))
+        return 1;
+
+    return 0;
+}
@@ -0,0 +1,100 @@
+/*
+   Host-side memory lookup cost vs. number of mapped regions.
+
+   Maps N single-page regions with a hole between each, then times
+   uc_mem_read() on randomly picked regions, so the one-entry lookup
+   cache almost never hits. Reads from the holes fail in the region
+   lookup alone, so their cost should stay flat as N grows.
+
+   Usage: mem_lookup [max regions], 1000 by default. Every region and
+   hole needs a section in the physical map, which QEMU caps at
+   TARGET_PAGE_SIZE entries.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <unicorn/unicorn.h>
+
+#define BASE     0x10000000ULL
+#define PAGE     0x1000ULL
+#define ACCESSES 1000000
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int bench(unsigned int regions)
+{
+    uc_engine *uc;
+    uc_err err;
+    unsigned int i;
+    uint32_t val;
+    double t0, t_map, t_read, t_miss;
+
+    err = uc_open(UC_ARCH_X86, UC_MODE_64, &uc);
+    if (err) {
+        printf("uc_open() failed: %s\n", uc_strerror(err));
+        return -1;
+    }
+
+    t0 = now();
+    for (i = 0; i < regions; i++) {
+        err = uc_mem_map(uc, BASE + i * 2 * PAGE, PAGE, UC_PROT_ALL);
+        if (err) {
+            printf("uc_mem_map() failed: %s\n", uc_strerror(err));
+            uc_close(uc);
+            return -1;
+        }
+    }
+    t_map = now() - t0;
+
+    srand(regions);
+    t0 = now();
+    for (i = 0; i < ACCESSES; i++) {
+        uint64_t addr = BASE + (rand() % regions) * 2 * PAGE;
+        if (uc_mem_read(uc, addr, &val, sizeof(val))) {
+            printf("uc_mem_read() failed at 0x%llx\n", (unsigned long long)addr);
+            uc_close(uc);
+            return -1;
+        }
+    }
+    t_read = now() - t0;
+
+    t0 = now();
+    for (i = 0; i < ACCESSES; i++) {
+        uint64_t addr = BASE + (rand() % regions) * 2 * PAGE + PAGE;
+        if (uc_mem_read(uc, addr, &val, sizeof(val)) != UC_ERR_READ_UNMAPPED) {
+            printf("uc_mem_read() succeeded at unmapped 0x%llx\n", (unsigned long long)addr);
+            uc_close(uc);
+            return -1;
+        }
+    }
+    t_miss = now() - t0;
+
+    printf("%8u regions: map %8.3f s, read %7.1f ns, unmapped read %7.1f ns\n",
+            regions, t_map, t_read * 1e9 / ACCESSES, t_miss * 1e9 / ACCESSES);
+
+    uc_close(uc);
+    return 0;
+}
+
+int main(int argc, char **argv, char **envp)
+{
+    unsigned int max = 1000, n;
+
+    if (argc > 1)
+        max = strtoul(argv[1], NULL, 0);
+
+    for (n = 10; n <= max; n *= 10) {
+        if (bench(n))
+            return 1;
+    }
+
+    return 0;
+}
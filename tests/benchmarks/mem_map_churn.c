@@ -0,0 +1,103 @@
+/*
+   Cost of mapping many regions while others come and go.
+
+   Maps 100000 regions of 1 to 8 pages, in random slots, unmapping a
+   random one whenever the given number of regions is live, and prints
+   the time per uc_mem_map() and uc_mem_unmap(). Both should stay flat
+   however many regions were mapped before, and whatever the holes the
+   unmapped ones leave in the RAM offsets.
+
+   Usage: mem_map_churn [live regions [maps]], 4000 and 100000 by default.
+   Every live region needs a section in the physical map, which QEMU caps
+   at TARGET_PAGE_SIZE entries.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <unicorn/unicorn.h>
+
+#define BASE     0x10000000ULL
+#define PAGE     0x1000ULL
+#define SLOT     (8 * PAGE)
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint32_t seed = 1;
+
+static uint32_t rand_next(void)
+{
+    seed = seed * 1103515245 + 12345;
+    return seed >> 8;
+}
+
+int main(int argc, char **argv, char **envp)
+{
+    uint32_t live = 4000, maps = 100000, slots, mapped = 0, i, slot;
+    uint32_t *sizes, *used;
+    double t0, t_map = 0, t_unmap = 0;
+    uint32_t unmaps = 0;
+    uc_engine *uc;
+    uc_err err;
+
+    if (argc > 1)
+        live = strtoul(argv[1], NULL, 0);
+    if (argc > 2)
+        maps = strtoul(argv[2], NULL, 0);
+
+    err = uc_open(UC_ARCH_X86, UC_MODE_64, &uc);
+    if (err) {
+        printf("uc_open() failed: %s\n", uc_strerror(err));
+        return 1;
+    }
+
+    // the live regions are used[0, mapped[, in slots of 2 * live
+    slots = 2 * live;
+    sizes = calloc(slots, sizeof(*sizes));
+    used = calloc(live, sizeof(*used));
+
+    for (i = 0; i < maps; i++) {
+        if (mapped == live) {
+            slot = rand_next() % mapped;
+            t0 = now();
+            err = uc_mem_unmap(uc, BASE + used[slot] * SLOT, sizes[used[slot]] * PAGE);
+            t_unmap += now() - t0;
+            if (err) {
+                printf("uc_mem_unmap() failed: %s\n", uc_strerror(err));
+                return 1;
+            }
+            sizes[used[slot]] = 0;
+            used[slot] = used[--mapped];
+            unmaps++;
+        }
+
+        do {
+            slot = rand_next() % slots;
+        } while (sizes[slot]);
+        sizes[slot] = 1 + rand_next() % 8;
+        t0 = now();
+        err = uc_mem_map(uc, BASE + slot * SLOT, sizes[slot] * PAGE, UC_PROT_ALL);
+        t_map += now() - t0;
+        if (err) {
+            printf("uc_mem_map() failed: %s\n", uc_strerror(err));
+            return 1;
+        }
+        used[mapped++] = slot;
+    }
+
+    printf("%u regions, up to %u live: map %.2f us, unmap %.2f us\n", maps, live,
+            t_map * 1e6 / maps, unmaps ? t_unmap * 1e6 / unmaps : 0);
+
+    uc_close(uc);
+    free(sizes);
+    free(used);
+
+    return 0;
+}
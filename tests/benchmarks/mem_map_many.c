@@ -0,0 +1,106 @@
+/*
+   Cost of mapping and unmapping many regions.
+
+   Maps N single-page regions with a hole between each, one by one and
+   then with one uc_mem_map_batch(), and unmaps them one by one. Each
+   change should cost about the same whatever N: only the region changed
+   is added to or removed from the memory map, and the TLB is not flushed.
+
+   Usage: mem_map_many [max regions], 4000 by default. Every region
+   needs a section in the physical map, which QEMU caps at
+   TARGET_PAGE_SIZE entries.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <unicorn/unicorn.h>
+
+#define BASE     0x10000000ULL
+#define PAGE     0x1000ULL
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int bench(unsigned int regions)
+{
+    uc_engine *uc;
+    uc_mem_region *batch;
+    uc_stats stats;
+    uc_err err;
+    unsigned int i;
+    double t0, t_map, t_unmap, t_batch;
+
+    err = uc_open(UC_ARCH_X86, UC_MODE_64, &uc);
+    if (err) {
+        printf("uc_open() failed: %s\n", uc_strerror(err));
+        return -1;
+    }
+
+    t0 = now();
+    for (i = 0; i < regions; i++) {
+        err = uc_mem_map(uc, BASE + i * 2 * PAGE, PAGE, UC_PROT_ALL);
+        if (err) {
+            printf("uc_mem_map() failed: %s\n", uc_strerror(err));
+            uc_close(uc);
+            return -1;
+        }
+    }
+    t_map = now() - t0;
+
+    t0 = now();
+    for (i = 0; i < regions; i++) {
+        err = uc_mem_unmap(uc, BASE + i * 2 * PAGE, PAGE);
+        if (err) {
+            printf("uc_mem_unmap() failed: %s\n", uc_strerror(err));
+            uc_close(uc);
+            return -1;
+        }
+    }
+    t_unmap = now() - t0;
+
+    batch = calloc(regions, sizeof(*batch));
+    for (i = 0; i < regions; i++) {
+        batch[i].begin = BASE + i * 2 * PAGE;
+        batch[i].end = batch[i].begin + PAGE - 1;
+        batch[i].perms = UC_PROT_ALL;
+    }
+    t0 = now();
+    err = uc_mem_map_batch(uc, batch, regions);
+    t_batch = now() - t0;
+    free(batch);
+    if (err) {
+        printf("uc_mem_map_batch() failed: %s\n", uc_strerror(err));
+        uc_close(uc);
+        return -1;
+    }
+
+    uc_stats_get(uc, &stats);
+    printf("%6u regions: map %7.2f us, unmap %7.2f us, batch map %7.2f us per region, %llu TLB flushes\n",
+            regions, t_map * 1e6 / regions, t_unmap * 1e6 / regions, t_batch * 1e6 / regions,
+            (unsigned long long)stats.tlb_flushes);
+
+    uc_close(uc);
+    return 0;
+}
+
+int main(int argc, char **argv, char **envp)
+{
+    unsigned int max = 4000, n;
+
+    if (argc > 1)
+        max = strtoul(argv[1], NULL, 0);
+
+    for (n = 250; n <= max; n *= 2) {
+        if (bench(n))
+            return 1;
+    }
+
+    return 0;
+}
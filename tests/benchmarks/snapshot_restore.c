@@ -0,0 +1,100 @@
+/*
+   Cost of resetting an engine between fuzz cases.
+
+   Runs the same loop as tests/fuzz/fuzz_emu_x86_32.c on random inputs:
+   once with uc_open() and uc_close() per input, and once restoring a
+   snapshot taken after the memory is mapped instead. Prints the time per
+   input of both, and of uc_snapshot_restore() alone, which should only
+   cost the pages the input wrote.
+
+   Usage: snapshot_restore [inputs], 2000 by default.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <unicorn/unicorn.h>
+
+#define ADDRESS 0x1000000
+#define SIZE 64
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint32_t seed = 1;
+
+static void random_input(uint8_t *data)
+{
+    int i;
+
+    for (i = 0; i < SIZE; i++) {
+        seed = seed * 1103515245 + 12345;
+        data[i] = seed >> 16;
+    }
+}
+
+static void run_input(uc_engine *uc, const uint8_t *data)
+{
+    uc_mem_write(uc, ADDRESS, data, SIZE);
+    uc_emu_start(uc, ADDRESS, ADDRESS + SIZE, 0, 0x1000);
+}
+
+int main(int argc, char **argv, char **envp)
+{
+    uint32_t inputs = 2000, i;
+    uint8_t data[SIZE];
+    uc_engine *uc;
+    uc_snapshot *snapshot;
+    double t0, t_open, t_snapshot, t_restore = 0;
+    uc_err err;
+
+    if (argc > 1)
+        inputs = strtoul(argv[1], NULL, 0);
+
+    t0 = now();
+    for (i = 0; i < inputs; i++) {
+        random_input(data);
+        err = uc_open(UC_ARCH_X86, UC_MODE_32, &uc);
+        if (err) {
+            printf("uc_open() failed: %s\n", uc_strerror(err));
+            return 1;
+        }
+        uc_mem_map(uc, ADDRESS, 4 * 1024 * 1024, UC_PROT_ALL);
+        run_input(uc, data);
+        uc_close(uc);
+    }
+    t_open = now() - t0;
+
+    seed = 1;
+    uc_open(UC_ARCH_X86, UC_MODE_32, &uc);
+    uc_mem_map(uc, ADDRESS, 4 * 1024 * 1024, UC_PROT_ALL);
+    err = uc_snapshot_take(uc, &snapshot);
+    if (err) {
+        printf("uc_snapshot_take() failed: %s\n", uc_strerror(err));
+        return 1;
+    }
+    t0 = now();
+    for (i = 0; i < inputs; i++) {
+        double t1;
+
+        random_input(data);
+        run_input(uc, data);
+        t1 = now();
+        uc_snapshot_restore(uc, snapshot);
+        t_restore += now() - t1;
+    }
+    t_snapshot = now() - t0;
+    uc_close(uc);
+    uc_snapshot_free(snapshot);
+
+    printf("%u inputs: uc_open() per input %.2f us, snapshot %.2f us, of which restore %.2f us\n",
+            inputs, t_open * 1e6 / inputs, t_snapshot * 1e6 / inputs, t_restore * 1e6 / inputs);
+
+    return 0;
+}
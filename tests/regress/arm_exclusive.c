@@ -0,0 +1,286 @@
+/*
+   Store-exclusives must succeed only while the monitor holds, for every
+   size, and be atomic between engines running on other host threads over
+   the same RAM (uc_mem_map_ptr), also on a page holding the code they run,
+   and for 16 bytes pairs, whatever the alignment of the host RAM. One whose
+   load fails stores nothing.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <pthread.h>
+
+#include <unicorn/unicorn.h>
+
+#define CODE 0x10000
+#define DATA 0x20000
+#define THREADS 4
+#define SHARED_SIZE 0x1000
+#define LOOPS 1000000
+
+// loop: ldrex r1, [r0]; add r1, r1, #1; strex r2, r1, [r0]; cmp r2, #0; bne loop
+//       subs r3, r3, #1; bne loop
+#define ARM_INC "\x9f\x1f\x90\xe1\x01\x10\x81\xe2\x91\x2f\x80\xe1\x00\x00\x52\xe3\xfa\xff\xff\x1a\x01\x30\x53\xe2\xf8\xff\xff\x1a"
+// loop: ldrexd r4, r5, [r0]; adds r4, r4, #1; adc r5, r5, #0; strexd r2, r4, r5, [r0]
+//       cmp r2, #0; bne loop; subs r3, r3, #1; bne loop
+#define ARM_INC64 "\x9f\x4f\xb0\xe1\x01\x40\x94\xe2\x00\x50\xa5\xe2\x94\x2f\xa0\xe1\x00\x00\x52\xe3\xf9\xff\xff\x1a\x01\x30\x53\xe2\xf7\xff\xff\x1a"
+// loop: ldxr w1, [x0]; add w1, w1, #1; stxr w2, w1, [x0]; cbnz w2, loop
+//       subs x3, x3, #1; b.ne loop
+#define ARM64_INC "\x01\x7c\x5f\x88\x21\x04\x00\x11\x01\x7c\x02\x88\xa2\xff\xff\x35\x63\x04\x00\xf1\x61\xff\xff\x54"
+// loop: ldaxp w4, w5, [x0]; add w4, w4, #1; add w5, w5, #2; stlxp w2, w4, w5, [x0]
+//       cbnz w2, loop; subs x3, x3, #1; b.ne loop
+#define ARM64_INC_PAIR "\x04\x94\x7f\x88\x84\x04\x00\x11\xa5\x08\x00\x11\x04\x94\x22\x88\x82\xff\xff\x35\x63\x04\x00\xf1\x41\xff\xff\x54"
+// ldrexb r1, [r0]; add r1, r1, #1; strexb r2, r1, [r0]
+// ldrexh r1, [r0]; add r1, r1, #1; strexh r2, r1, [r0]
+// strex r2, r1, [r0]
+#define ARM_SIZES "\x9f\x1f\xd0\xe1\x01\x10\x81\xe2\x91\x2f\xc0\xe1\x9f\x1f\xf0\xe1\x01\x10\x81\xe2\x91\x2f\xe0\xe1\x91\x2f\x80\xe1"
+// ldaxp x4, x5, [x0]; adds x4, x4, #1; adc x5, x5, xzr; stlxp w2, x4, x5, [x0]
+#define ARM64_PAIR64 "\x04\x94\x7f\xc8\x84\x04\x00\xb1\xa5\x00\x1f\x9a\x04\x94\x22\xc8"
+// loop: the above; cbnz w2, loop; subs x3, x3, #1; b.ne loop
+#define ARM64_INC_PAIR64 ARM64_PAIR64 "\x82\xff\xff\x35\x63\x04\x00\xf1\x41\xff\xff\x54"
+// ldrex r1, [r0]; strex r2, r5, [r0]
+#define ARM_PATCH "\x9f\x1f\x90\xe1\x95\x2f\x80\xe1"
+// add r3, r3, #1
+#define ARM_ADD1 "\x01\x30\x83\xe2"
+// offset of the counter in the shared page, when the code runs from there too
+#define CODE_SHARED 0x800
+
+struct test {
+    const char *name;
+    uc_arch arch;
+    const char *code;
+    size_t size;
+    int r0, r3;
+    int code_shared;    // run from the shared page, whose TLB entry stays clean
+    int misaligned;     // the shared page is 8 bytes off a 16 bytes boundary of the host
+};
+
+static uint64_t shared_mem[SHARED_SIZE / 8 + 1] __attribute__((aligned(16)));
+static uint64_t *shared = shared_mem;
+static const struct test *test;
+
+static void *run(void *arg)
+{
+    uc_engine *uc;
+    uint64_t r0 = DATA, r3 = LOOPS, code = CODE;
+    uc_err err;
+
+    if (uc_open(test->arch, UC_MODE_ARM, &uc)) {
+        printf("%s: uc_open() failed\n", test->name);
+        return (void *)1;
+    }
+
+    if (test->code_shared) {
+        // written to the shared page before the threads start
+        code = DATA;
+        r0 = DATA + CODE_SHARED;
+        uc_mem_map_ptr(uc, DATA, SHARED_SIZE, UC_PROT_ALL, shared);
+    } else {
+        uc_mem_map(uc, CODE, 0x1000, UC_PROT_ALL);
+        uc_mem_write(uc, CODE, test->code, test->size);
+        uc_mem_map_ptr(uc, DATA, SHARED_SIZE, UC_PROT_READ | UC_PROT_WRITE, shared);
+    }
+    uc_reg_write(uc, test->r0, &r0);
+    uc_reg_write(uc, test->r3, &r3);
+
+    err = uc_emu_start(uc, code, code + test->size, 0, 0);
+    uc_close(uc);
+    if (err) {
+        printf("%s: uc_emu_start() failed: %s\n", test->name, uc_strerror(err));
+        return (void *)1;
+    }
+
+    return NULL;
+}
+
+// increment a counter from THREADS engines at once
+static int test_threads(const struct test *t, uint64_t expected)
+{
+    pthread_t threads[THREADS];
+    uint64_t *counter;
+    void *ret;
+    int i, failed = 0;
+
+    test = t;
+    shared = counter = shared_mem + t->misaligned;
+    memset(shared, 0, SHARED_SIZE);
+    if (t->code_shared) {
+        memcpy(shared, t->code, t->size);
+        counter = shared + CODE_SHARED / 8;
+    }
+    for (i = 0; i < THREADS; i++)
+        pthread_create(&threads[i], NULL, run, NULL);
+    for (i = 0; i < THREADS; i++) {
+        pthread_join(threads[i], &ret);
+        failed |= ret != NULL;
+    }
+
+    // the high half of a 16 bytes counter stays 0
+    if (counter[0] != expected || counter[1] != 0) {
+        printf("%s: counter = 0x%llx 0x%llx, expected 0x%llx 0\n", t->name,
+                (unsigned long long)counter[0], (unsigned long long)counter[1],
+                (unsigned long long)expected);
+        failed = 1;
+    }
+
+    return failed;
+}
+
+static int test_sizes(void)
+{
+    uc_engine *uc;
+    uint32_t r0 = DATA, r2;
+    uint64_t x0 = DATA, x2;
+    int failed = 0;
+
+    // byte & halfword, then a store-exclusive without a load-exclusive
+    memset(shared, 0, SHARED_SIZE);
+    shared[0] = 0x0100;
+    uc_open(UC_ARCH_ARM, UC_MODE_ARM, &uc);
+    uc_mem_map(uc, CODE, 0x1000, UC_PROT_ALL);
+    uc_mem_write(uc, CODE, ARM_SIZES, sizeof(ARM_SIZES) - 1);
+    uc_mem_map_ptr(uc, DATA, SHARED_SIZE, UC_PROT_READ | UC_PROT_WRITE, shared);
+    uc_reg_write(uc, UC_ARM_REG_R0, &r0);
+    uc_emu_start(uc, CODE, CODE + 24, 0, 0);
+    uc_reg_read(uc, UC_ARM_REG_R2, &r2);
+    if (shared[0] != 0x0102 || r2 != 0) {
+        printf("arm sizes: memory = 0x%llx, r2 = %u, expected 0x102, 0\n",
+                (unsigned long long)shared[0], r2);
+        failed = 1;
+    }
+    uc_emu_start(uc, CODE + 24, CODE + 28, 0, 0);
+    uc_reg_read(uc, UC_ARM_REG_R2, &r2);
+    if (shared[0] != 0x0102 || r2 != 1) {
+        printf("arm no monitor: memory = 0x%llx, r2 = %u, expected 0x102, 1\n",
+                (unsigned long long)shared[0], r2);
+        failed = 1;
+    }
+    uc_close(uc);
+
+    // 128 bits pair
+    shared[0] = ~0ULL;
+    shared[1] = 1;
+    uc_open(UC_ARCH_ARM64, UC_MODE_ARM, &uc);
+    uc_mem_map(uc, CODE, 0x1000, UC_PROT_ALL);
+    uc_mem_write(uc, CODE, ARM64_PAIR64, sizeof(ARM64_PAIR64) - 1);
+    uc_mem_map_ptr(uc, DATA, SHARED_SIZE, UC_PROT_READ | UC_PROT_WRITE, shared);
+    uc_reg_write(uc, UC_ARM64_REG_X0, &x0);
+    uc_emu_start(uc, CODE, CODE + sizeof(ARM64_PAIR64) - 1, 0, 0);
+    uc_reg_read(uc, UC_ARM64_REG_X2, &x2);
+    if (shared[0] != 0 || shared[1] != 2 || x2 != 0) {
+        printf("arm64 pair: memory = 0x%llx 0x%llx, x2 = %llu, expected 0 2, 0\n",
+                (unsigned long long)shared[0], (unsigned long long)shared[1],
+                (unsigned long long)x2);
+        failed = 1;
+    }
+    uc_close(uc);
+
+    return failed;
+}
+
+static void unmap_data(uc_engine *uc, uint64_t address, uint32_t size, void *user_data)
+{
+    uc_mem_unmap(uc, DATA, 0x1000);
+}
+
+static bool count_write(uc_engine *uc, uc_mem_type type, uint64_t address, int size,
+        int64_t value, void *user_data)
+{
+    (*(int *)user_data)++;
+    return false;
+}
+
+// a store-exclusive whose load fails stops the emulation & stores nothing,
+// though the failed load gave the 0 the load-exclusive saw
+static int test_unmapped(void)
+{
+    uc_engine *uc;
+    uc_hook h1, h2;
+    uint32_t r0 = DATA, r5 = 1;
+    int writes = 0, failed = 0;
+    uc_err err;
+
+    uc_open(UC_ARCH_ARM, UC_MODE_ARM, &uc);
+    uc_mem_map(uc, CODE, 0x1000, UC_PROT_ALL);
+    uc_mem_write(uc, CODE, ARM_PATCH, sizeof(ARM_PATCH) - 1);
+    uc_mem_map(uc, DATA, 0x1000, UC_PROT_READ | UC_PROT_WRITE);
+    uc_reg_write(uc, UC_ARM_REG_R0, &r0);
+    uc_reg_write(uc, UC_ARM_REG_R5, &r5);
+    uc_hook_add(uc, &h1, UC_HOOK_CODE, unmap_data, NULL, CODE + 4, CODE + 4);
+    uc_hook_add(uc, &h2, UC_HOOK_MEM_WRITE_UNMAPPED, count_write, &writes, 1, 0);
+
+    err = uc_emu_start(uc, CODE, CODE + sizeof(ARM_PATCH) - 1, 0, 0);
+    if (err != UC_ERR_READ_UNMAPPED || writes != 0) {
+        printf("arm unmapped: %s, %d writes, expected UC_ERR_READ_UNMAPPED, 0\n",
+                uc_strerror(err), writes);
+        failed = 1;
+    }
+    uc_close(uc);
+
+    return failed;
+}
+
+// a store-exclusive over translated code drops it
+static int test_code(void)
+{
+    uc_engine *uc;
+    uint32_t r0 = CODE + 0x100, r3 = 0, r5 = 0xe2833002;    // add r3, r3, #2
+    int failed = 0;
+
+    uc_open(UC_ARCH_ARM, UC_MODE_ARM, &uc);
+    uc_mem_map(uc, CODE, 0x1000, UC_PROT_ALL);
+    uc_mem_write(uc, CODE, ARM_PATCH, sizeof(ARM_PATCH) - 1);
+    uc_mem_write(uc, CODE + 0x100, ARM_ADD1, sizeof(ARM_ADD1) - 1);
+    uc_reg_write(uc, UC_ARM_REG_R0, &r0);
+    uc_reg_write(uc, UC_ARM_REG_R3, &r3);
+    uc_reg_write(uc, UC_ARM_REG_R5, &r5);
+
+    uc_emu_start(uc, CODE + 0x100, CODE + 0x104, 0, 0);
+    uc_emu_start(uc, CODE, CODE + sizeof(ARM_PATCH) - 1, 0, 0);
+    uc_emu_start(uc, CODE + 0x100, CODE + 0x104, 0, 0);
+    uc_reg_read(uc, UC_ARM_REG_R3, &r3);
+    if (r3 != 3) {
+        printf("arm patch: r3 = %u, expected 3\n", r3);
+        failed = 1;
+    }
+    uc_close(uc);
+
+    return failed;
+}
+
+int main(int argc, char **argv, char **envp)
+{
+    static const struct test arm = { "arm strex", UC_ARCH_ARM, ARM_INC, sizeof(ARM_INC) - 1,
+        UC_ARM_REG_R0, UC_ARM_REG_R3 };
+    static const struct test arm64bit = { "arm strexd", UC_ARCH_ARM, ARM_INC64, sizeof(ARM_INC64) - 1,
+        UC_ARM_REG_R0, UC_ARM_REG_R3 };
+    static const struct test arm64 = { "arm64 stxr", UC_ARCH_ARM64, ARM64_INC, sizeof(ARM64_INC) - 1,
+        UC_ARM64_REG_X0, UC_ARM64_REG_X3 };
+    static const struct test arm64pair = { "arm64 stlxp", UC_ARCH_ARM64, ARM64_INC_PAIR, sizeof(ARM64_INC_PAIR) - 1,
+        UC_ARM64_REG_X0, UC_ARM64_REG_X3 };
+    static const struct test arm64pair64 = { "arm64 stlxp x", UC_ARCH_ARM64, ARM64_INC_PAIR64, sizeof(ARM64_INC_PAIR64) - 1,
+        UC_ARM64_REG_X0, UC_ARM64_REG_X3 };
+    static const struct test arm64pair64_misaligned = { "arm64 stlxp x misaligned", UC_ARCH_ARM64,
+        ARM64_INC_PAIR64, sizeof(ARM64_INC_PAIR64) - 1, UC_ARM64_REG_X0, UC_ARM64_REG_X3, 0, 1 };
+    static const struct test arm_code = { "arm strex next to code", UC_ARCH_ARM, ARM_INC, sizeof(ARM_INC) - 1,
+        UC_ARM_REG_R0, UC_ARM_REG_R3, 1 };
+    int failed = 0;
+
+    failed |= test_sizes();
+    failed |= test_code();
+    failed |= test_unmapped();
+    failed |= test_threads(&arm, THREADS * LOOPS);
+    failed |= test_threads(&arm64bit, THREADS * LOOPS);
+    failed |= test_threads(&arm64, THREADS * LOOPS);
+    failed |= test_threads(&arm64pair, ((uint64_t)THREADS * LOOPS * 2 << 32) | THREADS * LOOPS);
+    failed |= test_threads(&arm64pair64, THREADS * LOOPS);
+    failed |= test_threads(&arm64pair64_misaligned, THREADS * LOOPS);
+    failed |= test_threads(&arm_code, THREADS * LOOPS);
+
+    if (failed)
+        printf("\n\nTEST FAILED!\n\n");
+    else
+        printf("\n\nTEST PASSED!\n\n");
+
+    return failed;
+}
@@ -0,0 +1,394 @@
+/*
+   NEON integer ops on whole Q registers must compute what the same ops do
+   on each D register half, including the saturation flag (QC), and
+   VZIP/VUZP on Q registers and VTBL/VTBX must match their definitions.
+   VLD1/VST1 of several registers must copy the same bytes whether they are
+   on one RAM page, across pages or under a memory hook, which sees every
+   element, and fail on unmapped memory.  The float ops are in arm_vfp.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <unicorn/unicorn.h>
+
+#define CODE 0x10000
+#define DATA 0x20000
+#define DATA_SIZE 0x2000
+#define RUNS 200
+#define LOOPS 1000000
+#define FPSCR_QC (1 << 27)
+
+// vzip.8/16/32 q0, q1; vuzp.8/16/32 q0, q1
+#define VZIP(size) (0xf3b201c2 | (size) << 18)
+#define VUZP(size) (0xf3b20142 | (size) << 18)
+// vtbl.8 d0, {d2, d3, d4}, d6; vtbx.8 d0, {d2, d3}, d6
+#define VTBL3 0xf3b20a06
+#define VTBX2 0xf3b20946
+// loop: vadd.i8 q0, q0, q1; vqadd.s16 q2, q2, q3; vmla.i16 q4, q5, q6
+//       vmax.u8 q7, q7, q1; vceq.i32 q8, q8, q2; vrhadd.u8 q9, q9, q1
+//       vzip.8 q10, q11; vtbl.8 d24, {d0, d1}, d25; subs r0, r0, #1; bne loop
+#define LOOP "\x42\x08\x00\xf2\x56\x40\x14\xf2\x4c\x89\x1a\xf2\x42\xe6\x0e\xf3" \
+    "\xd4\x08\x60\xf3\xc2\x21\x42\xf3\xe6\x41\xf2\xf3\x29\x89\xf0\xf3" \
+    "\x01\x00\x50\xe2\xf5\xff\xff\x1a"
+// vld1/vst1.<size> {d<d> .. d<d + nregs - 1>}, [r<n>], with writeback if @wb
+#define VLD1(d, n, nregs, size, wb) (0xf4200000 | (n) << 16 | (d) << 12 | \
+    vld1_type[nregs] << 8 | (size) << 6 | ((wb) ? 13 : 15))
+#define VST1(d, n, nregs, size, wb) (VLD1(d, n, nregs, size, wb) & ~(1 << 21))
+static const int vld1_type[] = { 0, 7, 10, 6, 2 };
+
+// three registers of the same length: op is bits [11:8,4] as in the ARM ARM
+static uint32_t neon_3r(int op, int u, int size, int q, int d, int n, int m)
+{
+    return 0xf2000000 | u << 24 | size << 20 | n << 16 | d << 12 |
+        (op >> 1) << 8 | q << 6 | (op & 1) << 4 | m;
+}
+
+static const struct {
+    const char *name;
+    int op;
+} ops[] = {
+    { "vhadd", 0 }, { "vqadd", 1 }, { "vrhadd", 2 }, { "vqsub", 5 },
+    { "vcgt", 6 }, { "vcge", 7 }, { "vmax", 12 }, { "vmin", 13 },
+    { "vabd", 14 }, { "vaba", 15 }, { "vadd/vsub", 16 }, { "vtst/vceq", 17 },
+    { "vmla/vmls", 18 }, { "vmul", 19 },
+};
+
+static uc_engine *setup(void)
+{
+    uc_engine *uc;
+    uint32_t cpacr, fpexc = 0x40000000;
+
+    if (uc_open(UC_ARCH_ARM, UC_MODE_ARM, &uc)) {
+        printf("uc_open() failed\n");
+        exit(1);
+    }
+
+    // enable VFP & NEON
+    uc_reg_read(uc, UC_ARM_REG_C1_C0_2, &cpacr);
+    cpacr |= 0xf << 20;
+    uc_reg_write(uc, UC_ARM_REG_C1_C0_2, &cpacr);
+    uc_reg_write(uc, UC_ARM_REG_FPEXC, &fpexc);
+
+    uc_mem_map(uc, CODE, 0x1000, UC_PROT_ALL);
+    uc_mem_map(uc, DATA, DATA_SIZE, UC_PROT_READ | UC_PROT_WRITE);
+
+    return uc;
+}
+
+// random bytes, often the ones which saturate or overflow
+static void random_regs(uint8_t *regs, size_t size)
+{
+    static const uint8_t edges[] = { 0, 1, 0x7f, 0x80, 0xff };
+    size_t i;
+
+    for (i = 0; i < size; i++)
+        regs[i] = rand() & 1 ? edges[rand() % sizeof(edges)] : rand();
+}
+
+static void write_regs(uc_engine *uc, const uint8_t *regs, int count)
+{
+    uint32_t fpscr = 0;
+    int i;
+
+    for (i = 0; i < count; i++)
+        uc_reg_write(uc, UC_ARM_REG_D0 + i, regs + i * 8);
+    uc_reg_write(uc, UC_ARM_REG_FPSCR, &fpscr);
+}
+
+static uint32_t read_regs(uc_engine *uc, uint8_t *regs, int count)
+{
+    uint32_t fpscr;
+    int i;
+
+    for (i = 0; i < count; i++)
+        uc_reg_read(uc, UC_ARM_REG_D0 + i, regs + i * 8);
+    uc_reg_read(uc, UC_ARM_REG_FPSCR, &fpscr);
+
+    return fpscr & FPSCR_QC;
+}
+
+static int run(uc_engine *uc, const uint32_t *code, int count)
+{
+    uc_err err;
+
+    uc_mem_write(uc, CODE, code, count * 4);
+    err = uc_emu_start(uc, CODE, CODE + count * 4, 0, 0);
+    if (err) {
+        printf("uc_emu_start() failed: %s\n", uc_strerror(err));
+        return 1;
+    }
+
+    return 0;
+}
+
+// q0 = q1 op q2, against d0 = d2 op d4 & d1 = d3 op d5
+static int test_3r(uc_engine *uc, int i, int u, int size)
+{
+    uint32_t q = neon_3r(ops[i].op, u, size, 1, 0, 2, 4);
+    uint32_t d[2] = { neon_3r(ops[i].op, u, size, 0, 0, 2, 4), neon_3r(ops[i].op, u, size, 0, 1, 3, 5) };
+    uint8_t regs[6 * 8], expected[6 * 8], result[6 * 8];
+    uint32_t expected_qc, qc;
+    int run_;
+
+    for (run_ = 0; run_ < RUNS; run_++) {
+        random_regs(regs, sizeof(regs));
+
+        write_regs(uc, regs, 6);
+        if (run(uc, d, 2))
+            return 1;
+        expected_qc = read_regs(uc, expected, 6);
+
+        write_regs(uc, regs, 6);
+        if (run(uc, &q, 1))
+            return 1;
+        qc = read_regs(uc, result, 6);
+
+        if (memcmp(result, expected, sizeof(result)) || qc != expected_qc) {
+            printf("%s u=%d size=%d: q0 = %016llx%016llx qc %d, expected %016llx%016llx qc %d\n",
+                    ops[i].name, u, size,
+                    *(unsigned long long *)(result + 8), *(unsigned long long *)result, qc != 0,
+                    *(unsigned long long *)(expected + 8), *(unsigned long long *)expected,
+                    expected_qc != 0);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static int test_zip(uc_engine *uc, int size, int unzip)
+{
+    uint32_t code = unzip ? VUZP(size) : VZIP(size);
+    int e = 1 << size, n = 16 / e, run_, i;
+    uint8_t regs[4 * 8], result[4 * 8], expected[4 * 8];
+
+    for (run_ = 0; run_ < RUNS; run_++) {
+        random_regs(regs, sizeof(regs));
+        write_regs(uc, regs, 4);
+        if (run(uc, &code, 1))
+            return 1;
+        read_regs(uc, result, 4);
+
+        // q0:q1 as 2n elements
+        for (i = 0; i < n; i++) {
+            if (unzip) {
+                memcpy(expected + i * e, regs + i * 2 * e, e);
+                memcpy(expected + 16 + i * e, regs + (i * 2 + 1) * e, e);
+            } else {
+                memcpy(expected + i * 2 * e, regs + i * e, e);
+                memcpy(expected + (i * 2 + 1) * e, regs + 16 + i * e, e);
+            }
+        }
+        if (memcmp(result, expected, sizeof(result))) {
+            printf("%s.%d: wrong result\n", unzip ? "vuzp" : "vzip", e * 8);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static int test_tbl(uc_engine *uc, int tbx)
+{
+    uint32_t code = tbx ? VTBX2 : VTBL3;
+    int len = tbx ? 16 : 24, run_, i;
+    uint8_t regs[7 * 8], result[7 * 8];
+
+    for (run_ = 0; run_ < RUNS; run_++) {
+        random_regs(regs, sizeof(regs));
+        for (i = 0; i < 8; i++)
+            regs[6 * 8 + i] %= 32;
+        write_regs(uc, regs, 7);
+        if (run(uc, &code, 1))
+            return 1;
+        read_regs(uc, result, 7);
+
+        for (i = 0; i < 8; i++) {
+            int index = regs[6 * 8 + i];
+            uint8_t expected = index < len ? regs[2 * 8 + index] : tbx ? regs[i] : 0;
+            if (result[i] != expected) {
+                printf("%s: byte %d = 0x%x, expected 0x%x\n", tbx ? "vtbx" : "vtbl",
+                        i, result[i], expected);
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+static int accesses, access_size;
+
+static void hook_mem(uc_engine *uc, uc_mem_type type, uint64_t address, int size,
+        int64_t value, void *user_data)
+{
+    accesses++;
+    if (size != access_size)
+        printf("%d bytes access, expected %d\n", size, access_size);
+}
+
+// vld1 or vst1 of @nregs registers of elements of 1 << @size bytes at @addr
+static int test_ld1(uc_engine *uc, int nregs, int size, int store, uint32_t addr, int hooked)
+{
+    uint32_t code = store ? VST1(0, 1, nregs, size, 1) : VLD1(0, 1, nregs, size, 1);
+    uint8_t regs[4 * 8], mem[4 * 8], result[4 * 8];
+    uint32_t r1 = addr;
+    int len = nregs * 8;
+    uc_hook hook;
+    uc_err err;
+
+    random_regs(regs, sizeof(regs));
+    random_regs(mem, sizeof(mem));
+    write_regs(uc, regs, 4);
+    uc_mem_write(uc, addr, mem, len);
+    uc_reg_write(uc, UC_ARM_REG_R1, &r1);
+    uc_mem_write(uc, CODE, &code, 4);
+
+    accesses = 0;
+    access_size = 1 << size;
+    if (hooked)
+        uc_hook_add(uc, &hook, UC_HOOK_MEM_READ | UC_HOOK_MEM_WRITE, hook_mem, NULL, 1, 0);
+    err = uc_emu_start(uc, CODE, CODE + 4, 0, 0);
+    if (hooked)
+        uc_hook_del(uc, hook);
+    if (err) {
+        printf("uc_emu_start() failed: %s\n", uc_strerror(err));
+        return 1;
+    }
+
+    read_regs(uc, result, 4);
+    uc_reg_read(uc, UC_ARM_REG_R1, &r1);
+    if (store) {
+        uc_mem_read(uc, addr, mem, len);
+        memcpy(result, mem, len);
+    } else {
+        memcpy(regs, mem, len);
+    }
+    if (memcmp(result, regs, store ? len : sizeof(result)) || r1 != addr + len ||
+            (hooked && accesses != len / access_size)) {
+        printf("%s.%d of %d registers at 0x%x%s: wrong result\n", store ? "vst1" : "vld1",
+                8 << size, nregs, addr, hooked ? " hooked" : "");
+        return 1;
+    }
+
+    return 0;
+}
+
+static int test_ld1_unmapped(uc_engine *uc, int store)
+{
+    uint32_t code = store ? VST1(0, 1, 2, 0, 0) : VLD1(0, 1, 2, 0, 0);
+    uint32_t r1 = DATA + DATA_SIZE - 8;
+    uc_err err;
+
+    uc_reg_write(uc, UC_ARM_REG_R1, &r1);
+    uc_mem_write(uc, CODE, &code, 4);
+    err = uc_emu_start(uc, CODE, CODE + 4, 0, 0);
+    if (err != (store ? UC_ERR_WRITE_UNMAPPED : UC_ERR_READ_UNMAPPED)) {
+        printf("%s across the end of memory: %s\n", store ? "vst1" : "vld1", uc_strerror(err));
+        return 1;
+    }
+
+    return 0;
+}
+
+static void benchmark(uc_engine *uc, const char *what, const void *code, size_t size)
+{
+    uint8_t regs[32 * 8];
+    uint32_t r0 = LOOPS;
+    struct timespec t0, t1;
+
+    random_regs(regs, sizeof(regs));
+    write_regs(uc, regs, 32);
+    uc_reg_write(uc, UC_ARM_REG_R0, &r0);
+    uc_mem_write(uc, CODE, code, size);
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    uc_emu_start(uc, CODE, CODE + size, 0, 0);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    printf("%d loops of %s: %.1f ns each\n", LOOPS, what,
+            ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) / LOOPS);
+}
+
+// vadd.f32 q0, q0, q1; vmul.f32 q2, q2, q3; vmla.f32 q4, q5, q6
+// vld1.32 {d14, d15}, [r1]; vst1.32 {d14, d15}, [r2]; subs r0, r0, #1; bne loop
+static void benchmark_float_ld1(uc_engine *uc)
+{
+    const uint32_t loop[] = {
+        neon_3r(26, 0, 0, 1, 0, 0, 2), neon_3r(27, 1, 0, 1, 4, 4, 6),
+        neon_3r(27, 0, 0, 1, 8, 10, 12), VLD1(14, 1, 2, 2, 0), VST1(14, 2, 2, 2, 0),
+        0xe2500001, 0x1afffff8,
+    };
+    // normal numbers staying so, and inexact sums & products
+    const float q[7][4] = {
+        { 1, 1, 1, 1 }, { 0.1f, 0.1f, 0.1f, 0.1f }, { 1, 1, 1, 1 },
+        { 1.0000001f, 1.0000001f, 1.0000001f, 1.0000001f }, { 1, 1, 1, 1 },
+        { 0.1f, 0.1f, 0.1f, 0.1f }, { 0.1f, 0.1f, 0.1f, 0.1f },
+    };
+    uint32_t r0 = LOOPS, r1 = DATA, r2 = DATA + 0x100, fpscr = 0;
+    struct timespec t0, t1;
+    int i;
+
+    for (i = 0; i < 14; i++)
+        uc_reg_write(uc, UC_ARM_REG_D0 + i, &q[i / 2][i % 2 * 2]);
+    uc_reg_write(uc, UC_ARM_REG_FPSCR, &fpscr);
+    uc_reg_write(uc, UC_ARM_REG_R0, &r0);
+    uc_reg_write(uc, UC_ARM_REG_R1, &r1);
+    uc_reg_write(uc, UC_ARM_REG_R2, &r2);
+    uc_mem_write(uc, CODE, loop, sizeof(loop));
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    uc_emu_start(uc, CODE, CODE + sizeof(loop), 0, 0);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    printf("%d loops of 3 float & 2 VLD1/VST1 NEON instructions: %.1f ns each\n", LOOPS,
+            ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) / LOOPS);
+}
+
+int main(int argc, char **argv, char **envp)
+{
+    uc_engine *uc = setup();
+    int i, u, size, failed = 0;
+
+    srand(1);
+    for (i = 0; i < sizeof(ops) / sizeof(ops[0]); i++) {
+        for (u = 0; u < 2; u++) {
+            for (size = 0; size < 3; size++) {
+                // only vmul.p8
+                if (ops[i].op == 19 && u && size)
+                    continue;
+                failed |= test_3r(uc, i, u, size);
+            }
+        }
+    }
+    for (size = 0; size < 3; size++) {
+        failed |= test_zip(uc, size, 0);
+        failed |= test_zip(uc, size, 1);
+    }
+    failed |= test_tbl(uc, 0);
+    failed |= test_tbl(uc, 1);
+    for (i = 1; i <= 4; i++) {
+        for (size = 0; size < 4; size++) {
+            for (u = 0; u < 2; u++) {
+                // on a page, across two, and hooked
+                failed |= test_ld1(uc, i, size, u, DATA + 0x100, 0);
+                failed |= test_ld1(uc, i, size, u, DATA + 0x400 - 8, 0);
+                failed |= test_ld1(uc, i, size, u, DATA + 0x100, 1);
+            }
+        }
+    }
+    failed |= test_ld1_unmapped(uc, 0);
+    failed |= test_ld1_unmapped(uc, 1);
+
+    benchmark(uc, "8 integer NEON instructions", LOOP, sizeof(LOOP) - 1);
+    benchmark_float_ld1(uc);
+    uc_close(uc);
+
+    if (failed)
+        printf("\n\nTEST FAILED!\n\n");
+    else
+        printf("\n\nTEST PASSED!\n\n");
+
+    return failed;
+}
@@ -0,0 +1,250 @@
+/*
+   VFP & NEON float arithmetic done with the host FPU once the inexact
+   flag is set must give the same bits and FPSCR flags as softfloat, for
+   every rounding mode, flush-to-zero and default NaN setting, including
+   for NaNs, infinities, denormals and results around the normal range,
+   and whatever rounding or flush-to-zero mode the host FPU was left in.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <unicorn/unicorn.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <xmmintrin.h>
+// MXCSR: round towards zero, FTZ & DAZ
+#define HOST_MODES 1
+static const unsigned host_modes[] = { 0x6000, 0x8040 };
+#define set_host_mode(mode) _mm_setcsr((_mm_getcsr() & ~0xe040) | (mode))
+#else
+#define HOST_MODES 0
+#endif
+
+#define CODE 0x10000
+#define RUNS 2000
+#define LOOPS 1000000
+#define FPSCR_IXC (1 << 4)
+
+// vdiv.f64 d19, d20, d21; vmul.f32 d16, d17, d18: inexact, to set IXC
+#define PRIME "\xa5\x3b\xc4\xee\xb2\x0d\x41\xf3"
+#define PRIME_SIZE 8
+// loop: vmul.f64 d3, d0, d1; vadd.f64 d0, d3, d2; vdiv.f64 d4, d0, d5
+//       vsqrt.f64 d6, d4; vfma.f64 d7, d6, d1
+//       vmul.f32 s16, s17, s18; vadd.f32 s17, s16, s19; subs r0, r0, #1; bne loop
+#define LOOP "\x01\x3b\x20\xee\x02\x0b\x33\xee\x05\x4b\x80\xee\xc4\x6b\xb1\xee" \
+    "\x01\x7b\xa6\xee\x89\x8a\x28\xee\x29\x8a\x78\xee\x01\x00\x50\xe2\xf7\xff\xff\x1a"
+
+static const struct {
+    const char *name;
+    uint32_t insn;
+    int dp;
+} insns[] = {
+    { "vadd.f32 s0, s1, s2", 0xee300a81, 0 },
+    { "vsub.f32 s0, s1, s2", 0xee300ac1, 0 },
+    { "vmul.f32 s0, s1, s2", 0xee200a81, 0 },
+    { "vdiv.f32 s0, s1, s2", 0xee800a81, 0 },
+    { "vsqrt.f32 s0, s1", 0xeeb10ae0, 0 },
+    { "vfma.f32 s0, s1, s2", 0xeea00a81, 0 },
+    { "vmla.f32 s0, s1, s2", 0xee000a81, 0 },
+    { "vadd.f64 d0, d1, d2", 0xee310b02, 1 },
+    { "vsub.f64 d0, d1, d2", 0xee310b42, 1 },
+    { "vmul.f64 d0, d1, d2", 0xee210b02, 1 },
+    { "vdiv.f64 d0, d1, d2", 0xee810b02, 1 },
+    { "vsqrt.f64 d0, d1", 0xeeb10bc1, 1 },
+    { "vfma.f64 d0, d1, d2", 0xeea10b02, 1 },
+    { "vadd.f32 q0, q1, q2", 0xf2020d44, 0 },
+    { "vsub.f32 q0, q1, q2", 0xf2220d44, 0 },
+    { "vmul.f32 q0, q1, q2", 0xf3020d54, 0 },
+    { "vmla.f32 q0, q1, q2", 0xf2020d54, 0 },
+    { "vmls.f32 q0, q1, q2", 0xf2220d54, 0 },
+    { "vfma.f32 q0, q1, q2", 0xf2020c54, 0 },
+};
+
+// FPSCR: none, FZ, DN, both, and rounding towards zero & plus infinity
+static const uint32_t modes[] = {
+    0, 1 << 24, 1 << 25, 3 << 24, 3 << 22, 1 << 22,
+};
+
+static uc_engine *setup(void)
+{
+    uc_engine *uc;
+    uint32_t cpacr, fpexc = 0x40000000;
+
+    if (uc_open(UC_ARCH_ARM, UC_MODE_ARM, &uc)) {
+        printf("uc_open() failed\n");
+        exit(1);
+    }
+
+    // enable VFP & NEON
+    uc_reg_read(uc, UC_ARM_REG_C1_C0_2, &cpacr);
+    cpacr |= 0xf << 20;
+    uc_reg_write(uc, UC_ARM_REG_C1_C0_2, &cpacr);
+    uc_reg_write(uc, UC_ARM_REG_FPEXC, &fpexc);
+
+    uc_mem_map(uc, CODE, 0x1000, UC_PROT_ALL);
+
+    return uc;
+}
+
+// exponents at the edges of the normal range, or anything, or in the middle
+static uint64_t random_float(int bits, int mantissa)
+{
+    int emax = (1 << (bits - mantissa - 1)) - 1;
+    static const int edges[] = { 0, 1, 2, -3, -2, -1 };
+    uint64_t r = (uint64_t)rand() << 42 ^ (uint64_t)rand() << 21 ^ rand();
+    uint64_t sign = r & 1ULL << (bits - 1);
+    uint64_t exponent;
+
+    switch (rand() % 8) {
+    case 0:
+        return 0 | sign;
+    case 1:
+        exponent = edges[rand() % 6];
+        exponent = (exponent + emax + 1) % (emax + 1);
+        break;
+    case 2:
+        return bits == 64 ? r : r & 0xffffffff;
+    default:
+        exponent = emax / 2 + rand() % 64 - 32;
+        break;
+    }
+
+    return sign | exponent << mantissa | (r & ((1ULL << mantissa) - 1));
+}
+
+static void random_regs(uint64_t *regs, int count, int dp)
+{
+    int i;
+
+    for (i = 0; i < count; i++) {
+        if (dp)
+            regs[i] = random_float(64, 52);
+        else
+            regs[i] = random_float(32, 23) | random_float(32, 23) << 32;
+    }
+}
+
+// run @insn, after PRIME if @prime, and return FPSCR
+static uint32_t run(uc_engine *uc, uint32_t insn, uint32_t mode, const uint64_t *regs,
+        uint64_t *result, int prime)
+{
+    static const uint64_t prime_regs[] = {
+        // d16 .. d21: 1.0f / 3 twice, 3.0f twice, 1.0, 3.0
+        0, 0x3eaaaaab3eaaaaabULL, 0x4040000040400000ULL, 0, 0x3ff0000000000000ULL,
+        0x4008000000000000ULL,
+    };
+    uint32_t fpscr = mode;
+    uint64_t start = prime ? CODE : CODE + PRIME_SIZE;
+    uc_err err;
+    int i;
+
+    uc_mem_write(uc, CODE + PRIME_SIZE, &insn, 4);
+    for (i = 0; i < 6; i++) {
+        uc_reg_write(uc, UC_ARM_REG_D0 + i, &regs[i]);
+        uc_reg_write(uc, UC_ARM_REG_D16 + i, &prime_regs[i]);
+    }
+    uc_reg_write(uc, UC_ARM_REG_FPSCR, &fpscr);
+
+    err = uc_emu_start(uc, start, CODE + PRIME_SIZE + 4, 0, 0);
+    if (err)
+        printf("uc_emu_start() failed: %s\n", uc_strerror(err));
+
+    for (i = 0; i < 6; i++)
+        uc_reg_read(uc, UC_ARM_REG_D0 + i, &result[i]);
+    uc_reg_read(uc, UC_ARM_REG_FPSCR, &fpscr);
+
+    return fpscr;
+}
+
+static int test(uc_engine *uc, int i, uint32_t mode)
+{
+    uint64_t regs[6], expected[6], result[6];
+    uint32_t expected_fpscr, fpscr;
+    int run_;
+
+    for (run_ = 0; run_ < RUNS; run_++) {
+        random_regs(regs, 6, insns[i].dp);
+
+        // softfloat alone, inexact being clear
+        expected_fpscr = run(uc, insns[i].insn, mode, regs, expected, 0) | FPSCR_IXC;
+        fpscr = run(uc, insns[i].insn, mode, regs, result, 1);
+
+        if (memcmp(result, expected, sizeof(result)) || fpscr != expected_fpscr) {
+            printf("%s, fpscr 0x%x: d0 = %016llx %016llx fpscr 0x%x, expected %016llx %016llx fpscr 0x%x\n"
+                    "    d1 = %016llx d2 = %016llx\n",
+                    insns[i].name, mode,
+                    (unsigned long long)result[0], (unsigned long long)result[1], fpscr,
+                    (unsigned long long)expected[0], (unsigned long long)expected[1], expected_fpscr,
+                    (unsigned long long)regs[1], (unsigned long long)regs[2]);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static void benchmark(uc_engine *uc)
+{
+    // d0 = 1.0, d1 = 0.5, d2 = 1.0, d5 = 3.0; s17 = 1.0, s18 = 0.5, s19 = 1.0
+    static const uint64_t regs[] = {
+        0x3ff0000000000000ULL, 0x3fe0000000000000ULL, 0x3ff0000000000000ULL, 0, 0,
+        0x4008000000000000ULL, 0, 0, 0x3f80000000000000ULL, 0x3f8000003f000000ULL,
+    };
+    uint32_t r0 = LOOPS, fpscr = 0;
+    struct timespec t0, t1;
+    int i;
+
+    for (i = 0; i < 10; i++)
+        uc_reg_write(uc, UC_ARM_REG_D0 + i, &regs[i]);
+    uc_reg_write(uc, UC_ARM_REG_FPSCR, &fpscr);
+    uc_reg_write(uc, UC_ARM_REG_R0, &r0);
+    uc_mem_write(uc, CODE, LOOP, sizeof(LOOP) - 1);
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    uc_emu_start(uc, CODE, CODE + sizeof(LOOP) - 1, 0, 0);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    printf("%d loops of 7 VFP instructions: %.1f ns each\n", LOOPS,
+            ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) / LOOPS);
+}
+
+int main(int argc, char **argv, char **envp)
+{
+    uc_engine *uc = setup();
+    int i, m, failed = 0;
+
+    uc_mem_write(uc, CODE, PRIME, PRIME_SIZE);
+
+    srand(1);
+    for (i = 0; i < sizeof(insns) / sizeof(insns[0]); i++) {
+        for (m = 0; m < sizeof(modes) / sizeof(modes[0]); m++)
+            failed |= test(uc, i, modes[m]);
+    }
+
+#if HOST_MODES
+    for (m = 0; m < sizeof(host_modes) / sizeof(host_modes[0]); m++) {
+        unsigned csr = _mm_getcsr();
+
+        set_host_mode(host_modes[m]);
+        for (i = 0; i < sizeof(insns) / sizeof(insns[0]); i++) {
+            if (test(uc, i, 0)) {
+                printf("with host MXCSR 0x%x\n", _mm_getcsr());
+                failed = 1;
+            }
+        }
+        _mm_setcsr(csr);
+    }
+#endif
+
+    benchmark(uc);
+    uc_close(uc);
+
+    if (failed)
+        printf("\n\nTEST FAILED!\n\n");
+    else
+        printf("\n\nTEST PASSED!\n\n");
+
+    return failed;
+}
@@ -0,0 +1,161 @@
+/*
+   The translation buffer size set with UC_OPT_CODE_BUFFER_SIZE must be
+   used, and running more code than fits must evict old regions of it
+   (or flush it when too small to be split) while computing the same.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <unicorn/unicorn.h>
+
+#define ADDRESS 0x100000
+#define BLOCKS 100000
+#define MB (1024 * 1024)
+
+// add r0, r0, #1; b next
+#define ARM_BLOCK "\x01\x00\x80\xe2\xff\xff\xff\xea"
+
+static uint32_t *code;
+
+static size_t query(uc_engine *uc, uc_query_type type)
+{
+    size_t result = 0;
+
+    uc_query(uc, type, &result);
+    return result;
+}
+
+static uc_engine *setup(size_t size)
+{
+    uc_engine *uc;
+
+    if (uc_open(UC_ARCH_ARM, UC_MODE_ARM, &uc)) {
+        printf("uc_open() failed\n");
+        exit(1);
+    }
+    if (uc_option(uc, UC_OPT_CODE_BUFFER_SIZE, size)) {
+        printf("uc_option(UC_OPT_CODE_BUFFER_SIZE) failed\n");
+        exit(1);
+    }
+
+    uc_mem_map(uc, ADDRESS, MB, UC_PROT_ALL);
+    uc_mem_write(uc, ADDRESS, code, BLOCKS * 8);
+
+    return uc;
+}
+
+// run all the blocks @runs times, each translated to its own TB
+static int run(uc_engine *uc, const char *name, int runs)
+{
+    uint32_t r0 = 0;
+    struct timespec t0, t1;
+    uc_err err;
+    int i;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    uc_reg_write(uc, UC_ARM_REG_R0, &r0);
+    for (i = 0; i < runs; i++) {
+        err = uc_emu_start(uc, ADDRESS, ADDRESS + BLOCKS * 8, 0, 0);
+        if (err) {
+            printf("%s: uc_emu_start() failed: %s\n", name, uc_strerror(err));
+            return 1;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    uc_reg_read(uc, UC_ARM_REG_R0, &r0);
+    if (r0 != runs * BLOCKS) {
+        printf("%s: r0 = %u, expected %u\n", name, r0, runs * BLOCKS);
+        return 1;
+    }
+
+    printf("%s: %d x %d blocks in %.3fs, %zu flushes, %zu TBs evicted, %zu of %zu bytes used\n",
+            name, runs, BLOCKS, (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9,
+            query(uc, UC_QUERY_TB_FLUSHES), query(uc, UC_QUERY_TB_EVICTED),
+            query(uc, UC_QUERY_CODE_BUFFER_USED), query(uc, UC_QUERY_CODE_BUFFER_SIZE));
+
+    return 0;
+}
+
+static void hook_code(uc_engine *uc, uint64_t address, uint32_t size, void *user_data)
+{
+    *(uc_err *)user_data = uc_option(uc, UC_OPT_CODE_BUFFER_SIZE, 0);
+    uc_emu_stop(uc);
+}
+
+int main(int argc, char **argv, char **envp)
+{
+    uc_engine *uc;
+    uc_hook hook;
+    uc_err err;
+    int i, failed = 0;
+
+    code = malloc(BLOCKS * 8);
+    for (i = 0; i < BLOCKS; i++)
+        memcpy(&code[i * 2], ARM_BLOCK, 8);
+
+    // split into regions: only evictions
+    uc = setup(4 * MB);
+    if (query(uc, UC_QUERY_CODE_BUFFER_SIZE) != 4 * MB) {
+        printf("evict: buffer of %zu bytes, expected %u\n", query(uc, UC_QUERY_CODE_BUFFER_SIZE), 4 * MB);
+        failed = 1;
+    }
+    failed |= run(uc, "evict", 3);
+    if (query(uc, UC_QUERY_TB_FLUSHES) != 0 || query(uc, UC_QUERY_TB_EVICTED) == 0) {
+        printf("evict: expected TBs evicted without flushes\n");
+        failed = 1;
+    }
+    if (query(uc, UC_QUERY_CODE_BUFFER_USED) == 0 ||
+            query(uc, UC_QUERY_CODE_BUFFER_USED) > 4 * MB) {
+        printf("evict: %zu bytes used\n", query(uc, UC_QUERY_CODE_BUFFER_USED));
+        failed = 1;
+    }
+
+    // resized between runs
+    uc_option(uc, UC_OPT_CODE_BUFFER_SIZE, 64 * MB);
+    if (query(uc, UC_QUERY_CODE_BUFFER_USED) != 0) {
+        printf("resize: translated code kept\n");
+        failed = 1;
+    }
+    failed |= run(uc, "resize", 3);
+    uc_close(uc);
+
+    // everything fits
+    uc = setup(64 * MB);
+    failed |= run(uc, "fit", 3);
+    if (query(uc, UC_QUERY_TB_FLUSHES) != 0 || query(uc, UC_QUERY_TB_EVICTED) != 0) {
+        printf("fit: expected no flushes & no TBs evicted\n");
+        failed = 1;
+    }
+    uc_close(uc);
+
+    // too small to be split: flushes
+    uc = setup(MB);
+    failed |= run(uc, "flush", 3);
+    if (query(uc, UC_QUERY_TB_FLUSHES) == 0 || query(uc, UC_QUERY_TB_EVICTED) != 0) {
+        printf("flush: expected flushes only\n");
+        failed = 1;
+    }
+
+    // not from hooks
+    err = UC_ERR_OK;
+    uc_hook_add(uc, &hook, UC_HOOK_CODE, hook_code, &err, ADDRESS, ADDRESS);
+    uc_emu_start(uc, ADDRESS, ADDRESS + 8, 0, 0);
+    if (err != UC_ERR_ARG) {
+        printf("hook: uc_option(UC_OPT_CODE_BUFFER_SIZE) did not fail\n");
+        failed = 1;
+    }
+    uc_close(uc);
+
+    free(code);
+
+    if (failed)
+        printf("\n\nTEST FAILED!\n\n");
+    else
+        printf("\n\nTEST PASSED!\n\n");
+
+    return failed;
+}
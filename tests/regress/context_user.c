@@ -0,0 +1,204 @@
+/*
+   User contexts (uc_context_alloc_user) must bring back registers, flags
+   and FPU/SIMD state but not the EFLAGS bits of the system, switch
+   threads from within a hook, and be refused where they are not supported.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <unicorn/unicorn.h>
+
+#define ADDRESS 0x1000000
+#define THREAD2 (ADDRESS + 0x100)
+
+// inc ecx; add eax, ecx; movd xmm0, eax; jmp $
+#define X86_CODE "\x41\x01\xc8\x66\x0f\x6e\xc0\xeb\xfe"
+// inc edx
+#define X86_THREAD2 "\x42"
+// adds r0, r0, #1; vmov d0, r0, r0
+#define ARM_CODE "\x01\x00\x90\xe2\x10\x0b\x40\xec"
+// adds x0, x0, #1; fmov d0, x0
+#define ARM64_CODE "\x00\x04\x00\xb1\x00\x00\x67\x9e"
+
+static uc_context *thread2;
+
+static void hook_switch(uc_engine *uc, uint64_t address, uint32_t size, void *user_data)
+{
+    uc_context_restore(uc, thread2);
+}
+
+static int test_x86(void)
+{
+    uc_engine *uc;
+    uc_context *ctx;
+    uc_hook hook;
+    uint32_t ecx = 0x10, edx = 0x20, eax = 1, eflags, eflags_saved;
+    uint64_t xmm0[2] = { 0x1122334455667788ULL, 0x99aabbccddeeff00ULL }, xmm[2];
+    int failed = 0;
+
+    if (uc_open(UC_ARCH_X86, UC_MODE_32, &uc)) {
+        printf("uc_open() failed\n");
+        return 1;
+    }
+
+    uc_mem_map(uc, ADDRESS, 0x1000, UC_PROT_ALL);
+    uc_mem_write(uc, ADDRESS, X86_CODE, sizeof(X86_CODE) - 1);
+    uc_mem_write(uc, THREAD2, X86_THREAD2, sizeof(X86_THREAD2) - 1);
+
+    if (uc_context_alloc_user(uc, &ctx) || uc_context_alloc_user(uc, &thread2)) {
+        printf("x86: uc_context_alloc_user() failed\n");
+        return 1;
+    }
+
+    uc_reg_write(uc, UC_X86_REG_ECX, &ecx);
+    uc_reg_write(uc, UC_X86_REG_EDX, &edx);
+    uc_reg_write(uc, UC_X86_REG_EAX, &eax);
+    uc_reg_write(uc, UC_X86_REG_XMM0, xmm0);
+    uc_reg_read(uc, UC_X86_REG_EFLAGS, &eflags_saved);
+    uc_context_save(uc, ctx);
+
+    // run, then roll back
+    uc_emu_start(uc, ADDRESS, ADDRESS + 7, 0, 0);
+    uc_context_restore(uc, ctx);
+    uc_reg_read(uc, UC_X86_REG_ECX, &ecx);
+    uc_reg_read(uc, UC_X86_REG_EAX, &eax);
+    uc_reg_read(uc, UC_X86_REG_EFLAGS, &eflags);
+    uc_reg_read(uc, UC_X86_REG_XMM0, xmm);
+    if (ecx != 0x10 || eax != 1 || eflags != eflags_saved || memcmp(xmm, xmm0, sizeof(xmm))) {
+        printf("x86: restored ecx = %x, eax = %x, eflags = %x, xmm0 = %llx, expected 10, 1, %x, %llx\n",
+                ecx, eax, eflags, (unsigned long long)xmm[0], eflags_saved, (unsigned long long)xmm0[0]);
+        failed = 1;
+    }
+
+    // IOPL & IF are not for user code to change, bit 1 is always set
+    eflags = eflags_saved | 0x3202;
+    uc_reg_write(uc, UC_X86_REG_EFLAGS, &eflags);
+    uc_context_restore(uc, ctx);
+    uc_reg_read(uc, UC_X86_REG_EFLAGS, &eflags);
+    if (eflags != (eflags_saved | 0x3202)) {
+        printf("x86: restored eflags = %x, expected %x\n", eflags, eflags_saved | 0x3202);
+        failed = 1;
+    }
+
+    // switch to another thread from a hook, in the middle of a block
+    uc_reg_write(uc, UC_X86_REG_EIP, &(uint32_t){ THREAD2 });
+    uc_context_save(uc, thread2);
+    uc_hook_add(uc, &hook, UC_HOOK_CODE, hook_switch, NULL, ADDRESS + 1, ADDRESS + 1);
+    uc_emu_start(uc, ADDRESS, THREAD2 + 1, 0, 0);
+    uc_reg_read(uc, UC_X86_REG_ECX, &ecx);
+    uc_reg_read(uc, UC_X86_REG_EDX, &edx);
+    if (ecx != 0x10 || edx != 0x21) {
+        printf("x86: switched ecx = %x, edx = %x, expected 10, 21\n", ecx, edx);
+        failed = 1;
+    }
+
+    uc_free(ctx);
+    uc_free(thread2);
+    uc_close(uc);
+
+    return failed;
+}
+
+static int test_arm(uc_arch arch, const char *code, size_t size, int r0_reg, int d0_reg, int nzcv_reg)
+{
+    uc_engine *uc;
+    uc_context *ctx;
+    uint64_t r0 = -1, d0 = 0x1234, nzcv = 0, nzcv_saved = 0;
+    int failed = 0;
+
+    if (uc_open(arch, UC_MODE_ARM, &uc)) {
+        printf("uc_open() failed\n");
+        return 1;
+    }
+
+    uc_mem_map(uc, ADDRESS, 0x1000, UC_PROT_ALL);
+    uc_mem_write(uc, ADDRESS, code, size);
+
+    if (uc_context_alloc_user(uc, &ctx)) {
+        printf("%d: uc_context_alloc_user() failed\n", arch);
+        return 1;
+    }
+
+    uc_reg_write(uc, r0_reg, &r0);
+    uc_reg_write(uc, d0_reg, &d0);
+    uc_reg_read(uc, nzcv_reg, &nzcv_saved);
+    uc_context_save(uc, ctx);
+
+    // adds sets Z & C, vmov/fmov changes d0
+    uc_emu_start(uc, ADDRESS, ADDRESS + size, 0, 0);
+    uc_reg_read(uc, nzcv_reg, &nzcv);
+    if (nzcv == nzcv_saved) {
+        printf("%d: flags unchanged by the code\n", arch);
+        failed = 1;
+    }
+
+    uc_context_restore(uc, ctx);
+    r0 = d0 = nzcv = 0;
+    uc_reg_read(uc, r0_reg, &r0);
+    uc_reg_read(uc, d0_reg, &d0);
+    uc_reg_read(uc, nzcv_reg, &nzcv);
+    if ((uint32_t)r0 != 0xffffffff || d0 != 0x1234 || nzcv != nzcv_saved) {
+        printf("%d: restored r0 = %llx, d0 = %llx, flags = %llx, expected ffffffff, 1234, %llx\n", arch,
+                (unsigned long long)r0, (unsigned long long)d0, (unsigned long long)nzcv,
+                (unsigned long long)nzcv_saved);
+        failed = 1;
+    }
+
+    uc_free(ctx);
+    uc_close(uc);
+
+    return failed;
+}
+
+static void bench(void)
+{
+    uc_engine *uc;
+    uc_context *ctx;
+    struct timespec t0, t1;
+    int i, n = 1000000;
+
+    uc_open(UC_ARCH_ARM, UC_MODE_ARM, &uc);
+    uc_context_alloc_user(uc, &ctx);
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (i = 0; i < n; i++) {
+        uc_context_save(uc, ctx);
+        uc_context_restore(uc, ctx);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    printf("arm: save + restore of a user context: %.0f ns\n",
+            ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) / n);
+    uc_free(ctx);
+    uc_close(uc);
+}
+
+int main(int argc, char **argv, char **envp)
+{
+    uc_engine *uc;
+    uc_context *ctx;
+    int failed = 0;
+
+    failed |= test_x86();
+    failed |= test_arm(UC_ARCH_ARM, ARM_CODE, sizeof(ARM_CODE) - 1,
+            UC_ARM_REG_R0, UC_ARM_REG_D0, UC_ARM_REG_APSR);
+    failed |= test_arm(UC_ARCH_ARM64, ARM64_CODE, sizeof(ARM64_CODE) - 1,
+            UC_ARM64_REG_X0, UC_ARM64_REG_D0, UC_ARM64_REG_NZCV);
+
+    if (uc_open(UC_ARCH_MIPS, UC_MODE_MIPS32, &uc) == UC_ERR_OK) {
+        if (uc_context_alloc_user(uc, &ctx) != UC_ERR_ARCH) {
+            printf("mips: uc_context_alloc_user() did not fail\n");
+            failed = 1;
+        }
+        uc_close(uc);
+    }
+
+    bench();
+
+    if (failed)
+        printf("\n\nTEST FAILED!\n\n");
+    else
+        printf("\n\nTEST PASSED!\n\n");
+
+    return failed;
+}
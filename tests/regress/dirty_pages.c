@@ -0,0 +1,140 @@
+/*
+   uc_mem_dirty_get() returns the pages written by emulated code and by
+   uc_mem_write() since the last reset, and after uc_mem_dirty_reset() a
+   store through a TLB entry or RAM window already set up is seen again.
+ */
+
+#include <stdio.h>
+
+#include <unicorn/unicorn.h>
+
+#define ADDRESS 0x100000
+#define DATA 0x10000000
+#define DATA_SIZE (1024 * 1024)
+
+// str r2, [r1]
+#define ARM_STORE "\x00\x20\x81\xe5"
+
+static size_t page_size;
+
+static uc_err store(uc_engine *uc, uint32_t addr)
+{
+    uint32_t r2 = 0x11223344;
+
+    uc_reg_write(uc, UC_ARM_REG_R1, &addr);
+    uc_reg_write(uc, UC_ARM_REG_R2, &r2);
+    return uc_emu_start(uc, ADDRESS, ADDRESS + 4, 0, 0);
+}
+
+// the dirty pages must be the @n pages of DATA in @expected
+static int check_dirty(uc_engine *uc, const char *name, const uint32_t *expected, uint32_t n)
+{
+    uc_mem_dirty *regions;
+    uint32_t count, i, found = 0;
+    uint64_t page, pages;
+    int failed = 0;
+    uc_err err;
+
+    err = uc_mem_dirty_get(uc, &regions, &count);
+    if (err) {
+        printf("%s: uc_mem_dirty_get() failed: %s\n", name, uc_strerror(err));
+        return 1;
+    }
+
+    for (i = 0; i < count; i++) {
+        pages = (regions[i].end - regions[i].begin + 1) / page_size;
+        for (page = 0; page < pages; page++) {
+            if (!(regions[i].pages[page / 64] & (1ULL << (page % 64))))
+                continue;
+            if (regions[i].begin != DATA || found >= n || expected[found] != page) {
+                printf("%s: page %#llx dirty\n", name,
+                        (unsigned long long)(regions[i].begin + page * page_size));
+                failed = 1;
+            }
+            found++;
+        }
+    }
+    if (found != n) {
+        printf("%s: %u pages dirty, expected %u\n", name, found, n);
+        failed = 1;
+    }
+    uc_free(regions);
+
+    return failed;
+}
+
+static int test(int fastmem)
+{
+    const uint32_t stored[] = { 5 }, written[] = { 5, 7, 8 };
+    uc_mem_dirty *regions;
+    uc_engine *uc;
+    uint32_t count;
+    int failed = 0;
+    uc_err err;
+
+    err = uc_open(UC_ARCH_ARM, UC_MODE_ARM, &uc);
+    if (err) {
+        printf("uc_open() failed: %s\n", uc_strerror(err));
+        return 1;
+    }
+    if (fastmem && uc_option(uc, UC_OPT_FASTMEM, 1)) {
+        // not supported on this host
+        uc_close(uc);
+        return 0;
+    }
+    uc_query(uc, UC_QUERY_PAGE_SIZE, &page_size);
+
+    uc_mem_map(uc, ADDRESS, 0x1000, UC_PROT_ALL);
+    uc_mem_map(uc, DATA, DATA_SIZE, UC_PROT_READ | UC_PROT_WRITE);
+    uc_mem_write(uc, ADDRESS, ARM_STORE, 4);
+
+    if (uc_mem_dirty_get(uc, &regions, &count) != UC_ERR_ARG) {
+        printf("not started: uc_mem_dirty_get() did not fail\n");
+        failed = 1;
+    }
+
+    // the TLB has the page before tracking starts
+    store(uc, DATA + 5 * page_size);
+    uc_mem_dirty_start(uc);
+    failed |= check_dirty(uc, "start", NULL, 0);
+
+    err = store(uc, DATA + 5 * page_size);
+    if (err) {
+        printf("store: %s\n", uc_strerror(err));
+        failed = 1;
+    }
+    failed |= check_dirty(uc, "store", stored, 1);
+
+    // across two pages
+    uc_mem_write(uc, DATA + 8 * page_size - 2, "\x78\x56\x34\x12", 4);
+    failed |= check_dirty(uc, "write", written, 3);
+
+    uc_mem_dirty_reset(uc);
+    failed |= check_dirty(uc, "reset", NULL, 0);
+
+    // the TLB entry, now writable, must be caught again
+    store(uc, DATA + 5 * page_size);
+    failed |= check_dirty(uc, "store again", stored, 1);
+
+    uc_close(uc);
+
+    if (failed)
+        printf("with fastmem %d\n", fastmem);
+
+    return failed;
+}
+
+int main(int argc, char **argv, char **envp)
+{
+    int failed;
+
+    failed = test(0);
+    failed |= test(1);
+
+    if (failed)
+        printf("\n\nTEST FAILED!\n\n");
+    else
+        printf("\n\nTEST PASSED!\n\n");
+
+    return failed;
+}
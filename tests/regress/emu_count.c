@@ -0,0 +1,193 @@
+/*
+   uc_emu_start() with @count must run exactly @count instructions, also
+   when the budget runs out in the middle of a block, spans many blocks,
+   or is crossed by an interrupt, and with or without hooks installed.
+   A hook moving the PC in the middle of a block is only charged for the
+   instructions run.
+ */
+
+#include <string.h>
+#include <stdio.h>
+
+#include <unicorn/unicorn.h>
+
+#define ADDRESS 0x1000000
+
+// inc ecx; inc ecx; jmp $+2; inc ecx; inc ecx; inc ecx
+#define X86_BLOCKS "\x41\x41\xeb\x00\x41\x41\x41"
+// loop: inc ecx; jmp loop
+#define X86_LOOP "\x41\xeb\xfd"
+// inc ecx; int 0x80; inc ecx; inc ecx
+#define X86_INT "\x41\xcd\x80\x41\x41"
+// add r0, r0, #1 (x4)
+#define ARM_CODE "\x01\x00\x80\xe2\x01\x00\x80\xe2\x01\x00\x80\xe2\x01\x00\x80\xe2"
+
+static int blocks, insns;
+
+static void hook_block(uc_engine *uc, uint64_t address, uint32_t size, void *user_data)
+{
+    blocks++;
+}
+
+static void hook_code(uc_engine *uc, uint64_t address, uint32_t size, void *user_data)
+{
+    insns++;
+}
+
+static void hook_intr(uc_engine *uc, uint32_t intno, void *user_data)
+{
+}
+
+// go back to the start, the first time only
+static void hook_jump(uc_engine *uc, uint64_t address, uint32_t size, void *user_data)
+{
+    uint32_t pc = ADDRESS;
+
+    if (insns++ == 0)
+        uc_reg_write(uc, UC_ARM_REG_PC, &pc);
+}
+
+static int run_x86(uc_engine *uc, const char *name, size_t code_size, size_t count,
+        uint32_t ecx_expected, uint32_t eip_expected)
+{
+    uint32_t ecx = 0, eip;
+    uc_err err;
+
+    uc_reg_write(uc, UC_X86_REG_ECX, &ecx);
+    err = uc_emu_start(uc, ADDRESS, ADDRESS + code_size, 0, count);
+    if (err) {
+        printf("%s: uc_emu_start() failed: %s\n", name, uc_strerror(err));
+        return 1;
+    }
+
+    uc_reg_read(uc, UC_X86_REG_ECX, &ecx);
+    uc_reg_read(uc, UC_X86_REG_EIP, &eip);
+    if (ecx != ecx_expected || eip != ADDRESS + eip_expected) {
+        printf("%s: count %zu: ecx = %u, eip = +%u, expected %u, +%u\n", name, count,
+                ecx, eip - ADDRESS, ecx_expected, eip_expected);
+        return 1;
+    }
+
+    return 0;
+}
+
+static int test_x86(void)
+{
+    uc_engine *uc;
+    uc_hook block, code;
+    size_t i;
+    int failed = 0;
+    // address of the next instruction to run after i instructions
+    static const uint32_t next[] = { 0, 1, 2, 4, 5, 6, 7 };
+
+    if (uc_open(UC_ARCH_X86, UC_MODE_32, &uc)) {
+        printf("uc_open() failed\n");
+        return 1;
+    }
+
+    uc_mem_map(uc, ADDRESS, 0x1000, UC_PROT_ALL);
+    uc_mem_write(uc, ADDRESS, X86_BLOCKS, sizeof(X86_BLOCKS) - 1);
+
+    // every budget stops at the exact instruction, cached code or not
+    for (i = 1; i <= 6; i++) {
+        failed |= run_x86(uc, "blocks", sizeof(X86_BLOCKS) - 1, i, i < 3 ? i : i - 1, next[i]);
+        failed |= run_x86(uc, "blocks again", sizeof(X86_BLOCKS) - 1, i, i < 3 ? i : i - 1, next[i]);
+    }
+
+    // no budget runs up to @until
+    failed |= run_x86(uc, "no count", sizeof(X86_BLOCKS) - 1, 0, 5, 7);
+
+    // a block the budget does not reach is not hooked
+    uc_hook_add(uc, &block, UC_HOOK_BLOCK, hook_block, NULL, 1, 0);
+    uc_hook_add(uc, &code, UC_HOOK_CODE, hook_code, NULL, 1, 0);
+    blocks = insns = 0;
+    failed |= run_x86(uc, "hooked", sizeof(X86_BLOCKS) - 1, 3, 2, 4);
+    if (blocks != 1 || insns != 3) {
+        printf("hooked: %d blocks & %d instructions traced, expected 1 & 3\n", blocks, insns);
+        failed = 1;
+    }
+    blocks = insns = 0;
+    failed |= run_x86(uc, "hooked", sizeof(X86_BLOCKS) - 1, 5, 4, 6);
+    if (blocks != 2 || insns != 5) {
+        printf("hooked: %d blocks & %d instructions traced, expected 2 & 5\n", blocks, insns);
+        failed = 1;
+    }
+    uc_hook_del(uc, block);
+    uc_hook_del(uc, code);
+
+    // a budget spanning many blocks
+    uc_mem_write(uc, ADDRESS, X86_LOOP, sizeof(X86_LOOP) - 1);
+    failed |= run_x86(uc, "loop", sizeof(X86_LOOP) - 1, 100000, 50000, 0);
+    failed |= run_x86(uc, "loop", sizeof(X86_LOOP) - 1, 100001, 50001, 1);
+
+    // an interrupt in the middle does not upset the count
+    uc_hook_add(uc, &code, UC_HOOK_INTR, hook_intr, NULL, 1, 0);
+    uc_mem_write(uc, ADDRESS, X86_INT, sizeof(X86_INT) - 1);
+    failed |= run_x86(uc, "interrupt", sizeof(X86_INT) - 1, 3, 2, 4);
+
+    uc_close(uc);
+
+    return failed;
+}
+
+static int test_arm(void)
+{
+    uc_engine *uc;
+    uc_hook jump;
+    uint32_t r0, pc;
+    size_t i;
+    int failed = 0;
+
+    if (uc_open(UC_ARCH_ARM, UC_MODE_ARM, &uc)) {
+        printf("uc_open() failed\n");
+        return 1;
+    }
+
+    uc_mem_map(uc, ADDRESS, 0x1000, UC_PROT_ALL);
+    uc_mem_write(uc, ADDRESS, ARM_CODE, sizeof(ARM_CODE) - 1);
+
+    for (i = 1; i <= 4; i++) {
+        r0 = 0;
+        uc_reg_write(uc, UC_ARM_REG_R0, &r0);
+        uc_emu_start(uc, ADDRESS, ADDRESS + sizeof(ARM_CODE) - 1, 0, i);
+        uc_reg_read(uc, UC_ARM_REG_R0, &r0);
+        uc_reg_read(uc, UC_ARM_REG_PC, &pc);
+        if (r0 != i || pc != ADDRESS + 4 * i) {
+            printf("arm: count %zu: r0 = %u, pc = +%u, expected %zu, +%zu\n", i,
+                    r0, pc - ADDRESS, i, 4 * i);
+            failed = 1;
+        }
+    }
+
+    // the last two instructions of the block are not charged: runs 0, 1, 0, 1, 2
+    uc_hook_add(uc, &jump, UC_HOOK_CODE, hook_jump, NULL, ADDRESS + 8, ADDRESS + 8);
+    insns = 0;
+    r0 = 0;
+    uc_reg_write(uc, UC_ARM_REG_R0, &r0);
+    uc_emu_start(uc, ADDRESS, ADDRESS + sizeof(ARM_CODE) - 1, 0, 5);
+    uc_reg_read(uc, UC_ARM_REG_R0, &r0);
+    uc_reg_read(uc, UC_ARM_REG_PC, &pc);
+    if (r0 != 5 || pc != ADDRESS + 12) {
+        printf("arm jump: r0 = %u, pc = +%u, expected 5, +12\n", r0, pc - ADDRESS);
+        failed = 1;
+    }
+
+    uc_close(uc);
+
+    return failed;
+}
+
+int main(int argc, char **argv, char **envp)
+{
+    int failed = 0;
+
+    failed |= test_x86();
+    failed |= test_arm();
+
+    if (failed)
+        printf("\n\nTEST FAILED!\n\n");
+    else
+        printf("\n\nTEST PASSED!\n\n");
+
+    return failed;
+}
@@ -0,0 +1,105 @@
+/*
+   A timeout must stop an endless loop, with or without hooks, must not
+   fire for short runs, and must leave an instruction count exact.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <unicorn/unicorn.h>
+
+#define ADDRESS 0x1000000
+#define TIMEOUT (100 * UC_MILISECOND_SCALE)     // microseconds
+
+// loop: inc ecx; jmp loop
+#define X86_LOOP "\x41\xeb\xfd"
+
+static void hook_code(uc_engine *uc, uint64_t address, uint32_t size, void *user_data)
+{
+}
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int run(uc_engine *uc, const char *name, uint64_t until, size_t count,
+        size_t timed_out_expected, uint32_t *ecx)
+{
+    size_t timed_out;
+    double start, elapsed;
+    uc_err err;
+
+    *ecx = 0;
+    uc_reg_write(uc, UC_X86_REG_ECX, ecx);
+    start = now();
+    err = uc_emu_start(uc, ADDRESS, until, TIMEOUT, count);
+    elapsed = now() - start;
+    if (err) {
+        printf("%s: uc_emu_start() failed: %s\n", name, uc_strerror(err));
+        return 1;
+    }
+    uc_reg_read(uc, UC_X86_REG_ECX, ecx);
+
+    uc_query(uc, UC_QUERY_TIMEOUT, &timed_out);
+    if (timed_out != timed_out_expected) {
+        printf("%s: timed out = %zu, expected %zu\n", name, timed_out, timed_out_expected);
+        return 1;
+    }
+    if (timed_out && (elapsed < 0.1 || elapsed > 1)) {
+        printf("%s: timed out after %.3fs, expected 0.1s\n", name, elapsed);
+        return 1;
+    }
+
+    return 0;
+}
+
+int main(int argc, char **argv, char **envp)
+{
+    uc_engine *uc;
+    uc_hook hook;
+    uint32_t ecx;
+    int i, failed = 0;
+
+    if (uc_open(UC_ARCH_X86, UC_MODE_32, &uc)) {
+        printf("uc_open() failed\n");
+        return 1;
+    }
+
+    uc_mem_map(uc, ADDRESS, 0x1000, UC_PROT_ALL);
+    uc_mem_write(uc, ADDRESS, X86_LOOP, sizeof(X86_LOOP) - 1);
+
+    failed |= run(uc, "loop", ADDRESS + 0x100, 0, 1, &ecx);
+
+    // short runs in a row do not time out
+    for (i = 0; i < 10000 && !failed; i++)
+        failed |= run(uc, "short", ADDRESS + 1, 0, 0, &ecx);
+
+    // the instruction count still wins when it comes first
+    failed |= run(uc, "count", ADDRESS + 0x100, 100001, 0, &ecx);
+    if (ecx != 50001) {
+        printf("count: ecx = %u, expected 50001\n", ecx);
+        failed = 1;
+    }
+
+    // slow instructions
+    uc_hook_add(uc, &hook, UC_HOOK_CODE, hook_code, NULL, 1, 0);
+    failed |= run(uc, "hooked loop", ADDRESS + 0x100, 0, 1, &ecx);
+    uc_hook_del(uc, hook);
+
+    // and the loop again, with its translation cached
+    failed |= run(uc, "loop again", ADDRESS + 0x100, 0, 1, &ecx);
+
+    uc_close(uc);
+
+    if (failed)
+        printf("\n\nTEST FAILED!\n\n");
+    else
+        printf("\n\nTEST PASSED!\n\n");
+
+    return failed;
+}
@@ -0,0 +1,257 @@
+/*
+   With UC_OPT_FASTMEM, ARM code must compute the same as without it,
+   still fault at the edges of the RAM window, see changes to code made
+   by its own stores, call memory hooks, and honour uc_mem_protect(). A page
+   protected in the RAM region only leaves that page out of the window.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <unicorn/unicorn.h>
+
+#define FLAT 0
+#define FLAT_SIZE (64 * 1024 * 1024)
+#define CODE 0x1000
+#define CODE2 0x2000
+#define SRC 0x100000
+#define DST 0x1120000
+#define WORDS (4 * 1024 * 1024)
+#define OTHER 0x10000000
+#define RO 0x20000000
+#define GUARD (FLAT + 0x3000000)
+
+// loop: ldr r2, [r0], #4; ldrb r5, [r0, #-3]; ldrsh r6, [r0, #-2]
+//       add r3, r3, r2; add r3, r3, r5; add r3, r3, r6
+//       str r3, [r1], #4; strh r3, [r1, #-2]; subs r4, r4, #1; bne loop
+#define LOOP "\x04\x20\x90\xe4\x03\x50\x50\xe5\xf2\x60\x50\xe1\x02\x30\x83\xe0\x05\x30\x83\xe0\x06\x30\x83\xe0\x04\x30\x81\xe4\xb2\x30\x41\xe1\x01\x40\x54\xe2\xf5\xff\xff\x1a"
+// bl CODE2; str r1, [r0]; bl CODE2
+#define SMC "\xfe\x00\x00\xeb\x00\x10\x80\xe5\xfc\x00\x00\xeb"
+#define SMC_ADDR (CODE2 - 0x400)
+// mov r2, #1; bx lr
+#define MOV1 "\x01\x20\xa0\xe3\x1e\xff\x2f\xe1"
+// mov r2, #2
+#define MOV2 0xe3a02002
+// ldr r2, [r0]; str r1, [r0]
+#define LDR (CODE + 0x100)
+#define STR (CODE + 0x104)
+#define ACCESS "\x00\x20\x90\xe5\x00\x10\x80\xe5"
+
+static uint8_t *flat;
+
+static uc_engine *setup(int fastmem)
+{
+    uc_engine *uc;
+
+    if (uc_open(UC_ARCH_ARM, UC_MODE_ARM, &uc)) {
+        printf("uc_open() failed\n");
+        exit(1);
+    }
+    if (uc_option(uc, UC_OPT_FASTMEM, fastmem)) {
+        printf("uc_option(UC_OPT_FASTMEM) failed\n");
+        exit(1);
+    }
+
+    uc_mem_map_ptr(uc, FLAT, FLAT_SIZE, UC_PROT_ALL, flat);
+    uc_mem_map(uc, OTHER, 0x10000, UC_PROT_READ | UC_PROT_WRITE);
+    uc_mem_map(uc, RO, 0x1000, UC_PROT_READ);
+    uc_mem_write(uc, CODE, LOOP, sizeof(LOOP) - 1);
+    uc_mem_write(uc, SMC_ADDR, SMC, sizeof(SMC) - 1);
+    uc_mem_write(uc, CODE2, MOV1, sizeof(MOV1) - 1);
+    uc_mem_write(uc, LDR, ACCESS, sizeof(ACCESS) - 1);
+
+    return uc;
+}
+
+static uint32_t run_loop(uc_engine *uc, uint32_t words, double *elapsed)
+{
+    uint32_t r0 = SRC, r1 = DST, r3 = 0, r4 = words;
+    struct timespec t0, t1;
+    uc_err err;
+
+    uc_reg_write(uc, UC_ARM_REG_R0, &r0);
+    uc_reg_write(uc, UC_ARM_REG_R1, &r1);
+    uc_reg_write(uc, UC_ARM_REG_R3, &r3);
+    uc_reg_write(uc, UC_ARM_REG_R4, &r4);
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    err = uc_emu_start(uc, CODE, CODE + sizeof(LOOP) - 1, 0, 0);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    if (err)
+        printf("loop: uc_emu_start() failed: %s\n", uc_strerror(err));
+    uc_reg_read(uc, UC_ARM_REG_R3, &r3);
+    if (elapsed)
+        *elapsed = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+
+    return r3;
+}
+
+// one load or store at @addr, expecting @expected
+static int run_access(uc_engine *uc, int fastmem, uint64_t pc, uint32_t addr, uc_err expected)
+{
+    uint32_t r1 = 0x12345678;
+    uc_err err;
+
+    uc_reg_write(uc, UC_ARM_REG_R0, &addr);
+    uc_reg_write(uc, UC_ARM_REG_R1, &r1);
+    err = uc_emu_start(uc, pc, pc + 4, 0, 0);
+    if (err != expected) {
+        printf("fastmem %d: %s at 0x%x: %s, expected %s\n", fastmem,
+                pc == LDR ? "load" : "store", addr, uc_strerror(err), uc_strerror(expected));
+        return 1;
+    }
+
+    return 0;
+}
+
+static int test_edges(int fastmem)
+{
+    uc_engine *uc = setup(fastmem);
+    int failed = 0;
+
+    failed |= run_access(uc, fastmem, STR, FLAT + FLAT_SIZE - 4, UC_ERR_OK);
+    failed |= run_access(uc, fastmem, LDR, FLAT + FLAT_SIZE - 4, UC_ERR_OK);
+    failed |= run_access(uc, fastmem, LDR, FLAT + FLAT_SIZE - 2, UC_ERR_READ_UNMAPPED);
+    failed |= run_access(uc, fastmem, STR, FLAT + FLAT_SIZE, UC_ERR_WRITE_UNMAPPED);
+    failed |= run_access(uc, fastmem, STR, OTHER + 0x100, UC_ERR_OK);
+    failed |= run_access(uc, fastmem, LDR, OTHER + 0x100, UC_ERR_OK);
+    failed |= run_access(uc, fastmem, STR, RO, UC_ERR_WRITE_PROT);
+    failed |= run_access(uc, fastmem, LDR, RO - 4, UC_ERR_READ_UNMAPPED);
+
+    // part of the window becomes read-only
+    failed |= run_access(uc, fastmem, STR, DST, UC_ERR_OK);
+    uc_mem_protect(uc, DST, 0x1000, UC_PROT_READ);
+    failed |= run_access(uc, fastmem, STR, DST, UC_ERR_WRITE_PROT);
+    failed |= run_access(uc, fastmem, LDR, DST, UC_ERR_OK);
+    failed |= run_access(uc, fastmem, STR, DST + 0x1000, UC_ERR_OK);
+
+    uc_close(uc);
+
+    return failed;
+}
+
+static int test_smc(int fastmem)
+{
+    uc_engine *uc = setup(fastmem);
+    uint32_t r0 = CODE2, r1 = MOV2, r2;
+    int failed = 0;
+
+    // call a function, change its first instruction, and call it again
+    uc_reg_write(uc, UC_ARM_REG_R0, &r0);
+    uc_reg_write(uc, UC_ARM_REG_R1, &r1);
+    uc_emu_start(uc, SMC_ADDR, SMC_ADDR + sizeof(SMC) - 1, 0, 0);
+    uc_reg_read(uc, UC_ARM_REG_R2, &r2);
+    if (r2 != 2) {
+        printf("fastmem %d: code changed by a store still ran as before\n", fastmem);
+        failed = 1;
+    }
+
+    uc_close(uc);
+
+    return failed;
+}
+
+static int test_guard_page(void)
+{
+    uc_engine *uc = setup(1);
+    size_t hits;
+    int failed = 0;
+
+    // the loop is away from the guard page, so runs from the window
+    uc_mem_protect(uc, GUARD, 0x1000, UC_PROT_NONE);
+    if (uc_option(uc, UC_OPT_TLB_COUNT_HITS, 1) == UC_ERR_OK) {
+        run_loop(uc, 1024, NULL);
+        uc_query(uc, UC_QUERY_TLB_HITS, &hits);
+        if (hits >= 1024) {
+            printf("fastmem: %zu TLB hits with a guard page, the window is gone\n", hits);
+            failed = 1;
+        }
+    }
+
+    failed |= run_access(uc, 1, LDR, GUARD, UC_ERR_READ_PROT);
+    failed |= run_access(uc, 1, STR, GUARD + 0xffc, UC_ERR_WRITE_PROT);
+    failed |= run_access(uc, 1, STR, GUARD - 4, UC_ERR_OK);
+    failed |= run_access(uc, 1, LDR, GUARD + 0x1000, UC_ERR_OK);
+
+    uc_close(uc);
+
+    return failed;
+}
+
+static void hook_write(uc_engine *uc, uc_mem_type type, uint64_t address, int size, int64_t value, void *user_data)
+{
+    (*(int *)user_data)++;
+}
+
+static int test_hook(void)
+{
+    uc_engine *uc = setup(1);
+    uc_hook hook;
+    int writes = 0;
+
+    uc_hook_add(uc, &hook, UC_HOOK_MEM_WRITE, hook_write, &writes, 1, 0);
+    run_loop(uc, 16, NULL);
+    uc_close(uc);
+    if (writes != 32) {
+        printf("fastmem: %d writes hooked, expected 32\n", writes);
+        return 1;
+    }
+
+    return 0;
+}
+
+int main(int argc, char **argv, char **envp)
+{
+    uc_engine *uc;
+    uint32_t *src, sum[2], i;
+    uint8_t *dst;
+    double elapsed[2];
+    int fastmem, failed = 0;
+
+    flat = calloc(1, FLAT_SIZE);
+    src = (uint32_t *)(flat + SRC);
+    dst = malloc(WORDS * 4);
+    for (i = 0; i < WORDS; i++)
+        src[i] = i * 2654435761u;
+
+    // same results, and timing
+    for (fastmem = 0; fastmem < 2; fastmem++) {
+        uc = setup(fastmem);
+        memset(flat + DST, 0, WORDS * 4);
+        sum[fastmem] = run_loop(uc, WORDS, &elapsed[fastmem]);
+        uc_close(uc);
+        if (fastmem == 0) {
+            memcpy(dst, flat + DST, WORDS * 4);
+        } else if (sum[1] != sum[0] || memcmp(dst, flat + DST, WORDS * 4)) {
+            printf("fastmem: sum = 0x%x, expected 0x%x, or stores differ\n", sum[1], sum[0]);
+            failed = 1;
+        }
+    }
+    printf("arm: %u words summed in %.3fs, %.3fs with fastmem\n", WORDS, elapsed[0], elapsed[1]);
+
+    for (fastmem = 0; fastmem < 2; fastmem++) {
+        failed |= test_edges(fastmem);
+        failed |= test_smc(fastmem);
+    }
+    failed |= test_hook();
+    failed |= test_guard_page();
+
+    if (uc_open(UC_ARCH_X86, UC_MODE_32, &uc) == UC_ERR_OK) {
+        if (uc_option(uc, UC_OPT_FASTMEM, 1) != UC_ERR_ARG) {
+            printf("x86: uc_option(UC_OPT_FASTMEM) did not fail\n");
+            failed = 1;
+        }
+        uc_close(uc);
+    }
+
+    free(dst);
+    free(flat);
+
+    if (failed)
+        printf("\n\nTEST FAILED!\n\n");
+    else
+        printf("\n\nTEST PASSED!\n\n");
+
+    return failed;
+}
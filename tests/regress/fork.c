@@ -0,0 +1,186 @@
+/*
+   uc_fork() must give an engine with the memory, registers and hooks of
+   its parent, each writing to its own copy of the memory from then on,
+   and forking again must not copy the RAM, whatever its size. RAM smaller
+   than a host page is copied instead.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <unicorn/unicorn.h>
+
+#define ADDRESS 0x100000
+#define DATA 0x10000000
+#define DATA_SIZE (256 * 1024 * 1024)
+#define FAR (DATA + DATA_SIZE / 2)
+#define USER 0x200000
+// regions of a 1 KB guest page each, less than a host page
+#define SMALL 0x300000
+#define FORKS 100
+
+// ldr r2, [r1]; add r2, r2, r0; str r2, [r1]
+#define ARM_CODE "\x00\x20\x91\xe5\x00\x20\x82\xe0\x00\x20\x81\xe5"
+
+static void hook_code(uc_engine *uc, uint64_t address, uint32_t size, void *user_data)
+{
+    (*(uint64_t *)user_data)++;
+}
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// adds r0 to the word at DATA
+static int run(uc_engine *uc, const char *name, uint32_t r0)
+{
+    uc_err err;
+
+    uc_reg_write(uc, UC_ARM_REG_R0, &r0);
+    err = uc_emu_start(uc, ADDRESS, ADDRESS + sizeof(ARM_CODE) - 1, 0, 0);
+    if (err) {
+        printf("%s: uc_emu_start() failed: %s\n", name, uc_strerror(err));
+        return 1;
+    }
+
+    return 0;
+}
+
+static int check_word(uc_engine *uc, const char *name, uint64_t address, uint32_t expected)
+{
+    uint32_t value = 0;
+
+    uc_mem_read(uc, address, &value, sizeof(value));
+    if (value != expected) {
+        printf("%s: %u at %#llx, expected %u\n", name, value, (unsigned long long)address, expected);
+        return 1;
+    }
+
+    return 0;
+}
+
+int main(int argc, char **argv, char **envp)
+{
+    uc_engine *uc, *child, *grandchild;
+    uc_hook hook, gone;
+    uint64_t calls = 0, deleted = 0;
+    uint32_t value = 100, r1 = DATA, reg = 0;
+    uint8_t *user = calloc(1, 0x1000);
+    double t0, first, next;
+    int failed = 0, i;
+
+    if (uc_open(UC_ARCH_ARM, UC_MODE_ARM, &uc)) {
+        printf("uc_open() failed\n");
+        return 1;
+    }
+
+    uc_mem_map(uc, ADDRESS, 0x1000, UC_PROT_READ | UC_PROT_EXEC);
+    uc_mem_write(uc, ADDRESS, ARM_CODE, sizeof(ARM_CODE) - 1);
+    uc_mem_map(uc, DATA, DATA_SIZE, UC_PROT_ALL);
+    uc_mem_write(uc, DATA, &value, sizeof(value));
+    uc_mem_write(uc, FAR, &value, sizeof(value));
+    uc_mem_map_ptr(uc, USER, 0x1000, UC_PROT_ALL, user);
+    user[0] = 1;
+    uc_reg_write(uc, UC_ARM_REG_R1, &r1);
+    uc_hook_add(uc, &hook, UC_HOOK_CODE, hook_code, &calls, ADDRESS, ADDRESS + 0xfff);
+    uc_hook_add(uc, &gone, UC_HOOK_CODE, hook_code, &deleted, 1, 0);
+    uc_hook_del(uc, gone);
+
+    t0 = now();
+    if (uc_fork(uc, &child)) {
+        printf("uc_fork() failed\n");
+        return 1;
+    }
+    first = now() - t0;
+
+    // the same registers, memory & hooks
+    uc_reg_read(child, UC_ARM_REG_R1, &reg);
+    if (reg != DATA) {
+        printf("child: r1 is %#x, expected %#x\n", reg, DATA);
+        failed = 1;
+    }
+    failed |= check_word(child, "child", FAR, 100);
+    failed |= run(child, "child", 5);
+    failed |= check_word(child, "child", DATA, 105);
+    if (calls != 3 || deleted != 0) {
+        printf("child: %llu hook calls & %llu of a deleted hook, expected 3 & 0\n",
+                (unsigned long long)calls, (unsigned long long)deleted);
+        failed = 1;
+    }
+
+    // each its own memory
+    failed |= check_word(uc, "parent", DATA, 100);
+    failed |= run(uc, "parent", 7);
+    failed |= check_word(uc, "parent", DATA, 107);
+    failed |= check_word(child, "child", DATA, 105);
+
+    // a copy of the memory given to uc_mem_map_ptr()
+    value = 2;
+    uc_mem_write(child, USER, &value, 1);
+    if (user[0] != 1) {
+        printf("child: wrote to the memory of the parent\n");
+        failed = 1;
+    }
+
+    // forks of a fork
+    if (uc_fork(child, &grandchild)) {
+        printf("uc_fork() of the child failed\n");
+        return 1;
+    }
+    failed |= run(grandchild, "grandchild", 1);
+    failed |= check_word(grandchild, "grandchild", DATA, 106);
+    failed |= check_word(child, "child", DATA, 105);
+    uc_close(grandchild);
+    uc_close(child);
+
+    // the memory has not changed since the last fork: nothing to copy
+    t0 = now();
+    for (i = 0; i < FORKS; i++) {
+        if (uc_fork(uc, &child)) {
+            printf("uc_fork() %d failed\n", i);
+            return 1;
+        }
+        if (i == 0)
+            failed |= check_word(child, "again", DATA, 107);
+        uc_close(child);
+    }
+    next = (now() - t0) / FORKS;
+
+    printf("fork of %d MB of RAM: %.3f ms the first time, then %.3f ms\n",
+            DATA_SIZE >> 20, first * 1e3, next * 1e3);
+
+    // side by side
+    uc_mem_map(uc, SMALL, 0x400, UC_PROT_ALL);
+    uc_mem_map(uc, SMALL + 0x400, 0x400, UC_PROT_ALL);
+    value = 1;
+    uc_mem_write(uc, SMALL, &value, sizeof(value));
+    value = 2;
+    uc_mem_write(uc, SMALL + 0x400, &value, sizeof(value));
+    if (uc_fork(uc, &child)) {
+        printf("uc_fork() with small regions failed\n");
+        return 1;
+    }
+    failed |= check_word(child, "small", SMALL, 1);
+    failed |= check_word(child, "small", SMALL + 0x400, 2);
+    failed |= check_word(child, "small", DATA, 107);
+    value = 3;
+    uc_mem_write(child, SMALL + 0x400, &value, sizeof(value));
+    failed |= check_word(uc, "small parent", SMALL + 0x400, 2);
+    failed |= check_word(uc, "small parent", SMALL, 1);
+    uc_close(child);
+    uc_close(uc);
+    free(user);
+
+    if (failed)
+        printf("\n\nTEST FAILED!\n\n");
+    else
+        printf("\n\nTEST PASSED!\n\n");
+
+    return failed;
+}
@@ -0,0 +1,110 @@
+/*
+   Block and code hooks must not break the chaining of translated
+   blocks: a tight loop must run without going back to the TB lookup,
+   whatever hook is installed, on every target.
+ */
+
+#include <stdio.h>
+
+#include <unicorn/unicorn.h>
+
+#define ADDRESS 0x100000
+#define LOOPS 10000
+// lookups allowed for the entry, the loop and the until address
+#define MAX_LOOKUPS 8
+
+struct target {
+    const char *name;
+    uc_arch arch;
+    uc_mode mode;
+    const char *code;
+    size_t size;
+    int counter;
+    int insns;  // per iteration
+};
+
+static const struct target targets[] = {
+    // loop: inc ecx; dec eax; jnz loop
+    { "x86", UC_ARCH_X86, UC_MODE_32, "\x41\x48\x75\xfc", 4, UC_X86_REG_EAX, 3 },
+    // loop: add r1, r1, #1; subs r0, r0, #1; bne loop
+    { "arm", UC_ARCH_ARM, UC_MODE_ARM, "\x01\x10\x81\xe2\x01\x00\x50\xe2\xfc\xff\xff\x1a", 12, UC_ARM_REG_R0, 3 },
+    // loop: subs x0, x0, #1; b.ne loop
+    { "arm64", UC_ARCH_ARM64, UC_MODE_ARM, "\x00\x04\x00\xf1\xe1\xff\xff\x54", 8, UC_ARM64_REG_X0, 2 },
+    // loop: addiu $a0, $a0, -1; bnez $a0, loop; nop
+    { "mips", UC_ARCH_MIPS, UC_MODE_MIPS32 | UC_MODE_LITTLE_ENDIAN,
+        "\xff\xff\x84\x24\xfe\xff\x80\x14\x00\x00\x00\x00", 12, UC_MIPS_REG_4, 3 },
+    // loop: subcc %o0, 1, %o0; bne loop; nop
+    { "sparc", UC_ARCH_SPARC, UC_MODE_SPARC32 | UC_MODE_BIG_ENDIAN,
+        "\x90\xa2\x20\x01\x12\xbf\xff\xff\x01\x00\x00\x00", 12, UC_SPARC_REG_O0, 3 },
+    // loop: subq.l #1, d0; bne.b loop
+    { "m68k", UC_ARCH_M68K, UC_MODE_BIG_ENDIAN, "\x53\x80\x66\xfc", 4, UC_M68K_REG_D0, 2 },
+};
+
+static void hook_count(uc_engine *uc, uint64_t address, uint32_t size, void *user_data)
+{
+    (*(uint64_t *)user_data)++;
+}
+
+static int run(const struct target *t, uc_hook_type type)
+{
+    const char *name = type == UC_HOOK_BLOCK ? "block hook" : type == UC_HOOK_CODE ? "code hook" : "no hook";
+    uint64_t counter = LOOPS, calls = 0, expected;
+    uc_engine *uc;
+    uc_hook hook;
+    uc_stats stats;
+    uc_err err;
+
+    err = uc_open(t->arch, t->mode, &uc);
+    if (err) {
+        printf("%s: uc_open() failed: %s\n", t->name, uc_strerror(err));
+        return 1;
+    }
+
+    uc_mem_map(uc, ADDRESS, 0x1000, UC_PROT_ALL);
+    uc_mem_write(uc, ADDRESS, t->code, t->size);
+    uc_reg_write(uc, t->counter, &counter);
+    if (type)
+        uc_hook_add(uc, &hook, type, hook_count, &calls, 1, 0);
+
+    err = uc_emu_start(uc, ADDRESS, ADDRESS + t->size, 0, 0);
+    uc_stats_get(uc, &stats);
+    uc_close(uc);
+
+    if (err) {
+        printf("%s, %s: uc_emu_start() failed: %s\n", t->name, name, uc_strerror(err));
+        return 1;
+    }
+
+    expected = type == UC_HOOK_BLOCK ? LOOPS : type == UC_HOOK_CODE ? (uint64_t)LOOPS * t->insns : 0;
+    if (calls != expected) {
+        printf("%s, %s: %llu hook calls, expected %llu\n", t->name, name,
+                (unsigned long long)calls, (unsigned long long)expected);
+        return 1;
+    }
+    if (stats.tb_fast_hits + stats.tb_slow_lookups > MAX_LOOKUPS) {
+        printf("%s, %s: %llu TB lookups for %d iterations, chaining is broken\n", t->name, name,
+                (unsigned long long)(stats.tb_fast_hits + stats.tb_slow_lookups), LOOPS);
+        return 1;
+    }
+
+    return 0;
+}
+
+int main(int argc, char **argv, char **envp)
+{
+    int failed = 0;
+    size_t i;
+
+    for (i = 0; i < sizeof(targets) / sizeof(targets[0]); i++) {
+        failed |= run(&targets[i], 0);
+        failed |= run(&targets[i], UC_HOOK_BLOCK);
+        failed |= run(&targets[i], UC_HOOK_CODE);
+    }
+
+    if (failed)
+        printf("\n\nTEST FAILED!\n\n");
+    else
+        printf("\n\nTEST PASSED!\n\n");
+
+    return failed;
+}
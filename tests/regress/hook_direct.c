@@ -0,0 +1,134 @@
+/*
+   Code hooks called straight from translated code (UC_OPT_HOOK_DIRECT)
+   must see the same instructions, sizes & PC as through the generic
+   tracing helper, and still be able to stop emulation.
+ */
+
+#include <string.h>
+#include <stdio.h>
+
+#include <unicorn/unicorn.h>
+
+#define ADDRESS 0x10000
+
+// mov r0, #1; add r0, r0, #2; add r0, r0, #3; add r0, r0, #4
+#define ARM_CODE "\x01\x00\xa0\xe3\x02\x00\x80\xe2\x03\x00\x80\xe2\x04\x00\x80\xe2"
+// movs r0, #1; adds r0, #2; adds r0, #3; adds r0, #4
+#define THUMB_CODE "\x01\x20\x02\x30\x03\x30\x04\x30"
+// mov x0, #1; add x0, x0, #2; add x0, x0, #3; add x0, x0, #4
+#define ARM64_CODE "\x20\x00\x80\xd2\x00\x08\x00\x91\x00\x0c\x00\x91\x00\x10\x00\x91"
+
+struct run {
+    uc_arch arch;
+    uc_mode mode;
+    const char *code;
+    size_t size;
+    int pc_reg;
+    uint64_t pc_or;
+};
+
+static char trace[256];
+static uint64_t stop_at;
+static int pc_reg;
+
+static void hook_code(uc_engine *uc, uint64_t address, uint32_t size, void *user_data)
+{
+    char buf[32];
+    uint64_t pc = 0;
+
+    uc_reg_read(uc, pc_reg, &pc);
+    snprintf(buf, sizeof(buf), "%s%x/%u%s ", (char *)user_data, (unsigned int)(address - ADDRESS),
+            size, pc == address ? "" : "!");
+    strncat(trace, buf, sizeof(trace) - strlen(trace) - 1);
+
+    if (address == stop_at)
+        uc_emu_stop(uc);
+}
+
+static int run(const struct run *r, int direct, uint64_t stop, size_t count, char *out)
+{
+    uc_engine *uc;
+    uc_hook all, one;
+    uc_err err;
+    uint64_t start = ADDRESS | r->pc_or;
+
+    if (uc_open(r->arch, r->mode, &uc)) {
+        printf("uc_open() failed\n");
+        return 1;
+    }
+
+    err = uc_option(uc, UC_OPT_HOOK_DIRECT, direct);
+    if (err) {
+        printf("uc_option() failed: %s\n", uc_strerror(err));
+        uc_close(uc);
+        return 1;
+    }
+
+    uc_mem_map(uc, ADDRESS, 0x1000, UC_PROT_ALL);
+    uc_mem_write(uc, ADDRESS, r->code, r->size);
+    uc_hook_add(uc, &all, UC_HOOK_CODE, hook_code, "a", 1, 0);
+    uc_hook_add(uc, &one, UC_HOOK_CODE, hook_code, "o", ADDRESS + 4, ADDRESS + 4);
+
+    pc_reg = r->pc_reg;
+    stop_at = stop;
+    trace[0] = '\0';
+    err = uc_emu_start(uc, start, ADDRESS + r->size, 0, count);
+    if (err) {
+        printf("uc_emu_start() failed: %s\n", uc_strerror(err));
+        uc_close(uc);
+        return 1;
+    }
+    strcpy(out, trace);
+
+    uc_close(uc);
+    return 0;
+}
+
+static int compare(const struct run *r, const char *name, uint64_t stop, size_t count)
+{
+    char helper[256], direct[256];
+
+    if (run(r, 0, stop, count, helper) || run(r, 1, stop, count, direct))
+        return 1;
+
+    if (strcmp(helper, direct)) {
+        printf("%s: direct calls traced \"%s\", helper traced \"%s\"\n", name, direct, helper);
+        return 1;
+    }
+
+    return 0;
+}
+
+int main(int argc, char **argv, char **envp)
+{
+    const struct run arm = { UC_ARCH_ARM, UC_MODE_ARM, ARM_CODE, sizeof(ARM_CODE) - 1, UC_ARM_REG_PC, 0 };
+    const struct run thumb = { UC_ARCH_ARM, UC_MODE_THUMB, THUMB_CODE, sizeof(THUMB_CODE) - 1, UC_ARM_REG_PC, 1 };
+    const struct run arm64 = { UC_ARCH_ARM64, UC_MODE_ARM, ARM64_CODE, sizeof(ARM64_CODE) - 1, UC_ARM64_REG_PC, 0 };
+    uc_engine *uc;
+    int failed = 0;
+
+    failed |= compare(&arm, "arm", 0, 0);
+    failed |= compare(&arm, "arm stop", ADDRESS + 4, 0);
+    failed |= compare(&arm, "arm count", 0, 3);
+    failed |= compare(&thumb, "thumb", 0, 0);
+    failed |= compare(&thumb, "thumb stop", ADDRESS + 4, 0);
+    failed |= compare(&arm64, "arm64", 0, 0);
+    failed |= compare(&arm64, "arm64 stop", ADDRESS + 4, 0);
+    failed |= compare(&arm64, "arm64 count", 0, 3);
+
+    // only supported on ARM & ARM64
+    if (uc_open(UC_ARCH_X86, UC_MODE_32, &uc) == UC_ERR_OK) {
+        if (uc_option(uc, UC_OPT_HOOK_DIRECT, 1) != UC_ERR_ARG) {
+            printf("x86: UC_OPT_HOOK_DIRECT accepted\n");
+            failed = 1;
+        }
+        uc_close(uc);
+    }
+
+    if (failed)
+        printf("\n\nTEST FAILED!\n\n");
+    else
+        printf("\n\nTEST PASSED!\n\n");
+
+    return failed;
+}
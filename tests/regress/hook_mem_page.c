@@ -0,0 +1,171 @@
+/*
+   Memory hooks must only send the accesses to the pages they cover
+   through the softmmu helpers: loads elsewhere stay on the TLB fast
+   path, while the hooks still see every access in their range, even
+   when added or removed between or during runs.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <unicorn/unicorn.h>
+
+#define ADDRESS 0x100000
+#define DATA 0x200000
+#define WATCHED (DATA + 0x10000)
+#define LOOPS 100000
+
+// loop: ldr r2, [r1]; str r2, [r1, #4]; subs r0, r0, #1; bne loop
+#define ARM_CODE "\x00\x20\x91\xe5\x04\x20\x81\xe5\x01\x00\x50\xe2\xfb\xff\xff\x1a"
+
+struct counts {
+    uint64_t reads, writes, reads_after;
+    uc_hook extra;
+};
+
+static void hook_mem(uc_engine *uc, uc_mem_type type, uint64_t address, int size, int64_t value, void *user_data)
+{
+    struct counts *counts = user_data;
+
+    switch (type) {
+        default:
+            break;
+        case UC_MEM_READ:
+            counts->reads++;
+            break;
+        case UC_MEM_WRITE:
+            counts->writes++;
+            break;
+        case UC_MEM_READ_AFTER:
+            counts->reads_after++;
+            break;
+    }
+}
+
+// adds a write hook on the first read, from the hook itself
+static void hook_add_write(uc_engine *uc, uc_mem_type type, uint64_t address, int size, int64_t value, void *user_data)
+{
+    struct counts *counts = user_data;
+
+    if (counts->reads++ == 0)
+        uc_hook_add(uc, &counts->extra, UC_HOOK_MEM_WRITE, hook_mem, counts, address + 4, address + 7);
+}
+
+static uc_engine *setup(void)
+{
+    uc_engine *uc;
+
+    if (uc_open(UC_ARCH_ARM, UC_MODE_ARM, &uc)) {
+        printf("uc_open() failed\n");
+        exit(1);
+    }
+
+    uc_mem_map(uc, ADDRESS, 0x1000, UC_PROT_ALL);
+    uc_mem_write(uc, ADDRESS, ARM_CODE, sizeof(ARM_CODE) - 1);
+    uc_mem_map(uc, DATA, 0x20000, UC_PROT_ALL);
+    uc_option(uc, UC_OPT_TLB_COUNT_HITS, 1);
+
+    return uc;
+}
+
+// loads & stores LOOPS times at @addr, returns the TLB hits or -1 on error
+static long run(uc_engine *uc, const char *name, uint32_t addr)
+{
+    uint32_t r0 = LOOPS, r1 = addr;
+    size_t hits = 0, before = 0;
+    uc_err err;
+
+    uc_query(uc, UC_QUERY_TLB_HITS, &before);
+    uc_reg_write(uc, UC_ARM_REG_R0, &r0);
+    uc_reg_write(uc, UC_ARM_REG_R1, &r1);
+    err = uc_emu_start(uc, ADDRESS, ADDRESS + sizeof(ARM_CODE) - 1, 0, 0);
+    if (err) {
+        printf("%s: uc_emu_start() failed: %s\n", name, uc_strerror(err));
+        return -1;
+    }
+    uc_query(uc, UC_QUERY_TLB_HITS, &hits);
+
+    return (long)(hits - before);
+}
+
+static int check(const char *name, struct counts *counts, uint64_t reads, uint64_t writes, uint64_t reads_after)
+{
+    if (counts->reads != reads || counts->writes != writes || counts->reads_after != reads_after) {
+        printf("%s: %llu reads, %llu writes, %llu reads after, expected %llu, %llu, %llu\n", name,
+                (unsigned long long)counts->reads, (unsigned long long)counts->writes,
+                (unsigned long long)counts->reads_after, (unsigned long long)reads,
+                (unsigned long long)writes, (unsigned long long)reads_after);
+        return 1;
+    }
+
+    return 0;
+}
+
+int main(int argc, char **argv, char **envp)
+{
+    uc_engine *uc;
+    uc_hook hooks[3];
+    struct counts counts = { 0 };
+    long plain, hits;
+    int failed = 0;
+
+    uc = setup();
+    plain = run(uc, "plain", DATA);
+    failed |= plain < 0;
+    // hits are only counted by x86 hosts
+    if (plain == 0)
+        printf("TLB hits not counted on this host, only checking hook calls\n");
+
+    // hooks on 4 bytes of another page
+    uc_hook_add(uc, &hooks[0], UC_HOOK_MEM_READ, hook_mem, &counts, WATCHED, WATCHED + 3);
+    uc_hook_add(uc, &hooks[1], UC_HOOK_MEM_WRITE, hook_mem, &counts, WATCHED + 4, WATCHED + 7);
+    uc_hook_add(uc, &hooks[2], UC_HOOK_MEM_READ_AFTER, hook_mem, &counts, WATCHED, WATCHED + 3);
+    hits = run(uc, "elsewhere", DATA);
+    failed |= hits < 0;
+    failed |= check("elsewhere", &counts, 0, 0, 0);
+    printf("%d loads & stores: %ld TLB hits without hooks, %ld with hooks on another page\n", LOOPS, plain, hits);
+    if (hits < plain) {
+        printf("elsewhere: %ld TLB hits, expected %ld as without hooks\n", hits, plain);
+        failed = 1;
+    }
+
+    // the same page, outside of the hooks: no hits, no calls either
+    hits = run(uc, "same page", WATCHED + 8);
+    failed |= hits < 0;
+    failed |= check("same page", &counts, 0, 0, 0);
+    if (hits != 0) {
+        printf("same page: %ld TLB hits, expected none\n", hits);
+        failed = 1;
+    }
+
+    // in the hooks
+    hits = run(uc, "watched", WATCHED);
+    failed |= hits < 0;
+    failed |= check("watched", &counts, LOOPS, LOOPS, LOOPS);
+
+    // removed hooks give their page back to the fast path
+    uc_hook_del(uc, hooks[0]);
+    uc_hook_del(uc, hooks[1]);
+    uc_hook_del(uc, hooks[2]);
+    hits = run(uc, "removed", WATCHED);
+    failed |= hits < 0;
+    failed |= check("removed", &counts, LOOPS, LOOPS, LOOPS);
+    if (hits < plain) {
+        printf("removed: %ld TLB hits, expected %ld as without hooks\n", hits, plain);
+        failed = 1;
+    }
+
+    // a hook added by a hook sees the following accesses of the run
+    counts.reads = counts.writes = 0;
+    uc_hook_add(uc, &hooks[0], UC_HOOK_MEM_READ, hook_add_write, &counts, WATCHED, WATCHED + 3);
+    failed |= run(uc, "from hook", WATCHED) < 0;
+    failed |= check("from hook", &counts, LOOPS, LOOPS, LOOPS);
+    uc_close(uc);
+
+    if (failed)
+        printf("\n\nTEST FAILED!\n\n");
+    else
+        printf("\n\nTEST PASSED!\n\n");
+
+    return failed;
+}
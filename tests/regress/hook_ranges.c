@@ -0,0 +1,198 @@
+/*
+   Overlapping and nested hook ranges must each see exactly the
+   instructions & memory accesses they cover, in the order the hooks
+   were added, also when hooks come and go between runs, or from a
+   callback while the hooks of an access are being called.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <unicorn/unicorn.h>
+
+#define ADDRESS 0x1000000
+#define DATA    0x2000000
+
+// inc ecx; inc ecx; mov [DATA], ecx; mov [DATA + 8], ecx; inc ecx
+#define X86_CODE32 "\x41\x41\x89\x0d\x00\x00\x00\x02\x89\x0d\x08\x00\x00\x02\x41"
+#define CODE_SIZE (sizeof(X86_CODE32) - 1)
+// loop: mov [DATA + ecx * 4], ecx; inc ecx; cmp ecx, 16; jne loop
+#define X86_LOOP32 "\x89\x0c\x8d\x00\x00\x00\x02\x41\x83\xf9\x10\x75\xf3"
+#define WRITES 16
+#define CHURN_HOOKS 8
+#define CHURN_STEPS 200
+
+static char trace[4096];
+
+static void hook_code(uc_engine *uc, uint64_t address, uint32_t size, void *user_data)
+{
+    char buf[32];
+
+    snprintf(buf, sizeof(buf), "%s%x ", (char *)user_data, (unsigned int)(address - ADDRESS));
+    strncat(trace, buf, sizeof(trace) - strlen(trace) - 1);
+}
+
+static void hook_mem(uc_engine *uc, uc_mem_type type, uint64_t address, int size, int64_t value, void *user_data)
+{
+    char buf[32];
+
+    snprintf(buf, sizeof(buf), "%s%x ", (char *)user_data, (unsigned int)(address - DATA));
+    strncat(trace, buf, sizeof(trace) - strlen(trace) - 1);
+}
+
+static uc_hook added, doomed;
+
+// on the first call, add a hook & delete another, both covering the
+// access being hooked
+static void hook_mem_change(uc_engine *uc, uc_mem_type type, uint64_t address, int size, int64_t value, void *user_data)
+{
+    if (!added) {
+        uc_hook_add(uc, &added, UC_HOOK_MEM_WRITE, hook_mem, "y", DATA, DATA + 8);
+        uc_hook_del(uc, doomed);
+    }
+    hook_mem(uc, type, address, size, value, user_data);
+}
+
+static int check_code(uc_engine *uc, const char *what, const char *code, size_t size, const char *expected)
+{
+    uc_err err;
+
+    trace[0] = '\0';
+    err = uc_emu_start(uc, ADDRESS, ADDRESS + size, 0, 0);
+    if (err) {
+        printf("%s: uc_emu_start() failed: %s\n", what, uc_strerror(err));
+        return 1;
+    }
+
+    if (strcmp(trace, expected)) {
+        printf("%s: traced \"%s\", expected \"%s\"\n", what, trace, expected);
+        return 1;
+    }
+
+    return 0;
+}
+
+static int check(uc_engine *uc, const char *what, const char *expected)
+{
+    return check_code(uc, what, X86_CODE32, CODE_SIZE, expected);
+}
+
+// hooks of random ranges come and go, the index must keep up
+static int test_churn(void)
+{
+    static const char *names[CHURN_HOOKS] = { "0", "1", "2", "3", "4", "5", "6", "7" };
+    struct {
+        uc_hook hh;
+        int begin, end;     // in writes, begin > end for all addresses
+    } hooks[CHURN_HOOKS];
+    int order[CHURN_HOOKS], count = 0, step, i, j, n, failed = 0;
+    uint32_t ecx;
+    char expected[sizeof(trace)], buf[32], what[32];
+    uc_engine *uc;
+
+    uc_open(UC_ARCH_X86, UC_MODE_32, &uc);
+    uc_mem_map(uc, ADDRESS, 0x1000, UC_PROT_ALL);
+    uc_mem_map(uc, DATA, 0x1000, UC_PROT_ALL);
+    uc_mem_write(uc, ADDRESS, X86_LOOP32, sizeof(X86_LOOP32) - 1);
+
+    srand(1);
+    for (step = 0; step < CHURN_STEPS && !failed; step++) {
+        if (count == CHURN_HOOKS || (count && rand() % 3 == 0)) {
+            // delete one, the others keep their order
+            n = rand() % count;
+            uc_hook_del(uc, hooks[order[n]].hh);
+            memmove(order + n, order + n + 1, (count - n - 1) * sizeof(int));
+            count--;
+        } else {
+            // add one with a name not in use
+            for (n = 0; n < CHURN_HOOKS; n++) {
+                for (j = 0; j < count && order[j] != n; j++)
+                    ;
+                if (j == count)
+                    break;
+            }
+            hooks[n].begin = rand() % WRITES;
+            hooks[n].end = rand() % 8 ? hooks[n].begin + rand() % (WRITES - hooks[n].begin) : -1;
+            if (hooks[n].begin > hooks[n].end)
+                uc_hook_add(uc, &hooks[n].hh, UC_HOOK_MEM_WRITE, hook_mem, (void *)names[n], 1, 0);
+            else
+                uc_hook_add(uc, &hooks[n].hh, UC_HOOK_MEM_WRITE, hook_mem, (void *)names[n],
+                        DATA + hooks[n].begin * 4, DATA + hooks[n].end * 4 + 3);
+            order[count++] = n;
+        }
+
+        expected[0] = '\0';
+        for (i = 0; i < WRITES; i++) {
+            for (j = 0; j < count; j++) {
+                n = order[j];
+                if (hooks[n].begin > hooks[n].end || (i >= hooks[n].begin && i <= hooks[n].end)) {
+                    snprintf(buf, sizeof(buf), "%s%x ", names[n], i * 4);
+                    strcat(expected, buf);
+                }
+            }
+        }
+
+        ecx = 0;
+        uc_reg_write(uc, UC_X86_REG_ECX, &ecx);
+        snprintf(what, sizeof(what), "churn step %d", step);
+        failed |= check_code(uc, what, X86_LOOP32, sizeof(X86_LOOP32) - 1, expected);
+    }
+
+    uc_close(uc);
+
+    return failed;
+}
+
+int main(int argc, char **argv, char **envp)
+{
+    uc_engine *uc;
+    uc_hook all, wide, narrow, last, mem;
+    int failed = 0;
+
+    if (uc_open(UC_ARCH_X86, UC_MODE_32, &uc)) {
+        printf("uc_open() failed\n");
+        return 1;
+    }
+
+    uc_mem_map(uc, ADDRESS, 0x1000, UC_PROT_ALL);
+    uc_mem_map(uc, DATA, 0x1000, UC_PROT_ALL);
+    uc_mem_write(uc, ADDRESS, X86_CODE32, CODE_SIZE);
+
+    uc_hook_add(uc, &wide, UC_HOOK_CODE, hook_code, "w", ADDRESS + 1, ADDRESS + 8);
+    uc_hook_add(uc, &all, UC_HOOK_CODE, hook_code, "a", 1, 0);
+    uc_hook_add(uc, &narrow, UC_HOOK_CODE, hook_code, "n", ADDRESS + 2, ADDRESS + 2);
+    uc_hook_add(uc, &last, UC_HOOK_CODE, hook_code, "l", ADDRESS + 0xe, ADDRESS + 0xe);
+    uc_hook_add(uc, &mem, UC_HOOK_MEM_WRITE, hook_mem, "m", DATA + 4, DATA + 8);
+
+    failed |= check(uc, "all hooks",
+            "a0 w1 a1 w2 a2 n2 w8 a8 m8 ae le ");
+
+    uc_hook_del(uc, narrow);
+    uc_hook_del(uc, all);
+    failed |= check(uc, "hooks deleted", "w1 w2 w8 m8 le ");
+
+    uc_hook_del(uc, wide);
+    uc_hook_del(uc, last);
+    uc_hook_del(uc, mem);
+    uc_hook_add(uc, &mem, UC_HOOK_MEM_WRITE, hook_mem, "m", DATA, DATA + 3);
+    failed |= check(uc, "hooks replaced", "m0 ");
+
+    // a hook added from a callback is called for the accesses after, one
+    // deleted not for the one being hooked
+    uc_hook_del(uc, mem);
+    uc_hook_add(uc, &mem, UC_HOOK_MEM_WRITE, hook_mem_change, "x", DATA, DATA + 8);
+    uc_hook_add(uc, &doomed, UC_HOOK_MEM_WRITE, hook_mem, "d", DATA, DATA + 8);
+    failed |= check(uc, "hooks changed by a callback", "x0 x8 y8 ");
+
+    uc_close(uc);
+
+    failed |= test_churn();
+
+    if (failed)
+        printf("\n\nTEST FAILED!\n\n");
+    else
+        printf("\n\nTEST PASSED!\n\n");
+
+    return failed;
+}
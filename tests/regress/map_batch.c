@@ -0,0 +1,130 @@
+/*
+   uc_mem_map_batch() maps all of its regions or none, and mapping or
+   unmapping a region, also from a hook during emulation, is seen by the
+   next access although the TLB is no longer flushed as a whole.
+ */
+
+#include <stdio.h>
+
+#include <unicorn/unicorn.h>
+
+#define ADDRESS 0x100000
+#define DATA 0x200000
+
+// mov eax, [ebx]
+#define X86_LOAD "\x8b\x03"
+
+static bool hook_unmapped(uc_engine *uc, uc_mem_type type, uint64_t address, int size, int64_t value, void *user_data)
+{
+    uc_mem_region region = { address & ~0xfffULL, (address & ~0xfffULL) + 0xfff, UC_PROT_ALL };
+
+    (*(int *)user_data)++;
+    if (uc_mem_map_batch(uc, &region, 1))
+        return false;
+    uc_mem_write(uc, address, "\x78\x56\x34\x12", 4);
+
+    return true;
+}
+
+// loads at @addr, returns what it failed with
+static uc_err load(uc_engine *uc, uint32_t addr, uint32_t *value)
+{
+    uc_err err;
+
+    uc_reg_write(uc, UC_X86_REG_EBX, &addr);
+    err = uc_emu_start(uc, ADDRESS, ADDRESS + sizeof(X86_LOAD) - 1, 0, 0);
+    uc_reg_read(uc, UC_X86_REG_EAX, value);
+
+    return err;
+}
+
+static uint32_t region_count(uc_engine *uc)
+{
+    uc_mem_region *regions;
+    uint32_t count;
+
+    uc_mem_regions(uc, &regions, &count);
+    uc_free(regions);
+
+    return count;
+}
+
+int main(int argc, char **argv, char **envp)
+{
+    static const uc_mem_region overlapping[] = {
+        { DATA + 0x4000, DATA + 0x4fff, UC_PROT_READ },
+        { DATA, DATA + 0x1fff, UC_PROT_READ },
+        { DATA + 0x1000, DATA + 0x2fff, UC_PROT_READ },
+    };
+    static const uc_mem_region unsorted[] = {
+        { DATA + 0x4000, DATA + 0x4fff, UC_PROT_READ },
+        { DATA, DATA + 0x1fff, UC_PROT_READ | UC_PROT_WRITE },
+        { DATA + 0x2000, DATA + 0x2fff, UC_PROT_READ },
+    };
+    uc_engine *uc;
+    uc_hook hook;
+    uint32_t value = 0;
+    int calls = 0, failed = 0;
+    uc_err err;
+
+    err = uc_open(UC_ARCH_X86, UC_MODE_32, &uc);
+    if (err) {
+        printf("uc_open() failed: %s\n", uc_strerror(err));
+        return 1;
+    }
+
+    uc_mem_map(uc, ADDRESS, 0x1000, UC_PROT_ALL);
+    uc_mem_write(uc, ADDRESS, X86_LOAD, sizeof(X86_LOAD) - 1);
+
+    // overlapping regions: nothing is mapped
+    err = uc_mem_map_batch(uc, overlapping, 3);
+    if (err != UC_ERR_MAP || region_count(uc) != 1) {
+        printf("overlapping: %s with %u regions, expected %s with 1\n", uc_strerror(err),
+                region_count(uc), uc_strerror(UC_ERR_MAP));
+        failed = 1;
+    }
+
+    // the access to unmapped memory is in the TLB before the map
+    err = load(uc, DATA + 0x2000, &value);
+    if (err != UC_ERR_READ_UNMAPPED) {
+        printf("before: %s, expected %s\n", uc_strerror(err), uc_strerror(UC_ERR_READ_UNMAPPED));
+        failed = 1;
+    }
+
+    err = uc_mem_map_batch(uc, unsorted, 3);
+    if (err || region_count(uc) != 4) {
+        printf("unsorted: %s with %u regions, expected 4\n", uc_strerror(err), region_count(uc));
+        failed = 1;
+    }
+    uc_mem_write(uc, DATA + 0x2000, "\xef\xbe\xad\xde", 4);
+    err = load(uc, DATA + 0x2000, &value);
+    if (err || value != 0xdeadbeef) {
+        printf("mapped: %s, %#x, expected 0xdeadbeef\n", uc_strerror(err), value);
+        failed = 1;
+    }
+
+    // unmapped again, the TLB entry must be gone
+    uc_mem_unmap(uc, DATA + 0x2000, 0x1000);
+    err = load(uc, DATA + 0x2000, &value);
+    if (err != UC_ERR_READ_UNMAPPED) {
+        printf("unmapped: %s, expected %s\n", uc_strerror(err), uc_strerror(UC_ERR_READ_UNMAPPED));
+        failed = 1;
+    }
+
+    // mapped by the hook of the failed access
+    uc_hook_add(uc, &hook, UC_HOOK_MEM_READ_UNMAPPED, hook_unmapped, &calls, 1, 0);
+    err = load(uc, DATA + 0x2000, &value);
+    if (err || value != 0x12345678 || calls != 1) {
+        printf("from hook: %s, %#x after %d calls, expected 0x12345678 after 1\n", uc_strerror(err), value, calls);
+        failed = 1;
+    }
+
+    uc_close(uc);
+
+    if (failed)
+        printf("\n\nTEST FAILED!\n\n");
+    else
+        printf("\n\nTEST PASSED!\n\n");
+
+    return failed;
+}
@@ -0,0 +1,131 @@
+/*
+   uc_mem_read() & uc_mem_write() must copy straight from & to RAM, across
+   adjacent regions and to read-only memory, and still drop code translated
+   from what they change. uc_mem_get_ptr() must give the host address of
+   guest memory and how much of it is contiguous, and code changed through
+   it must be translated again after uc_mem_code_written().
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <unicorn/unicorn.h>
+
+#define CODE 0x10000
+#define DATA 0x20000
+#define NEXT 0x21000
+#define RO 0x30000
+#define READS 1000000
+
+// mov eax, 1
+#define X86_MOV1 "\xb8\x01\x00\x00\x00"
+// mov eax, 2
+#define X86_MOV2 "\xb8\x02\x00\x00\x00"
+
+static uint8_t user[0x1000];
+
+int main(int argc, char **argv, char **envp)
+{
+    uc_engine *uc;
+    uint8_t buf[0x20], *ptr;
+    uint32_t eax;
+    size_t size;
+    struct timespec t0, t1;
+    int i, failed = 0;
+
+    if (uc_open(UC_ARCH_X86, UC_MODE_32, &uc)) {
+        printf("uc_open() failed\n");
+        return 1;
+    }
+
+    uc_mem_map(uc, CODE, 0x1000, UC_PROT_ALL);
+    uc_mem_map(uc, DATA, 0x1000, UC_PROT_READ | UC_PROT_WRITE);
+    uc_mem_map_ptr(uc, NEXT, sizeof(user), UC_PROT_READ | UC_PROT_WRITE, user);
+    uc_mem_map(uc, RO, 0x1000, UC_PROT_READ);
+
+    // host address & contiguous size
+    if (uc_mem_get_ptr(uc, NEXT + 0x10, (void **)&ptr, &size) ||
+            ptr != user + 0x10 || size != sizeof(user) - 0x10) {
+        printf("uc_mem_get_ptr() of uc_mem_map_ptr() memory: %p, %zu, expected %p, %zu\n",
+                ptr, size, user + 0x10, sizeof(user) - 0x10);
+        failed = 1;
+    }
+    if (uc_mem_get_ptr(uc, DATA + 0xff0, (void **)&ptr, &size) || size != 0x10) {
+        printf("uc_mem_get_ptr() of uc_mem_map() memory failed\n");
+        failed = 1;
+    }
+    memcpy(ptr, "0123456789abcdef", 0x10);
+    if (uc_mem_get_ptr(uc, CODE + 0x1000, (void **)&ptr, &size) != UC_ERR_READ_UNMAPPED) {
+        printf("uc_mem_get_ptr() of unmapped memory did not fail\n");
+        failed = 1;
+    }
+
+    // across two regions
+    memcpy(user, "ghijklmnopqrstuv", 0x10);
+    if (uc_mem_read(uc, DATA + 0xff0, buf, 0x20) ||
+            memcmp(buf, "0123456789abcdefghijklmnopqrstuv", 0x20)) {
+        printf("uc_mem_read() across regions failed\n");
+        failed = 1;
+    }
+    if (uc_mem_write(uc, DATA + 0xff8, "ABCDEFGHIJKLMNOP", 0x10) || memcmp(user, "IJKLMNOP", 8)) {
+        printf("uc_mem_write() across regions failed\n");
+        failed = 1;
+    }
+    if (uc_mem_read(uc, NEXT + 0xff8, buf, 0x10) != UC_ERR_READ_UNMAPPED ||
+            uc_mem_write(uc, NEXT + 0xff8, buf, 0x10) != UC_ERR_WRITE_UNMAPPED) {
+        printf("access past the end of memory did not fail\n");
+        failed = 1;
+    }
+
+    // read-only memory, to the program only
+    if (uc_mem_write(uc, RO, "abcd", 4) || uc_mem_read(uc, RO, buf, 4) || memcmp(buf, "abcd", 4)) {
+        printf("uc_mem_write() to read-only memory failed\n");
+        failed = 1;
+    }
+
+    // code changed once translated
+    uc_mem_write(uc, CODE, X86_MOV1, sizeof(X86_MOV1) - 1);
+    uc_emu_start(uc, CODE, CODE + sizeof(X86_MOV1) - 1, 0, 0);
+    uc_mem_write(uc, CODE, X86_MOV2, sizeof(X86_MOV2) - 1);
+    uc_emu_start(uc, CODE, CODE + sizeof(X86_MOV2) - 1, 0, 0);
+    uc_reg_read(uc, UC_X86_REG_EAX, &eax);
+    if (eax != 2) {
+        printf("code changed by uc_mem_write() still ran as before: eax = %u\n", eax);
+        failed = 1;
+    }
+
+    // and changed by the host, then told with uc_mem_code_written()
+    uc_mem_get_ptr(uc, CODE, (void **)&ptr, &size);
+    memcpy(ptr, X86_MOV1, sizeof(X86_MOV1) - 1);
+    if (uc_mem_code_written(uc, CODE, sizeof(X86_MOV1) - 1)) {
+        printf("uc_mem_code_written() failed\n");
+        failed = 1;
+    }
+    uc_emu_start(uc, CODE, CODE + sizeof(X86_MOV1) - 1, 0, 0);
+    uc_reg_read(uc, UC_X86_REG_EAX, &eax);
+    if (eax != 1) {
+        printf("code changed through uc_mem_get_ptr() still ran as before: eax = %u\n", eax);
+        failed = 1;
+    }
+    if (uc_mem_code_written(uc, CODE + 0x1000, 4) != UC_ERR_WRITE_UNMAPPED) {
+        printf("uc_mem_code_written() of unmapped memory did not fail\n");
+        failed = 1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (i = 0; i < READS; i++)
+        uc_mem_read(uc, DATA + (i & 0xff0), buf, 0x10);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    printf("%d reads of 16 bytes: %.0f ns each\n", READS,
+            ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) / READS);
+
+    uc_close(uc);
+
+    if (failed)
+        printf("\n\nTEST FAILED!\n\n");
+    else
+        printf("\n\nTEST PASSED!\n\n");
+
+    return failed;
+}
@@ -0,0 +1,184 @@
+/*
+   uc_mem_protect() on some pages of a large region must not copy it: the
+   pages keep their own permissions, enforced by the CPU even once their
+   neighbours are in the TLB, listed by uc_mem_regions() and kept by a
+   partial uc_mem_unmap().
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <unicorn/unicorn.h>
+
+#define ADDRESS 0x100000
+#define DATA 0x10000000
+#define DATA_SIZE (256 * 1024 * 1024)
+#define PAGE (DATA + 0x800000)
+
+// str r2, [r1]
+#define ARM_STORE "\x00\x20\x81\xe5"
+// ldr r2, [r1]
+#define ARM_LOAD "\x00\x20\x91\xe5"
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// runs @code at ADDRESS on @addr, returns what it failed with
+static uc_err run(uc_engine *uc, const char *code, uint32_t addr)
+{
+    uint32_t r2 = 0x11223344;
+
+    uc_mem_write(uc, ADDRESS, code, 4);
+    uc_reg_write(uc, UC_ARM_REG_R1, &addr);
+    uc_reg_write(uc, UC_ARM_REG_R2, &r2);
+    return uc_emu_start(uc, ADDRESS, ADDRESS + 4, 0, 0);
+}
+
+static int check_run(uc_engine *uc, const char *name, const char *code, uint32_t addr, uc_err expected)
+{
+    uc_err err = run(uc, code, addr);
+
+    if (err != expected) {
+        printf("%s: %s at %#x, expected %s\n", name, uc_strerror(err), addr, uc_strerror(expected));
+        return 1;
+    }
+
+    return 0;
+}
+
+static int check_regions(uc_engine *uc, const char *name, const uc_mem_region *expected, uint32_t n)
+{
+    uc_mem_region *regions;
+    uint32_t count, i;
+    int failed = 0;
+
+    uc_mem_regions(uc, &regions, &count);
+    failed = count != n;
+    for (i = 0; i < count && !failed; i++) {
+        failed = regions[i].begin != expected[i].begin || regions[i].end != expected[i].end ||
+            regions[i].perms != expected[i].perms;
+    }
+    if (failed) {
+        printf("%s: unexpected regions\n", name);
+        for (i = 0; i < count; i++)
+            printf("  %#llx - %#llx, perms %u\n", (unsigned long long)regions[i].begin,
+                    (unsigned long long)regions[i].end, regions[i].perms);
+    }
+    uc_free(regions);
+
+    return failed;
+}
+
+int main(int argc, char **argv, char **envp)
+{
+    static const uc_mem_region protected[] = {
+        { ADDRESS, ADDRESS + 0xfff, UC_PROT_ALL },
+        { DATA, PAGE - 1, UC_PROT_READ | UC_PROT_WRITE },
+        { PAGE, PAGE + 0xfff, UC_PROT_READ },
+        { PAGE + 0x1000, DATA + DATA_SIZE - 1, UC_PROT_READ | UC_PROT_WRITE },
+    };
+    static const uc_mem_region unmapped[] = {
+        { ADDRESS, ADDRESS + 0xfff, UC_PROT_ALL },
+        { DATA, PAGE - 1, UC_PROT_READ | UC_PROT_WRITE },
+        { PAGE, PAGE + 0xfff, UC_PROT_READ },
+        { PAGE + 0x2000, DATA + DATA_SIZE - 1, UC_PROT_READ | UC_PROT_WRITE },
+    };
+    static const uc_mem_region restored[] = {
+        { ADDRESS, ADDRESS + 0xfff, UC_PROT_ALL },
+        { DATA, PAGE + 0xfff, UC_PROT_READ | UC_PROT_WRITE },
+        { PAGE + 0x2000, DATA + DATA_SIZE - 1, UC_PROT_READ | UC_PROT_WRITE },
+    };
+    uc_engine *uc;
+    uint32_t value = 0;
+    double t0, t;
+    int failed = 0;
+    uc_err err;
+
+    err = uc_open(UC_ARCH_ARM, UC_MODE_ARM, &uc);
+    if (err) {
+        printf("uc_open() failed: %s\n", uc_strerror(err));
+        return 1;
+    }
+
+    uc_mem_map(uc, ADDRESS, 0x1000, UC_PROT_ALL);
+    uc_mem_map(uc, DATA, DATA_SIZE, UC_PROT_READ | UC_PROT_WRITE);
+    uc_mem_write(uc, PAGE + 0xffc, "\x78\x56\x34\x12", 4);
+
+    // the TLB has the page and its neighbour before the protection
+    failed |= check_run(uc, "before", ARM_STORE, PAGE, UC_ERR_OK);
+    failed |= check_run(uc, "before", ARM_STORE, PAGE + 0x1000, UC_ERR_OK);
+
+    t0 = now();
+    err = uc_mem_protect(uc, PAGE, 0x1000, UC_PROT_READ);
+    t = now() - t0;
+    printf("one page of %d MB made read-only in %.3f ms\n", DATA_SIZE >> 20, t * 1e3);
+    if (err) {
+        printf("uc_mem_protect() failed: %s\n", uc_strerror(err));
+        failed = 1;
+    }
+    failed |= check_regions(uc, "protect", protected, 4);
+
+    failed |= check_run(uc, "protect", ARM_STORE, PAGE, UC_ERR_WRITE_PROT);
+    failed |= check_run(uc, "protect", ARM_LOAD, PAGE, UC_ERR_OK);
+    failed |= check_run(uc, "protect", ARM_STORE, PAGE - 4, UC_ERR_OK);
+    failed |= check_run(uc, "protect", ARM_STORE, PAGE + 0x1000, UC_ERR_OK);
+    failed |= check_run(uc, "protect", ARM_STORE, PAGE, UC_ERR_WRITE_PROT);
+
+    // a page can't be run unless it has EXEC
+    uc_mem_protect(uc, PAGE, 0x1000, UC_PROT_ALL);
+    uc_mem_write(uc, PAGE, ARM_LOAD, 4);
+    err = uc_emu_start(uc, PAGE, PAGE + 4, 0, 0);
+    uc_mem_protect(uc, PAGE, 0x1000, UC_PROT_READ);
+    if (err == UC_ERR_OK)
+        err = uc_emu_start(uc, PAGE, PAGE + 4, 0, 0);
+    if (err != UC_ERR_FETCH_PROT) {
+        printf("exec: %s, expected %s\n", uc_strerror(err), uc_strerror(UC_ERR_FETCH_PROT));
+        failed = 1;
+    }
+    err = uc_emu_start(uc, PAGE + 0x1000, PAGE + 0x1004, 0, 0);
+    if (err != UC_ERR_FETCH_PROT) {
+        printf("exec next: %s, expected %s\n", uc_strerror(err), uc_strerror(UC_ERR_FETCH_PROT));
+        failed = 1;
+    }
+
+    // unmapping the next page keeps the bytes and perms of the rest
+    uc_mem_write(uc, DATA + DATA_SIZE - 4, "\xef\xbe\xad\xde", 4);
+    err = uc_mem_unmap(uc, PAGE + 0x1000, 0x1000);
+    if (err) {
+        printf("uc_mem_unmap() failed: %s\n", uc_strerror(err));
+        failed = 1;
+    }
+    failed |= check_regions(uc, "unmap", unmapped, 4);
+    uc_mem_read(uc, PAGE + 0xffc, &value, 4);
+    if (value != 0x12345678) {
+        printf("unmap: %#x before the hole, expected 0x12345678\n", value);
+        failed = 1;
+    }
+    uc_mem_read(uc, DATA + DATA_SIZE - 4, &value, 4);
+    if (value != 0xdeadbeef) {
+        printf("unmap: %#x at the end, expected 0xdeadbeef\n", value);
+        failed = 1;
+    }
+    failed |= check_run(uc, "unmap", ARM_STORE, PAGE, UC_ERR_WRITE_PROT);
+    failed |= check_run(uc, "unmap", ARM_STORE, PAGE - 4, UC_ERR_OK);
+
+    // the same perms again make one range
+    uc_mem_protect(uc, PAGE, 0x1000, UC_PROT_READ | UC_PROT_WRITE);
+    failed |= check_regions(uc, "restore", restored, 3);
+    failed |= check_run(uc, "restore", ARM_STORE, PAGE, UC_ERR_OK);
+
+    uc_close(uc);
+
+    if (failed)
+        printf("\n\nTEST FAILED!\n\n");
+    else
+        printf("\n\nTEST PASSED!\n\n");
+
+    return failed;
+}
@@ -0,0 +1,155 @@
+/*
+   With UC_OPT_PROFILE, uc_profile_get() must return the translated
+   blocks by execution count, keeping the counts of the blocks dropped
+   from the cache by a flush with the sizes of the last translation,
+   and uc_profile_reset() must empty it.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <unicorn/unicorn.h>
+
+#define ADDRESS 0x100000
+#define LOOPS 10000
+#define RUNS 100
+
+// mov r1, #0; loop: add r1, r1, #1; subs r0, r0, #1; bne loop
+#define ARM_CODE "\x00\x10\xa0\xe3\x01\x10\x81\xe2\x01\x00\x50\xe2\xfc\xff\xff\x1a"
+#define LOOP (ADDRESS + 4)
+
+static void hook_block(uc_engine *uc, uint64_t address, uint32_t size, void *user_data)
+{
+    (*(uint64_t *)user_data)++;
+}
+
+static uc_engine *setup(bool profile)
+{
+    uc_engine *uc;
+
+    if (uc_open(UC_ARCH_ARM, UC_MODE_ARM, &uc)) {
+        printf("uc_open() failed\n");
+        exit(1);
+    }
+    uc_option(uc, UC_OPT_PROFILE, profile);
+
+    uc_mem_map(uc, ADDRESS, 0x1000, UC_PROT_ALL);
+    uc_mem_write(uc, ADDRESS, ARM_CODE, sizeof(ARM_CODE) - 1);
+
+    return uc;
+}
+
+// returns the time taken or -1 on error
+static double run(uc_engine *uc, const char *name, int runs)
+{
+    struct timespec t0, t1;
+    uint32_t r0;
+    uc_err err;
+    int i;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (i = 0; i < runs; i++) {
+        r0 = LOOPS;
+        uc_reg_write(uc, UC_ARM_REG_R0, &r0);
+        err = uc_emu_start(uc, ADDRESS, ADDRESS + sizeof(ARM_CODE) - 1, 0, 0);
+        if (err) {
+            printf("%s: uc_emu_start() failed: %s\n", name, uc_strerror(err));
+            return -1;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    return (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+}
+
+// the first iteration is in the block at ADDRESS, the others in the loop,
+// whose bytes of host code go to @host_size
+static int check_loop(uc_engine *uc, const char *name, uint64_t runs, uint32_t *host_size)
+{
+    uc_tb_profile blocks[4];
+    size_t found, i;
+
+    uc_profile_get(uc, blocks, 4, &found);
+    for (i = 0; i < found; i++)
+        printf("%s: %#llx, %u -> %u bytes, %llu runs\n", name, (unsigned long long)blocks[i].address,
+                blocks[i].size, blocks[i].host_size, (unsigned long long)blocks[i].count);
+    if (found != 2 || blocks[0].address != LOOP || blocks[0].count != runs * (LOOPS - 1) ||
+            blocks[1].address != ADDRESS || blocks[1].count != runs ||
+            blocks[0].size == 0 || blocks[0].host_size == 0) {
+        printf("%s: expected the loop run %llu times, then the entry %llu times\n", name,
+                (unsigned long long)(runs * (LOOPS - 1)), (unsigned long long)runs);
+        return 1;
+    }
+    *host_size = blocks[0].host_size;
+
+    return 0;
+}
+
+int main(int argc, char **argv, char **envp)
+{
+    uc_engine *uc;
+    uc_hook hook;
+    uint64_t blocks = 0;
+    double plain, profiled, hooked;
+    uc_tb_profile top[4];
+    uint32_t host_size = 0, plain_size;
+    size_t found;
+    int failed = 0;
+
+    // off by default
+    uc = setup(false);
+    plain = run(uc, "plain", RUNS);
+    failed |= plain < 0;
+    uc_profile_get(uc, top, 4, &found);
+    if (found != 0) {
+        printf("plain: %zu blocks found without profiling\n", found);
+        failed = 1;
+    }
+    uc_close(uc);
+
+    uc = setup(true);
+    profiled = run(uc, "profile", RUNS);
+    failed |= profiled < 0;
+    failed |= check_loop(uc, "profile", RUNS, &host_size);
+
+    // the counts of the blocks dropped by a flush are kept, the sizes are
+    // those of the code calling the hook
+    plain_size = host_size;
+    uc_hook_add(uc, &hook, UC_HOOK_BLOCK, hook_block, &blocks, 1, 0);
+    failed |= run(uc, "flush", 1) < 0;
+    failed |= check_loop(uc, "flush", RUNS + 1, &host_size);
+    if (host_size <= plain_size) {
+        printf("flush: loop of %u bytes of host code with a hook, %u without\n", host_size, plain_size);
+        failed = 1;
+    }
+    uc_hook_del(uc, hook);
+
+    uc_profile_reset(uc);
+    uc_profile_get(uc, top, 4, &found);
+    if (found != 0) {
+        printf("reset: %zu blocks found\n", found);
+        failed = 1;
+    }
+    failed |= run(uc, "reset", 1) < 0;
+    failed |= check_loop(uc, "reset", 1, &host_size);
+    uc_close(uc);
+
+    // the same with a block hook instead
+    uc = setup(false);
+    blocks = 0;
+    uc_hook_add(uc, &hook, UC_HOOK_BLOCK, hook_block, &blocks, 1, 0);
+    hooked = run(uc, "hook", RUNS);
+    failed |= hooked < 0;
+    uc_close(uc);
+
+    printf("%d x %d loops in %.3fs plain, %.3fs profiled, %.3fs with a block hook\n",
+            RUNS, LOOPS, plain, profiled, hooked);
+
+    if (failed)
+        printf("\n\nTEST FAILED!\n\n");
+    else
+        printf("\n\nTEST PASSED!\n\n");
+
+    return failed;
+}
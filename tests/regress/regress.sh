@@ -19,4 +19,26 @@
 ./eflags_nosync
 ./mips_kseg0_1
 ./mem_double_unmap
+./tb_cache
+./hook_ranges
+./hook_direct
 
+./emu_count
+./emu_timeout
+./context_user
+./arm_exclusive
+./fastmem
+./code_buffer
+./mem_ptr
+./arm_neon
+./arm_vfp
+./tlb_size
+./stats
+./profile
+./hook_chain
+./hook_mem_page
+./fork
+./page_perms
+./map_batch
+./dirty_pages
+./snapshot
@@ -0,0 +1,227 @@
+/*
+   uc_snapshot_restore() puts back the registers, the memory map with its
+   perms and the bytes of RAM, also the code run since, whether it only
+   copies the pages written since or the snapshot is an older one.
+   If it cannot, it leaves the engine as it was.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#include <unicorn/unicorn.h>
+
+#define CODE 0x100000
+#define DATA 0x200000
+#define DATA_SIZE 0x10000
+#define EXTRA 0x400000
+#define BIG 0x10000000
+#define BIG_SIZE 0x10000000
+
+// mov [ebx], eax; inc ecx
+#define X86_CODE "\x89\x03\x41"
+// dec ecx
+#define X86_DEC "\x49"
+
+static uint32_t run(uc_engine *uc)
+{
+    uint32_t ecx;
+    uc_err err;
+
+    err = uc_emu_start(uc, CODE, CODE + sizeof(X86_CODE) - 1, 0, 0);
+    if (err)
+        printf("uc_emu_start() failed: %s\n", uc_strerror(err));
+    uc_reg_read(uc, UC_X86_REG_ECX, &ecx);
+
+    return ecx;
+}
+
+// the state of the snapshot: @ecx, @value at DATA + 0x2000
+static int check(uc_engine *uc, const char *name, uint32_t ecx, uint32_t value)
+{
+    static const uc_mem_region expected[] = {
+        { CODE, CODE + 0xfff, UC_PROT_ALL },
+        { DATA, DATA + DATA_SIZE - 1, UC_PROT_READ | UC_PROT_WRITE },
+    };
+    uc_mem_region *regions;
+    uint32_t count, reg, mem = 0, i;
+    char bytes[5] = { 0 };
+    int failed = 0;
+
+    uc_reg_read(uc, UC_X86_REG_ECX, &reg);
+    if (reg != ecx) {
+        printf("%s: ecx %u, expected %u\n", name, reg, ecx);
+        failed = 1;
+    }
+
+    uc_mem_read(uc, DATA + 0x2000, &mem, 4);
+    uc_mem_read(uc, DATA + DATA_SIZE - 4, bytes, 4);
+    if (mem != value || strcmp(bytes, "orig")) {
+        printf("%s: %#x and \"%s\" in memory, expected %#x and \"orig\"\n", name, mem, bytes, value);
+        failed = 1;
+    }
+
+    uc_mem_regions(uc, &regions, &count);
+    failed |= count != 2;
+    for (i = 0; i < count && count == 2; i++) {
+        if (regions[i].begin != expected[i].begin || regions[i].end != expected[i].end ||
+                regions[i].perms != expected[i].perms)
+            failed = 1;
+    }
+    if (failed && count != 2)
+        printf("%s: %u regions, expected 2\n", name, count);
+    uc_free(regions);
+
+    return failed;
+}
+
+// the memory map & the bytes from check(), also after a failed restore
+static int test_nomem(void)
+{
+    uc_engine *uc;
+    uc_snapshot *snapshot;
+    struct rlimit old, limit;
+    unsigned long pages = 0;
+    uint32_t ecx = 5;
+    int failed = 0;
+    FILE *statm;
+    uc_err err;
+
+    uc_open(UC_ARCH_X86, UC_MODE_32, &uc);
+    uc_mem_map(uc, CODE, 0x1000, UC_PROT_ALL);
+    uc_mem_map(uc, DATA, DATA_SIZE, UC_PROT_READ | UC_PROT_WRITE);
+    uc_mem_map(uc, BIG, BIG_SIZE, UC_PROT_READ | UC_PROT_WRITE);
+    uc_mem_write(uc, DATA + DATA_SIZE - 4, "orig", 4);
+    uc_reg_write(uc, UC_X86_REG_ECX, &ecx);
+    uc_snapshot_take(uc, &snapshot);
+
+    // DATA can be mapped again, BIG cannot
+    uc_mem_unmap(uc, DATA + 0x8000, 0x1000);
+    uc_mem_unmap(uc, BIG, BIG_SIZE);
+    ecx = 7;
+    uc_reg_write(uc, UC_X86_REG_ECX, &ecx);
+
+    statm = fopen("/proc/self/statm", "r");
+    if (statm) {
+        if (fscanf(statm, "%lu", &pages) != 1)
+            pages = 0;
+        fclose(statm);
+    }
+    getrlimit(RLIMIT_AS, &old);
+    limit = old;
+    limit.rlim_cur = pages * 4096 + 0x4000000;
+    if (pages == 0 || setrlimit(RLIMIT_AS, &limit)) {
+        printf("nomem: cannot limit the address space, skipped\n");
+        goto out;
+    }
+
+    err = uc_snapshot_restore(uc, snapshot);
+    setrlimit(RLIMIT_AS, &old);
+    if (err != UC_ERR_NOMEM) {
+        printf("nomem: uc_snapshot_restore() returned %s\n", uc_strerror(err));
+        failed = 1;
+        goto out;
+    }
+    uc_reg_read(uc, UC_X86_REG_ECX, &ecx);
+    if (ecx != 7 || uc_mem_unmap(uc, DATA + 0x8000, 0x1000) != UC_ERR_NOMEM ||
+            uc_mem_read(uc, DATA + 0x7000, &ecx, 4) || uc_mem_read(uc, DATA + 0x9000, &ecx, 4) ||
+            uc_mem_read(uc, BIG, &ecx, 4) != UC_ERR_READ_UNMAPPED) {
+        printf("nomem: engine changed by the failed restore\n");
+        failed = 1;
+    }
+
+    err = uc_snapshot_restore(uc, snapshot);
+    if (err) {
+        printf("nomem: uc_snapshot_restore() failed: %s\n", uc_strerror(err));
+        failed = 1;
+    }
+    if (uc_mem_read(uc, BIG + BIG_SIZE - 4, &ecx, 4)) {
+        printf("nomem: BIG not mapped again\n");
+        failed = 1;
+    }
+    uc_mem_unmap(uc, BIG, BIG_SIZE);
+    failed |= check(uc, "nomem", 5, 0);
+
+out:
+    uc_close(uc);
+    uc_snapshot_free(snapshot);
+
+    return failed;
+}
+
+int main(int argc, char **argv, char **envp)
+{
+    uc_engine *uc;
+    uc_snapshot *snapshot, *later;
+    uint32_t eax = 0x11223344, ebx = DATA + 0x2000, ecx = 5;
+    int failed = 0;
+    uc_err err;
+
+    err = uc_open(UC_ARCH_X86, UC_MODE_32, &uc);
+    if (err) {
+        printf("uc_open() failed: %s\n", uc_strerror(err));
+        return 1;
+    }
+
+    uc_mem_map(uc, CODE, 0x1000, UC_PROT_ALL);
+    uc_mem_map(uc, DATA, DATA_SIZE, UC_PROT_READ | UC_PROT_WRITE);
+    uc_mem_write(uc, CODE, X86_CODE, sizeof(X86_CODE) - 1);
+    uc_mem_write(uc, DATA + DATA_SIZE - 4, "orig", 4);
+    uc_reg_write(uc, UC_X86_REG_EAX, &eax);
+    uc_reg_write(uc, UC_X86_REG_EBX, &ebx);
+    uc_reg_write(uc, UC_X86_REG_ECX, &ecx);
+
+    err = uc_snapshot_take(uc, &snapshot);
+    if (err) {
+        printf("uc_snapshot_take() failed: %s\n", uc_strerror(err));
+        return 1;
+    }
+
+    // run, change the code, the data & the memory map
+    run(uc);
+    uc_mem_write(uc, CODE + 2, X86_DEC, 1);
+    if (run(uc) != 5) {
+        printf("changed code not run\n");
+        failed = 1;
+    }
+    uc_mem_write(uc, DATA + DATA_SIZE - 4, "new!", 4);
+    uc_mem_map(uc, EXTRA, 0x1000, UC_PROT_ALL);
+    uc_mem_unmap(uc, DATA + 0x8000, 0x1000);
+    uc_mem_protect(uc, CODE, 0x1000, UC_PROT_READ | UC_PROT_EXEC);
+
+    uc_snapshot_restore(uc, snapshot);
+    failed |= check(uc, "restore", 5, 0);
+
+    // the code translated from the old bytes is gone
+    if (run(uc) != 6) {
+        printf("restore: stale code run\n");
+        failed = 1;
+    }
+    uc_mem_write(uc, DATA + DATA_SIZE - 4, "new!", 4);
+
+    // only the pages written since are copied back
+    uc_snapshot_restore(uc, snapshot);
+    failed |= check(uc, "restore again", 5, 0);
+
+    // from an older snapshot, all of them
+    run(uc);
+    uc_snapshot_take(uc, &later);
+    run(uc);
+    uc_snapshot_restore(uc, snapshot);
+    failed |= check(uc, "older", 5, 0);
+    uc_snapshot_restore(uc, later);
+    failed |= check(uc, "later", 6, eax);
+
+    uc_close(uc);
+    uc_snapshot_free(snapshot);
+    uc_snapshot_free(later);
+
+    failed |= test_nomem();
+
+    if (failed)
+        printf("\n\nTEST FAILED!\n\n");
+    else
+        printf("\n\nTEST PASSED!\n\n");
+
+    return failed;
+}
@@ -0,0 +1,174 @@
+/*
+   uc_stats_get() must count translation, TB lookups, invalidation of
+   code written by the guest, TLB fills and hook calls per type, with
+   code hooks called through helpers or from translated code alike.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <unicorn/unicorn.h>
+
+#define ADDRESS 0x100000
+#define DATA 0x200000
+#define CODE2 (ADDRESS + 0x1000)
+#define LOOPS 1000
+
+// loop: ldr r2, [r1]; subs r0, r0, #1; bne loop
+#define ARM_LOOP "\x00\x20\x91\xe5\x01\x00\x50\xe2\xfc\xff\xff\x1a"
+// str r3, [r4]; b CODE2
+#define ARM_STORE "\x00\x30\x84\xe5\xfd\x03\x00\xea"
+// mov r0, #1
+#define ARM_MOV "\x01\x00\xa0\xe3"
+// mov r0, #2
+#define ARM_MOV2 0xe3a00002
+
+static int hook_index(uc_hook_type type)
+{
+    int i = 0;
+
+    while ((1 << i) != type)
+        i++;
+    return i;
+}
+
+static void hook_block(uc_engine *uc, uint64_t address, uint32_t size, void *user_data)
+{
+    (*(uint64_t *)user_data)++;
+}
+
+static void hook_code(uc_engine *uc, uint64_t address, uint32_t size, void *user_data)
+{
+    (*(uint64_t *)user_data)++;
+}
+
+static void hook_mem(uc_engine *uc, uc_mem_type type, uint64_t address, int size, int64_t value, void *user_data)
+{
+    (*(uint64_t *)user_data)++;
+}
+
+static uc_engine *setup(void)
+{
+    uc_engine *uc;
+
+    if (uc_open(UC_ARCH_ARM, UC_MODE_ARM, &uc)) {
+        printf("uc_open() failed\n");
+        exit(1);
+    }
+
+    uc_mem_map(uc, ADDRESS, 0x2000, UC_PROT_ALL);
+    uc_mem_write(uc, ADDRESS, ARM_LOOP, sizeof(ARM_LOOP) - 1);
+    uc_mem_map(uc, DATA, 0x1000, UC_PROT_ALL);
+
+    return uc;
+}
+
+static int run_loop(uc_engine *uc, const char *name)
+{
+    uint32_t r0 = LOOPS, r1 = DATA;
+    uc_err err;
+
+    uc_reg_write(uc, UC_ARM_REG_R0, &r0);
+    uc_reg_write(uc, UC_ARM_REG_R1, &r1);
+    err = uc_emu_start(uc, ADDRESS, ADDRESS + sizeof(ARM_LOOP) - 1, 0, 0);
+    if (err) {
+        printf("%s: uc_emu_start() failed: %s\n", name, uc_strerror(err));
+        return 1;
+    }
+
+    return 0;
+}
+
+static int test_hooks(bool direct)
+{
+    const char *name = direct ? "direct" : "helper";
+    uc_engine *uc = setup();
+    uc_hook h1, h2, h3;
+    uint64_t blocks = 0, codes = 0, reads = 0;
+    uc_stats stats;
+    int failed = 0;
+
+    uc_option(uc, UC_OPT_HOOK_DIRECT, direct);
+    uc_hook_add(uc, &h1, UC_HOOK_BLOCK, hook_block, &blocks, 1, 0);
+    uc_hook_add(uc, &h2, UC_HOOK_CODE, hook_code, &codes, 1, 0);
+    uc_hook_add(uc, &h3, UC_HOOK_MEM_READ, hook_mem, &reads, 1, 0);
+    failed |= run_loop(uc, name);
+
+    uc_stats_get(uc, &stats);
+    if (stats.hook_calls[hook_index(UC_HOOK_BLOCK)] != blocks ||
+            stats.hook_calls[hook_index(UC_HOOK_CODE)] != codes ||
+            stats.hook_calls[hook_index(UC_HOOK_MEM_READ)] != reads ||
+            stats.hook_calls[hook_index(UC_HOOK_MEM_WRITE)] != 0) {
+        printf("%s: %llu block, %llu code & %llu read hook calls, expected %llu, %llu, %llu\n", name,
+                (unsigned long long)stats.hook_calls[hook_index(UC_HOOK_BLOCK)],
+                (unsigned long long)stats.hook_calls[hook_index(UC_HOOK_CODE)],
+                (unsigned long long)stats.hook_calls[hook_index(UC_HOOK_MEM_READ)],
+                (unsigned long long)blocks, (unsigned long long)codes, (unsigned long long)reads);
+        failed = 1;
+    }
+    if (codes != 3 * LOOPS || reads != LOOPS) {
+        printf("%s: %llu code & %llu read hook calls, expected %d, %d\n", name,
+                (unsigned long long)codes, (unsigned long long)reads, 3 * LOOPS, LOOPS);
+        failed = 1;
+    }
+
+    uc_close(uc);
+    return failed;
+}
+
+int main(int argc, char **argv, char **envp)
+{
+    uc_engine *uc;
+    uc_stats stats;
+    uint32_t r0, r3 = ARM_MOV2, r4 = CODE2;
+    uc_err err;
+    int failed = 0;
+
+    // translation & lookups
+    uc = setup();
+    failed |= run_loop(uc, "loop");
+    failed |= run_loop(uc, "loop");
+    uc_stats_get(uc, &stats);
+    printf("loop: %llu TBs of %llu -> %llu bytes, %llu fast hits, %llu slow lookups, "
+            "%llu TLB fills, %llu misses, %lluns translating, %lluns executing\n",
+            (unsigned long long)stats.tb_translated, (unsigned long long)stats.tb_guest_bytes,
+            (unsigned long long)stats.tb_host_bytes, (unsigned long long)stats.tb_fast_hits,
+            (unsigned long long)stats.tb_slow_lookups, (unsigned long long)stats.tlb_fills,
+            (unsigned long long)stats.tlb_misses, (unsigned long long)stats.translate_ns,
+            (unsigned long long)stats.execute_ns);
+    if (stats.tb_translated == 0 || stats.tb_guest_bytes < sizeof(ARM_LOOP) - 1 ||
+            stats.tb_host_bytes == 0 || stats.tb_fast_hits + stats.tb_slow_lookups == 0 ||
+            stats.tlb_fills == 0 || stats.tlb_misses == 0 || stats.tb_invalidated != 0) {
+        printf("loop: unexpected statistics\n");
+        failed = 1;
+    }
+
+    // guest stores to translated code drop it: run mov r0, #1, then
+    // replace it by mov r0, #2 and run it again
+    uc_mem_write(uc, CODE2, ARM_MOV, sizeof(ARM_MOV) - 1);
+    uc_mem_write(uc, ADDRESS, ARM_STORE, sizeof(ARM_STORE) - 1);
+    err = uc_emu_start(uc, CODE2, CODE2 + sizeof(ARM_MOV) - 1, 0, 0);
+    if (!err) {
+        uc_reg_write(uc, UC_ARM_REG_R3, &r3);
+        uc_reg_write(uc, UC_ARM_REG_R4, &r4);
+        err = uc_emu_start(uc, ADDRESS, CODE2 + sizeof(ARM_MOV) - 1, 0, 0);
+    }
+    uc_reg_read(uc, UC_ARM_REG_R0, &r0);
+    uc_stats_get(uc, &stats);
+    if (err || r0 != 2 || stats.tb_invalidated == 0) {
+        printf("write: %s, r0 = %u, %llu TBs invalidated\n", uc_strerror(err), r0,
+                (unsigned long long)stats.tb_invalidated);
+        failed = 1;
+    }
+    uc_close(uc);
+
+    failed |= test_hooks(false);
+    failed |= test_hooks(true);
+
+    if (failed)
+        printf("\n\nTEST FAILED!\n\n");
+    else
+        printf("\n\nTEST PASSED!\n\n");
+
+    return failed;
+}
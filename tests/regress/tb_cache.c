@@ -0,0 +1,118 @@
+/*
+   Translated code must survive across uc_emu_start() calls, yet stay
+   coherent with uc_mem_write(), a moved @until address and new hooks.
+ */
+
+#include <string.h>
+#include <stdio.h>
+
+#include <unicorn/unicorn.h>
+
+#define ADDRESS 0x1000000
+
+// inc ecx; inc ecx; inc ecx; inc edx
+#define X86_CODE32 "\x41\x41\x41\x42"
+
+static int count;
+
+static void hook_code(uc_engine *uc, uint64_t address, uint32_t size, void *user_data)
+{
+    count++;
+}
+
+static int run(uc_engine *uc, uint64_t until, uint32_t *ecx, uint32_t *edx)
+{
+    uint32_t zero = 0;
+    uc_err err;
+
+    uc_reg_write(uc, UC_X86_REG_ECX, &zero);
+    uc_reg_write(uc, UC_X86_REG_EDX, &zero);
+    err = uc_emu_start(uc, ADDRESS, until, 0, 0);
+    if (err) {
+        printf("uc_emu_start() failed: %s\n", uc_strerror(err));
+        return -1;
+    }
+    uc_reg_read(uc, UC_X86_REG_ECX, ecx);
+    uc_reg_read(uc, UC_X86_REG_EDX, edx);
+    return 0;
+}
+
+int main(int argc, char **argv, char **envp)
+{
+    uc_engine *uc;
+    uc_hook hook;
+    uint32_t ecx, edx;
+    size_t translated, reused;
+    int failed = 0;
+
+    if (uc_open(UC_ARCH_X86, UC_MODE_32, &uc)) {
+        printf("uc_open() failed\n");
+        return 1;
+    }
+
+    uc_mem_map(uc, ADDRESS, 0x1000, UC_PROT_ALL);
+    uc_mem_write(uc, ADDRESS, X86_CODE32, sizeof(X86_CODE32) - 1);
+
+    // the second run must not translate anything again
+    run(uc, ADDRESS + 4, &ecx, &edx);
+    uc_query(uc, UC_QUERY_TB_TRANSLATED, &translated);
+    run(uc, ADDRESS + 4, &ecx, &edx);
+    uc_query(uc, UC_QUERY_TB_TRANSLATED, &reused);
+    if (reused != translated) {
+        printf("code retranslated: %zu TBs, expected %zu\n", reused, translated);
+        failed = 1;
+    }
+    uc_query(uc, UC_QUERY_TB_REUSED, &reused);
+    if (reused == 0) {
+        printf("no TB was reused\n");
+        failed = 1;
+    }
+
+    // a shorter @until must stop earlier
+    run(uc, ADDRESS + 2, &ecx, &edx);
+    if (ecx != 2 || edx != 0) {
+        printf("until moved: ecx = %u, edx = %u, expected 2, 0\n", ecx, edx);
+        failed = 1;
+    }
+
+    // a longer one must run the whole code again
+    run(uc, ADDRESS + 4, &ecx, &edx);
+    if (ecx != 3 || edx != 1) {
+        printf("until restored: ecx = %u, edx = %u, expected 3, 1\n", ecx, edx);
+        failed = 1;
+    }
+
+    // patched code must be picked up: inc ecx -> inc edx
+    uc_mem_write(uc, ADDRESS + 1, "\x42", 1);
+    run(uc, ADDRESS + 4, &ecx, &edx);
+    if (ecx != 2 || edx != 2) {
+        printf("code patched: ecx = %u, edx = %u, expected 2, 2\n", ecx, edx);
+        failed = 1;
+    }
+
+    // a code hook added after translation must see every instruction
+    uc_hook_add(uc, &hook, UC_HOOK_CODE, hook_code, NULL, 1, 0);
+    run(uc, ADDRESS + 4, &ecx, &edx);
+    if (count != 4) {
+        printf("hook added: %d instructions traced, expected 4\n", count);
+        failed = 1;
+    }
+
+    // and must no longer be called once deleted
+    uc_hook_del(uc, hook);
+    count = 0;
+    run(uc, ADDRESS + 4, &ecx, &edx);
+    if (count != 0) {
+        printf("hook deleted: %d instructions traced, expected 0\n", count);
+        failed = 1;
+    }
+
+    uc_close(uc);
+
+    if (failed)
+        printf("\n\nTEST FAILED!\n\n");
+    else
+        printf("\n\nTEST PASSED!\n\n");
+
+    return failed;
+}
@@ -0,0 +1,188 @@
+/*
+   The TLB must take the size set with UC_OPT_TLB_SIZE, or grow when the
+   working set does not fit, and count its hits, misses and flushes for
+   uc_query(). Loads from more pages than the default 256 entries must
+   then miss less while computing the same.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <unicorn/unicorn.h>
+
+#define ADDRESS 0x100000
+#define DATA 0x1000000
+#define PAGES 2048
+#define PAGE_SIZE 1024     // of ARM targets
+#define RUNS 20
+
+// loop: ldr r2, [r1, r3]; add r0, r0, r2; add r3, r3, #1024; cmp r3, r4; bne loop
+#define ARM_CODE "\x03\x20\x91\xe7\x02\x00\x80\xe0\x01\x3b\x83\xe2\x04\x00\x53\xe1\xfa\xff\xff\x1a"
+
+static size_t query(uc_engine *uc, uc_query_type type)
+{
+    size_t result = 0;
+
+    uc_query(uc, type, &result);
+    return result;
+}
+
+static uc_engine *setup(size_t entries)
+{
+    uc_engine *uc;
+    uint32_t one = 1;
+    int i;
+
+    if (uc_open(UC_ARCH_ARM, UC_MODE_ARM, &uc)) {
+        printf("uc_open() failed\n");
+        exit(1);
+    }
+    if (uc_option(uc, UC_OPT_TLB_SIZE, entries)) {
+        printf("uc_option(UC_OPT_TLB_SIZE, %zu) failed\n", entries);
+        exit(1);
+    }
+
+    uc_mem_map(uc, ADDRESS, PAGE_SIZE, UC_PROT_ALL);
+    uc_mem_write(uc, ADDRESS, ARM_CODE, sizeof(ARM_CODE) - 1);
+    uc_mem_map(uc, DATA, PAGES * PAGE_SIZE, UC_PROT_READ);
+    for (i = 0; i < PAGES; i++)
+        uc_mem_write(uc, DATA + i * PAGE_SIZE, &one, sizeof(one));
+
+    return uc;
+}
+
+// load from every page RUNS times, returns the TLB misses or -1 on error
+static long run(uc_engine *uc, const char *name)
+{
+    uint32_t r0 = 0, r1 = DATA, r3, r4 = PAGES * PAGE_SIZE;
+    struct timespec t0, t1;
+    size_t misses = query(uc, UC_QUERY_TLB_MISSES);
+    uc_err err;
+    int i;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    uc_reg_write(uc, UC_ARM_REG_R0, &r0);
+    uc_reg_write(uc, UC_ARM_REG_R1, &r1);
+    uc_reg_write(uc, UC_ARM_REG_R4, &r4);
+    for (i = 0; i < RUNS; i++) {
+        r3 = 0;
+        uc_reg_write(uc, UC_ARM_REG_R3, &r3);
+        err = uc_emu_start(uc, ADDRESS, ADDRESS + sizeof(ARM_CODE) - 1, 0, 0);
+        if (err) {
+            printf("%s: uc_emu_start() failed: %s\n", name, uc_strerror(err));
+            return -1;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    uc_reg_read(uc, UC_ARM_REG_R0, &r0);
+    if (r0 != RUNS * PAGES) {
+        printf("%s: r0 = %u, expected %u\n", name, r0, RUNS * PAGES);
+        return -1;
+    }
+
+    misses = query(uc, UC_QUERY_TLB_MISSES) - misses;
+    printf("%s: %d x %d pages in %.3fs, TLB of %zu entries, %zu misses, %zu hits, %zu flushes\n",
+            name, RUNS, PAGES, (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9,
+            query(uc, UC_QUERY_TLB_SIZE), misses, query(uc, UC_QUERY_TLB_HITS),
+            query(uc, UC_QUERY_TLB_FLUSHES));
+
+    return (long)misses;
+}
+
+static void hook_code(uc_engine *uc, uint64_t address, uint32_t size, void *user_data)
+{
+    *(uc_err *)user_data = uc_option(uc, UC_OPT_TLB_SIZE, 1024);
+    uc_emu_stop(uc);
+}
+
+int main(int argc, char **argv, char **envp)
+{
+    uc_engine *uc;
+    uc_hook hook;
+    uc_err err;
+    long small, fixed, grown;
+    int failed = 0;
+
+    // sizes which are not a power of 2 in range
+    uc = setup(0);
+    if (query(uc, UC_QUERY_TLB_SIZE) != 256) {
+        printf("default: TLB of %zu entries, expected 256\n", query(uc, UC_QUERY_TLB_SIZE));
+        failed = 1;
+    }
+    if (uc_option(uc, UC_OPT_TLB_SIZE, 1000) != UC_ERR_ARG ||
+            uc_option(uc, UC_OPT_TLB_SIZE, 1 << 20) != UC_ERR_ARG) {
+        printf("invalid: uc_option(UC_OPT_TLB_SIZE) did not fail\n");
+        failed = 1;
+    }
+
+    // not from hooks
+    err = UC_ERR_OK;
+    uc_hook_add(uc, &hook, UC_HOOK_CODE, hook_code, &err, ADDRESS, ADDRESS);
+    uc_emu_start(uc, ADDRESS, ADDRESS + 4, 0, 0);
+    if (err != UC_ERR_ARG) {
+        printf("hook: uc_option(UC_OPT_TLB_SIZE) did not fail\n");
+        failed = 1;
+    }
+    uc_close(uc);
+
+    // the default size on all hosts
+    uc = setup(256);
+    small = run(uc, "256");
+    failed |= small < 0;
+    if (query(uc, UC_QUERY_TLB_SIZE) != 256) {
+        printf("256: TLB of %zu entries\n", query(uc, UC_QUERY_TLB_SIZE));
+        failed = 1;
+    }
+    uc_close(uc);
+
+    // bigger than the working set: other hosts keep 256 entries
+    if (uc_open(UC_ARCH_ARM, UC_MODE_ARM, &uc) == UC_ERR_OK) {
+        err = uc_option(uc, UC_OPT_TLB_SIZE, 4096);
+        uc_close(uc);
+        if (err) {
+            printf("4096: not supported on this host, skipped\n");
+            goto out;
+        }
+    }
+
+    uc = setup(4096);
+    uc_option(uc, UC_OPT_TLB_COUNT_HITS, 1);
+    fixed = run(uc, "4096");
+    failed |= fixed < 0;
+    if (query(uc, UC_QUERY_TLB_SIZE) != 4096 || query(uc, UC_QUERY_TLB_HITS) == 0) {
+        printf("4096: TLB of %zu entries, %zu hits\n",
+                query(uc, UC_QUERY_TLB_SIZE), query(uc, UC_QUERY_TLB_HITS));
+        failed = 1;
+    }
+    if (fixed >= small / 4) {
+        printf("4096: %ld misses, expected much less than %ld\n", fixed, small);
+        failed = 1;
+    }
+    uc_close(uc);
+
+    // following the working set
+    uc = setup(0);
+    grown = run(uc, "dynamic");
+    failed |= grown < 0;
+    if (query(uc, UC_QUERY_TLB_SIZE) < PAGES) {
+        printf("dynamic: TLB of %zu entries, expected at least %d\n",
+                query(uc, UC_QUERY_TLB_SIZE), PAGES);
+        failed = 1;
+    }
+    if (grown >= small / 4) {
+        printf("dynamic: %ld misses, expected much less than %ld\n", grown, small);
+        failed = 1;
+    }
+    uc_close(uc);
+
+out:
+    if (failed)
+        printf("\n\nTEST FAILED!\n\n");
+    else
+        printf("\n\nTEST PASSED!\n\n");
+
+    return failed;
+}
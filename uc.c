@@ -10,6 +10,9 @@
 #endif
 
 #include <time.h>   // nanosleep
+#ifdef _MSC_VER
+#include <intrin.h> // _InterlockedExchange
+#endif
 
 #include <string.h>
 
@@ -151,10 +154,7 @@ uc_err uc_open(uc_arch arch, uc_mode mode, uc_engine **result)
         uc->errnum = UC_ERR_OK;
         uc->arch = arch;
         uc->mode = mode;
-
-        // uc->ram_list = { .blocks = QTAILQ_HEAD_INITIALIZER(ram_list.blocks) };
-        uc->ram_list.blocks.tqh_first = NULL;
-        uc->ram_list.blocks.tqh_last = &(uc->ram_list.blocks.tqh_first);
+        uc->fork_fd = -1;
 
         uc->memory_listeners.tqh_first = NULL;
         uc->memory_listeners.tqh_last = &uc->memory_listeners.tqh_first;
@@ -319,6 +319,8 @@ uc_err uc_close(uc_engine *uc)
 
     // Other auxilaries.
     free(uc->l1_map);
+    g_free(uc->fastmem_code);
+    free(uc->profile_blocks);
 
     if (uc->bounce.buffer) {
         free(uc->bounce.buffer);
@@ -327,9 +329,9 @@ uc_err uc_close(uc_engine *uc)
     g_hash_table_foreach(uc->type_table, free_table, uc);
     g_hash_table_destroy(uc->type_table);
 
-    for (i = 0; i < DIRTY_MEMORY_NUM; i++) {
-        free(uc->ram_list.dirty_memory[i]);
-    }
+    g_free(uc->ram_list.blocks);
+    g_free(uc->ram_list.by_host);
+    g_free(uc->ram_list.gaps);
 
     // free hooks and hook lists
     for (i = 0; i < UC_HOOK_MAX; i++) {
@@ -344,10 +346,19 @@ uc_err uc_close(uc_engine *uc)
             cur = cur->next;
         }
         list_clear(&uc->hook[i]);
+        g_free(uc->hook_index[i].segs);
+        g_free(uc->hook_index[i].hooks);
     }
+    for (cur = uc->hook_index_retired.head; cur != NULL; cur = cur->next)
+        g_free(cur->data);
+    list_clear(&uc->hook_index_retired);
 
     free(uc->mapped_blocks);
 
+    if (uc->fork_fd >= 0)
+        qemu_ram_cow_close(uc->fork_fd);
+    g_free(uc->fork_offsets);
+
     // finally, free uc itself.
     memset(uc, 0, sizeof(*uc));
     free(uc);
@@ -418,20 +429,30 @@ uc_err uc_mem_read(uc_engine *uc, uint64_t address, void *_bytes, size_t size)
 {
     size_t count = 0, len;
     uint8_t *bytes = _bytes;
+    MemoryRegion *mr;
 
     if (uc->mem_redirect) {
         address = uc->mem_redirect(address);
     }
 
+    // the usual small read within a RAM region: copy it straight
+    mr = memory_mapping(uc, address);
+    if (mr && mr->host && size <= mr->end - address) {
+        memcpy(bytes, mr->host + (address - mr->addr), size);
+        return UC_ERR_OK;
+    }
+
     if (!check_mem_area(uc, address, size))
         return UC_ERR_READ_UNMAPPED;
 
     // memory area can overlap adjacent memory blocks
     while(count < size) {
-        MemoryRegion *mr = memory_mapping(uc, address);
+        mr = memory_mapping(uc, address);
         if (mr) {
             len = (size_t)MIN(size - count, mr->end - address);
-            if (uc->read_mem(&uc->as, address, bytes, len) == false)
+            if (mr->host)
+                memcpy(bytes, mr->host + (address - mr->addr), len);
+            else if (uc->read_mem(&uc->as, address, bytes, len) == false)
                 break;
             count += len;
             address += len;
@@ -446,35 +467,58 @@ uc_err uc_mem_read(uc_engine *uc, uint64_t address, void *_bytes, size_t size)
         return UC_ERR_READ_UNMAPPED;
 }
 
+// copy to a RAM region, and drop the code translated from what changed
+static void write_ram(uc_engine *uc, MemoryRegion *mr, uint64_t address, const uint8_t *bytes, size_t len)
+{
+    memcpy(mr->host + (address - mr->addr), bytes, len);
+    uc->ram_written(uc, mr->ram_addr + (address - mr->addr), len);
+}
+
 UNICORN_EXPORT
 uc_err uc_mem_write(uc_engine *uc, uint64_t address, const void *_bytes, size_t size)
 {
     size_t count = 0, len;
     const uint8_t *bytes = _bytes;
+    MemoryRegion *mr;
 
     if (uc->mem_redirect) {
         address = uc->mem_redirect(address);
     }
 
+    // forks must not see this write
+    uc->fork_frozen = false;
+
+    // the usual small write within a RAM region: copy it straight,
+    // which also ignores write protection
+    mr = memory_mapping(uc, address);
+    if (mr && mr->host && size <= mr->end - address) {
+        write_ram(uc, mr, address, bytes, size);
+        return UC_ERR_OK;
+    }
+
     if (!check_mem_area(uc, address, size))
         return UC_ERR_WRITE_UNMAPPED;
 
     // memory area can overlap adjacent memory blocks
     while(count < size) {
-        MemoryRegion *mr = memory_mapping(uc, address);
+        mr = memory_mapping(uc, address);
         if (mr) {
             uint32_t operms = mr->perms;
-            if (!(operms & UC_PROT_WRITE)) // write protected
-                // but this is not the program accessing memory, so temporarily mark writable
-                uc->readonly_mem(mr, false);
-
             len = (size_t)MIN(size - count, mr->end - address);
-            if (uc->write_mem(&uc->as, address, bytes, len) == false)
-                break;
+            if (mr->host) {
+                write_ram(uc, mr, address, bytes, len);
+            } else {
+                if (!(operms & UC_PROT_WRITE)) // write protected
+                    // but this is not the program accessing memory, so temporarily mark writable
+                    uc->readonly_mem(mr, false);
+
+                if (uc->write_mem(&uc->as, address, bytes, len) == false)
+                    break;
 
-            if (!(operms & UC_PROT_WRITE)) // write protected
-                // now write protect it again
-                uc->readonly_mem(mr, true);
+                if (!(operms & UC_PROT_WRITE)) // write protected
+                    // now write protect it again
+                    uc->readonly_mem(mr, true);
+            }
 
             count += len;
             address += len;
@@ -489,43 +533,114 @@ uc_err uc_mem_write(uc_engine *uc, uint64_t address, const void *_bytes, size_t
         return UC_ERR_WRITE_UNMAPPED;
 }
 
-#define TIMEOUT_STEP 2    // microseconds
-static void *_timeout_fn(void *arg)
+UNICORN_EXPORT
+uc_err uc_mem_get_ptr(uc_engine *uc, uint64_t address, void **ptr, size_t *size)
 {
-    struct uc_struct *uc = arg;
-    int64_t current_time = get_clock();
+    MemoryRegion *mr;
 
-    do {
-        usleep(TIMEOUT_STEP);
-        // perhaps emulation is even done before timeout?
-        if (uc->emulation_done)
-            break;
-    } while((uint64_t)(get_clock() - current_time) < uc->timeout);
+    if (uc->mem_redirect) {
+        address = uc->mem_redirect(address);
+    }
 
-    // timeout before emulation is done?
-    if (!uc->emulation_done) {
-        uc->timed_out = true;
-        // force emulation to stop
-        uc_emu_stop(uc);
+    mr = memory_mapping(uc, address);
+    if (mr == NULL || mr->host == NULL)
+        return UC_ERR_READ_UNMAPPED;
+
+    // the caller may write through @ptr
+    uc->fork_frozen = false;
+
+    *ptr = mr->host + (address - mr->addr);
+    *size = (size_t)(mr->end - address);
+
+    return UC_ERR_OK;
+}
+
+UNICORN_EXPORT
+uc_err uc_mem_code_written(uc_engine *uc, uint64_t address, size_t size)
+{
+    if (uc->mem_redirect) {
+        address = uc->mem_redirect(address);
     }
 
-    return NULL;
+    if (!check_mem_area(uc, address, size))
+        return UC_ERR_WRITE_UNMAPPED;
+
+    uc->tb_invalidate_uc_range(uc, address, size);
+
+    return UC_ERR_OK;
 }
 
+// with a timeout, the instruction budget is handed out in slices, sized
+// to check the deadline about every TIMEOUT_STEP of emulation
+#define TIMEOUT_STEP 100000     // nanoseconds
+#define TIMEOUT_SLICE 1024      // instructions in the first slice
+
 static void enable_emu_timer(uc_engine *uc, uint64_t timeout)
 {
     uc->timeout = timeout;
-    qemu_thread_create(uc, &uc->timer, "timeout", _timeout_fn,
-            uc, QEMU_THREAD_JOINABLE);
+    if (uc->timeout_slice == 0)
+        uc->timeout_slice = TIMEOUT_SLICE;
+    uc->timeout_checked = get_clock();
+    uc->timeout_deadline = uc->timeout_checked + timeout;
 }
 
-static void hook_count_cb(struct uc_struct *uc, uint64_t address, uint32_t size, void *user_data)
+// called by cpu_exec() whenever a slice of the budget is spent
+bool emu_timeout_expired(struct uc_struct *uc)
 {
-    // count this instruction. ah ah ah.
-    uc->emu_counter++;
+    int64_t now = get_clock();
+    int64_t elapsed = now - uc->timeout_checked;
+    int64_t slice, target;
 
-    if (uc->emu_counter > uc->emu_count)
-        uc_emu_stop(uc);
+    if (now >= uc->timeout_deadline) {
+        uc->timed_out = true;
+        return true;
+    }
+
+    // size the next slice after the last one, to end at the next step,
+    // or right at the deadline if that comes first
+    target = MIN(TIMEOUT_STEP, uc->timeout_deadline - now);
+    slice = (int64_t)uc->timeout_slice * 2;
+    if (elapsed > 0)
+        slice = MIN(slice, uc->timeout_slice * target / elapsed);
+    uc->timeout_slice = (int32_t)MAX(1, MIN(slice, INT32_MAX));
+    uc->timeout_checked = now;
+
+    return false;
+}
+
+// engines can share RAM, see uc_mem_map_ptr(), so the locks are for all of
+// them, striped by host address. One is only held for a few host accesses,
+// never while user callbacks run, so spin
+#define EXCLUSIVE_STRIPES 64
+static volatile long exclusive_locks[EXCLUSIVE_STRIPES];
+
+static volatile long *exclusive_lock(const void *host)
+{
+    return &exclusive_locks[((uintptr_t)host >> 4) % EXCLUSIVE_STRIPES];
+}
+
+void uc_exclusive_start(const void *host)
+{
+    volatile long *lock = exclusive_lock(host);
+
+#ifdef _MSC_VER
+    while (_InterlockedExchange(lock, 1)) {
+#else
+    while (__sync_lock_test_and_set(lock, 1)) {
+#endif
+        while (*lock) {
+            // wait for it to look free before trying again
+        }
+    }
+}
+
+void uc_exclusive_end(const void *host)
+{
+#ifdef _MSC_VER
+    _InterlockedExchange(exclusive_lock(host), 0);
+#else
+    __sync_lock_release(exclusive_lock(host));
+#endif
 }
 
 static void clear_deleted_hooks(uc_engine *uc)
@@ -538,6 +653,7 @@ static void clear_deleted_hooks(uc_engine *uc)
         assert(hook->to_delete);
         for (i = 0; i < UC_HOOK_MAX; i++) {
             if (list_remove(&uc->hook[i], (void *)hook)) {
+                hook_index_dirty(uc, i, hook);
                 if (--hook->refs == 0) {
                     free(hook);
                 }
@@ -549,16 +665,22 @@ static void clear_deleted_hooks(uc_engine *uc)
     }
 
     list_clear(&uc->hooks_to_del);
+
+    // no callback is running, so nothing walks the old indexes anymore
+    for (cur = uc->hook_index_retired.head; cur != NULL; cur = cur->next)
+        g_free(cur->data);
+    list_clear(&uc->hook_index_retired);
 }
 
 UNICORN_EXPORT
 uc_err uc_emu_start(uc_engine* uc, uint64_t begin, uint64_t until, uint64_t timeout, size_t count)
 {
-    // reset the counter
-    uc->emu_counter = 0;
+    int64_t budget, slice, start;
+
     uc->invalid_error = UC_ERR_OK;
     uc->block_full = false;
     uc->emulation_done = false;
+    uc->fork_frozen = false;    // the guest writes to RAM
     uc->size_recur_mem = 0;
     uc->timed_out = false;
 
@@ -620,35 +742,49 @@ uc_err uc_emu_start(uc_engine* uc, uint64_t begin, uint64_t until, uint64_t time
 
     uc->stop_request = false;
 
-    uc->emu_count = count;
-    // remove count hook if counting isn't necessary
-    if (count <= 0 && uc->count_hook != 0) {
-        uc_hook_del(uc, uc->count_hook);
-        uc->count_hook = 0;
-    }
-    // set up count hook to count instructions.
-    if (count > 0 && uc->count_hook == 0) {
-        uc_err err;
-        // callback to count instructions must be run before everything else,
-        // so instead of appending, we must insert the hook at the begin
-        // of the hook list
-        uc->hook_insert = 1;
-        err = uc_hook_add(uc, &uc->count_hook, UC_HOOK_CODE, hook_count_cb, NULL, 1, 0);
-        // restore to append mode for uc_hook_add()
-        uc->hook_insert = 0;
-        if (err != UC_ERR_OK) {
-            return err;
-        }
+    // hooks deleted since the last run are not referenced anymore,
+    // so drop them before the translator looks them up
+    clear_deleted_hooks(uc);
+
+    // translated code is kept across runs, unless hooks it depends on changed
+    if (uc->tb_flush_request) {
+        uc->tb_flush_all(uc);
+        uc->tb_flush_request = false;
+    }
+
+    // translation stops at @until, so code translated for another address is stale
+    if (until != uc->addr_end) {
+        uc->tb_invalidate_addr_end(uc, uc->addr_end);
+        uc->tb_invalidate_addr_end(uc, until);
     }
 
     uc->addr_end = until;
 
-    if (timeout)
+    // without @count, the budget is as good as endless
+    budget = count > 0 ? MIN(count, INT64_MAX) : INT64_MAX;
+    if (timeout) {
         enable_emu_timer(uc, timeout * 1000);   // microseconds -> nanoseconds
-
+        slice = uc->timeout_slice;
+    } else {
+        uc->timeout = 0;
+        slice = INT32_MAX;
+    }
+    // translated code takes each TB off this budget, also without @count,
+    // so the same code serves counted runs and uncounted ones. The budget
+    // of a run can exceed what fits in icount_decr.u32, so keep the rest in
+    // icount_extra, like QEMU does for -icount
+    uc->cpu->icount_decr.u32 = (uint32_t)MIN(budget, slice);
+    uc->cpu->icount_extra = budget - uc->cpu->icount_decr.u32;
+
+    // the memory map or the MMU may have changed since the last run
+    if (uc->fastmem)
+        uc->fastmem_update(uc);
+
+    start = get_clock();
     if (uc->vm_start(uc)) {
         return UC_ERR_RESOURCE;
     }
+    uc->emu_ns += get_clock() - start;
 
     // emulation is done
     uc->emulation_done = true;
@@ -656,11 +792,6 @@ uc_err uc_emu_start(uc_engine* uc, uint64_t begin, uint64_t until, uint64_t time
     // remove hooks to delete
     clear_deleted_hooks(uc);
 
-    if (timeout) {
-        // wait for the timer to finish
-        qemu_thread_join(&uc->timer);
-    }
-
     return uc->invalid_error;
 }
 
@@ -681,34 +812,38 @@ uc_err uc_emu_stop(uc_engine *uc)
     return UC_ERR_OK;
 }
 
+// find the index of the first mapped region ending above @address.
+// mapped_blocks is kept sorted by address, so this is a binary search
+static uint32_t bsearch_mapped_blocks(const struct uc_struct *uc, uint64_t address)
+{
+    uint32_t left = 0, right = uc->mapped_block_count, mid;
+
+    while (left < right) {
+        mid = left + (right - left) / 2;
+        if (uc->mapped_blocks[mid]->end - 1 < address)
+            left = mid + 1;
+        else
+            right = mid;
+    }
+
+    return left;
+}
+
 // find if a memory range overlaps with existing mapped regions
 static bool memory_overlap(struct uc_struct *uc, uint64_t begin, size_t size)
 {
-    unsigned int i;
     uint64_t end = begin + size - 1;
+    uint32_t i = bsearch_mapped_blocks(uc, begin);
 
-    for(i = 0; i < uc->mapped_block_count; i++) {
-        // begin address falls inside this region?
-        if (begin >= uc->mapped_blocks[i]->addr && begin <= uc->mapped_blocks[i]->end - 1)
-            return true;
-
-        // end address falls inside this region?
-        if (end >= uc->mapped_blocks[i]->addr && end <= uc->mapped_blocks[i]->end - 1)
-            return true;
-
-        // this region falls totally inside this range?
-        if (begin < uc->mapped_blocks[i]->addr && end > uc->mapped_blocks[i]->end - 1)
-            return true;
-    }
-
-    // not found
-    return false;
+    // the first region ending at or after @begin must start after @end
+    return i < uc->mapped_block_count && uc->mapped_blocks[i]->addr <= end;
 }
 
 // common setup/error checking shared between uc_mem_map and uc_mem_map_ptr
 static uc_err mem_map(uc_engine *uc, uint64_t address, size_t size, uint32_t perms, MemoryRegion *block)
 {
     MemoryRegion **regions;
+    uint32_t i;
 
     if (block == NULL)
         return UC_ERR_NOMEM;
@@ -722,8 +857,15 @@ static uc_err mem_map(uc_engine *uc, uint64_t address, size_t size, uint32_t per
         uc->mapped_blocks = regions;
     }
 
-    uc->mapped_blocks[uc->mapped_block_count] = block;
+    // keep the array sorted: shift up the regions above this one
+    i = bsearch_mapped_blocks(uc, block->addr);
+    memmove(&uc->mapped_blocks[i + 1], &uc->mapped_blocks[i],
+            sizeof(MemoryRegion*) * (uc->mapped_block_count - i));
+
+    uc->mapped_blocks[i] = block;
     uc->mapped_block_count++;
+    uc->fastmem_stale = true;
+    uc->fork_frozen = false;
 
     return UC_ERR_OK;
 }
@@ -793,158 +935,281 @@ uc_err uc_mem_map_ptr(uc_engine *uc, uint64_t address, size_t size, uint32_t per
     return mem_map(uc, address, size, UC_PROT_ALL, uc->memory_map_ptr(uc, address, size, perms, ptr));
 }
 
-// Create a backup copy of the indicated MemoryRegion.
-// Generally used in prepartion for splitting a MemoryRegion.
-static uint8_t *copy_region(struct uc_struct *uc, MemoryRegion *mr)
+static int region_begin_compare(const void *a, const void *b)
+{
+    const uc_mem_region *x = a, *y = b;
+
+    return x->begin < y->begin ? -1 : x->begin > y->begin;
+}
+
+UNICORN_EXPORT
+uc_err uc_mem_map_batch(uc_engine *uc, const uc_mem_region *regions, uint32_t count)
+{
+    uc_mem_region *sorted;
+    uc_err res = UC_ERR_OK;
+    uint32_t i, mapped;
+
+    if (count == 0)
+        return UC_ERR_OK;
+
+    if (regions == NULL)
+        return UC_ERR_ARG;
+
+    sorted = g_memdup(regions, sizeof(*regions) * count);
+    for (i = 0; i < count && !res; i++) {
+        if (uc->mem_redirect) {
+            sorted[i].begin = uc->mem_redirect(sorted[i].begin);
+            sorted[i].end = uc->mem_redirect(sorted[i].end);
+        }
+        if (sorted[i].end < sorted[i].begin || sorted[i].end - sorted[i].begin + 1 == 0)
+            res = UC_ERR_ARG;
+        else
+            res = mem_map_check(uc, sorted[i].begin, sorted[i].end - sorted[i].begin + 1, sorted[i].perms);
+    }
+
+    // the regions must not overlap each other either
+    if (!res) {
+        qsort(sorted, count, sizeof(*sorted), region_begin_compare);
+        for (i = 1; i < count && !res; i++) {
+            if (sorted[i].begin <= sorted[i - 1].end)
+                res = UC_ERR_MAP;
+        }
+    }
+
+    if (res) {
+        g_free(sorted);
+        return res;
+    }
+
+    // one transaction: the memory map is only rebuilt once, if at all
+    uc->memory_begin(uc);
+    for (mapped = 0; mapped < count && !res; mapped++) {
+        res = mem_map(uc, sorted[mapped].begin, sorted[mapped].end - sorted[mapped].begin + 1,
+                sorted[mapped].perms, uc->memory_map(uc, sorted[mapped].begin,
+                    sorted[mapped].end - sorted[mapped].begin + 1, sorted[mapped].perms));
+    }
+
+    // all or nothing: drop what was mapped before the failure
+    if (res) {
+        for (i = 0; i + 1 < mapped; i++)
+            uc->memory_unmap(uc, memory_mapping(uc, sorted[i].begin));
+    }
+    uc->memory_commit(uc);
+    g_free(sorted);
+
+    return res;
+}
+
+// set the perms of @mr from the page counts: those all pages have, and
+// writable unless no page is. Back to one set of perms once the pages agree
+static void region_perms_update(struct uc_struct *uc, MemoryRegion *mr)
 {
-    uint8_t *block = (uint8_t *)g_malloc0((size_t)int128_get64(mr->size));
-    if (block != NULL) {
-        uc_err err = uc_mem_read(uc, mr->addr, block, (size_t)int128_get64(mr->size));
-        if (err != UC_ERR_OK) {
-            free(block);
-            block = NULL;
+    uint64_t pages = (mr->end - mr->addr) / uc->target_page_size;
+    uint32_t all = UC_PROT_ALL, any = 0, p;
+
+    for (p = 0; p <= UC_PROT_ALL; p++) {
+        if (mr->perms_pages[p] == 0)
+            continue;
+        if (mr->perms_pages[p] == pages) {
+            g_free(mr->page_perms);
+            mr->page_perms = NULL;
+        }
+        all &= p;
+        any |= p;
+    }
+
+    // this changes @perms too
+    uc->readonly_mem(mr, (any & UC_PROT_WRITE) == 0);
+    mr->perms = all;
+}
+
+// give the pages of @mr from @address, @size bytes, the permissions @perms.
+// Returns the permissions they had between them
+static uint32_t region_protect(struct uc_struct *uc, MemoryRegion *mr, uint64_t address,
+        size_t size, uint32_t perms)
+{
+    uint64_t pages = (mr->end - mr->addr) / uc->target_page_size;
+    uint64_t first = (address - mr->addr) / uc->target_page_size;
+    uint64_t count = size / uc->target_page_size, i;
+    uint32_t old = 0;
+
+    if (mr->page_perms == NULL) {
+        old = mr->perms;
+        if (count == pages || perms == mr->perms) {
+            // still the same perms for all pages
+            uc->readonly_mem(mr, (perms & UC_PROT_WRITE) == 0);
+            mr->perms = perms;
+            return old;
+        }
+        mr->page_perms = g_malloc(pages);
+        memset(mr->page_perms, mr->perms, pages);
+        memset(mr->perms_pages, 0, sizeof(mr->perms_pages));
+        mr->perms_pages[mr->perms] = pages;
+    }
+
+    for (i = first; i < first + count; i++) {
+        old |= mr->page_perms[i];
+        mr->perms_pages[mr->page_perms[i]]--;
+        mr->page_perms[i] = perms;
+    }
+    mr->perms_pages[perms] += count;
+    region_perms_update(uc, mr);
+
+    return old;
+}
+
+// give the pages of @mr the permissions of @page_perms, one per page
+static void region_set_perms(struct uc_struct *uc, MemoryRegion *mr, const uint8_t *page_perms)
+{
+    uint64_t pages = (mr->end - mr->addr) / uc->target_page_size, i;
+
+    g_free(mr->page_perms);
+    mr->page_perms = g_memdup(page_perms, pages);
+    memset(mr->perms_pages, 0, sizeof(mr->perms_pages));
+    for (i = 0; i < pages; i++)
+        mr->perms_pages[page_perms[i]]++;
+    region_perms_update(uc, mr);
+}
+
+// fill @r with the ranges of @mr having the same perms, if not NULL.
+// Returns the number of ranges
+static uint32_t region_perms_ranges(struct uc_struct *uc, MemoryRegion *mr, uc_mem_region *r)
+{
+    uint64_t pages, start, i;
+    uint32_t n = 0;
+
+    if (mr->page_perms == NULL) {
+        if (r) {
+            r->begin = mr->addr;
+            r->end = mr->end - 1;
+            r->perms = mr->perms;
+        }
+        return 1;
+    }
+
+    pages = (mr->end - mr->addr) / uc->target_page_size;
+    for (start = 0, i = 1; i <= pages; i++) {
+        if (i == pages || mr->page_perms[i] != mr->page_perms[start]) {
+            if (r) {
+                r[n].begin = mr->addr + start * uc->target_page_size;
+                r[n].end = mr->addr + i * uc->target_page_size - 1;
+                r[n].perms = mr->page_perms[start];
+            }
+            n++;
+            start = i;
         }
     }
 
-    return block;
+    return n;
 }
 
 /*
-   Split the given MemoryRegion at the indicated address for the indicated size
-   this may result in the create of up to 3 spanning sections. If the delete
-   parameter is true, the no new section will be created to replace the indicate
-   range. This functions exists to support uc_mem_protect and uc_mem_unmap.
+   Unmap the part of the MemoryRegion @mr from @address, @size bytes. What is
+   left of it is mapped again as up to 2 regions, with its bytes & perms. The
+   bytes are moved over to the new regions, and only copied if the host cannot
+   move them. This function exists to support uc_mem_unmap.
 
    This is a static function and callers have already done some preliminary
    parameter validation.
-
-   The do_delete argument indicates that we are being called to support
-   uc_mem_unmap. In this case we save some time by choosing NOT to remap
-   the areas that are intended to get unmapped
  */
-// TODO: investigate whether qemu region manipulation functions already offered
-// this capability
-static bool split_region(struct uc_struct *uc, MemoryRegion *mr, uint64_t address,
-        size_t size, bool do_delete)
+static bool split_region(struct uc_struct *uc, MemoryRegion *mr, uint64_t address, size_t size)
 {
-    uint8_t *backup;
-    uint32_t perms;
-    uint64_t begin, end, chunk_end;
-    size_t l_size, m_size, r_size;
-    RAMBlock *block = NULL;
-    bool prealloc = false;
-
-    chunk_end = address + size;
+    struct {
+        uint64_t begin;
+        size_t size;
+        uint8_t *bytes;     // where the bytes are kept meanwhile
+        bool moved;         // @bytes are the pages moved away, else a copy
+    } parts[2];
+    uint64_t begin = mr->addr, end = mr->end, chunk_end = address + size;
+    uint32_t perms = mr->perms;
+    uint8_t *host = mr->host, *page_perms;
+    bool user = mr->host_user, ok = true;
+    MemoryRegion *part;
+    int i, n = 0;
 
     // if this region belongs to area [address, address+size],
     // then there is no work to do.
-    if (address <= mr->addr && chunk_end >= mr->end)
+    if (address <= begin && chunk_end >= end)
         return true;
 
     if (size == 0)
         // trivial case
         return true;
 
-    if (address >= mr->end || chunk_end <= mr->addr)
+    if (address >= end || chunk_end <= begin)
         // impossible case
         return false;
 
-    QTAILQ_FOREACH(block, &uc->ram_list.blocks, next) {
-        if (block->offset <= mr->addr && block->length >= (mr->end - mr->addr)) {
-            break;
-        }
-    }
-
-    if (block == NULL)
-        return false;
-
-    // RAM_PREALLOC is not defined outside exec.c and I didn't feel like
-    // moving it
-	prealloc = !!(block->flags & 1);
-
-    if (block->flags & 1) {
-        backup = block->host;
-    } else {
-        backup = copy_region(uc, mr);
-        if (backup == NULL)
-            return false;
-    }
-
-    // save the essential information required for the split before mr gets deleted
-    perms = mr->perms;
-    begin = mr->addr;
-    end = mr->end;
-
-    // unmap this region first, then do split it later
-    if (uc_mem_unmap(uc, mr->addr, (size_t)int128_get64(mr->size)) != UC_ERR_OK)
-        goto error;
-
     /* overlapping cases
      *               |------mr------|
      * case 1    |---size--|
      * case 2           |--size--|
      * case 3                  |---size--|
      */
+    if (address > begin) {
+        parts[n].begin = begin;
+        parts[n].size = (size_t)(address - begin);
+        n++;
+    }
+    if (chunk_end < end) {
+        parts[n].begin = chunk_end;
+        parts[n].size = (size_t)(end - chunk_end);
+        n++;
+    }
 
-    // adjust some things
-    if (address < begin)
-        address = begin;
-    if (chunk_end > end)
-        chunk_end = end;
+    // take the bytes of the parts out of the region. Memory of
+    // uc_mem_map_ptr() stays where it is, its parts are mapped from there
+    for (i = 0; i < n && !user; i++) {
+        parts[i].bytes = qemu_ram_move(host + (parts[i].begin - begin), NULL, parts[i].size);
+        parts[i].moved = parts[i].bytes != NULL;
+        if (!parts[i].moved) {
+            parts[i].bytes = malloc(parts[i].size);
+            if (parts[i].bytes == NULL) {
+                // put back what was moved
+                if (i > 0 && parts[0].moved)
+                    qemu_ram_move(parts[0].bytes, host + (parts[0].begin - begin), parts[0].size);
+                else if (i > 0)
+                    free(parts[0].bytes);
+                return false;
+            }
+            memcpy(parts[i].bytes, host + (parts[i].begin - begin), parts[i].size);
+        }
+    }
 
-    // compute sub region sizes
-    l_size = (size_t)(address - begin);
-    r_size = (size_t)(end - chunk_end);
-    m_size = (size_t)(chunk_end - address);
+    // the region goes, its page perms go to the parts
+    page_perms = mr->page_perms;
+    mr->page_perms = NULL;
+    uc->memory_unmap(uc, mr);
 
     // If there are error in any of the below operations, things are too far gone
     // at that point to recover. Could try to remap orignal region, but these smaller
     // allocation just failed so no guarantee that we can recover the original
     // allocation at this point
-    if (l_size > 0) {
-        if (!prealloc) {
-            if (uc_mem_map(uc, begin, l_size, perms) != UC_ERR_OK)
-                goto error;
-            if (uc_mem_write(uc, begin, backup, l_size) != UC_ERR_OK)
-                goto error;
+    for (i = 0; i < n; i++) {
+        if (user) {
+            part = uc->memory_map_ptr(uc, parts[i].begin, parts[i].size, perms,
+                    host + (parts[i].begin - begin));
         } else {
-            if (uc_mem_map_ptr(uc, begin, l_size, perms, backup) != UC_ERR_OK)
-                goto error;
+            part = uc->memory_map(uc, parts[i].begin, parts[i].size, perms);
         }
-    }
-
-    if (m_size > 0 && !do_delete) {
-        if (!prealloc) {
-            if (uc_mem_map(uc, address, m_size, perms) != UC_ERR_OK)
-                goto error;
-            if (uc_mem_write(uc, address, backup + l_size, m_size) != UC_ERR_OK)
-                goto error;
-        } else {
-            if (uc_mem_map_ptr(uc, address, m_size, perms, backup + l_size) != UC_ERR_OK)
-                goto error;
+        ok = ok && mem_map(uc, parts[i].begin, parts[i].size, perms, part) == UC_ERR_OK;
+
+        if (!user && (part == NULL || !parts[i].moved ||
+                    !qemu_ram_move(parts[i].bytes, part->host, parts[i].size))) {
+            if (part != NULL)
+                memcpy(part->host, parts[i].bytes, parts[i].size);
+            if (parts[i].moved)
+                qemu_anon_ram_free(parts[i].bytes, parts[i].size);
+            else
+                free(parts[i].bytes);
         }
-    }
 
-    if (r_size > 0) {
-        if (!prealloc) {
-            if (uc_mem_map(uc, chunk_end, r_size, perms) != UC_ERR_OK)
-                goto error;
-            if (uc_mem_write(uc, chunk_end, backup + l_size + m_size, r_size) != UC_ERR_OK)
-                goto error;
-        } else {
-            if (uc_mem_map_ptr(uc, chunk_end, r_size, perms, backup + l_size + m_size) != UC_ERR_OK)
-                goto error;
-        }
+        if (part != NULL && page_perms != NULL)
+            region_set_perms(uc, part, page_perms + (parts[i].begin - begin) / uc->target_page_size);
     }
 
-    if (!prealloc)
-        free(backup);
-    return true;
-
-error:
-    if (!prealloc)
-        free(backup);
-    return false;
+    g_free(page_perms);
+    return ok;
 }
 
 UNICORN_EXPORT
@@ -979,27 +1244,35 @@ uc_err uc_mem_protect(struct uc_struct *uc, uint64_t address, size_t size, uint3
     if (!check_mem_area(uc, address, size))
         return UC_ERR_NOMEM;
 
+    // the RAM window may lose permissions
+    uc->fastmem_stale = true;
+
     // Now we know entire region is mapped, so change permissions
-    // We may need to split regions if this area spans adjacent regions
+    // of its pages. This area may span adjacent regions
     addr = address;
     count = 0;
     while(count < size) {
         mr = memory_mapping(uc, addr);
         len = (size_t)MIN(size - count, mr->end - addr);
-        if (!split_region(uc, mr, addr, len, false))
-            return UC_ERR_NOMEM;
-
-        mr = memory_mapping(uc, addr);
         // will this remove EXEC permission?
-        if (((mr->perms & UC_PROT_EXEC) != 0) && ((perms & UC_PROT_EXEC) == 0))
+        if ((region_protect(uc, mr, addr, len, perms) & UC_PROT_EXEC) != 0 &&
+                (perms & UC_PROT_EXEC) == 0) {
             remove_exec = true;
-        mr->perms = perms;
-        uc->readonly_mem(mr, (perms & UC_PROT_WRITE) == 0);
+            // code translated from this area must not run anymore
+            uc->tb_invalidate_uc_range(uc, addr, len);
+        }
 
         count += len;
         addr += len;
     }
 
+    // the TLB may still let through what is not allowed anymore
+    uc->tlb_flush_all(uc);
+
+    // the RAM window may have lost its permissions
+    if (uc->fastmem)
+        uc->fastmem_update(uc);
+
     // if EXEC permission is removed, then quit TB and continue at the same place
     if (remove_exec) {
         uc->quit_request = true;
@@ -1036,6 +1309,10 @@ uc_err uc_mem_unmap(struct uc_struct *uc, uint64_t address, size_t size)
     if (!check_mem_area(uc, address, size))
         return UC_ERR_NOMEM;
 
+    // the RAM window may go away
+    uc->fastmem_stale = true;
+    uc->fork_frozen = false;
+
     // Now we know entire region is mapped, so do the unmap
     // We may need to split regions if this area spans adjacent regions
     addr = address;
@@ -1043,7 +1320,7 @@ uc_err uc_mem_unmap(struct uc_struct *uc, uint64_t address, size_t size)
     while(count < size) {
         mr = memory_mapping(uc, addr);
         len = (size_t)MIN(size - count, mr->end - addr);
-        if (!split_region(uc, mr, addr, len, true))
+        if (!split_region(uc, mr, addr, len))
             return UC_ERR_NOMEM;
 
         // if we can retrieve the mapping, then no splitting took place
@@ -1076,12 +1353,12 @@ MemoryRegion *memory_mapping(struct uc_struct* uc, uint64_t address)
     if (i < uc->mapped_block_count && address >= uc->mapped_blocks[i]->addr && address < uc->mapped_blocks[i]->end)
         return uc->mapped_blocks[i];
 
-    for(i = 0; i < uc->mapped_block_count; i++) {
-        if (address >= uc->mapped_blocks[i]->addr && address <= uc->mapped_blocks[i]->end - 1) {
-            // cache this index for the next query
-            uc->mapped_block_cache_index = i;
-            return uc->mapped_blocks[i];
-        }
+    i = bsearch_mapped_blocks(uc, address);
+
+    if (i < uc->mapped_block_count && address >= uc->mapped_blocks[i]->addr) {
+        // cache this index for the next query
+        uc->mapped_block_cache_index = i;
+        return uc->mapped_blocks[i];
     }
 
     // not found
@@ -1136,10 +1413,21 @@ uc_err uc_hook_add(uc_engine *uc, uc_hook *hh, int type, void *callback,
             }
         }
 
+        hook_index_dirty(uc, UC_HOOK_INSN_IDX, hook);
         hook->refs++;
         return UC_ERR_OK;
     }
 
+    if (type & UC_HOOK_TB_DEPENDENT) {
+        // code translated before this hook existed does not call it
+        uc->tb_flush_request = true;
+    }
+
+    if (type & UC_HOOK_TLB_DEPENDENT) {
+        // the pages it covers must leave the TLB fast path, right now
+        uc->tlb_flush_all(uc);
+    }
+
     while ((type >> i) > 0) {
         if ((type >> i) & 1) {
             // TODO: invalid hook error?
@@ -1159,6 +1447,7 @@ uc_err uc_hook_add(uc_engine *uc, uc_hook *hh, int type, void *callback,
                         return UC_ERR_NOMEM;
                     }
                 }
+                hook_index_dirty(uc, i, hook);
                 hook->refs++;
             }
         }
@@ -1190,6 +1479,13 @@ uc_err uc_hook_del(uc_engine *uc, uc_hook hh)
         if (list_exists(&uc->hook[i], (void *) hook)) {
             hook->to_delete = true;
             list_append(&uc->hooks_to_del, hook);
+            hook_index_dirty(uc, i, hook);
+            if ((1 << i) & UC_HOOK_TB_DEPENDENT) {
+                uc->tb_flush_request = true;
+            }
+            if ((1 << i) & UC_HOOK_TLB_DEPENDENT) {
+                uc->tlb_flush_all(uc);
+            }
         }
     }
 
@@ -1201,7 +1497,7 @@ void helper_uc_tracecode(int32_t size, uc_hook_type type, void *handle, int64_t
 void helper_uc_tracecode(int32_t size, uc_hook_type type, void *handle, int64_t address)
 {
     struct uc_struct *uc = handle;
-    struct list_item *cur;
+    struct hook **cur, **last;
     struct hook *hook;
 
     // sync PC in CPUArchState with address
@@ -1209,22 +1505,186 @@ void helper_uc_tracecode(int32_t size, uc_hook_type type, void *handle, int64_t
         uc->set_pc(uc, address);
     }
 
-    for (cur = uc->hook[type].head; cur != NULL && (hook = (struct hook *)cur->data); cur = cur->next) {
+    for (cur = hook_index_find(uc, type, (uint64_t)address, &last); cur < last; cur++) {
+        hook = *cur;
         if (hook->to_delete)
             continue;
-        if (HOOK_BOUND_CHECK(hook, (uint64_t)address)) {
-            ((uc_cb_hookcode_t)hook->callback)(uc, address, size, hook->user_data);
+        uc->hook_calls[type]++;
+        ((uc_cb_hookcode_t)hook->callback)(uc, address, size, hook->user_data);
+    }
+}
+
+static int bound_compare(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+void hook_index_dirty(struct uc_struct *uc, int idx, struct hook *hook)
+{
+    struct hook_index *index = &uc->hook_index[idx];
+    uint64_t begin = 0, end = UINT64_MAX;
+
+    if (hook && hook->begin <= hook->end) {
+        begin = hook->begin;
+        end = hook->end;
+    }
+
+    if (!index->dirty) {
+        index->dirty = true;
+        index->dirty_begin = begin;
+        index->dirty_end = end;
+    } else {
+        index->dirty_begin = MIN(index->dirty_begin, begin);
+        index->dirty_end = MAX(index->dirty_end, end);
+    }
+}
+
+// whether @hook is live & covers some address of [begin, end], narrowing
+// them to what it covers
+static bool hook_clip(struct hook *hook, uint64_t *begin, uint64_t *end)
+{
+    if (hook->to_delete)
+        return false;
+    if (hook->begin > hook->end)
+        return true;
+    if (hook->end < *begin || hook->begin > *end)
+        return false;
+    *begin = MAX(*begin, hook->begin);
+    *end = MIN(*end, hook->end);
+    return true;
+}
+
+void hook_index_rebuild(struct uc_struct *uc, int idx)
+{
+    struct hook_index *index = &uc->hook_index[idx];
+    struct hook_index old = *index;
+    struct hook_index_seg *seg, *old_seg;
+    struct list_item *cur;
+    struct hook *hook;
+    uint64_t *bounds, lo = index->dirty_begin, hi = index->dirty_end, begin, end;
+    uint32_t bound_count = 0, hook_count = 0, live = 0, total, i, j;
+
+    // without segments yet, everything is to do
+    if (old.seg_count == 0) {
+        lo = 0;
+        hi = UINT64_MAX;
+    }
+
+    for (cur = uc->hook[idx].head; cur != NULL; cur = cur->next) {
+        hook_count++;
+        if (!((struct hook *)cur->data)->to_delete)
+            live++;
+    }
+
+    memset(index, 0, sizeof(*index));
+    if (live == 0) {
+        g_free(old.segs);
+        goto retire;
+    }
+
+    // segment boundaries: those out of [lo, hi] stay, the ones in there are
+    // where each hook starts & stops
+    bounds = g_new(uint64_t, old.seg_count + 2 * hook_count + 3);
+    bounds[bound_count++] = 0;
+    for (i = 0; i < old.seg_count; i++) {
+        if (old.segs[i].begin < lo || old.segs[i].begin > hi)
+            bounds[bound_count++] = old.segs[i].begin;
+    }
+    bounds[bound_count++] = lo;
+    if (hi != UINT64_MAX)
+        bounds[bound_count++] = hi + 1;
+    for (cur = uc->hook[idx].head; cur != NULL; cur = cur->next) {
+        hook = (struct hook *)cur->data;
+        if (hook->to_delete || hook->begin > hook->end)
+            continue;
+        if (hook->begin >= lo && hook->begin <= hi)
+            bounds[bound_count++] = hook->begin;
+        if (hook->end >= lo && hook->end < hi)
+            bounds[bound_count++] = hook->end + 1;
+    }
+
+    qsort(bounds, bound_count, sizeof(uint64_t), bound_compare);
+    for (i = 1, j = 1; i < bound_count; i++) {
+        if (bounds[i] != bounds[j - 1])
+            bounds[j++] = bounds[i];
+    }
+    bound_count = j;
+
+    index->segs = g_new0(struct hook_index_seg, bound_count);
+    index->seg_count = bound_count;
+    for (i = 0; i < bound_count; i++)
+        index->segs[i].begin = bounds[i];
+    g_free(bounds);
+
+    // out of [lo, hi], a segment has the hooks of the old one holding it.
+    // In there, a hook covers a whole segment or none of it: count it in
+    // the segments from the one holding the first address it covers
+    for (i = 0; i < bound_count; i++) {
+        seg = &index->segs[i];
+        if (seg->begin < lo || seg->begin > hi)
+            seg->count = old.segs[hook_index_seg(&old, seg->begin)].count;
+    }
+    for (cur = uc->hook[idx].head; cur != NULL; cur = cur->next) {
+        begin = lo;
+        end = hi;
+        if (!hook_clip((struct hook *)cur->data, &begin, &end))
+            continue;
+        for (i = hook_index_seg(index, begin); i < bound_count && index->segs[i].begin <= end; i++)
+            index->segs[i].count++;
+    }
+
+    for (i = 0, total = 0; i < bound_count; i++) {
+        index->segs[i].first = total;
+        total += index->segs[i].count;
+    }
+
+    // then fill them in, in hook list order
+    index->hooks = g_new(struct hook *, total ? total : 1);
+    for (i = 0; i < bound_count; i++) {
+        seg = &index->segs[i];
+        if (seg->begin < lo || seg->begin > hi) {
+            old_seg = &old.segs[hook_index_seg(&old, seg->begin)];
+            memcpy(index->hooks + seg->first, old.hooks + old_seg->first,
+                   seg->count * sizeof(struct hook *));
+        } else {
+            seg->count = 0;
+        }
+    }
+    for (cur = uc->hook[idx].head; cur != NULL; cur = cur->next) {
+        hook = (struct hook *)cur->data;
+        begin = lo;
+        end = hi;
+        if (!hook_clip(hook, &begin, &end))
+            continue;
+        for (i = hook_index_seg(index, begin); i < bound_count && index->segs[i].begin <= end; i++) {
+            seg = &index->segs[i];
+            index->hooks[seg->first + seg->count++] = hook;
         }
     }
+
+    g_free(old.segs);
+
+retire:
+    // a callback adding or deleting a hook gets here while the loop which
+    // called it still walks the old array, see HOOK_FOREACH_BOUNDED
+    if (old.hooks && uc->current_cpu && !uc->emulation_done)
+        list_append(&uc->hook_index_retired, old.hooks);
+    else
+        g_free(old.hooks);
 }
 
 UNICORN_EXPORT
 uint32_t uc_mem_regions(uc_engine *uc, uc_mem_region **regions, uint32_t *count)
 {
-    uint32_t i;
+    uint32_t i, n;
     uc_mem_region *r = NULL;
 
-    *count = uc->mapped_block_count;
+    // a region with pages of different perms is listed as one range per perms
+    for (i = 0, n = 0; i < uc->mapped_block_count; i++)
+        n += region_perms_ranges(uc, uc->mapped_blocks[i], NULL);
+    *count = n;
 
     if (*count) {
         r = g_malloc0(*count * sizeof(uc_mem_region));
@@ -1234,11 +1694,8 @@ uint32_t uc_mem_regions(uc_engine *uc, uc_mem_region **regions, uint32_t *count)
         }
     }
 
-    for (i = 0; i < *count; i++) {
-        r[i].begin = uc->mapped_blocks[i]->addr;
-        r[i].end = uc->mapped_blocks[i]->end - 1;
-        r[i].perms = uc->mapped_blocks[i]->perms;
-    }
+    for (i = 0, n = 0; i < uc->mapped_block_count; i++)
+        n += region_perms_ranges(uc, uc->mapped_blocks[i], r + n);
 
     *regions = r;
 
@@ -1246,9 +1703,75 @@ uint32_t uc_mem_regions(uc_engine *uc, uc_mem_region **regions, uint32_t *count)
 }
 
 UNICORN_EXPORT
-uc_err uc_query(uc_engine *uc, uc_query_type type, size_t *result)
+uc_err uc_mem_dirty_start(uc_engine *uc)
 {
-    switch(type) {
+    uc->dirty_clients |= 1 << DIRTY_MEMORY_USER;
+    uc->dirty_reset(uc, DIRTY_MEMORY_USER);
+
+    return UC_ERR_OK;
+}
+
+UNICORN_EXPORT
+uc_err uc_mem_dirty_get(uc_engine *uc, uc_mem_dirty **regions, uint32_t *count)
+{
+    uc_mem_dirty *r;
+    uint64_t *pages;
+    size_t words = 0;
+    uint32_t i;
+
+    if (!(uc->dirty_clients & (1 << DIRTY_MEMORY_USER)))
+        return UC_ERR_ARG;
+
+    // the regions, then the bitmaps of their pages, in one block
+    for (i = 0; i < uc->mapped_block_count; i++) {
+        MemoryRegion *mr = uc->mapped_blocks[i];
+        words += ((mr->end - mr->addr) / uc->target_page_size + 63) / 64;
+    }
+
+    *count = uc->mapped_block_count;
+    *regions = NULL;
+    if (*count == 0)
+        return UC_ERR_OK;
+
+    r = g_malloc0(*count * sizeof(uc_mem_dirty) + words * sizeof(uint64_t));
+    if (r == NULL) {
+        // out of memory
+        return UC_ERR_NOMEM;
+    }
+
+    pages = (uint64_t *)(r + *count);
+    for (i = 0; i < uc->mapped_block_count; i++) {
+        MemoryRegion *mr = uc->mapped_blocks[i];
+        uint64_t size = mr->end - mr->addr;
+
+        r[i].begin = mr->addr;
+        r[i].end = mr->end - 1;
+        r[i].pages = pages;
+        if (mr->ram)
+            uc->dirty_get(uc, DIRTY_MEMORY_USER, mr->ram_addr, size, pages);
+        pages += (size / uc->target_page_size + 63) / 64;
+    }
+
+    *regions = r;
+
+    return UC_ERR_OK;
+}
+
+UNICORN_EXPORT
+uc_err uc_mem_dirty_reset(uc_engine *uc)
+{
+    if (!(uc->dirty_clients & (1 << DIRTY_MEMORY_USER)))
+        return UC_ERR_ARG;
+
+    uc->dirty_reset(uc, DIRTY_MEMORY_USER);
+
+    return UC_ERR_OK;
+}
+
+UNICORN_EXPORT
+uc_err uc_query(uc_engine *uc, uc_query_type type, size_t *result)
+{
+    switch(type) {
         default:
             return UC_ERR_ARG;
 
@@ -1271,11 +1794,242 @@ uc_err uc_query(uc_engine *uc, uc_query_type type, size_t *result)
         case UC_QUERY_TIMEOUT:
             *result = uc->timed_out;
             break;
+
+        case UC_QUERY_TB_TRANSLATED:
+            *result = (size_t)uc->tb_translated;
+            break;
+
+        case UC_QUERY_TB_REUSED:
+            *result = (size_t)uc->tb_reused;
+            break;
+
+        case UC_QUERY_TB_FLUSHES:
+            *result = (size_t)uc->tb_flushes;
+            break;
+
+        case UC_QUERY_TB_EVICTED:
+            *result = (size_t)uc->tb_evicted;
+            break;
+
+        case UC_QUERY_CODE_BUFFER_SIZE:
+            *result = uc->code_buffer_size;
+            break;
+
+        case UC_QUERY_CODE_BUFFER_USED:
+            *result = uc->code_buffer_used;
+            break;
+
+        case UC_QUERY_TLB_SIZE:
+        case UC_QUERY_TLB_HITS:
+            return uc->tlb_query(uc, type, result);
+
+        case UC_QUERY_TLB_MISSES:
+            *result = (size_t)uc->tlb_misses;
+            break;
+
+        case UC_QUERY_TLB_FLUSHES:
+            *result = (size_t)uc->tlb_flushes;
+            break;
+    }
+
+    return UC_ERR_OK;
+}
+
+UNICORN_EXPORT
+uc_err uc_option(uc_engine *uc, uc_opt_type type, size_t value)
+{
+    switch(type) {
+        default:
+            return UC_ERR_ARG;
+
+        case UC_OPT_FASTMEM:
+            if (uc->fastmem_update == NULL)
+                return UC_ERR_ARG;
+            if (uc->fastmem != (value != 0)) {
+                uc->fastmem = (value != 0);
+                uc->fastmem_stale = true;
+                // code translated in the other mode is stale
+                uc->tb_flush_request = true;
+            }
+            break;
+
+        case UC_OPT_CODE_BUFFER_SIZE:
+            // not from hooks: translated code is running from the buffer
+            if (uc->current_cpu && !uc->emulation_done)
+                return UC_ERR_ARG;
+            uc->tcg_exec_resize(uc, value);
+            break;
+
+        case UC_OPT_TLB_SIZE:
+            // not from hooks: memory helpers are looking the TLB up
+            if (uc->current_cpu && !uc->emulation_done)
+                return UC_ERR_ARG;
+            if (!uc->tlb_resize(uc, value))
+                return UC_ERR_ARG;
+            break;
+
+        case UC_OPT_TLB_COUNT_HITS:
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+            if (uc->tlb_count_hits != (value != 0)) {
+                uc->tlb_count_hits = (value != 0);
+                // code translated in the other mode is stale
+                uc->tb_flush_request = true;
+            }
+            break;
+#else
+            return UC_ERR_ARG;
+#endif
+
+        case UC_OPT_PROFILE:
+            if (uc->profile != (value != 0)) {
+                uc->profile = (value != 0);
+                // code translated in the other mode is stale
+                uc->tb_flush_request = true;
+            }
+            break;
+
+        case UC_OPT_HOOK_DIRECT:
+            if (uc->arch != UC_ARCH_ARM && uc->arch != UC_ARCH_ARM64)
+                return UC_ERR_ARG;
+            if (uc->hook_direct != (value != 0)) {
+                uc->hook_direct = (value != 0);
+                // code translated in the other mode is stale
+                uc->tb_flush_request = true;
+            }
+            break;
     }
 
     return UC_ERR_OK;
 }
 
+UNICORN_EXPORT
+uc_err uc_stats_get(uc_engine *uc, uc_stats *stats)
+{
+    int i;
+
+    memset(stats, 0, sizeof(*stats));
+    stats->tb_translated = uc->tb_translated;
+    stats->tb_guest_bytes = uc->tb_guest_bytes;
+    stats->tb_host_bytes = uc->tb_host_bytes;
+    stats->tb_fast_hits = uc->tb_fast_hits;
+    stats->tb_slow_lookups = uc->tb_slow_lookups;
+    stats->tb_flushes = uc->tb_flushes;
+    stats->tb_evicted = uc->tb_evicted;
+    stats->tb_invalidated = uc->tb_invalidated;
+    stats->tlb_fills = uc->tlb_fills;
+    stats->tlb_misses = uc->tlb_misses;
+    stats->tlb_flushes = uc->tlb_flushes;
+
+    // hook lists mirror the order of the bits of uc_hook_type
+    for (i = 0; i < UC_HOOK_MAX; i++)
+        stats->hook_calls[i] = uc->hook_calls[i];
+
+    stats->translate_ns = uc->translate_ns;
+    // translation happens within uc_emu_start(), except for a few clock ticks
+    stats->execute_ns = MAX(uc->emu_ns - uc->translate_ns, 0);
+
+    return UC_ERR_OK;
+}
+
+// by address, flags, then in translation order
+static int profile_block_compare(const void *a, const void *b)
+{
+    const struct profile_block *x = a, *y = b;
+
+    if (x->tb.address != y->tb.address)
+        return x->tb.address < y->tb.address ? -1 : 1;
+    if (x->flags != y->flags)
+        return x->flags < y->flags ? -1 : 1;
+    return x->seq < y->seq ? -1 : x->seq > y->seq;
+}
+
+static int profile_count_compare(const void *a, const void *b)
+{
+    const struct profile_block *x = a, *y = b;
+
+    return x->tb.count > y->tb.count ? -1 : x->tb.count < y->tb.count;
+}
+
+// merge the runs of the same block, keeping the sizes of its last translation
+static void profile_compact(struct uc_struct *uc)
+{
+    struct profile_block *blocks = uc->profile_blocks;
+    size_t i, n = 0;
+
+    qsort(blocks, uc->profile_count, sizeof(*blocks), profile_block_compare);
+    for (i = 0; i < uc->profile_count; i++) {
+        if (n > 0 && blocks[n - 1].tb.address == blocks[i].tb.address &&
+                blocks[n - 1].flags == blocks[i].flags) {
+            blocks[n - 1].tb.count += blocks[i].tb.count;
+            blocks[n - 1].tb.size = blocks[i].tb.size;
+            blocks[n - 1].tb.host_size = blocks[i].tb.host_size;
+            blocks[n - 1].seq = blocks[i].seq;
+        } else {
+            blocks[n++] = blocks[i];
+        }
+    }
+    uc->profile_count = n;
+}
+
+void uc_profile_keep(struct uc_struct *uc, uint64_t pc, uint64_t flags, uint64_t seq,
+        uint32_t size, uint32_t host_size, uint64_t count)
+{
+    struct profile_block *block;
+
+    if (uc->profile_count == uc->profile_size) {
+        // blocks are retranslated after flushes: merge before growing
+        profile_compact(uc);
+        if (uc->profile_count >= uc->profile_size / 2) {
+            size_t new_size = uc->profile_size ? uc->profile_size * 2 : 256;
+            struct profile_block *blocks = realloc(uc->profile_blocks, new_size * sizeof(*blocks));
+
+            if (blocks == NULL) {
+                // out of memory: lose these runs rather than the profile
+                if (uc->profile_count == uc->profile_size)
+                    return;
+            } else {
+                uc->profile_blocks = blocks;
+                uc->profile_size = new_size;
+            }
+        }
+    }
+
+    block = &uc->profile_blocks[uc->profile_count++];
+    block->tb.address = pc;
+    block->tb.size = size;
+    block->tb.host_size = host_size;
+    block->tb.count = count;
+    block->flags = flags;
+    block->seq = seq;
+}
+
+UNICORN_EXPORT
+uc_err uc_profile_get(uc_engine *uc, uc_tb_profile *blocks, size_t count, size_t *found)
+{
+    size_t i;
+
+    // the runs of the translated code still in the cache come last
+    uc->tb_profile_harvest(uc);
+    profile_compact(uc);
+
+    qsort(uc->profile_blocks, uc->profile_count, sizeof(*uc->profile_blocks),
+            profile_count_compare);
+    *found = MIN(count, uc->profile_count);
+    for (i = 0; i < *found; i++)
+        blocks[i] = uc->profile_blocks[i].tb;
+
+    return UC_ERR_OK;
+}
+
+UNICORN_EXPORT
+uc_err uc_profile_reset(uc_engine *uc)
+{
+    uc->tb_profile_harvest(uc);
+    uc->profile_count = 0;
+
+    return UC_ERR_OK;
+}
+
 static size_t cpu_context_size(uc_arch arch, uc_mode mode)
 {
     // each of these constants is defined by offsetof(CPUXYZState, tlb_table)
@@ -1323,10 +2077,30 @@ uc_err uc_context_alloc(uc_engine *uc, uc_context **context)
     struct uc_context **_context = context;
     size_t size = cpu_context_size(uc->arch, uc->mode);
 
-    *_context = malloc(size);
+    *_context = malloc(sizeof(uc_context) + size + sizeof(*uc->cpu->jmp_env));
     if (*_context) {
         (*_context)->jmp_env_size = sizeof(*uc->cpu->jmp_env);
-        (*_context)->context_size = size - sizeof(uc_context) - (*_context)->jmp_env_size;
+        (*_context)->context_size = size;
+        (*_context)->user = false;
+        return UC_ERR_OK;
+    } else {
+        return UC_ERR_NOMEM;
+    }
+}
+
+UNICORN_EXPORT
+uc_err uc_context_alloc_user(uc_engine *uc, uc_context **context)
+{
+    struct uc_context **_context = context;
+
+    if (uc->context_user_size == 0)
+        return UC_ERR_ARCH;
+
+    *_context = malloc(sizeof(uc_context) + uc->context_user_size);
+    if (*_context) {
+        (*_context)->jmp_env_size = 0;
+        (*_context)->context_size = uc->context_user_size;
+        (*_context)->user = true;
         return UC_ERR_OK;
     } else {
         return UC_ERR_NOMEM;
@@ -1343,13 +2117,19 @@ uc_err uc_free(void *mem)
 UNICORN_EXPORT
 size_t uc_context_size(uc_engine *uc)
 {
-    // return the total size of struct uc_context
-    return sizeof(uc_context) + cpu_context_size(uc->arch, uc->mode) + sizeof(*uc->cpu->jmp_env);
+    // return the total size of struct uc_context, of either kind
+    return sizeof(uc_context) + MAX(cpu_context_size(uc->arch, uc->mode) + sizeof(*uc->cpu->jmp_env),
+            uc->context_user_size);
 }
 
 UNICORN_EXPORT
 uc_err uc_context_save(uc_engine *uc, uc_context *context)
 {
+    if (context->user) {
+        uc->context_user_save(uc, context->data);
+        return UC_ERR_OK;
+    }
+
     memcpy(context->data, uc->cpu->env_ptr, context->context_size);
     memcpy(context->data + context->context_size, uc->cpu->jmp_env, context->jmp_env_size);
 
@@ -1359,8 +2139,400 @@ uc_err uc_context_save(uc_engine *uc, uc_context *context)
 UNICORN_EXPORT
 uc_err uc_context_restore(uc_engine *uc, uc_context *context)
 {
+    if (context->user) {
+        uc->context_user_restore(uc, context->data);
+        // as when writing the PC register: quit the current TB, if any
+        uc->quit_request = true;
+        uc_emu_stop(uc);
+        return UC_ERR_OK;
+    }
+
     memcpy(uc->cpu->env_ptr, context->data, context->context_size);
     memcpy(uc->cpu->jmp_env, context->data + context->context_size, context->jmp_env_size);
 
     return UC_ERR_OK;
 }
+
+// offsets of the RAM regions in the file of a fork, for any host page size
+#define FORK_ALIGN 0x10000
+#define FORK_COPY UINT64_MAX
+
+// move the RAM of @uc to a new file and map it back from there, copy-on-write,
+// so that forks can map it too. Returns false if forks have to copy it instead
+static bool fork_freeze(uc_engine *uc)
+{
+    MemoryRegion *mr;
+    uint64_t size = 0;
+    uint32_t i;
+    int fd;
+
+    if (uc->fork_frozen)
+        return true;
+
+    // regions one after the other, but for the memory given to uc_mem_map_ptr()
+    uc->fork_offsets = g_renew(uint64_t, uc->fork_offsets, uc->mapped_block_count);
+    for (i = 0; i < uc->mapped_block_count; i++) {
+        mr = uc->mapped_blocks[i];
+        if (mr->host_user) {
+            uc->fork_offsets[i] = FORK_COPY;
+        } else {
+            uc->fork_offsets[i] = size;
+            size += QEMU_ALIGN_UP(mr->end - mr->addr, FORK_ALIGN);
+        }
+    }
+
+    fd = qemu_ram_cow_file(size);
+    if (fd < 0)
+        return false;
+
+    for (i = 0; i < uc->mapped_block_count; i++) {
+        mr = uc->mapped_blocks[i];
+        if (uc->fork_offsets[i] != FORK_COPY &&
+                !qemu_ram_cow_freeze(fd, uc->fork_offsets[i], mr->host, (size_t)(mr->end - mr->addr)))
+            uc->fork_offsets[i] = FORK_COPY;
+    }
+
+    // regions still mapped from the previous file keep it open
+    if (uc->fork_fd >= 0)
+        qemu_ram_cow_close(uc->fork_fd);
+    uc->fork_fd = fd;
+    uc->fork_frozen = true;
+
+    return true;
+}
+
+// copy the hooks of @uc to @child, in the same order, each once whatever lists it is in
+static uc_err fork_hooks(uc_engine *uc, uc_engine *child)
+{
+    GHashTable *copies = g_hash_table_new(NULL, NULL);
+    struct list_item *cur;
+    struct hook *hook, *copy;
+    uc_err err = UC_ERR_OK;
+    int i;
+
+    for (i = 0; i < UC_HOOK_MAX && err == UC_ERR_OK; i++) {
+        for (cur = uc->hook[i].head; cur != NULL; cur = cur->next) {
+            hook = (struct hook *)cur->data;
+            if (hook->to_delete)
+                continue;
+
+            copy = g_hash_table_lookup(copies, hook);
+            if (copy == NULL) {
+                copy = malloc(sizeof(*copy));
+                if (copy == NULL) {
+                    err = UC_ERR_NOMEM;
+                    break;
+                }
+                *copy = *hook;
+                copy->refs = 0;
+                g_hash_table_insert(copies, hook, copy);
+            }
+
+            if (list_append(&child->hook[i], copy) == NULL) {
+                if (copy->refs == 0)
+                    free(copy);
+                err = UC_ERR_NOMEM;
+                break;
+            }
+            copy->refs++;
+            hook_index_dirty(child, i, copy);
+        }
+    }
+
+    g_hash_table_destroy(copies);
+    return err;
+}
+
+UNICORN_EXPORT
+uc_err uc_fork(uc_engine *uc, uc_engine **result)
+{
+    uc_engine *child;
+    MemoryRegion *mr, *copy_mr;
+    size_t size;
+    bool frozen;
+    uint32_t i;
+    uc_err err;
+
+    // not from hooks: the running CPU is not in sync with its registers
+    if (uc->current_cpu && !uc->emulation_done)
+        return UC_ERR_ARG;
+
+    err = uc_open(uc->arch, uc->mode, &child);
+    if (err)
+        return err;
+
+    // the same memory map. RAM is shared until written, if the host can
+    frozen = fork_freeze(uc);
+    for (i = 0; i < uc->mapped_block_count; i++) {
+        mr = uc->mapped_blocks[i];
+        size = (size_t)(mr->end - mr->addr);
+        err = mem_map(child, mr->addr, size, mr->perms, child->memory_map(child, mr->addr, size, mr->perms));
+        if (err)
+            goto error;
+
+        // mapped in order, so at the end of the child's array
+        copy_mr = child->mapped_blocks[i];
+        if (!frozen || uc->fork_offsets[i] == FORK_COPY ||
+                !qemu_ram_cow_map(uc->fork_fd, uc->fork_offsets[i], copy_mr->host, size))
+            memcpy(copy_mr->host, mr->host, size);
+        if (mr->page_perms)
+            region_set_perms(child, copy_mr, mr->page_perms);
+    }
+
+    // the registers uc_context_save() saves
+    memcpy(child->cpu->env_ptr, uc->cpu->env_ptr, cpu_context_size(uc->arch, uc->mode));
+    if (child->env_copied)
+        child->env_copied(child);
+
+    err = fork_hooks(uc, child);
+    if (err)
+        goto error;
+
+    // the same options. Nothing is translated yet, so no flush is needed
+    child->hook_insert = uc->hook_insert;
+    child->hook_direct = uc->hook_direct;
+    child->fastmem = uc->fastmem;
+    child->tlb_count_hits = uc->tlb_count_hits;
+    child->profile = uc->profile;
+    if (child->code_buffer_size != uc->code_buffer_size)
+        child->tcg_exec_resize(child, uc->code_buffer_size);
+    if (child->tlb_size != uc->tlb_size)
+        child->tlb_resize(child, uc->tlb_size);
+
+    *result = child;
+    return UC_ERR_OK;
+
+error:
+    uc_close(child);
+    return err;
+}
+
+// the pages written from now on are those that differ from @snapshot
+static void snapshot_track(uc_engine *uc, uc_snapshot *snapshot)
+{
+    uc->dirty_clients |= 1 << DIRTY_MEMORY_SNAPSHOT;
+    uc->dirty_reset(uc, DIRTY_MEMORY_SNAPSHOT);
+    snapshot->generation = ++uc->snapshot_generation;
+}
+
+UNICORN_EXPORT
+uc_err uc_snapshot_take(uc_engine *uc, uc_snapshot **result)
+{
+    uc_snapshot *snapshot;
+    struct uc_snapshot_region *r;
+    MemoryRegion *mr;
+    uint64_t pages, words = 0;
+    uint32_t i;
+
+    // not from hooks: the running CPU is not in sync with its registers
+    if (uc->current_cpu && !uc->emulation_done)
+        return UC_ERR_ARG;
+
+    snapshot = g_new0(uc_snapshot, 1);
+    snapshot->region_count = uc->mapped_block_count;
+    snapshot->regions = g_new0(struct uc_snapshot_region, uc->mapped_block_count);
+    for (i = 0; i < uc->mapped_block_count; i++) {
+        mr = uc->mapped_blocks[i];
+        r = &snapshot->regions[i];
+        pages = (mr->end - mr->addr) / uc->target_page_size;
+        r->mr = mr;
+        r->addr = mr->addr;
+        r->end = mr->end;
+        r->perms = mr->perms;
+        if (mr->page_perms)
+            r->page_perms = g_memdup(mr->page_perms, pages);
+        if (mr->host_user)
+            r->host = mr->host;
+        r->data = g_memdup(mr->host, (size_t)(mr->end - mr->addr));
+        words = MAX(words, (pages + 63) / 64);
+    }
+    snapshot->dirty = g_new(uint64_t, words);
+
+    snapshot->context_size = cpu_context_size(uc->arch, uc->mode);
+    snapshot->env = g_memdup(uc->cpu->env_ptr, snapshot->context_size);
+
+    snapshot_track(uc, snapshot);
+
+    *result = snapshot;
+    return UC_ERR_OK;
+}
+
+// copy the bytes of @r back to its region, only the pages written since if @dirty
+static void snapshot_restore_data(uc_engine *uc, uc_snapshot *snapshot,
+        struct uc_snapshot_region *r, bool dirty)
+{
+    MemoryRegion *mr = r->mr;
+    uint64_t size = r->end - r->addr;
+    uint64_t pages = size / uc->target_page_size, page, last, *bits = snapshot->dirty;
+    size_t offset, len;
+
+    // the host writes to the memory of uc_mem_map_ptr() are not seen
+    if (!dirty || r->host) {
+        memcpy(mr->host, r->data, (size_t)size);
+        uc->ram_written(uc, mr->ram_addr, (size_t)size);
+        return;
+    }
+
+    memset(bits, 0, (pages + 63) / 64 * sizeof(uint64_t));
+    uc->dirty_get(uc, DIRTY_MEMORY_SNAPSHOT, mr->ram_addr, (size_t)size, bits);
+
+    // each run of pages written
+    page = 0;
+    while (page < pages) {
+        if ((bits[page / 64] >> (page % 64)) == 0) {
+            page = (page / 64 + 1) * 64;
+            continue;
+        }
+        if (!(bits[page / 64] & (1ULL << (page % 64)))) {
+            page++;
+            continue;
+        }
+        for (last = page + 1; last < pages && (bits[last / 64] & (1ULL << (last % 64))); last++)
+            ;
+
+        offset = (size_t)(page * uc->target_page_size);
+        len = (size_t)((last - page) * uc->target_page_size);
+        memcpy(mr->host + offset, r->data + offset, len);
+        // and the code translated from them is stale
+        uc->ram_written(uc, mr->ram_addr + offset, len);
+        page = last;
+    }
+}
+
+// give the region of @r the perms of its pages back, if they changed
+static void snapshot_restore_perms(uc_engine *uc, struct uc_snapshot_region *r)
+{
+    MemoryRegion *mr = r->mr;
+    uint64_t size = r->end - r->addr;
+
+    if (r->page_perms) {
+        if (mr->page_perms && !memcmp(mr->page_perms, r->page_perms, size / uc->target_page_size))
+            return;
+        region_set_perms(uc, mr, r->page_perms);
+    } else {
+        if (mr->page_perms == NULL && mr->perms == r->perms)
+            return;
+        region_protect(uc, mr, mr->addr, (size_t)size, r->perms);
+    }
+
+    // code translated with other perms must not run
+    uc->tb_invalidate_uc_range(uc, mr->addr, size);
+    uc->fastmem_stale = true;
+}
+
+UNICORN_EXPORT
+uc_err uc_snapshot_restore(uc_engine *uc, uc_snapshot *snapshot)
+{
+    struct uc_snapshot_region *r;
+    MemoryRegion *mr, **stale, **fresh;
+    bool dirty = snapshot->generation == uc->snapshot_generation, *kept;
+    uint32_t i, j, n = 0, m = 0;
+    size_t size;
+    uc_err err = UC_ERR_OK;
+
+    // not from hooks: the running CPU is not in sync with its registers
+    if (uc->current_cpu && !uc->emulation_done)
+        return UC_ERR_ARG;
+
+    // the regions still mapped as they were. Both arrays are sorted by address
+    stale = g_new(MemoryRegion *, uc->mapped_block_count);
+    kept = g_new0(bool, snapshot->region_count);
+    for (i = 0, j = 0; i < uc->mapped_block_count; i++) {
+        mr = uc->mapped_blocks[i];
+        while (j < snapshot->region_count && snapshot->regions[j].end <= mr->addr)
+            j++;
+        r = j < snapshot->region_count ? &snapshot->regions[j] : NULL;
+        if (r && r->mr == mr && r->addr == mr->addr && r->end == mr->end &&
+                r->host == (mr->host_user ? mr->host : NULL))
+            kept[j] = true;
+        else
+            stale[n++] = mr;
+    }
+
+    // the others are mapped again, in one memory transaction, while the
+    // stale ones are still there: if one cannot be allocated, dropping the
+    // new ones leaves the engine as it was
+    fresh = g_new(MemoryRegion *, snapshot->region_count);
+    uc->memory_begin(uc);
+    for (j = 0; j < snapshot->region_count; j++) {
+        r = &snapshot->regions[j];
+        if (kept[j])
+            continue;
+
+        size = (size_t)(r->end - r->addr);
+        if (r->host)
+            mr = uc->memory_map_ptr(uc, r->addr, size, r->perms, r->host);
+        else
+            mr = uc->memory_map(uc, r->addr, size, r->perms);
+        if (mr == NULL) {
+            err = UC_ERR_NOMEM;
+            break;
+        }
+        fresh[m++] = mr;
+    }
+    uc->memory_commit(uc);
+
+    // memory_unmap() frees the region at once, so not inside the transaction
+    // where the address space still points to it
+    if (err) {
+        // it only frees those in mapped_blocks, the others keep their order
+        for (i = 0; i < m; i++) {
+            mem_map(uc, fresh[i]->addr, (size_t)(fresh[i]->end - fresh[i]->addr),
+                    fresh[i]->perms, fresh[i]);
+            uc->memory_unmap(uc, fresh[i]);
+        }
+    } else {
+        for (i = 0; i < n; i++)
+            uc->memory_unmap(uc, stale[i]);
+        for (j = 0, i = 0; j < snapshot->region_count; j++) {
+            r = &snapshot->regions[j];
+            if (kept[j])
+                continue;
+            r->mr = fresh[i++];
+            mem_map(uc, r->addr, (size_t)(r->end - r->addr), r->perms, r->mr);
+            if (r->page_perms)
+                region_set_perms(uc, r->mr, r->page_perms);
+        }
+    }
+    g_free(fresh);
+    g_free(stale);
+    if (err) {
+        g_free(kept);
+        return err;
+    }
+
+    for (j = 0; j < snapshot->region_count; j++) {
+        r = &snapshot->regions[j];
+        snapshot_restore_data(uc, snapshot, r, dirty && kept[j]);
+        if (kept[j])
+            snapshot_restore_perms(uc, r);
+    }
+    uc->fork_frozen = false;
+    g_free(kept);
+
+    memcpy(uc->cpu->env_ptr, snapshot->env, snapshot->context_size);
+
+    // the MMU may have been set up differently
+    uc->tlb_flush_all(uc);
+
+    snapshot_track(uc, snapshot);
+
+    return UC_ERR_OK;
+}
+
+UNICORN_EXPORT
+uc_err uc_snapshot_free(uc_snapshot *snapshot)
+{
+    uint32_t i;
+
+    for (i = 0; i < snapshot->region_count; i++) {
+        g_free(snapshot->regions[i].page_perms);
+        g_free(snapshot->regions[i].data);
+    }
+    g_free(snapshot->regions);
+    g_free(snapshot->dirty);
+    g_free(snapshot->env);
+    g_free(snapshot);
+
+    return UC_ERR_OK;
+}